@@ -57,6 +57,17 @@ const char* ITEM_SYSTEM       = D_ITEM_SYSTEM;
 const char* ITEM_TOKEN        = D_ITEM_TOKEN;
 const char* ITEM_PAYLOAD      = D_ITEM_PAYLOAD;
 const char* ITEM_PEERS        = D_ITEM_PEERS;
+const char* ITEM_SEQ          = D_ITEM_SEQ;
+const char* ITEM_SINCE_SEQ    = D_ITEM_SINCE_SEQ;
+const char* ITEM_LAST_SEQ     = D_ITEM_LAST_SEQ;
+const char* ITEM_LIMIT        = D_ITEM_LIMIT;
+const char* ITEM_MESSAGES     = D_ITEM_MESSAGES;
+const char* ITEM_VERSION      = D_ITEM_VERSION;
+const char* ITEM_SINCE_VERSION = D_ITEM_SINCE_VERSION;
+const char* ITEM_DELTAS       = D_ITEM_DELTAS;
+const char* ITEM_MOVE         = D_ITEM_MOVE;
+const char* ITEM_FRAMING      = D_ITEM_FRAMING;
+const char* ITEM_DEFLATE      = D_ITEM_DEFLATE;
 
 #if SECURE
 const char* ITEM_PRIVATE_REQUEST = D_ITEM_PRIVATE_REQUEST;
@@ -64,6 +75,9 @@ const char* ITEM_PRIVATE_CONFIRM = D_ITEM_PRIVATE_CONFIRM;
 const char* ITEM_PRIVATE_ABORT   = D_ITEM_PRIVATE_ABORT;
 const char* ITEM_PRIVATE_PUBKEY  = D_ITEM_PRIVATE_PUBKEY;
 const char* ITEM_PRIVATE_PUBKEY_EXCHANGE = D_ITEM_PRIVATE_PUBKEY_EXCHANGE;
+const char* ITEM_PRIVATE_EPHEMERAL = D_ITEM_PRIVATE_EPHEMERAL;
+const char* ITEM_SENDER_KEY   = D_ITEM_SENDER_KEY;
+const char* ITEM_GENERATION   = D_ITEM_GENERATION;
 #endif  // SECURE
 
 const char* PATH_ADMIN          = D_PATH_ADMIN;
@@ -79,6 +93,11 @@ const char* PATH_IS_REGISTERED  = D_PATH_IS_REGISTERED;
 const char* PATH_CHECK_AUTH     = D_PATH_CHECK_AUTH;
 const char* PATH_KICK_BY_AUTH   = D_PATH_KICK_BY_AUTH;
 const char* PATH_ALL_PEERS      = D_PATH_ALL_PEERS;
+const char* PATH_HISTORY        = D_PATH_HISTORY;
+const char* PATH_RESUME         = D_PATH_RESUME;
+const char* PATH_WEBSOCKET      = D_PATH_WEBSOCKET;
+const char* PATH_STREAM         = D_PATH_STREAM;
+const char* PATH_HELLO          = D_PATH_HELLO;
 
 #if SECURE
 const char* PATH_PRIVATE_REQUEST = D_PATH_PRIVATE_REQUEST;
@@ -29,7 +29,9 @@
 #ifndef CHAT_SERVER_API__H__
 #define CHAT_SERVER_API__H__
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include "structures.h"
 #include "types.h"
@@ -39,6 +41,8 @@
 /**
  *  Body format: JSON
  *
+ *  GET   /hello - get Server's hello, sent right after connection is accepted
+ *
  *  GET   /login - get login form
  *  POST  /login - send filled login form
  *
@@ -57,12 +61,32 @@
  *
  *  GET   /all_peers           - get list of all logged in peers
  *  GET   /all_peers?channel=K - get list of all logged in peers on channel
+ *  GET   /all_peers?channel=K&since_version=V - get changes of list since version V
+ *
+ *  GET   /history?channel=K&since_seq=S&limit=L - get messages on channel after S
+ *
+ *  PUT   /resume?id=N&token=str - resume session on new connection
  *
  *  terminate code: 99
  */
 
 /* API details */
 // ----------------------------------------------------------------------------
+/* Hello */
+// ----------------------------------------------
+/**
+ *  GET /hello
+ *
+ *  Get Server's hello, see ClientApi::getHello().
+ *
+ *  @response_body:  {"system":TEXT,"payload":TEXT}
+ *
+ *  @note:  browsers and other standard HTTP clients speak first, so hello is
+ *          not sent to a connection whose first request (WebSocket upgrade,
+ *          event stream or any other) arrives in time. Connection staying
+ *          silent for hello delay gets hello unasked, as older clients expect.
+ */
+
 /* Administrating */
 // ----------------------------------------------
 /**
@@ -158,6 +182,8 @@
  *  @response_body:  {"code":INT,"action":INT,"id":INT,"token":TEXT,"payload":TEXT}
  *
  *  @note:  message as @request_body is then sent to peer[s].
+ *          Message to dedicated peer being offline is queued and delivered
+ *          right after the peer logs in again.
  */
 
 /* Switch Channel */
@@ -228,11 +254,65 @@
  *
  *  Get list of all logged in peers [on channel];
  *
- *  @params: channel  : INT - channel to get peers on [OPTIONAL]
+ *  @params: channel        : INT - channel to get peers on [OPTIONAL]
+ *           since_version  : INT - get only changes made after this version of list [OPTIONAL]
+ *
+ *  @response_body:  {"peers":[{"id":INT,"login":TEXT,"email":TEXT,"channel":INT},{},{},...],"channel":INT,"version":INT}
  *
- *  @response_body:  {"peers":[{"id":INT,"login":TEXT,"email":TEXT,"channel":INT},{},{},...],"channel":INT}
+ *  @response_body:  {"deltas":[{"move":INT,"id":INT,"login":TEXT,"email":TEXT,"channel":INT},{},{},...],
+ *                    "channel":INT,"version":INT,"since_version":INT}
  *
  *  @note:  channel could be missing in @response_body, if it was not specified in @params.
+ *          Status with INVALID_QUERY is sent if channel or since_version is not a number.
+ *
+ *  @note:  version grows with every login, logout and channel switch. Deltas are returned
+ *          if since_version is given and changes after it are still kept by Server, they
+ *          must be applied in order: JOIN and MOVE put peer into list or update it, LEAVE
+ *          removes peer. On channel, peer moved in or out comes as JOIN or LEAVE. Otherwise
+ *          the whole list is returned, as without since_version.
+ */
+
+/* Messages history */
+// ----------------------------------------------
+/**
+ *  GET /history
+ *
+ *  Get page of messages broadcasted on channel, ordered by sequence number.
+ *
+ *  @params: channel    : INT - channel to get messages on
+ *           since_seq  : INT - get messages with greater sequence number [OPTIONAL]
+ *           limit      : INT - max number of messages, 50 by default, 500 at most [OPTIONAL]
+ *           token      : TEXT - read token for channel, if peer is not logged in [OPTIONAL]
+ *
+ *  @response_body:  {"code":INT,"channel":INT,"last_seq":INT,"messages":[{"seq":INT,"message":{...}},{},{},...]}
+ *
+ *  @note:  if since_seq is missing, the last @limit messages are returned.
+ *
+ *  @note:  history is given to a peer logged in over the same connection or
+ *          with read token (see /stream), otherwise status is UNAUTHORIZED.
+ */
+
+/* Session resumption */
+// ----------------------------------------------
+/**
+ *  PUT /resume
+ *
+ *  Rebind session of logged in peer to the current connection after the
+ *  previous one has dropped, keeping peer's channel and pending handshakes.
+ *
+ *  @params: id     : INT - peer's id
+ *           token  : TEXT - session token received in response to login
+ *
+ *  @response_body:  {"code":INT,"action":INT,"id":INT,"token":TEXT,"payload":TEXT}
+ *  @payload:        {"login":TEXT,"email":TEXT,"channel":INT}
+ *
+ *  @note:  session is kept within grace period after connection drop, then
+ *          peer is logged out. Messages broadcasted on peer's channel meanwhile
+ *          are replayed right after @response_body in /history format.
+ *
+ *  @note:  only a detached session could be resumed. Token is sent only in
+ *          successful responses to login, registration and resume, to the
+ *          connection owning the session; it is empty in any other status.
  */
 
 /* Private secure communication */
@@ -293,9 +373,16 @@
  *
  *  @params:  id   :  INT - source peer's id
  *
- *  @request_body:  {"private_pubkey":{"id":INT,"key":TEXT}}
+ *  @request_body:  {"private_pubkey":{"id":INT,"key":TEXT,"version":INT}}
  *
  *  @response_body:  {"code":INT,"action":INT,"id":INT,"token":TEXT,"payload":TEXT}
+ *
+ *  @note:  version 1 (default, if omitted) - key is RSA public key in PEM;
+ *          version 2 - key is base64 of X25519 public key, Ed25519 identity
+ *          public key and Ed25519 signature, see crypting/agreement.h.
+ *          Peers agree on session key only if both have sent version 2 keys.
+ *          Server does not vouch for identity: client remembers identity of
+ *          each peer on first use and rejects another one later.
  */
 
 /**
@@ -306,9 +393,33 @@
  *  @params:  src_id   :  INT - source peer's id
  *            dest_id  :  INT - destination peer's id
  *
+ *  @request_body:  {"private_ephemeral":{"id":INT,"key":TEXT,"version":2}}, optional
+ *
  *  @response_body:  {"code":INT,"action":INT,"id":INT,"token":TEXT,"payload":TEXT}
  *
  *  @note:  public keys must exist on Server-side for each peer.
+ *
+ *  @note:  destination peer receives source's public key and one-time key, if given:
+ *
+ *          {"private_pubkey":{"id":INT,"key":TEXT,"version":INT},"private_ephemeral":{...}}
+ *
+ *          One-time key is base64 of X25519 public key and Ed25519 signature
+ *          by source's identity, see crypting/agreement.h. Both peers mix
+ *          their latest one-time keys into session key.
+ */
+
+/**
+ *  Group secure communication (no dedicated path)
+ *
+ *  Sender distributes its sender key for current channel to each peer it has
+ *  agreed session key with, as a dedicated POST /message encrypted with that
+ *  session key. Decrypted message reads:
+ *
+ *          {"sender_key":{"id":INT,"channel":INT,"generation":INT,"key":TEXT}}
+ *
+ *  Then every channel message is encrypted only once with sender key and goes
+ *  through ordinary broadcast. Sender key is rotated (generation is increased)
+ *  whenever a peer leaves the group.
  */
 
 // ----------------------------------------------------------------------------
@@ -342,6 +453,17 @@
 #define D_ITEM_TOKEN         "token"
 #define D_ITEM_PAYLOAD       "payload"
 #define D_ITEM_PEERS         "peers"
+#define D_ITEM_SEQ           "seq"
+#define D_ITEM_SINCE_SEQ     "since_seq"
+#define D_ITEM_LAST_SEQ      "last_seq"
+#define D_ITEM_LIMIT         "limit"
+#define D_ITEM_MESSAGES      "messages"
+#define D_ITEM_VERSION       "version"
+#define D_ITEM_SINCE_VERSION "since_version"
+#define D_ITEM_DELTAS        "deltas"
+#define D_ITEM_MOVE          "move"
+#define D_ITEM_FRAMING       "framing"
+#define D_ITEM_DEFLATE       "deflate"
 
 #if SECURE
 #define D_ITEM_PRIVATE_REQUEST "private_request"
@@ -349,6 +471,9 @@
 #define D_ITEM_PRIVATE_ABORT   "private_abort"
 #define D_ITEM_PRIVATE_PUBKEY  "private_pubkey"
 #define D_ITEM_PRIVATE_PUBKEY_EXCHANGE "private_pubkey_exchange"
+#define D_ITEM_PRIVATE_EPHEMERAL "private_ephemeral"
+#define D_ITEM_SENDER_KEY      "sender_key"
+#define D_ITEM_GENERATION      "generation"
 #endif  // SECURE
 
 #define D_PATH_ADMIN           "/admin"
@@ -364,6 +489,11 @@
 #define D_PATH_CHECK_AUTH      "/check_auth"
 #define D_PATH_KICK_BY_AUTH    "/kick_by_auth"
 #define D_PATH_ALL_PEERS       "/all_peers"
+#define D_PATH_HISTORY         "/history"
+#define D_PATH_RESUME          "/resume"
+#define D_PATH_WEBSOCKET       "/ws"
+#define D_PATH_STREAM          "/stream"
+#define D_PATH_HELLO           "/hello"
 
 #if SECURE
 #define D_PATH_PRIVATE_REQUEST  "/private_request"
@@ -401,6 +531,17 @@ extern const char* ITEM_SYSTEM;
 extern const char* ITEM_TOKEN;
 extern const char* ITEM_PAYLOAD;
 extern const char* ITEM_PEERS;
+extern const char* ITEM_SEQ;
+extern const char* ITEM_SINCE_SEQ;
+extern const char* ITEM_LAST_SEQ;
+extern const char* ITEM_LIMIT;
+extern const char* ITEM_MESSAGES;
+extern const char* ITEM_VERSION;
+extern const char* ITEM_SINCE_VERSION;
+extern const char* ITEM_DELTAS;
+extern const char* ITEM_MOVE;
+extern const char* ITEM_FRAMING;
+extern const char* ITEM_DEFLATE;
 
 #if SECURE
 extern const char* ITEM_PRIVATE_REQUEST;
@@ -408,6 +549,9 @@ extern const char* ITEM_PRIVATE_CONFIRM;
 extern const char* ITEM_PRIVATE_ABORT;
 extern const char* ITEM_PRIVATE_PUBKEY;
 extern const char* ITEM_PRIVATE_PUBKEY_EXCHANGE;
+extern const char* ITEM_PRIVATE_EPHEMERAL;
+extern const char* ITEM_SENDER_KEY;
+extern const char* ITEM_GENERATION;
 #endif  // SECURE
 
 extern const char* PATH_ADMIN;
@@ -423,6 +567,11 @@ extern const char* PATH_IS_REGISTERED;
 extern const char* PATH_CHECK_AUTH;
 extern const char* PATH_KICK_BY_AUTH;
 extern const char* PATH_ALL_PEERS;
+extern const char* PATH_HISTORY;
+extern const char* PATH_RESUME;
+extern const char* PATH_WEBSOCKET;
+extern const char* PATH_STREAM;
+extern const char* PATH_HELLO;
 
 #if SECURE
 extern const char* PATH_PRIVATE_REQUEST;
@@ -458,6 +607,11 @@ enum class Path : int {
   , PRIVATE_PUBKEY    = 14
   , PRIVATE_PUBKEY_EXCHANGE = 15
 #endif  // SECURE
+  , HISTORY = 16
+  , RESUME  = 17
+  , WEBSOCKET = 18
+  , STREAM    = 19
+  , HELLO     = 20
 };
 
 enum class StatusCode : int {
@@ -482,13 +636,30 @@ enum class StatusCode : int {
   PERMISSION_DENIED  = 17,
   KICKED             = 18,
   FORBIDDEN_MESSAGE  = 19,
-  REQUEST_REJECTED   = 20
+  REQUEST_REJECTED   = 20,
+  SESSION_EXPIRED    = 21,
+  SERVER_BUSY        = 22
 };
 
 enum class ChannelMove : int {
   UNKNOWN = -1, ENTER = 0, EXIT = 1
 };
 
+enum class RosterMove : int {
+  JOIN = 0, LEAVE = 1, MOVE = 2
+};
+
+/* List of logged in peers, whole or changes since some version of it */
+struct Roster {
+  std::vector<Peer> peers;
+  std::vector<std::pair<RosterMove, Peer>> deltas;  // in order of changes
+  int channel = WRONG_CHANNEL;
+  uint64_t version = 0;
+  uint64_t since_version = 0;
+  bool is_delta = false;
+  std::shared_ptr<const std::string> response;  // whole list already serialized, if any
+};
+
 #if SECURE
 enum class PrivateHandshake : int {
   UNKNOWN = -1,
@@ -520,8 +691,10 @@ void print(HandshakeStatus status);
  * Status:                {"code":INT,"action":INT,"id":INT,"token":TEXT,"payload":TEXT}
  * System:                {"system":TEXT,"action":INT,"id":INT,"payload":TEXT}
  * Check:                 {"check":INT,"action":INT,"id":INT}
- * List peers:            {"peers":[{"id":INT,"login":TEXT,"email":TEXT,"channel":INT},{},{},...]}
- * List peers (channel):  {"peers":[{"id":INT,"login":TEXT,"email":TEXT,"channel":INT},{},{},...],"channel":INT}
+ * List peers:            {"peers":[{"id":INT,"login":TEXT,"email":TEXT,"channel":INT},{},{},...],"version":INT}
+ * List peers (channel):  {"peers":[{"id":INT,"login":TEXT,"email":TEXT,"channel":INT},{},{},...],"channel":INT,"version":INT}
+ * Peers changed:         {"deltas":[{"move":INT,"id":INT,"login":TEXT,"email":TEXT,"channel":INT},{},...],"channel":INT,"version":INT,"since_version":INT}
+ * History:               {"code":INT,"channel":INT,"last_seq":INT,"messages":[{"seq":INT,"message":{...}},{},{},...]}
  */
 
 /* Client API */
@@ -530,6 +703,7 @@ class ClientApi {
 public:
   virtual ~ClientApi() {}
 
+  virtual void getHello() = 0;  // ask for Server's hello right after connect
   virtual void getLoginForm() = 0;
   virtual void getRegistrationForm() = 0;
   virtual void sendLoginForm(const LoginForm& form) = 0;
@@ -544,15 +718,20 @@ public:
   virtual void kickByAuth(const std::string& name, const std::string& password, bool encrypted) = 0;
   virtual void getAllPeers() = 0;
   virtual void getAllPeers(int channel) = 0;
+  virtual void getAllPeers(int channel, uint64_t since_version) = 0;  // only changes, WRONG_CHANNEL for all
+  virtual void getHistory(int channel, uint64_t since_seq, int limit) = 0;
+  virtual void resume(ID_t id, const std::string& token) = 0;
 #if SECURE
   virtual void privateRequest(ID_t src_id, ID_t dest_id) = 0;  // send request to Server from src peer
   virtual void privateConfirm(ID_t src_id, ID_t dest_id, bool accept) = 0;  // send confirm to Server from src peer
   virtual void privateAbort(ID_t src_id, ID_t dest_id) = 0;    // send abort to Server from src peer
   virtual void privatePubKey(ID_t src_id, const secure::Key& key) = 0;  // send public key to Server from src peer
-  virtual void privatePubKeysExchange(ID_t src_id, ID_t dest_id) = 0;  // send request to exchange public keys with dest peer
+  virtual void privatePubKeysExchange(ID_t src_id, ID_t dest_id, const secure::Key& ephemeral) = 0;  // send request to exchange public keys with dest peer, with one-time key if any
 #endif  // SECURE
   virtual void sendKickRequest(ID_t src_id, ID_t dest_id) = 0;  // send request to kick dest peer by src peer
   virtual void sendAdminRequest(ID_t src_id, const std::string& cert) = 0;  // send request to get administrating priviledges
+
+  virtual bool enableFraming(bool accept_deflate) = 0;  // switch connection to binary frames, if supported
 };
 
 /* Server API */
@@ -578,14 +757,18 @@ public:
   virtual void sendRegistrationForm(int socket) = 0;
   virtual void sendStatus(int socket, StatusCode status, Path action, ID_t id) = 0;
   virtual void sendCheck(int socket, bool check, Path action, ID_t id) = 0;
-  virtual void sendPeers(int socket, StatusCode status, const std::vector<Peer>& peers, int channel) = 0;
+  virtual void sendPeers(int socket, StatusCode status, const Roster& roster) = 0;
+  virtual void sendHistory(int socket, StatusCode status, const std::string& frames, int channel, uint64_t last_seq) = 0;
+  virtual void sendMissedMessages(int socket, int channel, uint64_t since_seq) = 0;  // replay history after resume
+  virtual void sendOfflineMessages(int socket, ID_t id) = 0;  // deliver dedicated messages queued while peer was offline
 #if SECURE
-  virtual void sendPubKey(const secure::Key& key, ID_t dest_id) = 0;  // forward stored public key to dest peer
+  virtual void sendPubKey(const secure::Key& key, const secure::Key& ephemeral, ID_t dest_id) = 0;  // forward stored public key and one-time key, if any, to dest peer
 #endif
 
   virtual StatusCode login(int socket, const std::string& json, ID_t& id) = 0;
   virtual StatusCode registrate(int socket, const std::string& json, ID_t& id) = 0;
   virtual StatusCode message(const std::string& json, ID_t& id) = 0;
+  virtual StatusCode message(const Message& message, ID_t& id) = 0;  // decoded from binary frame
   virtual StatusCode logout(const std::string& path, ID_t& id) = 0;
   virtual StatusCode switchChannel(const std::string& path, ID_t& id) = 0;
   virtual bool getPeerId(const std::string& path, ID_t& id) = 0;
@@ -593,13 +776,15 @@ public:
   virtual bool checkRegistered(const std::string& path, ID_t& id) = 0;
   virtual bool checkAuth(const std::string& path, ID_t& id) = 0;
   virtual bool kickByAuth(const std::string& path, ID_t& id) = 0;
-  virtual StatusCode getAllPeers(const std::string& path, std::vector<Peer>* peers, int& channel) = 0;
+  virtual StatusCode getAllPeers(const std::string& path, Roster* roster) = 0;
+  virtual StatusCode getHistory(int socket, const std::string& path, std::string* frames, int& channel, uint64_t& last_seq) = 0;
+  virtual StatusCode resume(int socket, const std::string& path, ID_t& id, int& channel, uint64_t& since_seq) = 0;
 #if SECURE
   virtual StatusCode privateRequest(const std::string& path, ID_t& id) = 0;  // forward request to dest peer
   virtual StatusCode privateConfirm(const std::string& path, ID_t& id) = 0;  // forward confirm to dest peer
   virtual StatusCode privateAbort(const std::string& path, ID_t& id) = 0;    // forward abort to dest peer
   virtual StatusCode privatePubKey(const std::string& path, const std::string& json, ID_t& id) = 0;  // store public key at Server side
-  virtual StatusCode privatePubKeysExchange(const std::string& path, ID_t& id) = 0;  // exchange public keys between peers
+  virtual StatusCode privatePubKeysExchange(const std::string& path, const std::string& json, ID_t& id) = 0;  // exchange public keys between peers
 
   virtual void setKeyPair(const std::pair<secure::Key, secure::Key>& keypair) = 0;  // set server-side key pair to this adapter
 #endif  // SECURE
@@ -51,6 +51,13 @@ public:
   virtual std::string encrypt(const std::string& source, const Key& public_key, bool& encrypted) = 0;
   virtual std::string decrypt(const std::string& source, const Key& private_key, bool& decrypted) = 0;
 
+  /**
+   * Same as above, but raw bytes instead of hex. Output buffer must be larger than input
+   * by at least one cipher block. Return output length or -1 on failure.
+   */
+  virtual int encrypt(const std::string& source, const Key& public_key, unsigned char* cipher) = 0;
+  virtual int decrypt(const unsigned char* cipher, int cipher_len, const Key& private_key, unsigned char* plain) = 0;
+
   virtual int getEKlength() const = 0;
   virtual int getIVlength() const = 0;
   virtual int getCipherLength() const = 0;
@@ -31,8 +31,9 @@
 #include <cstring>
 #include "api.h"
 #include "common.h"
+#include "json_reader.h"
+#include "json_writer.h"
 #include "logger.h"
-#include "rapidjson/document.h"
 #include "structures.h"
 
 // ----------------------------------------------
@@ -46,15 +47,15 @@ namespace secure {
 Key Key::EMPTY;
 
 Key::Key()
-  : m_id(UNKNOWN_ID), m_key("") {
+  : m_id(UNKNOWN_ID), m_key(""), m_version(KeyVersion::RSA_PEM) {
 }
 
-Key::Key(ID_t id, const std::string& key)
-  : m_id(id), m_key(key) {
+Key::Key(ID_t id, const std::string& key, KeyVersion version)
+  : m_id(id), m_key(key), m_version(version) {
 }
 
 bool Key::operator == (const Key& rhs) const {
-  return (m_id == rhs.m_id && m_key == rhs.m_key);
+  return (m_id == rhs.m_id && m_key == rhs.m_key && m_version == rhs.m_version);
 }
 
 bool Key::operator != (const Key& rhs) const {
@@ -65,27 +66,74 @@ std::string Key::toJson() const {
   std::ostringstream oss;
   oss << "{\"" D_ITEM_ID "\":" << m_id
       << ",\"" D_ITEM_KEY "\":\"" << m_key
-      << "\"}";
+      << "\",\"" D_ITEM_VERSION "\":" << static_cast<int>(m_version)
+      << "}";
   return oss.str();
 }
 
+void Key::write(json::Writer& writer) const {
+  writer.StartObject();
+  writer.Key(ITEM_ID);       writer.Int64(m_id);
+  writer.Key(ITEM_KEY);      writer.String(m_key);
+  writer.Key(ITEM_VERSION);  writer.Int(static_cast<int>(m_version));
+  writer.EndObject();
+}
+
 Key Key::fromJson(const std::string& json) {
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-
-  if (document.IsObject() &&
-      document.HasMember(ITEM_ID) && document[ITEM_ID].IsInt64() &&
-      document.HasMember(ITEM_KEY) && document[ITEM_KEY].IsString()) {
-    ID_t id = document[ITEM_ID].GetInt64();
-    std::string key = document[ITEM_KEY].GetString();
-    return Key(id, key);
+  ID_t id = UNKNOWN_ID;
+  std::string key;
+  int version = static_cast<int>(KeyVersion::RSA_PEM);  // peers unaware of versions send PEM
+  json::Reader reader;
+  reader.bind(ITEM_ID, &id).bind(ITEM_KEY, &key).bind(ITEM_VERSION, &version, false);
+
+  if (reader.read(common::preparse(json))) {
+    if (version != static_cast<int>(KeyVersion::RSA_PEM) && version != static_cast<int>(KeyVersion::X25519)) {
+      ERR("Key parse failed: unsupported version %i", version);
+      throw ConvertException();
+    }
+    return Key(id, key, static_cast<KeyVersion>(version));
   } else {
     ERR("Key parse failed: invalid json: %s", json.c_str());
     throw ConvertException();
   }
 }
 
+// ----------------------------------------------
+SenderKey SenderKey::EMPTY;
+
+SenderKey::SenderKey()
+  : m_id(UNKNOWN_ID), m_channel(0), m_generation(0), m_key("") {
+}
+
+SenderKey::SenderKey(ID_t id, int channel, uint32_t generation, const std::string& key)
+  : m_id(id), m_channel(channel), m_generation(generation), m_key(key) {
+}
+
+std::string SenderKey::toJson() const {
+  std::ostringstream oss;
+  oss << "{\"" D_ITEM_SENDER_KEY "\":{\"" D_ITEM_ID "\":" << m_id
+      << ",\"" D_ITEM_CHANNEL "\":" << m_channel
+      << ",\"" D_ITEM_GENERATION "\":" << m_generation
+      << ",\"" D_ITEM_KEY "\":\"" << m_key
+      << "\"}}";
+  return oss.str();
+}
+
+SenderKey SenderKey::fromJson(const std::string& json) {
+  ID_t id = UNKNOWN_ID;
+  int channel = 0;
+  uint32_t generation = 0;
+  std::string key;
+  json::Reader reader(ITEM_SENDER_KEY);
+  reader.bind(ITEM_ID, &id).bind(ITEM_CHANNEL, &channel).bind(ITEM_GENERATION, &generation).bind(ITEM_KEY, &key);
+
+  if (reader.read(json)) {
+    return SenderKey(id, channel, generation, key);
+  }
+  ERR("SenderKey parse failed: invalid json: %s", json.c_str());
+  throw ConvertException();
+}
+
 }
 
 #endif  // SECURE
@@ -108,17 +156,23 @@ std::string LoginForm::toJson() const {
   return oss.str();
 }
 
+void LoginForm::write(json::Writer& writer) const {
+  writer.StartObject();
+  writer.Key(ITEM_LOGIN);      writer.String(m_login);
+  writer.Key(ITEM_PASSWORD);   writer.String(m_password);
+  writer.Key(ITEM_ENCRYPTED);  writer.Int(m_is_password_encrypted ? 1 : 0);
+  writer.EndObject();
+}
+
 LoginForm LoginForm::fromJson(const std::string& json) {
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-
-  if (document.IsObject() &&
-      document.HasMember(ITEM_LOGIN) && document[ITEM_LOGIN].IsString() &&
-      document.HasMember(ITEM_PASSWORD) && document[ITEM_PASSWORD].IsString() &&
-      document.HasMember(ITEM_ENCRYPTED) && document[ITEM_ENCRYPTED].IsInt()) {
-    LoginForm form(document[ITEM_LOGIN].GetString(), document[ITEM_PASSWORD].GetString());
-    form.setEncrypted(document[ITEM_ENCRYPTED].GetInt() != 0);
+  std::string login, password;
+  int is_encrypted = 0;
+  json::Reader reader;
+  reader.bind(ITEM_LOGIN, &login).bind(ITEM_PASSWORD, &password).bind(ITEM_ENCRYPTED, &is_encrypted);
+
+  if (reader.read(common::preparse(json))) {
+    LoginForm form(login, password);
+    form.setEncrypted(is_encrypted != 0);
     return form;
   } else {
     ERR("Login Form parse failed: invalid json: %s", json.c_str());
@@ -162,18 +216,24 @@ std::string RegistrationForm::toJson() const {
   return oss.str();
 }
 
+void RegistrationForm::write(json::Writer& writer) const {
+  writer.StartObject();
+  writer.Key(ITEM_LOGIN);      writer.String(m_login);
+  writer.Key(ITEM_EMAIL);      writer.String(m_email);
+  writer.Key(ITEM_PASSWORD);   writer.String(m_password);
+  writer.Key(ITEM_ENCRYPTED);  writer.Int(m_is_password_encrypted ? 1 : 0);
+  writer.EndObject();
+}
+
 RegistrationForm RegistrationForm::fromJson(const std::string& json) {
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-
-  if (document.IsObject() &&
-      document.HasMember(ITEM_LOGIN) && document[ITEM_LOGIN].IsString() &&
-      document.HasMember(ITEM_EMAIL) && document[ITEM_EMAIL].IsString() &&
-      document.HasMember(ITEM_PASSWORD) && document[ITEM_PASSWORD].IsString() &&
-      document.HasMember(ITEM_ENCRYPTED) && document[ITEM_ENCRYPTED].IsInt()) {
-    RegistrationForm form(document[ITEM_LOGIN].GetString(), document[ITEM_EMAIL].GetString(), document[ITEM_PASSWORD].GetString());
-    form.setEncrypted(document[ITEM_ENCRYPTED].GetInt() != 0);
+  std::string login, email, password;
+  int is_encrypted = 0;
+  json::Reader reader;
+  reader.bind(ITEM_LOGIN, &login).bind(ITEM_EMAIL, &email).bind(ITEM_PASSWORD, &password).bind(ITEM_ENCRYPTED, &is_encrypted);
+
+  if (reader.read(common::preparse(json))) {
+    RegistrationForm form(login, email, password);
+    form.setEncrypted(is_encrypted != 0);
     return form;
   } else {
     ERR("Registration Form parse failed: invalid json: %s", json.c_str());
@@ -258,48 +318,37 @@ Message::Message(const Message& message)
 }
 
 std::string Message::toJson() const {
-  std::ostringstream oss;
-  oss << "{\"" D_ITEM_ID "\":" << m_id
-      << ",\"" D_ITEM_LOGIN "\":\"" << m_login
-      << "\",\"" D_ITEM_EMAIL "\":\"" << m_email
-      << "\",\"" D_ITEM_CHANNEL "\":" << m_channel
-      << ",\"" D_ITEM_DEST_ID "\":" << m_dest_id
-      << ",\"" D_ITEM_TIMESTAMP "\":" << m_timestamp
-      << ",\"" D_ITEM_SIZE "\":" << m_message.size()
-      << ",\"" D_ITEM_ENCRYPTED "\":" << (m_is_encrypted ? 1 : 0)
-      << ",\"" D_ITEM_MESSAGE "\":\"" << m_message
-      << "\"}";
-  return oss.str();
+  return json::toString(*this);
 }
 
-Message Message::fromJson(const std::string& json) {
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-
-  if (document.IsObject() &&
-      document.HasMember(ITEM_ID) && document[ITEM_ID].IsInt64() &&
-      document.HasMember(ITEM_LOGIN) && document[ITEM_LOGIN].IsString() &&
-      document.HasMember(ITEM_EMAIL) && document[ITEM_EMAIL].IsString() &&
-      document.HasMember(ITEM_CHANNEL) && document[ITEM_CHANNEL].IsInt() &&
-      document.HasMember(ITEM_DEST_ID) && document[ITEM_DEST_ID].IsInt64() &&
-      document.HasMember(ITEM_TIMESTAMP) && document[ITEM_TIMESTAMP].IsInt64() &&
-      document.HasMember(ITEM_SIZE) && document[ITEM_SIZE].IsInt() &&
-      document.HasMember(ITEM_ENCRYPTED) && document[ITEM_ENCRYPTED].IsInt() &&
-      document.HasMember(ITEM_MESSAGE) && document[ITEM_MESSAGE].IsString()) {
-    ID_t id = document[ITEM_ID].GetInt64();
-    std::string login = document[ITEM_LOGIN].GetString();
-    std::string email = document[ITEM_EMAIL].GetString();
-    int channel = document[ITEM_CHANNEL].GetInt();
-    ID_t dest_id = document[ITEM_DEST_ID].GetInt64();
-    uint64_t timestamp = document[ITEM_TIMESTAMP].GetInt64();
-    size_t size = document[ITEM_SIZE].GetInt();
-    bool is_encrypted = document[ITEM_ENCRYPTED].GetInt() != 0;
-    std::string message = document[ITEM_MESSAGE].GetString();
+void Message::write(json::Writer& writer) const {
+  writer.StartObject();
+  writer.Key(ITEM_ID);         writer.Int64(m_id);
+  writer.Key(ITEM_LOGIN);      writer.String(m_login);
+  writer.Key(ITEM_EMAIL);      writer.String(m_email);
+  writer.Key(ITEM_CHANNEL);    writer.Int(m_channel);
+  writer.Key(ITEM_DEST_ID);    writer.Int64(m_dest_id);
+  writer.Key(ITEM_TIMESTAMP);  writer.Uint64(m_timestamp);
+  writer.Key(ITEM_SIZE);       writer.Uint64(m_message.size());
+  writer.Key(ITEM_ENCRYPTED);  writer.Int(m_is_encrypted ? 1 : 0);
+  writer.Key(ITEM_MESSAGE);    writer.String(m_message);
+  writer.EndObject();
+}
 
+Message Message::fromJson(const std::string& json) {
+  ID_t id = UNKNOWN_ID, dest_id = UNKNOWN_ID;
+  std::string login, email, message;
+  int channel = 0, size = 0, is_encrypted = 0;
+  uint64_t timestamp = 0;
+  json::Reader reader;
+  reader.bind(ITEM_ID, &id).bind(ITEM_LOGIN, &login).bind(ITEM_EMAIL, &email)
+        .bind(ITEM_CHANNEL, &channel).bind(ITEM_DEST_ID, &dest_id).bind(ITEM_TIMESTAMP, &timestamp)
+        .bind(ITEM_SIZE, &size).bind(ITEM_ENCRYPTED, &is_encrypted).bind(ITEM_MESSAGE, &message);
+
+  if (reader.read(common::preparse(json))) {
     return Message::Builder(id).setLogin(login).setEmail(email).setChannel(channel)
         .setDestId(dest_id).setTimestamp(timestamp).setSize(size)
-        .setEncrypted(is_encrypted).setMessage(message)
+        .setEncrypted(is_encrypted != 0).setMessage(message)
         .build();
   } else {
     ERR("Message parse failed: invalid json: %s", json.c_str());
@@ -337,6 +386,20 @@ void Message::decrypt(secure::IAsymmetricCryptor& cryptor, const secure::Key& pr
   SYS("Decrypted message[%i]: %s", isEncrypted(), getMessage().c_str());
 }
 
+void Message::encrypt(const secure::SymmetricKey& session_key) {
+  m_message = secure::good::encryptAndPack(session_key, m_message, m_is_encrypted);
+  m_size = m_message.length();
+  SYS("Encrypted message with session key[%i]: %s", isEncrypted(), getMessage().c_str());
+}
+
+void Message::decrypt(const secure::SymmetricKey& session_key) {
+  bool decrypted = false;
+  m_message = secure::good::unpackAndDecrypt(session_key, m_message, decrypted);
+  m_size = m_message.length();
+  m_is_encrypted = !decrypted;
+  SYS("Decrypted message with session key[%i]: %s", isEncrypted(), getMessage().c_str());
+}
+
 #endif  // SECURE
 
 // ----------------------------------------------
@@ -371,30 +434,26 @@ Peer::Peer(const Peer::Builder& builder)
 }
 
 std::string Peer::toJson() const {
-  std::ostringstream oss;
-  oss << "{\"" D_ITEM_ID "\":" << m_id
-      << ",\"" D_ITEM_LOGIN "\":\"" << m_login
-      << "\",\"" D_ITEM_EMAIL "\":\"" << m_email
-      << "\",\"" D_ITEM_CHANNEL "\":" << m_channel
-      << "}";
-  return oss.str();
+  return json::toString(*this);
+}
+
+void Peer::write(json::Writer& writer) const {
+  writer.StartObject();
+  writer.Key(ITEM_ID);       writer.Int64(m_id);
+  writer.Key(ITEM_LOGIN);    writer.String(m_login);
+  writer.Key(ITEM_EMAIL);    writer.String(m_email);
+  writer.Key(ITEM_CHANNEL);  writer.Int(m_channel);
+  writer.EndObject();
 }
 
 Peer Peer::fromJson(const std::string& json) {
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-
-  if (document.IsObject() &&
-      document.HasMember(ITEM_ID) && document[ITEM_ID].IsInt64() &&
-      document.HasMember(ITEM_LOGIN) && document[ITEM_LOGIN].IsString() &&
-      document.HasMember(ITEM_EMAIL) && document[ITEM_EMAIL].IsString() &&
-      document.HasMember(ITEM_CHANNEL) && document[ITEM_CHANNEL].IsInt()) {
-    ID_t id = document[ITEM_ID].GetInt64();
-    std::string login = document[ITEM_LOGIN].GetString();
-    std::string email = document[ITEM_EMAIL].GetString();
-    int channel = document[ITEM_CHANNEL].GetInt();
+  ID_t id = UNKNOWN_ID;
+  std::string login, email;
+  int channel = 0;
+  json::Reader reader;
+  reader.bind(ITEM_ID, &id).bind(ITEM_LOGIN, &login).bind(ITEM_EMAIL, &email).bind(ITEM_CHANNEL, &channel);
 
+  if (reader.read(common::preparse(json))) {
     return Peer::Builder(id).setLogin(login).setEmail(email).setChannel(channel).build();
   } else {
     ERR("Peer parse failed: invalid json: %s", json.c_str());
@@ -34,6 +34,10 @@
 #include "api/types.h"
 #include "exception.h"
 
+namespace json {
+class Writer;
+}
+
 /* Internal implementation API */
 // ----------------------------------------------------------------------------
 #if SECURE
@@ -41,11 +45,19 @@
 namespace secure {
 
 class IAsymmetricCryptor;
+struct SymmetricKey;
+
+/* Kind of key material, sent along with key as "version" */
+enum class KeyVersion : int {
+  RSA_PEM = 1,  // RSA key in PEM
+  X25519  = 2   // X25519 agreement key with Ed25519 identity, see crypting/agreement.h
+};
 
 /**
  * {
  *   "id":1000,
- *   "key":"MIIEpgIBAAKCAQEAwV7VBYF221EVcUrfxMtAyqo60VNOnY7WyfyT0DwtHhdH0bj9..."
+ *   "key":"MIIEpgIBAAKCAQEAwV7VBYF221EVcUrfxMtAyqo60VNOnY7WyfyT0DwtHhdH0bj9...",
+ *   "version":1
  * }
  */
 class Key {
@@ -53,18 +65,53 @@ public:
   static Key EMPTY;
 
   Key();
-  Key(ID_t id, const std::string& key);
+  Key(ID_t id, const std::string& key, KeyVersion version = KeyVersion::RSA_PEM);
   bool operator == (const Key& rhs) const;
   bool operator != (const Key& rhs) const;
 
   std::string toJson() const;
+  void write(json::Writer& writer) const;
   static Key fromJson(const std::string& json);
 
   inline ID_t getId() const { return m_id; }
   inline const std::string& getKey() const { return m_key; }
+  inline KeyVersion getVersion() const { return m_version; }
+
+private:
+  ID_t m_id;
+  std::string m_key;
+  KeyVersion m_version;
+};
+
+/**
+ * Sender key of peer for channel, base64-encoded, see crypting/agreement.h
+ * {
+ *   "id":1000,
+ *   "channel":500,
+ *   "generation":1,
+ *   "key":"q83vASNFZ4mrze8BI0VniavN7wEjRWeJq83vASNFZ4k="
+ * }
+ */
+class SenderKey {
+public:
+  static SenderKey EMPTY;
+
+  SenderKey();
+  SenderKey(ID_t id, int channel, uint32_t generation, const std::string& key);
+
+  /* wrapped into {"sender_key":{...}} when distributed */
+  std::string toJson() const;
+  static SenderKey fromJson(const std::string& json);
+
+  inline ID_t getId() const { return m_id; }
+  inline int getChannel() const { return m_channel; }
+  inline uint32_t getGeneration() const { return m_generation; }
+  inline const std::string& getKey() const { return m_key; }
 
 private:
   ID_t m_id;
+  int m_channel;
+  uint32_t m_generation;
   std::string m_key;
 };
 
@@ -94,6 +141,7 @@ public:
   inline void setEncrypted(bool is_encrypted) { m_is_password_encrypted = is_encrypted; }
 
   std::string toJson() const;
+  void write(json::Writer& writer) const;
   static LoginForm fromJson(const std::string& json);
 
 #if SECURE
@@ -128,6 +176,7 @@ public:
   inline void setEmail(const std::string& email) { m_email = email; }
 
   std::string toJson() const;
+  void write(json::Writer& writer) const;
   static RegistrationForm fromJson(const std::string& json);
 
 protected:
@@ -146,16 +195,21 @@ protected:
  * }
  *
  *  --------------------
- *  SECURE message format:
+ *  SECURE message format, base64-encoded:
  *
- *  [meta]-----*****-----[E][message]
+ *  [header][E][IV][message]
  *
- *     meta - colon separated: size of encrypted symmetric key E,
- *            size of hash, size of encrypted message, hash value;
+ *   header - magic, version, sizes of E, IV and encrypted message,
+ *            see secure::EnvelopeHeader;
  *
  *       E  - symmetric key E encrypted with some public key;
  *
  *  message - message encrypted with E.
+ *
+ *  If message is encrypted with session key agreed between peers, E is empty
+ *  and message is sealed with AEAD, see secure::AEADCryptor.
+ *
+ *  Legacy colon-separated hex format is still accepted on decryption.
  */
 class Message {
 public:
@@ -198,6 +252,7 @@ public:
   Message(const Builder& builder);
   Message(const Message& message);
   std::string toJson() const;
+  void write(json::Writer& writer) const;  // into response being serialized
   static Message fromJson(const std::string& json);
 
   inline ID_t getId() const { return m_id; }
@@ -216,6 +271,10 @@ public:
 #if SECURE
   void encrypt(secure::IAsymmetricCryptor& cryptor, const secure::Key& public_key);
   void decrypt(secure::IAsymmetricCryptor& cryptor, const secure::Key& private_key);
+
+  /* with session key agreed between peers, see crypting/agreement.h */
+  void encrypt(const secure::SymmetricKey& session_key);
+  void decrypt(const secure::SymmetricKey& session_key);
 #endif  // SECURE
 
 private:
@@ -263,6 +322,7 @@ public:
 
   Peer(const Builder& builder);
   std::string toJson() const;
+  void write(json::Writer& writer) const;
   static Peer fromJson(const std::string& json);
 
   inline ID_t getId() const { return m_id; }
@@ -31,6 +31,7 @@
 #include <cstring>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <errno.h>
 #include "client.h"
@@ -39,10 +40,12 @@
 #include "utils.h"
 
 #if SECURE
+#include "crypting/agreement.h"
 #include "crypting/cryptor.h"
 #include "crypting/crypting_util.h"
 #include "crypting/random_util.h"
 #include "crypting/evp_cryptor.h"
+#include "crypting/key_pool.h"
 #endif  // SECURE
 
 static const char* FILENAME_ADMIN_CERT = "admin_cert.pem";
@@ -50,7 +53,14 @@ static const char* FILENAME_ADMIN_CERT = "admin_cert.pem";
 Client::Client(const std::string& config_file)
   : m_id(UNKNOWN_ID), m_name(""), m_email(""), m_auth_token(""), m_channel(0), m_dest_id(UNKNOWN_ID)
   , m_is_connected(false), m_is_stopped(false), m_private_secure_chat(false)
-  , m_socket(-1), m_ip_address(""), m_port("http") {
+  , m_is_framing_offered(false), m_is_framed(false), m_is_deflate_offered(false)
+  , m_socket(-1), m_ip_address(""), m_port("http"), m_frames(WIRE_MAX_DOWNSTREAM_LENGTH)
+  , m_roster_channel(WRONG_CHANNEL), m_roster_version(0) {
+#if SECURE
+  m_key_version = secure::KeyVersion::RSA_PEM;
+  m_group_secure_chat = false;
+  m_sender_key_stale = false;
+#endif  // SECURE
   if (!readConfiguration(config_file)) {
     throw ClientException();
   }
@@ -70,7 +80,8 @@ void Client::run() {
     throw ClientException();
   }
 
-  // receive Server's hello
+  // ask for and receive Server's hello
+  m_api_impl->getHello();
   bool is_stopped = false;
   std::vector<Response> responses;
   Response response = getResponse(m_socket, &is_stopped, &responses);
@@ -78,17 +89,20 @@ void Client::run() {
     ERR("Received empty response. Connection closed");
     throw ClientException();
   } else {
-    std::string system = "", payload = "";
-    Path action = Path::UNKNOWN;
-    ID_t id = UNKNOWN_ID;
-    if (util::checkSystemMessage(response.body, &system, &payload, action, id)) {
-      processSystemPayload(payload);
+    util::ResponseEvent event;
+    if (util::classifyResponse(response.body, &event) == util::ResponseType::SYSTEM) {
+      processSystemPayload(event.payload);
     } else {
       ERR("Incoming response is not a Server's hello!");
       throw ClientException();
     }
   }
 
+  if (m_is_framing_offered) {
+    m_is_framed = m_api_impl->enableFraming(m_is_deflate_offered);
+    DBG("Binary frames: %s", m_is_framed ? "enabled" : "not supported");
+  }
+
   goToMainMenu();
 }
 
@@ -172,6 +186,17 @@ bool Client::readConfiguration(const std::string& config_file) {
     int i2 = line.find_first_of(' ');
     m_port = line.substr(i2 + 1);
     DBG("Port: %s", m_port.c_str());
+#if SECURE
+    // handshake, optional: 'rsa' (default) or 'x25519'
+    if (std::getline(fs, line)) {
+      int i3 = line.find_first_of(' ');
+      std::string handshake = line.substr(i3 + 1);
+      if (handshake.compare("x25519") == 0) {
+        m_key_version = secure::KeyVersion::X25519;
+      }
+      DBG("Handshake: %s", handshake.c_str());
+    }
+#endif  // SECURE
     fs.close();
   } else {
     ERR("Failed to open configure file: %s", config_file.c_str());
@@ -238,6 +263,9 @@ void Client::goToMainMenu() {
 /* Process response */
 // ----------------------------------------------
 Response Client::getResponse(int socket, bool* is_closed, std::vector<Response>* responses) {
+  if (m_is_framed) {
+    return getFramedResponse(socket, is_closed, responses);
+  }
   char buffer[MESSAGE_SIZE];
   memset(buffer, 0, MESSAGE_SIZE);
   int read_bytes = recv(socket, buffer, MESSAGE_SIZE, 0);
@@ -260,6 +288,62 @@ Response Client::getResponse(int socket, bool* is_closed, std::vector<Response>*
   }
 }
 
+Response Client::getFramedResponse(int socket, bool* is_closed, std::vector<Response>* responses) {
+  char buffer[MESSAGE_SIZE];
+  while (responses->empty()) {
+    int read_bytes = recv(socket, buffer, MESSAGE_SIZE, 0);
+    if (read_bytes <= 0) {
+      if (read_bytes == -1) {
+        ERR("getResponse() error: %s", strerror(errno));
+      } else if (read_bytes == 0) {
+        printf("\e[5;00;31mSystem: Server shutdown\e[m\n");
+      }
+      DBG("Connection closed");
+      *is_closed = true;
+      return Response::EMPTY;
+    }
+    m_frames.append(buffer, read_bytes);
+    wire::Frame frame;
+    while (m_frames.next(&frame)) {
+      if (frame.type != wire::FrameType::DEFLATED) {
+        decodeFrame(frame, responses);
+        continue;
+      }
+      std::string inflated;
+      if (!m_inflater.inflate(frame, &inflated)) {
+        ERR("Failed to inflate frame of %zu bytes - ignored", frame.length);
+        continue;
+      }
+      wire::FrameDecoder frames(WIRE_MAX_DOWNSTREAM_LENGTH);  // whole frames, as before compression
+      frames.append(inflated.data(), inflated.length());
+      wire::Frame inner;
+      while (frames.next(&inner)) {
+        decodeFrame(inner, responses);
+      }
+    }
+    if (m_frames.isBroken()) {
+      FAT("Broken frame stream from Server");
+      *is_closed = true;
+      return Response::EMPTY;
+    }
+  }
+  return responses->front();
+}
+
+bool Client::decodeFrame(const wire::Frame& frame, std::vector<Response>* responses) {
+  Response response;
+  Message message;
+  if (frame.type == wire::FrameType::MESSAGE && wire::decodeMessage(frame, &message)) {
+    response.codeline = CodeLine{ 1, 102, "Processing" };  // as pushed over HTTP
+    response.body = message.toJson();
+  } else if (!wire::decodeResponse(frame, &response)) {
+    ERR("Invalid frame of type %i - ignored", static_cast<int>(frame.type));
+    return false;
+  }
+  responses->push_back(response);
+  return true;
+}
+
 /* API invocations */
 // ----------------------------------------------------------------------------
 /* List all peers */
@@ -272,15 +356,20 @@ void Client::listAllPeers(int channel) {
   printf("\e[5;00;36mSystem: List of all logged in peers\e[m");
   if (channel == WRONG_CHANNEL) {
     printf("\n");
-    m_api_impl->getAllPeers();
   } else {
     printf("\e[5;00;36m on channel: \e[m%i\n", channel);
+  }
+  if (m_roster_version != 0 && m_roster_channel == channel) {
+    m_api_impl->getAllPeers(channel, m_roster_version);  // only what has changed since last time
+  } else if (channel == WRONG_CHANNEL) {
+    m_api_impl->getAllPeers();
+  } else {
     m_api_impl->getAllPeers(channel);
   }
-  receiveAndprocessListAllPeersResponse(channel != WRONG_CHANNEL);
+  receiveAndprocessListAllPeersResponse(channel);
 }
 
-void Client::receiveAndprocessListAllPeersResponse(bool withChannel) {
+void Client::receiveAndprocessListAllPeersResponse(int channel) {
   bool is_closed = false;
   std::vector<Response> responses;
   Response check_response = getResponse(m_socket, &is_closed, &responses);
@@ -292,20 +381,29 @@ void Client::receiveAndprocessListAllPeersResponse(bool withChannel) {
   auto json = common::preparse(check_response.body);
   document.Parse(json.c_str());
 
+  bool is_delta = document.IsObject() && document.HasMember(ITEM_DELTAS) && document[ITEM_DELTAS].IsArray();
   if (document.IsObject() &&
-      document.HasMember(ITEM_PEERS) && document[ITEM_PEERS].IsArray() &&
-      (!withChannel || document.HasMember(ITEM_CHANNEL) && document[ITEM_CHANNEL].IsInt())) {
-    int channel = DEFAULT_CHANNEL;
-    if (withChannel) {
-      channel = document[ITEM_CHANNEL].GetInt();
+      (is_delta || (document.HasMember(ITEM_PEERS) && document[ITEM_PEERS].IsArray())) &&
+      (channel == WRONG_CHANNEL || (document.HasMember(ITEM_CHANNEL) && document[ITEM_CHANNEL].IsInt()))) {
+    if (!is_delta) {
+      m_roster.clear();
     }
-    auto peers = document[ITEM_PEERS].GetArray();
+    auto peers = document[is_delta ? ITEM_DELTAS : ITEM_PEERS].GetArray();
     for (rapidjson::Value::ConstValueIterator it = peers.Begin(); it != peers.End(); ++it) {
-      ID_t id = (*it)[ITEM_ID].GetInt64();
-      std::string name = (*it)[ITEM_LOGIN].GetString();
-      std::string email = (*it)[ITEM_EMAIL].GetString();
-      int channel = (*it)[ITEM_CHANNEL].GetInt();
-      printf("\tPeer[%lli]: %s <%s> is on channel: %i\n", id, name.c_str(), email.c_str(), channel);
+      Peer peer = Peer::Builder((*it)[ITEM_ID].GetInt64())
+          .setLogin((*it)[ITEM_LOGIN].GetString())
+          .setEmail((*it)[ITEM_EMAIL].GetString())
+          .setChannel((*it)[ITEM_CHANNEL].GetInt())
+          .build();
+      m_roster.erase(peer.getId());
+      if (!is_delta || static_cast<RosterMove>((*it)[ITEM_MOVE].GetInt()) != RosterMove::LEAVE) {
+        m_roster.insert(std::make_pair(peer.getId(), peer));
+      }
+    }
+    m_roster_channel = channel;
+    m_roster_version = document.HasMember(ITEM_VERSION) && document[ITEM_VERSION].IsUint64() ? document[ITEM_VERSION].GetUint64() : 0;
+    for (auto& it : m_roster) {
+      printf("\tPeer[%lli]: %s <%s> is on channel: %i\n", it.first, it.second.getLogin().c_str(), it.second.getEmail().c_str(), it.second.getChannel());
     }
     printf("\n");
   } else {
@@ -450,8 +548,10 @@ void Client::tryLogin(LoginForm& form) {
   bool is_closed = false;
 #if SECURE
   {
-    DBG("Encrypt login form before send");
-    form.encrypt(m_server_pubkey);
+    if (!form.isEncrypted()) {  // already encrypted, if resent
+      DBG("Encrypt login form before send");
+      form.encrypt(m_server_pubkey);
+    }
   }
 #endif  // SECURE
   m_api_impl->sendLoginForm(form);
@@ -493,6 +593,10 @@ void Client::tryLogin(LoginForm& form) {
       case StatusCode::ALREADY_LOGGED_IN:
         onAlreadyLoggedIn();
         break;
+      case StatusCode::SERVER_BUSY:
+        onServerBusy();
+        tryLogin(form);  // resend the same form
+        break;
       case StatusCode::INVALID_FORM:
         ERR("Login failed: client's sent invalid form");
         throw RuntimeException();
@@ -596,8 +700,10 @@ void Client::tryRegister(RegistrationForm& form) {
   bool is_closed = false;
 #if SECURE
   {
-    DBG("Encrypt registration form before send");
-    form.encrypt(m_server_pubkey);
+    if (!form.isEncrypted()) {  // already encrypted, if resent
+      DBG("Encrypt registration form before send");
+      form.encrypt(m_server_pubkey);
+    }
   }
 #endif  // SECURE
   m_api_impl->sendRegistrationForm(form);
@@ -631,6 +737,10 @@ void Client::tryRegister(RegistrationForm& form) {
       case StatusCode::ALREADY_REGISTERED:
         onAlreadyRegistered();
         break;
+      case StatusCode::SERVER_BUSY:
+        onServerBusy();
+        tryRegister(form);  // resend the same form
+        break;
       case StatusCode::INVALID_FORM:
         ERR("Registration failed: client's sent invalid form");
         throw RuntimeException();
@@ -665,7 +775,18 @@ void Client::onAlreadyRegistered() {
   goToMainMenu();
 }
 
+void Client::onServerBusy() {
+  printf("\e[5;00;33mSystem: Server is busy, retry in %i ms\e[m\n", SERVER_BUSY_RETRY_DELAY);
+  std::this_thread::sleep_for(std::chrono::milliseconds(SERVER_BUSY_RETRY_DELAY));
+}
+
 void Client::startChat() {
+#if SECURE
+  if (m_key_version == secure::KeyVersion::RSA_PEM &&
+      !common::isFileAccessible(common::createFilenameWithId(m_id, PUBLIC_KEY_FILE))) {
+    secure::getKeyPool();  // key pair for '.pk' is generated in background meanwhile
+  }
+#endif  // SECURE
   std::thread t(&Client::receiverThread, this);
   t.detach();
 
@@ -709,6 +830,7 @@ void Client::startChat() {
         printf("\t\e[5;00;37m.px <id> - abort private secure chat with <id>\e[m\n");
         printf("\t\e[5;00;37m.pe <id> - send public key to <id>\e[m\n");
         printf("\t\e[5;00;37m.pk - store public key remotely (generate if not exists)\e[m\n");
+        printf("\t\e[5;00;37m.g - toggle group secure chat in current channel\e[m\n");
 #endif  // SECURE
         printf("\t\e[5;00;37m.i <login | email> - get peer's id by login or email\e[m\n");
         printf("\t\e[5;00;37m.x <id> - send request to kick peer with <id>\e[m\n");
@@ -737,7 +859,14 @@ void Client::startChat() {
         m_private_secure_chat = false;
         continue;
       case util::Command::PRIVATE_PUBKEY_EXCHANGE:
-        m_api_impl->privatePubKeysExchange(m_id, value);
+        if (m_key_pair.second.getVersion() == secure::KeyVersion::X25519) {
+          // fresh one-time key each time, session key is re-agreed with it
+          m_ephemeral_keys[value] = secure::agreement::generateEphemeralKeyPair(value, m_key_pair.second);
+          m_api_impl->privatePubKeysExchange(m_id, value, m_ephemeral_keys[value].first);
+          agreeSessionKey(value);
+        } else {
+          m_api_impl->privatePubKeysExchange(m_id, value, secure::Key::EMPTY);
+        }
         continue;
       case util::Command::PRIVATE_PUBKEY:
         if (m_key_pair.first == secure::Key::EMPTY) {
@@ -756,6 +885,14 @@ void Client::startChat() {
       case util::Command::ADMIN_REQUEST:
         m_api_impl->sendAdminRequest(m_id, obtainAdminCert());
         continue;
+      case util::Command::GROUP_SECURE:
+        m_group_secure_chat = !m_group_secure_chat;
+        if (m_group_secure_chat) {
+          printf("\e[5;00;34mSystem: messages to channel [%i] will be encrypted with sender key, given to %zu peer(s) with agreed session key\e[m\n", m_channel, m_session_keys.size());
+        } else {
+          printf("\e[5;00;34mSystem: group secure chat is off\e[m\n");
+        }
+        continue;
 #endif  // SECURE
       case util::Command::UNKNOWN:
       default:
@@ -777,13 +914,24 @@ void Client::startChat() {
 #if SECURE
     if (m_private_secure_chat) {
       auto it = m_handshakes.find(m_dest_id);
-      if (it != m_handshakes.end()) {
+      auto session_it = m_session_keys.find(m_dest_id);
+      if (session_it != m_session_keys.end()) {
+        message.encrypt(session_it->second);
+      } else if (it != m_handshakes.end() && it->second.getVersion() == secure::KeyVersion::RSA_PEM) {
         message.encrypt(*m_asym_cryptor, it->second);
       } else {
         WRN("Missing public key for peer [%lli]. Fallback to send not-encrypted message to dedicated peer", m_dest_id);
         m_api_impl->privateAbort(m_id, m_dest_id);  // abort handshake if keys are missing
         m_private_secure_chat = false;
       }
+    } else if (m_group_secure_chat && m_dest_id == UNKNOWN_ID) {
+      unsigned char raw[KEY_LENGTH] = {0};
+      secure::SymmetricKey sender_key(raw);
+      if (prepareSenderKey() && secure::agreement::decodeSenderKey(m_sender_key, sender_key)) {
+        message.encrypt(sender_key);  // once for the whole channel
+      } else {
+        WRN("Missing sender key. Fallback to send not-encrypted message to channel [%i]", m_channel);
+      }
     }
 #endif  // SECURE
 
@@ -811,6 +959,8 @@ void Client::receiverThread() {
     for (size_t i = 0; !interruption && i < total; ++i) {
       VER("Processing response: %zu / %zu", i + 1, total);
       Response& response = responses[i];
+      util::ResponseEvent event;
+      util::ResponseType type = util::classifyResponse(response.body, &event);  // single parse
 
       {  // system responses
         int code = response.codeline.code;
@@ -823,8 +973,8 @@ void Client::receiverThread() {
         }
 
         {  // status code
-          StatusCode status = StatusCode::UNKNOWN;
-          if (util::checkStatus(response.body, status)) {
+          if (type == util::ResponseType::STATUS) {
+            StatusCode status = event.status;
             SYS("Received status: %i", static_cast<int>(status));
             switch (status) {
               case StatusCode::PERMISSION_DENIED:
@@ -845,10 +995,10 @@ void Client::receiverThread() {
         }
 
         {  // check
-          bool check = false;
-          Path action = Path::UNKNOWN;
-          ID_t id = UNKNOWN_ID;
-          if (util::checkCheck(response.body, check, action, id)) {
+          if (type == util::ResponseType::CHECK) {
+            bool check = event.check;
+            Path action = event.action;
+            ID_t id = event.id;
             SYS("Received check: action = %i, ID = %lli", static_cast<int>(action), id);
             switch (action) {
               case Path::PEER_ID:
@@ -867,14 +1017,16 @@ void Client::receiverThread() {
         }
 
         {  // system message
-          std::string system = "", payload = "";
-          Path action = Path::UNKNOWN;
-          ID_t id = UNKNOWN_ID;
-          if (util::checkSystemMessage(response.body, &system, &payload, action, id)) {
-            printf("\e[5;00;32mSystem: %s\e[m\n", system.c_str());
+          if (type == util::ResponseType::SYSTEM) {
+            Path action = event.action;
+            ID_t id = event.id;
+            printf("\e[5;00;32mSystem: %s\e[m\n", event.system.c_str());
             switch (action) {
               case Path::LOGOUT:
                 DBG("Peer [%lli] has just logged out", id);
+#if SECURE
+                dropPeerKeys(id);
+#endif  // SECURE
                 if (m_dest_id == id) {
                   m_dest_id = UNKNOWN_ID;
                   if (m_private_secure_chat) {
@@ -886,13 +1038,13 @@ void Client::receiverThread() {
                 }
                 break;
             }
-            processSystemPayload(payload);
+            processSystemPayload(event.payload);
             continue;  // received system message from Server
           }
         }
 #if SECURE
-        util::HandshakeBundle bundle;
-        auto handshake_type = util::checkPrivateHandshake(response.body, &bundle);
+        const util::HandshakeBundle& bundle = event.bundle;
+        auto handshake_type = event.handshake;
         if (bundle.dest_id == m_id || handshake_type == PrivateHandshake::PUBKEY) {
           std::string acceptance;
           switch (handshake_type) {
@@ -914,6 +1066,7 @@ void Client::receiverThread() {
             case PrivateHandshake::ABORT:
               printf("\e[5;01;35mPeer [%lli] has aborted private communication with you\e[m\n", bundle.src_id);
               m_handshakes.erase(bundle.src_id);  // remove previously stored public key
+              dropPeerKeys(bundle.src_id);
               if (m_dest_id == bundle.src_id) {
                 m_dest_id = UNKNOWN_ID;
               }
@@ -923,6 +1076,30 @@ void Client::receiverThread() {
               {
                 auto unwrapped_json = common::unwrapJsonObject(ITEM_PRIVATE_PUBKEY, response.body, common::PreparseLeniency::STRICT);
                 secure::Key key_unformatted = secure::Key::fromJson(unwrapped_json);
+                if (key_unformatted.getVersion() == secure::KeyVersion::X25519) {
+                  ID_t peer_id = key_unformatted.getId();
+                  if (!secure::agreement::verifyPublicKey(key_unformatted)) {
+                    WRN("Received agreement key from peer [%lli] with invalid signature. Skip", peer_id);
+                    continue;
+                  }
+                  if (!secure::agreement::pinIdentity(m_id, key_unformatted)) {
+                    printf("\e[5;00;31mSystem: identity of peer [%lli] has changed since first seen, its key is rejected\e[m\n", peer_id);
+                    continue;
+                  }
+                  if (response.body.find("\"" D_ITEM_PRIVATE_EPHEMERAL "\"") != std::string::npos) {
+                    auto unwrapped_ephemeral = common::unwrapJsonObject(ITEM_PRIVATE_EPHEMERAL, response.body, common::PreparseLeniency::STRICT);
+                    secure::Key ephemeral = secure::Key::fromJson(unwrapped_ephemeral);
+                    if (!secure::agreement::verifyEphemeralKey(ephemeral, m_id, key_unformatted)) {
+                      WRN("Received one-time key from peer [%lli] with invalid signature. Skip", peer_id);
+                      continue;
+                    }
+                    m_peer_ephemeral_keys[peer_id] = ephemeral;
+                  }
+                  printf("\e[5;01;34mReceived agreement key from peer [%lli]\e[m\n", peer_id);
+                  m_handshakes[peer_id] = key_unformatted;
+                  agreeSessionKey(peer_id);
+                  continue;
+                }
                 secure::Key key(key_unformatted.getId(), common::restoreStrippedInMemoryPEM(key_unformatted.getKey()));
                 printf("\e[5;01;34mReceived public key from peer [%lli]\e[m\n", key.getId());
                 TRC("Public Key: %s", key.getKey().c_str());
@@ -941,12 +1118,33 @@ void Client::receiverThread() {
       }
 
       // peers' messages
+      if (type != util::ResponseType::MESSAGE) {
+        WRN("Something doesn't like a message has been received. Skip");
+        continue;
+      }
       try {
-        Message message = Message::fromJson(response.body);
+        Message& message = event.message;
 
 #if SECURE
-        if (message.isEncrypted()) {
-          message.decrypt(*m_asym_cryptor, m_key_pair.second);
+        if (message.isEncrypted() && message.getDestId() == UNKNOWN_ID) {
+          auto group_it = m_group_keys.find(std::make_pair(message.getId(), message.getChannel()));
+          unsigned char raw[KEY_LENGTH] = {0};
+          secure::SymmetricKey sender_key(raw);
+          if (group_it != m_group_keys.end() && secure::agreement::decodeSenderKey(group_it->second, sender_key)) {
+            message.decrypt(sender_key);
+          } else {
+            WRN("No sender key of peer [%lli] for channel [%i]", message.getId(), message.getChannel());
+          }
+        } else if (message.isEncrypted()) {
+          auto session_it = m_session_keys.find(message.getId());
+          if (session_it != m_session_keys.end()) {
+            message.decrypt(session_it->second);
+            if (onSenderKeyReceived(message)) {
+              continue;  // not a message to display
+            }
+          } else {
+            message.decrypt(*m_asym_cryptor, m_key_pair.second);
+          }
         }
 #endif  // SECURE
 
@@ -958,7 +1156,7 @@ void Client::receiverThread() {
 
         printf("\e[5;00;33m%s\e[m :: \e[5;01;37m%s\e[m: %s\n", timestamp.c_str(), message.getLogin().c_str(), message.getMessage().c_str());
       } catch (ConvertException exception) {
-        WRN("Something doesn't like a message has been received. Skip");
+        WRN("Received message could not be processed. Skip");
       }
 
     }  // for loop ending
@@ -972,15 +1170,20 @@ void Client::processSystemPayload(const std::string& payload) {
   if (!payload.empty()) {
     std::vector<Query> params;
     m_parser.parsePayload(payload, &params);
-    if (!params.empty()) {
+    for (auto& param : params) {
 #if SECURE
       // server's public key has changed
-      if (strcmp(params[0].key.c_str(), ITEM_PRIVATE_PUBKEY) == 0) {
-        std::string pem = common::restoreStrippedInMemoryPEM(params[0].value);
+      if (strcmp(param.key.c_str(), ITEM_PRIVATE_PUBKEY) == 0) {
+        std::string pem = common::restoreStrippedInMemoryPEM(param.value);
         m_server_pubkey = secure::Key(SERVER_ID, pem);
         SYS("Received server's public key: %s", m_server_pubkey.getKey().c_str());
       }
 #endif  // SECURE
+      if (strcmp(param.key.c_str(), ITEM_FRAMING) == 0) {
+        m_is_framing_offered = param.value.compare("1") == 0;
+      } else if (strcmp(param.key.c_str(), ITEM_DEFLATE) == 0) {
+        m_is_deflate_offered = param.value.compare("1") == 0;
+      }
     }
   }
 }
@@ -1001,7 +1204,11 @@ void Client::enterPassword(std::string& password) {
 #if SECURE
 
 void Client::getKeyPair() {
-  m_key_pair = secure::random::getKeyPair(m_id);
+  if (m_key_version == secure::KeyVersion::X25519) {
+    m_key_pair = secure::agreement::generateKeyPair(m_id, secure::agreement::getIdentityKey(m_id));  // identity is kept in file
+  } else {
+    m_key_pair = secure::random::getKeyPair(m_id);
+  }
 }
 
 std::string Client::obtainAdminCert() const {
@@ -1010,6 +1217,94 @@ std::string Client::obtainAdminCert() const {
   return secure::good::encryptRSA(m_server_pubkey, cert, encrypted);
 }
 
+/* Rotates own sender key if needed and gives it to peers with agreed session key */
+bool Client::prepareSenderKey() {
+  if (m_sender_key_stale || m_sender_key.getKey().empty() || m_sender_key.getChannel() != m_channel) {
+    secure::SenderKey sender_key = secure::agreement::generateSenderKey(m_id, m_channel, m_sender_key.getGeneration() + 1);
+    if (sender_key.getKey().empty()) {
+      return false;
+    }
+    DBG("Rotate sender key for channel [%i], generation %u", m_channel, sender_key.getGeneration());
+    m_sender_key = sender_key;
+    m_sender_key_holders.clear();
+    m_sender_key_stale = false;
+  }
+
+  std::string distribution = m_sender_key.toJson();
+  for (auto& it : m_session_keys) {
+    if (m_sender_key_holders.insert(it.first).second) {
+      Message message = Message::Builder(m_id)
+          .setLogin(m_name).setEmail(m_email).setChannel(m_channel).setDestId(it.first)
+          .setTimestamp(common::getCurrentTime()).setSize(distribution.length()).setEncrypted(false).setMessage(distribution).build();
+      message.encrypt(it.second);
+      m_api_impl->sendMessage(message);
+    }
+  }
+  return true;
+}
+
+/* Stores sender key, if message sent over session key carries it */
+bool Client::onSenderKeyReceived(const Message& message) {
+  if (message.isEncrypted() || message.getMessage().rfind("{\"" D_ITEM_SENDER_KEY "\"", 0) != 0) {
+    return false;
+  }
+  try {
+    secure::SenderKey sender_key = secure::SenderKey::fromJson(message.getMessage());
+    if (sender_key.getId() != message.getId()) {
+      WRN("Peer [%lli] has sent sender key of other peer [%lli]. Skip", message.getId(), sender_key.getId());
+      return true;
+    }
+    auto& stored = m_group_keys[std::make_pair(sender_key.getId(), sender_key.getChannel())];
+    if (!stored.getKey().empty() && stored.getGeneration() > sender_key.getGeneration()) {
+      DBG("Outdated sender key of peer [%lli], generation %u", sender_key.getId(), sender_key.getGeneration());
+      return true;
+    }
+    stored = sender_key;
+    printf("\e[5;01;34mReceived sender key from peer [%lli] for channel [%i]\e[m\n", sender_key.getId(), sender_key.getChannel());
+  } catch (ConvertException exception) {
+    WRN("Malformed sender key from peer [%lli]. Skip", message.getId());
+  }
+  return true;
+}
+
+/* Forgets keys of peer and rotates own sender key, so that peer can't read further */
+void Client::dropPeerKeys(ID_t id) {
+  if (m_session_keys.erase(id) > 0) {
+    m_sender_key_stale = true;
+  }
+  m_ephemeral_keys.erase(id);
+  m_peer_ephemeral_keys.erase(id);
+  for (auto it = m_group_keys.begin(); it != m_group_keys.end(); ) {
+    if (it->first.first == id) {
+      it = m_group_keys.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+/* Agrees on session key once own and peer's agreement and one-time keys are all known */
+bool Client::agreeSessionKey(ID_t id) {
+  auto handshake_it = m_handshakes.find(id);
+  auto ephemeral_it = m_ephemeral_keys.find(id);
+  auto peer_ephemeral_it = m_peer_ephemeral_keys.find(id);
+  if (m_key_pair.second.getVersion() != secure::KeyVersion::X25519 || handshake_it == m_handshakes.end() ||
+      ephemeral_it == m_ephemeral_keys.end() || peer_ephemeral_it == m_peer_ephemeral_keys.end()) {
+    WRN("No session key agreed with peer [%lli] yet: both peers have to exchange x25519 keys", id);
+    return false;
+  }
+  unsigned char raw[KEY_LENGTH] = {0};
+  secure::SymmetricKey session_key(raw);
+  if (!secure::agreement::deriveSessionKey(m_key_pair.second, ephemeral_it->second.second,
+                                           handshake_it->second, peer_ephemeral_it->second, session_key)) {
+    return false;
+  }
+  m_session_keys.erase(id);
+  m_session_keys.emplace(id, session_key);
+  DBG("Session key agreed with peer [%lli]", id);
+  return true;
+}
+
 #endif  // SECURE
 
 
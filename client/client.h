@@ -29,8 +29,10 @@
 #ifndef CHAT_SERVER_CLIENT__H__
 #define CHAT_SERVER_CLIENT__H__
 
+#include <map>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include "all.h"
 #include "api/api.h"
 #include "api/icryptor.h"
@@ -39,9 +41,13 @@
 #include "common.h"
 #include "exception.h"
 #include "parser/my_parser.h"
+#include "wire.h"
+
+#define SERVER_BUSY_RETRY_DELAY 1000  // ms
 
 #if SECURE
 #include "api/icryptor.h"
+#include "crypting/sym_key.h"
 #endif  // SECURE
 
 class Client {
@@ -63,21 +69,40 @@ protected:
   bool m_is_connected;
   bool m_is_stopped;
   bool m_private_secure_chat;
+  bool m_is_framing_offered;  // by Server in its hello
+  bool m_is_framed;  // connection has switched to binary frames
+  bool m_is_deflate_offered;  // large frames could come compressed
   int m_socket;  // for insecure connections only
   std::string m_ip_address;
   std::string m_port;
   MyParser m_parser;
+  wire::FrameDecoder m_frames;
+  wire::Inflater m_inflater;
+  std::map<ID_t, Peer> m_roster;  // last listed peers, kept in sync with deltas
+  int m_roster_channel;
+  uint64_t m_roster_version;  // 0 if nothing was listed yet
   ClientApi* m_api_impl;
 #if SECURE
   secure::ICryptor* m_cryptor;
   secure::IAsymmetricCryptor* m_asym_cryptor;
+  secure::KeyVersion m_key_version;  // kind of key pair for private handshakes
   std::pair<secure::Key, secure::Key> m_key_pair;
   std::unordered_map<ID_t, secure::Key> m_handshakes;
+  std::unordered_map<ID_t, secure::SymmetricKey> m_session_keys;  // agreed with peers over X25519
+  std::unordered_map<ID_t, std::pair<secure::Key, secure::Key>> m_ephemeral_keys;  // own one-time key pairs, by peer
+  std::unordered_map<ID_t, secure::Key> m_peer_ephemeral_keys;  // latest one-time keys received from peers
+  bool m_group_secure_chat;  // encrypt channel messages once with own sender key
+  bool m_sender_key_stale;   // some peer holding own sender key has left
+  secure::SenderKey m_sender_key;
+  std::unordered_set<ID_t> m_sender_key_holders;  // peers own sender key was distributed to
+  std::map<std::pair<ID_t, int>, secure::SenderKey> m_group_keys;  // sender keys of other peers by id and channel
   secure::Key m_server_pubkey;
 #endif  // SECURE
 
   bool readConfiguration(const std::string& config_file);
   virtual Response getResponse(int socket, bool* is_closed, std::vector<Response>* responses);
+  Response getFramedResponse(int socket, bool* is_closed, std::vector<Response>* responses);
+  bool decodeFrame(const wire::Frame& frame, std::vector<Response>* responses);
 
   virtual void goToMainMenu();
   void stopThread();
@@ -85,7 +110,7 @@ protected:
 
   void listAllPeers();
   void listAllPeers(int channel);
-  void receiveAndprocessListAllPeersResponse(bool withChannel);
+  void receiveAndprocessListAllPeersResponse(int channel);
 
   void getPeerId(const std::string& name);
   void checkAuth(const std::string& name, std::string& password);
@@ -105,6 +130,7 @@ protected:
   void onWrongPassword(LoginForm& form);
   void onAlreadyLoggedIn();
   void onAlreadyRegistered();
+  void onServerBusy();
   virtual void startChat();
 
   virtual void receiverThread();
@@ -114,6 +140,10 @@ protected:
 #if SECURE
   void getKeyPair();
   std::string obtainAdminCert() const;
+  bool prepareSenderKey();
+  bool onSenderKeyReceived(const Message& message);
+  void dropPeerKeys(ID_t id);
+  bool agreeSessionKey(ID_t id);
 #endif  // SECURE
 };
 
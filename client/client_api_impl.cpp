@@ -28,7 +28,9 @@
 
 #include <sys/socket.h>
 #include "client_api_impl.h"
+#include "logger.h"
 #include "request_prepare.h"
+#include "wire.h"
 
 /* Client implementation */
 // ----------------------------------------------------------------------------
@@ -37,80 +39,107 @@ ClientApiImpl::ClientApiImpl(
     const std::string& ip_address,
     const std::string& port)
   : m_socket(socket)
-  , m_host(ip_address + ":" + port) {
+  , m_host(ip_address + ":" + port)
+  , m_is_framed(false) {
 }
 
 ClientApiImpl::~ClientApiImpl() {
 }
 
+void ClientApiImpl::getHello() {
+  std::string request = util::getHello_request(m_host);
+  sendRequest(request);
+}
+
 void ClientApiImpl::getLoginForm() {
   std::string request = util::getLoginForm_request(m_host);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::getRegistrationForm() {
   std::string request = util::getRegistrationForm_request(m_host);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::sendLoginForm(const LoginForm& form) {
   std::string request = util::sendLoginForm_request(m_host, form);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::sendRegistrationForm(const RegistrationForm& form) {
   std::string request = util::sendRegistrationForm_request(m_host, form);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::sendMessage(const Message& message) {
+  if (m_is_framed) {
+    std::string frame;
+    wire::encodeMessage(message, &frame);
+    send(m_socket, frame.c_str(), frame.length(), 0);
+    return;
+  }
   std::string request = util::sendMessage_request(m_host, message);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::logout(ID_t id) {
   std::string request = util::logout_request(m_host, id);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::switchChannel(ID_t id, int channel) {
   std::string request = util::switchChannel_request(m_host, id, channel);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::getPeerId(const std::string& name) {
   std::string request = util::getPeerId_request(m_host, name);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::isLoggedIn(const std::string& name) {
   std::string request = util::isLoggedIn_request(m_host, name);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::isRegistered(const std::string& name) {
   std::string request = util::isRegistered_request(m_host, name);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::checkAuth(const std::string& name, const std::string& password, bool encrypted) {
   std::string request = util::checkAuth_request(m_host, name, password, encrypted);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::kickByAuth(const std::string& name, const std::string& password, bool encrypted) {
   std::string request = util::kickByAuth_request(m_host, name, password, encrypted);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::getAllPeers() {
   std::string request = util::getAllPeers_request(m_host);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::getAllPeers(int channel) {
   std::string request = util::getAllPeers_request(m_host, channel);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
+}
+
+void ClientApiImpl::getAllPeers(int channel, uint64_t since_version) {
+  std::string request = util::getAllPeers_request(m_host, channel, since_version);
+  sendRequest(request);
+}
+
+void ClientApiImpl::getHistory(int channel, uint64_t since_seq, int limit) {
+  std::string request = util::getHistory_request(m_host, channel, since_seq, limit);
+  sendRequest(request);
+}
+
+void ClientApiImpl::resume(ID_t id, const std::string& token) {
+  std::string request = util::resume_request(m_host, id, token);
+  sendRequest(request);
 }
 
 /* Private secure communication */
@@ -119,27 +148,27 @@ void ClientApiImpl::getAllPeers(int channel) {
 
 void ClientApiImpl::privateRequest(ID_t src_id, ID_t dest_id) {
   std::string request = util::privateRequest_request(m_host, src_id, dest_id);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::privateConfirm(ID_t src_id, ID_t dest_id, bool accept) {
   std::string request = util::privateConfirm_request(m_host, src_id, dest_id, accept);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::privateAbort(ID_t src_id, ID_t dest_id) {
   std::string request = util::privateAbort_request(m_host, src_id, dest_id);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::privatePubKey(ID_t id, const secure::Key& key) {
   std::string request = util::privatePubKey_request(m_host, id, key);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
-void ClientApiImpl::privatePubKeysExchange(ID_t src_id, ID_t dest_id) {
-  std::string request = util::privatePubKeysExchange_request(m_host, src_id, dest_id);
-  send(m_socket, request.c_str(), request.length(), 0);
+void ClientApiImpl::privatePubKeysExchange(ID_t src_id, ID_t dest_id, const secure::Key& ephemeral) {
+  std::string request = util::privatePubKeysExchange_request(m_host, src_id, dest_id, ephemeral);
+  sendRequest(request);
 }
 
 #endif  // SECURE
@@ -148,11 +177,36 @@ void ClientApiImpl::privatePubKeysExchange(ID_t src_id, ID_t dest_id) {
 // ----------------------------------------------------------------------------
 void ClientApiImpl::sendKickRequest(ID_t src_id, ID_t dest_id) {
   std::string request = util::sendKickRequest_request(m_host, src_id, dest_id);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
 void ClientApiImpl::sendAdminRequest(ID_t src_id, const std::string& cert) {
   std::string request = util::sendAdminRequest_request(m_host, src_id, cert);
-  send(m_socket, request.c_str(), request.length(), 0);
+  sendRequest(request);
 }
 
+/* Framing */
+// ----------------------------------------------------------------------------
+bool ClientApiImpl::enableFraming(bool accept_deflate) {
+  std::string hello;
+  wire::encodeHello(&hello, accept_deflate ? WIRE_HELLO_DEFLATE : 0);
+  if (send(m_socket, hello.c_str(), hello.length(), 0) != static_cast<ssize_t>(hello.length())) {
+    ERR("Failed to switch connection to binary frames");
+    return false;
+  }
+  m_is_framed = true;
+  return true;
+}
+
+void ClientApiImpl::sendRequest(const std::string& request) {
+  if (m_is_framed) {
+    std::string frame;
+    if (!wire::encodeHttpRequest(request.c_str(), request.length(), &frame)) {
+      ERR("Failed to frame request: %s", request.c_str());
+      return;
+    }
+    send(m_socket, frame.c_str(), frame.length(), 0);
+    return;
+  }
+  send(m_socket, request.c_str(), request.length(), 0);
+}
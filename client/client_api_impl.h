@@ -42,6 +42,7 @@ public:
   virtual ~ClientApiImpl();
 
   /* API */
+  void getHello() override;
   void getLoginForm() override;
   void getRegistrationForm() override;
   void sendLoginForm(const LoginForm& form) override;
@@ -56,19 +57,27 @@ public:
   void kickByAuth(const std::string& name, const std::string& password, bool encrypted) override;
   void getAllPeers() override;
   void getAllPeers(int channel) override;
+  void getAllPeers(int channel, uint64_t since_version) override;
+  void getHistory(int channel, uint64_t since_seq, int limit) override;
+  void resume(ID_t id, const std::string& token) override;
 #if SECURE
   void privateRequest(ID_t src_id, ID_t dest_id) override;
   void privateConfirm(ID_t src_id, ID_t dest_id, bool accept) override;
   void privateAbort(ID_t src_id, ID_t dest_id) override;
   void privatePubKey(ID_t src_id, const secure::Key& key) override;
-  void privatePubKeysExchange(ID_t src_id, ID_t dest_id) override;
+  void privatePubKeysExchange(ID_t src_id, ID_t dest_id, const secure::Key& ephemeral) override;
 #endif  // SECURE
   void sendKickRequest(ID_t src_id, ID_t dest_id) override;
   void sendAdminRequest(ID_t src_id, const std::string& cert) override;
 
+  bool enableFraming(bool accept_deflate) override;
+
 private:
   int m_socket;
   std::string m_host;
+  bool m_is_framed;
+
+  void sendRequest(const std::string& request);  // as is or framed
 };
 
 #endif  // CHAT_SERVER_CLIENT_API_IMPL__H__
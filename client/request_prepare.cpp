@@ -33,6 +33,13 @@
 
 namespace util {
 
+std::string getHello_request(const std::string& host) {
+  std::ostringstream oss;
+  oss << "GET " D_PATH_HELLO " HTTP/1.1\r\nHost: " << host << "\r\n\r\n";
+  MSG("Request: %s", oss.str().c_str());
+  return oss.str();
+}
+
 std::string getLoginForm_request(const std::string& host) {
   std::ostringstream oss;
   oss << "GET " D_PATH_LOGIN " HTTP/1.1\r\nHost: " << host << "\r\n\r\n";
@@ -147,6 +154,36 @@ std::string getAllPeers_request(const std::string& host, int channel) {
   return oss.str();
 }
 
+std::string getAllPeers_request(const std::string& host, int channel, uint64_t since_version) {
+  std::ostringstream oss;
+  oss << "GET " D_PATH_ALL_PEERS "?" D_ITEM_SINCE_VERSION "=" << since_version;
+  if (channel != WRONG_CHANNEL) {
+    oss << "&" D_ITEM_CHANNEL "=" << channel;
+  }
+  oss << " HTTP/1.1\r\nHost: " << host << "\r\n\r\n";
+  MSG("Request: %s", oss.str().c_str());
+  return oss.str();
+}
+
+std::string getHistory_request(const std::string& host, int channel, uint64_t since_seq, int limit) {
+  std::ostringstream oss;
+  oss << "GET " D_PATH_HISTORY "?" D_ITEM_CHANNEL "=" << channel
+      << "&" D_ITEM_SINCE_SEQ "=" << since_seq
+      << "&" D_ITEM_LIMIT "=" << limit
+      << " HTTP/1.1\r\nHost: " << host << "\r\n\r\n";
+  MSG("Request: %s", oss.str().c_str());
+  return oss.str();
+}
+
+std::string resume_request(const std::string& host, ID_t id, const std::string& token) {
+  std::ostringstream oss;
+  oss << "PUT " D_PATH_RESUME "?" D_ITEM_ID "=" << id
+      << "&" D_ITEM_TOKEN "=" << token
+      << " HTTP/1.1\r\nHost: " << host << "\r\n\r\n";
+  MSG("Request: %s", oss.str().c_str());
+  return oss.str();
+}
+
 /* Private secure communication */
 // ----------------------------------------------------------------------------
 #if SECURE
@@ -188,11 +225,14 @@ std::string privatePubKey_request(const std::string& host, ID_t src_id, const se
   return oss.str();
 }
 
-std::string privatePubKeysExchange_request(const std::string& host, ID_t src_id, ID_t dest_id) {
+std::string privatePubKeysExchange_request(const std::string& host, ID_t src_id, ID_t dest_id, const secure::Key& ephemeral) {
   std::ostringstream oss;
   oss << "POST " D_PATH_PRIVATE_PUBKEY_EXCHANGE "?" D_ITEM_SRC_ID "=" << src_id
       << "&" D_ITEM_DEST_ID "=" << dest_id
       << " HTTP/1.1\r\nHost: " << host << "\r\n\r\n";
+  if (!(ephemeral == secure::Key::EMPTY)) {
+    oss << "{\"" D_ITEM_PRIVATE_EPHEMERAL "\":" << ephemeral.toJson() << "}";
+  }
   MSG("Request: %s", oss.str().c_str());
   return oss.str();
 }
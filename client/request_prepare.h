@@ -35,6 +35,7 @@
 
 namespace util {
 
+std::string getHello_request(const std::string& host);
 std::string getLoginForm_request(const std::string& host);
 std::string getRegistrationForm_request(const std::string& host);
 std::string sendLoginForm_request(const std::string& host, const LoginForm& form);
@@ -49,12 +50,15 @@ std::string checkAuth_request(const std::string& host, const std::string& name,
 std::string kickByAuth_request(const std::string& host, const std::string& name, const std::string& password, bool encrypted);
 std::string getAllPeers_request(const std::string& host);
 std::string getAllPeers_request(const std::string& host, int channel);
+std::string getAllPeers_request(const std::string& host, int channel, uint64_t since_version);
+std::string getHistory_request(const std::string& host, int channel, uint64_t since_seq, int limit);
+std::string resume_request(const std::string& host, ID_t id, const std::string& token);
 #if SECURE
 std::string privateRequest_request(const std::string& host, ID_t src_id, ID_t dest_id);
 std::string privateConfirm_request(const std::string& host, ID_t src_id, ID_t dest_id, bool accept);
 std::string privateAbort_request(const std::string& host, ID_t src_id, ID_t dest_id);
 std::string privatePubKey_request(const std::string& host, ID_t src_id, const secure::Key& key);
-std::string privatePubKeysExchange_request(const std::string& host, ID_t src_id, ID_t dest_id);
+std::string privatePubKeysExchange_request(const std::string& host, ID_t src_id, ID_t dest_id, const secure::Key& ephemeral);
 #endif  // SECURE
 std::string sendKickRequest_request(const std::string& host, ID_t src_id, ID_t dest_id);
 std::string sendAdminRequest_request(const std::string& host, ID_t src_id, const std::string& cert);
@@ -44,6 +44,11 @@ SecureClientApiImpl::SecureClientApiImpl(
 SecureClientApiImpl::~SecureClientApiImpl() {
 }
 
+void SecureClientApiImpl::getHello() {
+  std::string request = util::getHello_request(m_host);
+  BIO_write(m_bio, request.c_str(), request.length());
+}
+
 void SecureClientApiImpl::getLoginForm() {
   std::string request = util::getLoginForm_request(m_host);
   BIO_write(m_bio, request.c_str(), request.length());
@@ -114,6 +119,21 @@ void SecureClientApiImpl::getAllPeers(int channel) {
   BIO_write(m_bio, request.c_str(), request.length());
 }
 
+void SecureClientApiImpl::getAllPeers(int channel, uint64_t since_version) {
+  std::string request = util::getAllPeers_request(m_host, channel, since_version);
+  BIO_write(m_bio, request.c_str(), request.length());
+}
+
+void SecureClientApiImpl::getHistory(int channel, uint64_t since_seq, int limit) {
+  std::string request = util::getHistory_request(m_host, channel, since_seq, limit);
+  BIO_write(m_bio, request.c_str(), request.length());
+}
+
+void SecureClientApiImpl::resume(ID_t id, const std::string& token) {
+  std::string request = util::resume_request(m_host, id, token);
+  BIO_write(m_bio, request.c_str(), request.length());
+}
+
 /* Private secure communication */
 // ----------------------------------------------------------------------------
 void SecureClientApiImpl::privateRequest(ID_t src_id, ID_t dest_id) {
@@ -136,8 +156,8 @@ void SecureClientApiImpl::privatePubKey(ID_t id, const secure::Key& key) {
   BIO_write(m_bio, request.c_str(), request.length());
 }
 
-void SecureClientApiImpl::privatePubKeysExchange(ID_t src_id, ID_t dest_id) {
-  std::string request = util::privatePubKeysExchange_request(m_host, src_id, dest_id);
+void SecureClientApiImpl::privatePubKeysExchange(ID_t src_id, ID_t dest_id, const secure::Key& ephemeral) {
+  std::string request = util::privatePubKeysExchange_request(m_host, src_id, dest_id, ephemeral);
   BIO_write(m_bio, request.c_str(), request.length());
 }
 
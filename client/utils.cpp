@@ -36,8 +36,8 @@
 #include <unistd.h>
 #include "api/api.h"
 #include "common.h"
+#include "json_reader.h"
 #include "logger.h"
-#include "rapidjson/document.h"
 #include "utils.h"
 
 namespace util {
@@ -103,134 +103,108 @@ int selectChannel() {
   return channel;
 }
 
-bool checkCheck(const std::string& json, bool& check, Path& action, ID_t& id) {
-  action = Path::UNKNOWN;
-  id = UNKNOWN_ID;
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-  bool result = document.IsObject() &&
-      document.HasMember(ITEM_CHECK) && document[ITEM_CHECK].IsInt();
-  if (result) {
-    check = document[ITEM_CHECK].GetInt() != 0;
-    if (document.HasMember(ITEM_ACTION) && document[ITEM_ACTION].IsInt() &&
-        document.HasMember(ITEM_ID) && document[ITEM_ID].IsInt64()) {
-      action = static_cast<Path>(document[ITEM_ACTION].GetInt());
-      id = document[ITEM_ID].GetInt64();
-    } else {
-      DBG("Check json has no action and peer's id");
-    }
+ResponseType classifyResponse(const std::string& json, ResponseEvent* event) {
+  event->status = StatusCode::UNKNOWN;
+  event->check = false;
+  event->action = Path::UNKNOWN;
+  event->id = UNKNOWN_ID;
+  event->system.clear();
+  event->payload.clear();
+
+  ID_t dest_id = UNKNOWN_ID;
+  std::string login, email, message;
+  int code = 0, check = 0, action = 0, channel = 0, size = 0, is_encrypted = 0;
+  uint64_t timestamp = 0;
+  json::Reader reader;
+  reader.bind(ITEM_CODE, &code, false).bind(ITEM_ID, &event->id, false).bind(ITEM_CHECK, &check, false)
+        .bind(ITEM_ACTION, &action, false).bind(ITEM_SYSTEM, &event->system, false)
+        .bind(ITEM_PAYLOAD, &event->payload, false).bind(ITEM_LOGIN, &login, false)
+        .bind(ITEM_EMAIL, &email, false).bind(ITEM_CHANNEL, &channel, false)
+        .bind(ITEM_DEST_ID, &dest_id, false).bind(ITEM_TIMESTAMP, &timestamp, false)
+        .bind(ITEM_SIZE, &size, false).bind(ITEM_ENCRYPTED, &is_encrypted, false)
+        .bind(ITEM_MESSAGE, &message, false);
+
+#if SECURE
+  const char* handshake_items[] = { ITEM_PRIVATE_REQUEST, ITEM_PRIVATE_CONFIRM, ITEM_PRIVATE_ABORT };
+  const PrivateHandshake handshakes[] = { PrivateHandshake::REQUEST, PrivateHandshake::CONFIRM, PrivateHandshake::ABORT };
+  HandshakeBundle bundles[3] = {};
+  int accepts[3] = {0};
+  for (int i = 0; i < 3; ++i) {
+    reader.within(handshake_items[i]).bind(ITEM_SRC_ID, &bundles[i].src_id, false)
+          .bind(ITEM_DEST_ID, &bundles[i].dest_id, false).bind(ITEM_ACCEPT, &accepts[i], false);
   }
-  return result;
-}
+  ID_t pubkey_id = UNKNOWN_ID;
+  reader.within(ITEM_PRIVATE_PUBKEY).bind(ITEM_ID, &pubkey_id, false);
+  event->handshake = PrivateHandshake::UNKNOWN;
+  event->bundle = HandshakeBundle();
+#endif  // SECURE
 
-bool checkStatus(const std::string& json, StatusCode& status) {
-  status = StatusCode::UNKNOWN;
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-  bool result = document.IsObject() &&
-      document.HasMember(ITEM_CODE) && document[ITEM_CODE].IsInt() &&
-      document.HasMember(ITEM_ID) && document[ITEM_ID].IsInt64();
-  if (result) {
-    status = static_cast<StatusCode>(document[ITEM_CODE].GetInt());
+  if (!reader.read(common::preparse(json))) {
+    DBG("Response is not a valid json: %s", json.c_str());
+    return ResponseType::UNKNOWN;
   }
-  return result;
-}
 
-bool checkSystemMessage(
-    const std::string& json,
-    std::string* system,
-    std::string* payload,
-    Path& action,
-    ID_t& id) {
-  action = Path::UNKNOWN;
-  id = UNKNOWN_ID;
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-  bool result = document.IsObject() &&
-      document.HasMember(ITEM_SYSTEM) && document[ITEM_SYSTEM].IsString();
-  if (result) {
-    *system = document[ITEM_SYSTEM].GetString();
-    if (document.HasMember(ITEM_ACTION) && document[ITEM_ACTION].IsInt() &&
-        document.HasMember(ITEM_ID) && document[ITEM_ID].IsInt64()) {
-      action = static_cast<Path>(document[ITEM_ACTION].GetInt());
-      id = document[ITEM_ID].GetInt64();
+  if (reader.isSet(ITEM_CODE) && reader.isSet(ITEM_ID)) {
+    event->status = static_cast<StatusCode>(code);
+    return ResponseType::STATUS;
+  }
+  bool has_action = reader.isSet(ITEM_ACTION) && reader.isSet(ITEM_ID);
+  if (reader.isSet(ITEM_CHECK)) {
+    event->check = check != 0;
+    if (has_action) {
+      event->action = static_cast<Path>(action);
     } else {
-      DBG("System message json has no action and peer's id");
+      DBG("Check json has no action and peer's id");
+      event->id = UNKNOWN_ID;
     }
-    if (document.HasMember(ITEM_PAYLOAD) && document[ITEM_PAYLOAD].IsString()) {
-      *payload = document[ITEM_PAYLOAD].GetString();
+    return ResponseType::CHECK;
+  }
+  if (reader.isSet(ITEM_SYSTEM)) {
+    if (has_action) {
+      event->action = static_cast<Path>(action);
     } else {
+      DBG("System message json has no action and peer's id");
+      event->id = UNKNOWN_ID;
+    }
+    if (!reader.isSet(ITEM_PAYLOAD)) {
       DBG("System message json has no payload");
     }
+    return ResponseType::SYSTEM;
   }
-  return result;
-}
 
 #if SECURE
-
-static void fillHandshakeBundle(const rapidjson::Value& object, HandshakeBundle* bundle) {
-  if (bundle == nullptr) {
-    TRC("Bundle not allocated!");
-    return;
-  }
-  if (object.IsObject() &&
-      object.HasMember(ITEM_SRC_ID) && object[ITEM_SRC_ID].IsInt64() &&
-      object.HasMember(ITEM_DEST_ID) && object[ITEM_DEST_ID].IsInt64()) {
-    bundle->src_id = object[ITEM_SRC_ID].GetInt64();
-    bundle->dest_id = object[ITEM_DEST_ID].GetInt64();
-    if (object.HasMember(ITEM_ACCEPT) && object[ITEM_ACCEPT].IsInt()) {
-      bundle->accept = object[ITEM_ACCEPT].GetInt();
+  for (int i = 0; i < 3; ++i) {
+    if (reader.isSet(ITEM_SRC_ID, handshake_items[i]) && reader.isSet(ITEM_DEST_ID, handshake_items[i])) {
+      DBG("Handshake: %s", handshake_items[i]);
+      event->handshake = handshakes[i];
+      event->bundle = bundles[i];
+      event->bundle.accept = accepts[i] != 0;
+      return ResponseType::HANDSHAKE;
     }
-  } else {
-    TRC("Object is not a handshake structure");
-  }
-}
-
-static void fillHandshakeBundleOnlyId(const rapidjson::Value& object, HandshakeBundle* bundle) {
-  if (bundle == nullptr) {
-    TRC("Bundle not allocated!");
-    return;
   }
-  if (object.IsObject() &&
-      object.HasMember(ITEM_ID) && object[ITEM_ID].IsInt64()) {
-      bundle->dest_id = object[ITEM_ID].GetInt64();
-  } else {
-    TRC("Object is not a handshake structure");
+  if (reader.isSet(ITEM_ID, ITEM_PRIVATE_PUBKEY)) {
+    DBG("Handshake: pubkey");
+    event->handshake = PrivateHandshake::PUBKEY;
+    event->bundle.dest_id = pubkey_id;
+    return ResponseType::HANDSHAKE;
   }
-}
+#endif  // SECURE
 
-PrivateHandshake checkPrivateHandshake(const std::string& json, HandshakeBundle* bundle) {
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json);
-  document.Parse(prepared_json.c_str());
-  if (document.IsObject()) {
-    if (document.HasMember(ITEM_PRIVATE_REQUEST)) {
-      DBG("Handshake: request");
-      fillHandshakeBundle(document[ITEM_PRIVATE_REQUEST], bundle);
-      return PrivateHandshake::REQUEST;
-    } else if (document.HasMember(ITEM_PRIVATE_CONFIRM)) {
-      DBG("Handshake: confirm");
-      fillHandshakeBundle(document[ITEM_PRIVATE_CONFIRM], bundle);
-      return PrivateHandshake::CONFIRM;
-    } else if (document.HasMember(ITEM_PRIVATE_ABORT)) {
-      DBG("Handshake: abort");
-      fillHandshakeBundle(document[ITEM_PRIVATE_ABORT], bundle);
-      return PrivateHandshake::ABORT;
-    } else if (document.HasMember(ITEM_PRIVATE_PUBKEY)) {
-      DBG("Handshake: pubkey");
-      fillHandshakeBundleOnlyId(document[ITEM_PRIVATE_PUBKEY], bundle);
-      return PrivateHandshake::PUBKEY;
+  const char* message_items[] = { ITEM_ID, ITEM_LOGIN, ITEM_EMAIL, ITEM_CHANNEL, ITEM_DEST_ID,
+                                  ITEM_TIMESTAMP, ITEM_SIZE, ITEM_ENCRYPTED, ITEM_MESSAGE };
+  for (const char* item : message_items) {
+    if (!reader.isSet(item)) {
+      DBG("Json is not related to any known response: %s", json.c_str());
+      return ResponseType::UNKNOWN;
     }
   }
-  DBG("Json is not related to private handshake: %s", json.c_str());
-  return PrivateHandshake::UNKNOWN;
+  event->message = Message::Builder(event->id).setLogin(login).setEmail(email).setChannel(channel)
+      .setDestId(dest_id).setTimestamp(timestamp).setSize(size)
+      .setEncrypted(is_encrypted != 0).setMessage(message)
+      .build();
+  return ResponseType::MESSAGE;
 }
 
-#endif  // SECURE
-
 bool isEmailValid(const std::string& email) {
   /*try {
     auto pattern = std::regex(EMAIL_REGEX_PATTERN);
@@ -273,6 +247,7 @@ Command parseCommand(const std::string& command, ID_t& value, std::string* paylo
       case 'x': return Command::KICK;
 #if SECURE
       case 'a': return Command::ADMIN_REQUEST;
+      case 'g': return Command::GROUP_SECURE;
 #endif
     }
   }
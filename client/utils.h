@@ -46,6 +46,33 @@ struct HandshakeBundle {
 };
 #endif  //SECURE
 
+/* Kind of response received from Server */
+enum class ResponseType : int {
+  UNKNOWN = 0,
+  STATUS = 1,
+  CHECK = 2,
+  SYSTEM = 3,
+#if SECURE
+  HANDSHAKE = 4,
+#endif  // SECURE
+  MESSAGE = 5
+};
+
+/* Fields of response, filled according to its type */
+struct ResponseEvent {
+  StatusCode status;
+  bool check;
+  Path action;
+  ID_t id;
+  std::string system;
+  std::string payload;
+#if SECURE
+  PrivateHandshake handshake;
+  HandshakeBundle bundle;
+#endif  // SECURE
+  Message message;
+};
+
 std::string enterSymbolic(const char* title);
 std::string enterSymbolic(const char* title, bool hide);
 #if SECURE
@@ -53,12 +80,8 @@ std::string enterSymbolic(const char* title, secure::ICryptor* cryptor);
 std::string enterSymbolic(const char* title, secure::ICryptor* cryptor, bool hide);
 #endif  // SECURE
 int selectChannel();
-bool checkCheck(const std::string& json, bool& check, Path& action, ID_t& id);
-bool checkStatus(const std::string& json, StatusCode& status);
-bool checkSystemMessage(const std::string& json, std::string* system, std::string* payload, Path& action, ID_t& id);
-#if SECURE
-PrivateHandshake checkPrivateHandshake(const std::string& json, HandshakeBundle* bundle);
-#endif  // SECURE
+/* Parses response once, classifies it and extracts its fields */
+ResponseType classifyResponse(const std::string& json, ResponseEvent* event);
 bool isEmailValid(const std::string& email);
 
 enum class Command : int {
@@ -78,6 +101,9 @@ enum class Command : int {
   , PEER_ID = 10
   , KICK = 11
   , ADMIN_REQUEST = 12
+#if SECURE
+  , GROUP_SECURE = 13
+#endif  // SECURE
 };
 
 Command parseCommand(const std::string& command, ID_t& value, std::string* payload);
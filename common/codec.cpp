@@ -0,0 +1,487 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include "codec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CODEC_X86 1
+#include <immintrin.h>
+#else
+#define CODEC_X86 0
+#endif
+
+namespace codec {
+
+namespace {
+
+const char HEX_ALPHABET[] = "0123456789abcdef";
+const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const unsigned char INVALID = 0xFF;
+
+struct Tables {
+  uint16_t hex_pairs[256];          // byte -> both its hex characters, in memory order
+  unsigned char hex_values[256];    // character -> nibble
+  unsigned char base64_values[256]; // character -> 6 bits
+
+  Tables() {
+    memset(hex_values, INVALID, sizeof(hex_values));
+    memset(base64_values, INVALID, sizeof(base64_values));
+    for (int i = 0; i < 256; ++i) {
+      char pair[2] = { HEX_ALPHABET[i >> 4], HEX_ALPHABET[i & 0x0F] };
+      memcpy(&hex_pairs[i], pair, 2);
+    }
+    for (int i = 0; i < 16; ++i) {
+      hex_values[static_cast<unsigned char>(HEX_ALPHABET[i])] = i;
+      hex_values[static_cast<unsigned char>(toupper(HEX_ALPHABET[i]))] = i;
+    }
+    for (int i = 0; i < 64; ++i) {
+      base64_values[static_cast<unsigned char>(BASE64_ALPHABET[i])] = i;
+    }
+  }
+
+  static int toupper(char c) { return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c; }
+};
+
+inline const Tables& tables() {
+  static const Tables s_tables;
+  return s_tables;
+}
+
+inline std::atomic<int>& level() {
+  static std::atomic<int> s_level(getSupportedLevel());
+  return s_level;
+}
+
+/* Scalar */
+// ----------------------------------------------------------------------------
+void hexEncodeScalar(const unsigned char* src, size_t size, char* output) {
+  const uint16_t* pairs = tables().hex_pairs;
+  for (size_t i = 0; i < size; ++i, output += 2) {
+    memcpy(output, &pairs[src[i]], 2);
+  }
+}
+
+bool hexDecodeScalar(const char* src, size_t length, unsigned char* output) {
+  const unsigned char* values = tables().hex_values;
+  for (size_t i = 0; i < length; i += 2) {
+    unsigned char hi = values[static_cast<unsigned char>(src[i])];
+    unsigned char lo = values[static_cast<unsigned char>(src[i + 1])];
+    if ((hi | lo) & 0xF0) {
+      return false;
+    }
+    *output++ = (hi << 4) | lo;
+  }
+  return true;
+}
+
+void base64EncodeScalar(const unsigned char* src, size_t size, char* output) {
+  size_t i = 0;
+  for (; i + 3 <= size; i += 3, output += 4) {
+    uint32_t group = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+    output[0] = BASE64_ALPHABET[(group >> 18) & 0x3F];
+    output[1] = BASE64_ALPHABET[(group >> 12) & 0x3F];
+    output[2] = BASE64_ALPHABET[(group >> 6) & 0x3F];
+    output[3] = BASE64_ALPHABET[group & 0x3F];
+  }
+  if (i < size) {  // tail of 1 or 2 bytes
+    uint32_t group = (src[i] << 16) | (i + 1 < size ? src[i + 1] << 8 : 0);
+    output[0] = BASE64_ALPHABET[(group >> 18) & 0x3F];
+    output[1] = BASE64_ALPHABET[(group >> 12) & 0x3F];
+    output[2] = i + 1 < size ? BASE64_ALPHABET[(group >> 6) & 0x3F] : '=';
+    output[3] = '=';
+  }
+}
+
+// whole quanta without padding
+bool base64DecodeScalar(const char* src, size_t length, unsigned char* output) {
+  const unsigned char* values = tables().base64_values;
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+  for (size_t i = 0; i < length; i += 4, output += 3) {
+    unsigned char a = values[in[i]], b = values[in[i + 1]], c = values[in[i + 2]], d = values[in[i + 3]];
+    if ((a | b | c | d) & 0xC0) {
+      return false;
+    }
+    uint32_t group = (a << 18) | (b << 12) | (c << 6) | d;
+    output[0] = group >> 16;
+    output[1] = (group >> 8) & 0xFF;
+    output[2] = group & 0xFF;
+  }
+  return true;
+}
+
+#if CODEC_X86
+
+/* SSSE3 */
+// ----------------------------------------------------------------------------
+__attribute__((target("ssse3")))
+size_t hexEncodeSsse3(const unsigned char* src, size_t size, char* output) {
+  const __m128i alphabet = _mm_loadu_si128(reinterpret_cast<const __m128i*>(HEX_ALPHABET));
+  const __m128i mask = _mm_set1_epi8(0x0F);
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16, output += 32) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i hi = _mm_shuffle_epi8(alphabet, _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+    __m128i lo = _mm_shuffle_epi8(alphabet, _mm_and_si128(in, mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 16), _mm_unpackhi_epi8(hi, lo));
+  }
+  return i;
+}
+
+// nibble values of 16 hex characters, 'valid' gets all ones for proper characters
+__attribute__((target("ssse3")))
+inline __m128i hexValuesSsse3(__m128i chars, __m128i& valid) {
+  __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+  valid = _mm_or_si128(is_digit, is_letter);
+  return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                      _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+__attribute__((target("ssse3")))
+size_t hexDecodeSsse3(const char* src, size_t length, unsigned char* output) {
+  const __m128i weights = _mm_set1_epi16(0x0110);  // high nibble * 16 + low nibble
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32, output += 16) {
+    __m128i valid_0, valid_1;
+    __m128i values_0 = hexValuesSsse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), valid_0);
+    __m128i values_1 = hexValuesSsse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16)), valid_1);
+    if (_mm_movemask_epi8(_mm_and_si128(valid_0, valid_1)) != 0xFFFF) {
+      break;  // scalar code reports the failure
+    }
+    __m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(values_0, weights), _mm_maddubs_epi16(values_1, weights));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), bytes);
+  }
+  return i;
+}
+
+// @see http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+__attribute__((target("ssse3")))
+inline __m128i base64CharsSsse3(__m128i in) {
+  const __m128i shift_lut = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+  __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+  __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+  __m128i indices = _mm_or_si128(t0, t1);
+  __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  reduced = _mm_or_si128(reduced, _mm_and_si128(less, _mm_set1_epi8(13)));
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(shift_lut, reduced));
+}
+
+__attribute__((target("ssse3")))
+size_t base64EncodeSsse3(const unsigned char* src, size_t size, char* output) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 12, output += 16) {  // loads 16 bytes, consumes 12
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), base64CharsSsse3(in));
+  }
+  return i;
+}
+
+// @see http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+__attribute__((target("ssse3")))
+size_t base64DecodeSsse3(const char* src, size_t length, unsigned char* output) {
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2F);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  // stores 16 bytes, 12 of them valid: keep enough input ahead to not overrun output
+  for (; i + 20 <= length; i += 16, output += 12) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+    __m128i lo = _mm_shuffle_epi8(lut_lo, _mm_and_si128(in, mask_2f));
+    __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero)) != 0xFFFF) {
+      break;  // scalar code reports the failure
+    }
+    __m128i eq_2f = _mm_cmpeq_epi8(in, mask_2f);
+    __m128i values = _mm_add_epi8(in, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles)));
+    __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    packed = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), packed);
+  }
+  return i;
+}
+
+/* AVX2 */
+// ----------------------------------------------------------------------------
+__attribute__((target("avx2")))
+size_t hexEncodeAvx2(const unsigned char* src, size_t size, char* output) {
+  const __m256i alphabet = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(HEX_ALPHABET)));
+  const __m256i mask = _mm256_set1_epi8(0x0F);
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32, output += 64) {
+    __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i hi = _mm256_shuffle_epi8(alphabet, _mm256_and_si256(_mm256_srli_epi16(in, 4), mask));
+    __m256i lo = _mm256_shuffle_epi8(alphabet, _mm256_and_si256(in, mask));
+    __m256i first = _mm256_unpacklo_epi8(hi, lo);   // bytes 0-7 and 16-23
+    __m256i second = _mm256_unpackhi_epi8(hi, lo);  // bytes 8-15 and 24-31
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), _mm256_permute2x128_si256(first, second, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 32), _mm256_permute2x128_si256(first, second, 0x31));
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+inline __m256i hexValuesAvx2(__m256i chars, __m256i& valid) {
+  __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+  __m256i letter = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+  __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+  __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+  valid = _mm256_or_si256(is_digit, is_letter);
+  return _mm256_or_si256(_mm256_and_si256(is_digit, digit),
+                         _mm256_and_si256(is_letter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2")))
+size_t hexDecodeAvx2(const char* src, size_t length, unsigned char* output) {
+  const __m256i weights = _mm256_set1_epi16(0x0110);
+  size_t i = 0;
+  for (; i + 64 <= length; i += 64, output += 32) {
+    __m256i valid_0, valid_1;
+    __m256i values_0 = hexValuesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), valid_0);
+    __m256i values_1 = hexValuesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32)), valid_1);
+    if (_mm256_movemask_epi8(_mm256_and_si256(valid_0, valid_1)) != -1) {
+      break;
+    }
+    __m256i bytes = _mm256_packus_epi16(_mm256_maddubs_epi16(values_0, weights), _mm256_maddubs_epi16(values_1, weights));
+    bytes = _mm256_permute4x64_epi64(bytes, 0xD8);  // pack works within 128-bit lanes
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), bytes);
+  }
+  return i;
+}
+
+// @see http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+__attribute__((target("avx2")))
+size_t base64EncodeAvx2(const unsigned char* src, size_t size, char* output) {
+  const __m256i shift_lut = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  const __m256i shuffle = _mm256_setr_epi8(
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  size_t i = 0;
+  for (; i + 28 <= size; i += 24, output += 32) {  // 12 bytes into each lane
+    __m256i in = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12)), 1);
+    in = _mm256_shuffle_epi8(in, shuffle);
+    __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+    __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+    __m256i indices = _mm256_or_si256(t0, t1);
+    __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    reduced = _mm256_or_si256(reduced, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    __m256i chars = _mm256_add_epi8(indices, _mm256_shuffle_epi8(shift_lut, reduced));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), chars);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+size_t base64DecodeAvx2(const char* src, size_t length, unsigned char* output) {
+  const __m256i lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m256i lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i pack_shuffle = _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = 0;
+  // stores 32 bytes, 24 of them valid: keep enough input ahead to not overrun output
+  for (; i + 44 <= length; i += 32, output += 24) {
+    __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask_2f);
+    __m256i lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(in, mask_2f));
+    __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero)) != -1) {
+      break;
+    }
+    __m256i eq_2f = _mm256_cmpeq_epi8(in, mask_2f);
+    __m256i values = _mm256_add_epi8(in, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles)));
+    __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    packed = _mm256_shuffle_epi8(packed, pack_shuffle);
+    packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), packed);
+  }
+  return i;
+}
+
+#endif  // CODEC_X86
+
+}  // namespace
+
+/* Level */
+// ----------------------------------------------------------------------------
+Level getSupportedLevel() {
+#if CODEC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Level::AVX2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return Level::SSSE3;
+  }
+#endif  // CODEC_X86
+  return Level::SCALAR;
+}
+
+Level getLevel() {
+  return static_cast<Level>(level().load(std::memory_order_relaxed));
+}
+
+Level setLevel(Level value) {
+  Level supported = getSupportedLevel();
+  Level actual = value < supported ? value : supported;
+  level().store(actual, std::memory_order_relaxed);
+  return actual;
+}
+
+/* Codecs */
+// ----------------------------------------------------------------------------
+size_t hexEncode(const unsigned char* src, size_t size, char* output) {
+  size_t done = 0;
+#if CODEC_X86
+  switch (getLevel()) {
+    case Level::AVX2:  done = hexEncodeAvx2(src, size, output);  break;
+    case Level::SSSE3: done = hexEncodeSsse3(src, size, output); break;
+    default: break;
+  }
+#endif  // CODEC_X86
+  hexEncodeScalar(src + done, size - done, output + done * 2);
+  return size * 2;
+}
+
+bool hexDecode(const char* src, size_t length, unsigned char* output, size_t& output_size) {
+  output_size = 0;
+  if (length % 2 != 0) {
+    return false;
+  }
+  size_t done = 0;
+#if CODEC_X86
+  switch (getLevel()) {
+    case Level::AVX2:  done = hexDecodeAvx2(src, length, output);  break;
+    case Level::SSSE3: done = hexDecodeSsse3(src, length, output); break;
+    default: break;
+  }
+#endif  // CODEC_X86
+  if (!hexDecodeScalar(src + done, length - done, output + done / 2)) {
+    return false;
+  }
+  output_size = length / 2;
+  return true;
+}
+
+size_t base64Encode(const unsigned char* src, size_t size, char* output) {
+  size_t done = 0;
+#if CODEC_X86
+  switch (getLevel()) {
+    case Level::AVX2:  done = base64EncodeAvx2(src, size, output);  break;
+    case Level::SSSE3: done = base64EncodeSsse3(src, size, output); break;
+    default: break;
+  }
+#endif  // CODEC_X86
+  base64EncodeScalar(src + done, size - done, output + done / 3 * 4);
+  return base64EncodedLength(size);
+}
+
+bool base64Decode(const char* src, size_t length, unsigned char* output, size_t& output_size) {
+  output_size = 0;
+  if (length % 4 != 0) {
+    return false;
+  }
+  if (length == 0) {
+    return true;
+  }
+
+  // all quanta but the last one, which may be padded
+  size_t body = length - 4;
+  size_t done = 0;
+#if CODEC_X86
+  switch (getLevel()) {
+    case Level::AVX2:  done = base64DecodeAvx2(src, body, output);  break;
+    case Level::SSSE3: done = base64DecodeSsse3(src, body, output); break;
+    default: break;
+  }
+#endif  // CODEC_X86
+  if (!base64DecodeScalar(src + done, body - done, output + done / 4 * 3)) {
+    return false;
+  }
+  output += body / 4 * 3;
+
+  const unsigned char* values = tables().base64_values;
+  const unsigned char* last = reinterpret_cast<const unsigned char*>(src + body);
+  unsigned char a = values[last[0]], b = values[last[1]];
+  unsigned char c = values[last[2]], d = values[last[3]];
+  size_t tail = 3;
+  if (last[3] == '=') {
+    d = 0;
+    tail = 2;
+    if (last[2] == '=') {
+      c = 0;
+      tail = 1;
+    }
+  }
+  if ((a | b | c | d) & 0xC0) {
+    return false;
+  }
+  uint32_t group = (a << 18) | (b << 12) | (c << 6) | d;
+  if (tail < 3 && (group & (tail == 1 ? 0xFFFF : 0xFF)) != 0) {
+    return false;  // non-zero bits under padding
+  }
+  output[0] = group >> 16;
+  if (tail > 1) { output[1] = (group >> 8) & 0xFF; }
+  if (tail > 2) { output[2] = group & 0xFF; }
+  output_size = body / 4 * 3 + tail;
+  return true;
+}
+
+}
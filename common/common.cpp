@@ -36,11 +36,10 @@
 #include <stdarg.h>
 #include <sstream>
 #include <sys/stat.h>
+#include "codec.h"
 #include "common.h"
+#include "json_reader.h"
 #include "logger.h"
-#include "rapidjson/document.h"
-#include "rapidjson/stringbuffer.h"
-#include "rapidjson/writer.h"
 
 /*void PRINTR(const char* format, ...) {
 #if ENABLED_LOGGING
@@ -155,58 +154,41 @@ std::string preparse(const std::string& json, PreparseLeniency leniency) {
 }
 
 std::string restoreStrippedInMemoryPEM(const std::string& pem) {
-  char* buffer = new char[pem.length() + 80];
-  memset(buffer, 0, pem.length() + 80);
-
   size_t i1 = pem.find("RSA", 5);
   if (i1 == std::string::npos) {
     ERR("Input string not in PEM format!");
     return pem;
   }
-  size_t i2 = pem.find("KEY", i1 + 3) + 8;
-  strncpy(buffer, pem.substr(0, i2).c_str(), i2);
-  buffer[i2] = '\n';
-  ++i2;
-
-  size_t k = 1;
-  size_t i3 = pem.find("END", i2) - 5;
-  while (i2 + 64 < i3) {
-    strncpy(buffer + i2, pem.substr(i2 - k, 64).c_str(), 64);
-    i2 += 64;
-    buffer[i2] = '\n';
-    ++i2;
-    ++k;
+  size_t body_start = pem.find("KEY", i1 + 3) + 8;  // past "KEY-----"
+  size_t body_end = pem.find("-----END", body_start);
+  if (body_end == std::string::npos) {
+    ERR("Input string not in PEM format!");
+    return pem;
   }
-  if (i2 != i3) {
-    int rest_length = i3 - i2 + k;
-    std::string rest = pem.substr(i2 - k, rest_length);
-    strncpy(buffer + i2, rest.c_str(), rest.length());
-    i2 += rest_length;
+
+  // header, base64 body wrapped at 64 columns, footer
+  std::string answer;
+  answer.reserve(pem.length() + (body_end - body_start) / 64 + 2);
+  answer.append(pem, 0, body_start).append(1, '\n');
+  for (size_t i = body_start; i < body_end; i += 64) {
+    answer.append(pem, i, std::min<size_t>(64, body_end - i)).append(1, '\n');
   }
-  buffer[i2] = '\n';
-  ++i2;
-  std::string tail = pem.substr(i3);
-  strncpy(buffer + i2, tail.c_str(), tail.length());
-  DBG("%s", buffer);
-
-  std::string answer(buffer);
-  delete [] buffer;  buffer = nullptr;
+  answer.append(pem, body_end, std::string::npos);
+  DBG("%s", answer.c_str());
   return answer;
 }
 
 std::string unwrapJsonObject(const char* field, const std::string& json, PreparseLeniency leniency) {
-  rapidjson::Document document;
-  auto prepared_json = common::preparse(json, leniency);
-  document.Parse(prepared_json.c_str());
-
-  if (document.IsObject() &&
-      document.HasMember(field) && document[field].IsObject()) {
-    std::ostringstream oss;
-    rapidjson::StringBuffer sb;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
-    document[field].Accept(writer);
-    oss << sb.GetString();
-    std::string substr = oss.str();
+  std::string substr;
+  bool is_unwrapped = false;
+  if (leniency == PreparseLeniency::DISABLED) {
+    is_unwrapped = json::extractObject(json, field, &substr);
+  } else {
+    std::string prepared_json = common::preparse(json, leniency);  // own copy, parse it in-situ
+    is_unwrapped = json::extractObjectInsitu(&prepared_json[0], field, &substr);
+  }
+
+  if (is_unwrapped) {
     TRC("Unwrapped sub-object: %s", substr.c_str());
     return substr;
   } else {
@@ -233,44 +215,35 @@ bool isNumber(const std::string& str, ID_t& id) {
 }
 
 // ----------------------------------------------------------------------------
-static int char2int(char input) {
-  if (input >= '0' && input <= '9') {
-    return input - '0';
-  }
-  if (input >= 'A' && input <= 'F') {
-    return input - 'A' + 10;
-  }
-  if (input >= 'a' && input <= 'f') {
-    return input - 'a' + 10;
-  }
-  ERR("Invalid char: %c", input);
-  throw std::invalid_argument("Invalid input string");
-}
-
 std::string bin2hex(unsigned char* src, size_t size) {
-  std::ostringstream oss;
-  for (size_t i = 0; i < size; ++i) {
-    int value = static_cast<int>(src[i]);
-    if (value < 16) {
-      oss << '0';
-    }
-    oss << std::hex << value;
-  }
-  return oss.str();
+  std::string output(codec::hexEncodedLength(size), '\0');
+  codec::hexEncode(src, size, &output[0]);
+  return output;
 }
 
-// This function assumes src to be a zero terminated sanitized string with
-// an even number of [0-9a-f] characters, and target to be sufficiently large
+// target must be sufficiently large to hold hexDecodedLength(source.length()) bytes
 void hex2bin(const std::string& source, unsigned char* target, size_t& target_length) {
   if (source.length() < 2) {
     throw std::invalid_argument("Input string must have even number of [0-9a-f] characters");
   }
-  target_length = 0;
-  for (size_t i = 0; i < source.length(); i += 2, ++target_length) {
-     *(target++) = char2int(source[i]) * 16 + char2int(source[i + 1]);
+  if (!codec::hexDecode(source.c_str(), source.length(), target, target_length)) {
+    ERR("Invalid hex string of length %zu", source.length());
+    throw std::invalid_argument("Invalid input string");
   }
 }
 
+// ----------------------------------------------------------------------------
+std::string base64Encode(const unsigned char* src, size_t size) {
+  std::string output(codec::base64EncodedLength(size), '\0');
+  codec::base64Encode(src, size, &output[0]);
+  return output;
+}
+
+// target must hold at least base64DecodedCapacity(source.length()) bytes
+bool base64Decode(const std::string& source, unsigned char* target, size_t& target_length) {
+  return codec::base64Decode(source.c_str(), source.length(), target, target_length);
+}
+
 // ----------------------------------------------------------------------------
 bool isMessageForbidden(const std::string& message) {
   /* Logic to forbid some content in message */
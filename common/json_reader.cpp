@@ -0,0 +1,377 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <climits>
+#include <cstring>
+#include "json_reader.h"
+#include "json_writer.h"
+#include "logger.h"
+#include "rapidjson/reader.h"
+
+namespace json {
+
+typedef rapidjson::MemoryPoolAllocator<> Arena;
+typedef rapidjson::GenericReader<rapidjson::UTF8<>, rapidjson::UTF8<>, Arena> InsituReader;
+
+/* Thread-local parse state */
+// ----------------------------------------------------------------------------
+static thread_local char t_stack_buffer[JSON_STACK_ARENA_SIZE];
+static thread_local std::string t_input;  // keeps capacity of the largest input
+
+/* Parses buffer with stack from arena, resets arena afterwards */
+template <typename Handler>
+static bool parseInsitu(char* buffer, Handler& handler) {
+  static thread_local Arena arena(t_stack_buffer, sizeof(t_stack_buffer));
+  bool result = false;
+  {
+    InsituReader reader(&arena, JSON_STACK_ARENA_SIZE / 2);
+    rapidjson::InsituStringStream stream(buffer);
+    result = !reader.Parse<rapidjson::kParseInsituFlag>(stream, handler).IsError();
+  }
+  arena.Clear();  // returns chunks beyond thread-local buffer, if deep input needed them
+  return result;
+}
+
+static char* copyToInput(const std::string& json) {
+  t_input.assign(json);
+  return &t_input[0];
+}
+
+/* Reader */
+// ----------------------------------------------------------------------------
+class ReaderHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ReaderHandler> {
+public:
+  ReaderHandler(Reader& reader)
+    : m_reader(reader), m_depth(0), m_field(-1)
+    , m_key(nullptr), m_key_length(0), m_object(nullptr), m_object_length(0)
+    , m_is_found(reader.m_object == nullptr) {
+  }
+
+  inline bool isFound() const { return m_is_found; }
+
+  bool Default() { return skip(); }  // null, bool, double
+  bool Bool(bool) { return skip(); }
+  bool Int(int value) { return integer(value, true); }
+  bool Uint(unsigned value) { return integer(value, true); }
+  bool Int64(int64_t value) { return integer(value, true); }
+  bool Uint64(uint64_t value) { return integer(static_cast<int64_t>(value), value <= INT64_MAX); }
+
+  bool String(const char* str, rapidjson::SizeType length, bool /* copy */) {
+    if (!isBound()) {
+      return skip();
+    }
+    Reader::Field& field = m_reader.m_fields[m_field];
+    if (field.type != Reader::Type::STRING) {
+      return false;
+    }
+    static_cast<std::string*>(field.target)->assign(str, length);
+    return assigned(field);
+  }
+
+  bool StartObject() {
+    if (isBound()) {
+      return false;  // bound field is not an object
+    }
+    if (m_depth == 1) {  // keys are kept in-situ, so pointer stays valid
+      m_object = m_key;
+      m_object_length = m_key_length;
+      if (!m_is_found && strlen(m_reader.m_object) == m_key_length &&
+          strncmp(m_reader.m_object, m_key, m_key_length) == 0) {
+        m_is_found = true;
+      }
+    }
+    ++m_depth;
+    return true;
+  }
+
+  bool Key(const char* str, rapidjson::SizeType length, bool /* copy */) {
+    if (m_depth == 1) {
+      m_key = str;
+      m_key_length = length;
+      m_field = m_reader.find(nullptr, 0, str, length);
+    } else if (m_depth == 2) {
+      m_field = m_reader.find(m_object, m_object_length, str, length);
+    }
+    return true;
+  }
+
+  bool EndObject(rapidjson::SizeType) {
+    if (--m_depth == 1) {
+      m_object = nullptr;
+    }
+    return true;
+  }
+
+  bool StartArray() {
+    if (m_depth == 0 || isBound()) {
+      return false;  // root or bound field is array
+    }
+    ++m_depth;
+    return true;
+  }
+
+  bool EndArray(rapidjson::SizeType) {
+    --m_depth;
+    return true;
+  }
+
+private:
+  Reader& m_reader;
+  int m_depth;
+  int m_field;  // bound field the current value belongs to, -1 if none
+  const char* m_key;  // last key of root
+  size_t m_key_length;
+  const char* m_object;  // nested object being read, nullptr if at root
+  size_t m_object_length;
+  bool m_is_found;
+
+  inline bool isBound() const {
+    return m_field >= 0;
+  }
+
+  bool skip() {
+    if (isBound()) {
+      return false;  // bound field has unexpected type
+    }
+    return m_depth > 0;  // root must be an object
+  }
+
+  bool integer(int64_t value, bool fits_int64) {
+    if (!isBound()) {
+      return skip();
+    }
+    Reader::Field& field = m_reader.m_fields[m_field];
+    switch (field.type) {
+      case Reader::Type::INT64:
+        if (!fits_int64) return false;
+        *static_cast<ID_t*>(field.target) = value;
+        break;
+      case Reader::Type::UINT64:
+        if (!fits_int64) return false;
+        *static_cast<uint64_t*>(field.target) = static_cast<uint64_t>(value);
+        break;
+      case Reader::Type::INT:
+        if (!fits_int64 || value < INT_MIN || value > INT_MAX) return false;
+        *static_cast<int*>(field.target) = static_cast<int>(value);
+        break;
+      case Reader::Type::UINT:
+        if (!fits_int64 || value < 0 || value > UINT32_MAX) return false;
+        *static_cast<uint32_t*>(field.target) = static_cast<uint32_t>(value);
+        break;
+      default:
+        return false;
+    }
+    return assigned(field);
+  }
+
+  bool assigned(Reader::Field& field) {
+    field.is_set = true;
+    m_field = -1;
+    return true;
+  }
+};
+
+Reader::Reader(const char* object)
+  : m_object(object)
+  , m_scope(object)
+  , m_size(0) {
+}
+
+Reader& Reader::bind(const char* name, std::string* value, bool required) {
+  return add(name, Type::STRING, value, required);
+}
+
+Reader& Reader::bind(const char* name, ID_t* value, bool required) {
+  return add(name, Type::INT64, value, required);
+}
+
+Reader& Reader::bind(const char* name, uint64_t* value, bool required) {
+  return add(name, Type::UINT64, value, required);
+}
+
+Reader& Reader::bind(const char* name, int* value, bool required) {
+  return add(name, Type::INT, value, required);
+}
+
+Reader& Reader::bind(const char* name, uint32_t* value, bool required) {
+  return add(name, Type::UINT, value, required);
+}
+
+Reader& Reader::within(const char* object) {
+  m_scope = object;
+  return *this;
+}
+
+bool Reader::read(const std::string& json) {
+  return readInsitu(copyToInput(json));
+}
+
+bool Reader::readInsitu(char* buffer) {
+  for (int i = 0; i < m_size; ++i) {
+    m_fields[i].is_set = false;
+  }
+  ReaderHandler handler(*this);
+  if (!parseInsitu(buffer, handler) || !handler.isFound()) {
+    return false;
+  }
+  for (int i = 0; i < m_size; ++i) {
+    if (m_fields[i].required && !m_fields[i].is_set) {
+      TRC("Missing required field: %s", m_fields[i].name);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Reader::isSet(const char* name) const {
+  return isSet(name, m_object);
+}
+
+bool Reader::isSet(const char* name, const char* object) const {
+  int index = find(object, object == nullptr ? 0 : strlen(object), name, strlen(name));
+  return index >= 0 && m_fields[index].is_set;
+}
+
+Reader& Reader::add(const char* name, Type type, void* target, bool required) {
+  if (m_size == JSON_READER_MAX_FIELDS) {
+    ERR("Too many fields bound to JSON reader, skipping: %s", name);
+    return *this;
+  }
+  size_t object_length = m_scope == nullptr ? 0 : strlen(m_scope);
+  m_fields[m_size++] = { m_scope, object_length, name, strlen(name), type, target, required, false };
+  return *this;
+}
+
+int Reader::find(const char* object, size_t object_length, const char* name, size_t length) const {
+  for (int i = 0; i < m_size; ++i) {
+    const Field& field = m_fields[i];
+    if (field.length == length && memcmp(field.name, name, length) == 0 &&
+        field.object_length == object_length &&
+        (object == nullptr ? field.object == nullptr :
+         field.object != nullptr && memcmp(field.object, object, object_length) == 0)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Extract */
+// ----------------------------------------------------------------------------
+/* Forwards events of the target object to writer, drops the rest */
+class ExtractHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ExtractHandler> {
+public:
+  ExtractHandler(const char* field)
+    : m_field(field), m_writer(m_buffer)
+    , m_depth(0), m_is_pending(false), m_is_inside(false), m_is_found(false) {
+  }
+
+  inline bool isFound() const { return m_is_found; }
+  inline const Buffer& getBuffer() const { return m_buffer; }
+
+  bool Default() { return forward(m_is_inside && m_writer.Null()); }
+  bool Null() { return Default(); }
+  bool Bool(bool b) { return forward(m_is_inside && m_writer.Bool(b)); }
+  bool Int(int i) { return forward(m_is_inside && m_writer.Int(i)); }
+  bool Uint(unsigned u) { return forward(m_is_inside && m_writer.Uint(u)); }
+  bool Int64(int64_t i) { return forward(m_is_inside && m_writer.Int64(i)); }
+  bool Uint64(uint64_t u) { return forward(m_is_inside && m_writer.Uint64(u)); }
+  bool Double(double d) { return forward(m_is_inside && m_writer.Double(d)); }
+  bool String(const char* str, rapidjson::SizeType length, bool /* copy */) {
+    return forward(m_is_inside && m_writer.String(str, length));
+  }
+
+  bool Key(const char* str, rapidjson::SizeType length, bool /* copy */) {
+    if (m_is_inside) {
+      return m_writer.Key(str, length);
+    }
+    m_is_pending = m_depth == 1 && strlen(m_field) == length && strncmp(m_field, str, length) == 0;
+    return true;
+  }
+
+  bool StartObject() {
+    if (m_depth == 1 && m_is_pending && !m_is_found) {
+      m_is_inside = m_is_found = true;
+    }
+    m_is_pending = false;
+    ++m_depth;
+    return !m_is_inside || m_writer.StartObject();
+  }
+
+  bool EndObject(rapidjson::SizeType count) {
+    --m_depth;
+    if (m_is_inside) {
+      bool result = m_writer.EndObject(count);
+      m_is_inside = m_depth > 1;
+      return result;
+    }
+    return true;
+  }
+
+  bool StartArray() {
+    if (m_depth == 0) {
+      return false;
+    }
+    m_is_pending = false;
+    ++m_depth;
+    return !m_is_inside || m_writer.StartArray();
+  }
+
+  bool EndArray(rapidjson::SizeType count) {
+    --m_depth;
+    return !m_is_inside || m_writer.EndArray(count);
+  }
+
+private:
+  const char* m_field;
+  Buffer m_buffer;
+  Writer m_writer;
+  int m_depth;
+  bool m_is_pending;
+  bool m_is_inside;
+  bool m_is_found;
+
+  bool forward(bool written) {
+    m_is_pending = false;
+    return written || (!m_is_inside && m_depth > 0);
+  }
+};
+
+bool extractObject(const std::string& json, const char* field, std::string* output) {
+  return extractObjectInsitu(copyToInput(json), field, output);
+}
+
+bool extractObjectInsitu(char* buffer, const char* field, std::string* output) {
+  ExtractHandler handler(field);
+  if (parseInsitu(buffer, handler) && handler.isFound()) {
+    output->assign(handler.getBuffer().GetString(), handler.getBuffer().GetSize());
+    return true;
+  }
+  return false;
+}
+
+}
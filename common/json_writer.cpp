@@ -0,0 +1,111 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <cstring>
+#include "json_writer.h"
+#include "rapidjson/internal/itoa.h"
+
+namespace json {
+
+static const char* HTTP_VERSION = "HTTP/1.1 ";
+static const char* CONTENT_LENGTH = "\r\nContent-Length: ";
+
+/* Writer */
+// ----------------------------------------------------------------------------
+bool Writer::String(const char* str, rapidjson::SizeType length, bool copy) {
+  unsigned char escaped = 0;  // branchless, so that compiler can vectorize the scan
+  for (rapidjson::SizeType i = 0; i < length; ++i) {
+    unsigned char c = static_cast<unsigned char>(str[i]);
+    escaped |= (c < 0x20) | (c == '"') | (c == '\\');
+  }
+  if (escaped) {
+    return rapidjson::Writer<Buffer>::String(str, length, copy);
+  }
+  Prefix(rapidjson::kStringType);
+  char* output = os_->Push(length + 2);
+  output[0] = '"';
+  memcpy(output + 1, str, length);
+  output[length + 1] = '"';
+  return true;
+}
+
+/* Thread-local response state */
+// ----------------------------------------------------------------------------
+static thread_local Buffer t_buffer;  // keeps capacity of the largest response
+static thread_local Writer t_writer(t_buffer);
+
+Response::Response()
+  : m_buffer(t_buffer)
+  , m_writer(t_writer)
+  , m_start(RESPONSE_HEADER_RESERVE) {
+  m_buffer.Clear();
+  m_buffer.Push(RESPONSE_HEADER_RESERVE);
+  m_writer.Reset(m_buffer);
+}
+
+void Response::finish(const char* status, const char* headers) {
+  char digits[24];
+  size_t digits_length = rapidjson::internal::u64toa(m_buffer.GetSize() - RESPONSE_HEADER_RESERVE, digits) - digits;
+  size_t lengths[] = {strlen(HTTP_VERSION), strlen(status), 2, strlen(headers), strlen(CONTENT_LENGTH), digits_length, 4};
+  const char* parts[] = {HTTP_VERSION, status, "\r\n", headers, CONTENT_LENGTH, digits, "\r\n\r\n"};
+  size_t header_length = 0;
+  for (size_t length : lengths) {
+    header_length += length;
+  }
+  char* output = reserveHeader(header_length);
+  for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); ++i) {
+    memcpy(output, parts[i], lengths[i]);
+    output += lengths[i];
+  }
+}
+
+void Response::finish(const HeaderPrefix& prefix) {
+  char digits[24];
+  size_t digits_length = rapidjson::internal::u64toa(m_buffer.GetSize() - RESPONSE_HEADER_RESERVE, digits) - digits;
+  char* output = reserveHeader(prefix.length + digits_length + 4);
+  memcpy(output, prefix.data, prefix.length);
+  memcpy(output + prefix.length, digits, digits_length);
+  memcpy(output + prefix.length + digits_length, "\r\n\r\n", 4);
+}
+
+/* Start of header which ends right before body */
+char* Response::reserveHeader(size_t header_length) {
+  char* data = const_cast<char*>(m_buffer.GetString());
+  if (header_length > RESPONSE_HEADER_RESERVE) {  // unusually long headers, shift body to make room
+    size_t body_length = m_buffer.GetSize() - RESPONSE_HEADER_RESERVE;
+    m_buffer.Push(header_length - RESPONSE_HEADER_RESERVE);
+    data = const_cast<char*>(m_buffer.GetString());
+    memmove(data + header_length, data + RESPONSE_HEADER_RESERVE, body_length);
+    m_start = 0;
+  } else {
+    m_start = RESPONSE_HEADER_RESERVE - header_length;
+  }
+  return data + m_start;
+}
+
+}
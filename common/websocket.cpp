@@ -0,0 +1,348 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "api/api.h"
+#include "common.h"
+#include "logger.h"
+#include "websocket.h"
+
+namespace ws {
+
+static const unsigned char FINAL_BIT = 0x80;
+static const unsigned char MASK_BIT = 0x80;
+static const unsigned char OPCODE_BITS = 0x0F;
+static const unsigned char RESERVED_BITS = 0x70;
+static const size_t SHA1_DIGEST_LENGTH = 20;
+
+/* SHA-1, only to answer handshake, see RFC 3174 */
+// ----------------------------------------------------------------------------
+static inline uint32_t rotate(uint32_t value, int bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+static void sha1Block(const unsigned char* block, uint32_t* state) {
+  uint32_t w[80];
+  for (int i = 0; i < 16; ++i) {
+    w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+           (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | static_cast<uint32_t>(block[i * 4 + 3]);
+  }
+  for (int i = 16; i < 80; ++i) {
+    w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+  for (int i = 0; i < 80; ++i) {
+    uint32_t f, k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);  k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;  k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);  k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;  k = 0xCA62C1D6;
+    }
+    uint32_t temp = rotate(a, 5) + f + e + k + w[i];
+    e = d;  d = c;  c = rotate(b, 30);  b = a;  a = temp;
+  }
+  state[0] += a;  state[1] += b;  state[2] += c;  state[3] += d;  state[4] += e;
+}
+
+static void sha1(const std::string& input, unsigned char* digest) {
+  uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+  std::string padded = input;
+  padded.push_back(static_cast<char>(0x80));
+  while (padded.length() % 64 != 56) {
+    padded.push_back('\0');
+  }
+  uint64_t bits = static_cast<uint64_t>(input.length()) * 8;
+  for (int i = 7; i >= 0; --i) {
+    padded.push_back(static_cast<char>(bits >> (8 * i)));
+  }
+  for (size_t i = 0; i < padded.length(); i += 64) {
+    sha1Block(reinterpret_cast<const unsigned char*>(padded.data() + i), state);
+  }
+  for (int i = 0; i < 5; ++i) {
+    digest[i * 4]     = static_cast<unsigned char>(state[i] >> 24);
+    digest[i * 4 + 1] = static_cast<unsigned char>(state[i] >> 16);
+    digest[i * 4 + 2] = static_cast<unsigned char>(state[i] >> 8);
+    digest[i * 4 + 3] = static_cast<unsigned char>(state[i]);
+  }
+}
+
+/* Utility */
+// ----------------------------------------------------------------------------
+static bool equalsIgnoreCase(const std::string& lhs, const char* rhs) {
+  size_t length = strlen(rhs);
+  if (lhs.length() != length) {
+    return false;
+  }
+  for (size_t i = 0; i < length; ++i) {
+    if (tolower(static_cast<unsigned char>(lhs[i])) != tolower(static_cast<unsigned char>(rhs[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Whether comma-separated list of header value contains token */
+static bool hasToken(const std::string& value, const char* token) {
+  std::istringstream iss(value);
+  std::string item;
+  while (std::getline(iss, item, ',')) {
+    if (equalsIgnoreCase(trim(item), token)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static const std::string* findHeader(const Request& request, const char* name) {
+  for (auto& header : request.headers) {
+    if (equalsIgnoreCase(header.name, name)) {
+      return &header.value;
+    }
+  }
+  return nullptr;
+}
+
+/* Bounded strstr(), input is not required to be null-terminated */
+static const char* find(const char* begin, const char* end, const char* needle) {
+  const char* found = std::search(begin, end, needle, needle + strlen(needle));
+  return found == end ? nullptr : found;
+}
+
+static void beginFrame(Opcode opcode, size_t length, bool is_masked, std::string* output) {
+  output->push_back(static_cast<char>(FINAL_BIT | static_cast<unsigned char>(opcode)));
+  unsigned char mask_bit = is_masked ? MASK_BIT : 0;
+  if (length < 126) {
+    output->push_back(static_cast<char>(mask_bit | length));
+  } else if (length <= 0xFFFF) {
+    output->push_back(static_cast<char>(mask_bit | 126));
+    output->push_back(static_cast<char>(length >> 8));
+    output->push_back(static_cast<char>(length));
+  } else {
+    output->push_back(static_cast<char>(mask_bit | 127));
+    for (int i = 7; i >= 0; --i) {
+      output->push_back(static_cast<char>(static_cast<uint64_t>(length) >> (8 * i)));
+    }
+  }
+}
+
+static void unmask(char* payload, size_t length, const unsigned char* mask) {
+  for (size_t i = 0; i < length; ++i) {
+    payload[i] ^= mask[i & 3];
+  }
+}
+
+static inline bool isControl(Opcode opcode) {
+  return (static_cast<unsigned char>(opcode) & 0x08) != 0;
+}
+
+/* Handshake */
+// ----------------------------------------------------------------------------
+std::string acceptKey(const std::string& key) {
+  unsigned char digest[SHA1_DIGEST_LENGTH];
+  sha1(key + WS_GUID, digest);
+  return common::base64Encode(digest, SHA1_DIGEST_LENGTH);
+}
+
+bool acceptUpgrade(const Request& request, std::string* response, bool* is_binary) {
+  const std::string* upgrade = findHeader(request, "Upgrade");
+  const std::string* connection = findHeader(request, "Connection");
+  const std::string* key = findHeader(request, "Sec-WebSocket-Key");
+  const std::string* version = findHeader(request, "Sec-WebSocket-Version");
+  if (request.startline.method != "GET" ||
+      upgrade == nullptr || !hasToken(*upgrade, "websocket") ||
+      connection == nullptr || !hasToken(*connection, "upgrade") ||
+      key == nullptr || key->empty() || version == nullptr || *version != WS_VERSION) {
+    WRN("Invalid WebSocket upgrade request");
+    response->assign("HTTP/1.1 400 Bad Request\r\nSec-WebSocket-Version: " WS_VERSION "\r\nContent-Length: 0\r\n\r\n");
+    return false;
+  }
+  const std::string* protocol = findHeader(request, "Sec-WebSocket-Protocol");
+  *is_binary = protocol != nullptr && hasToken(*protocol, WS_PROTOCOL_FRAME);
+  response->assign("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n");
+  response->append("Sec-WebSocket-Accept: ").append(acceptKey(*key)).append("\r\n");
+  if (*is_binary) {
+    response->append("Sec-WebSocket-Protocol: " WS_PROTOCOL_FRAME "\r\n");
+  }
+  response->append("\r\n");
+  return true;
+}
+
+/* Encoding */
+// ----------------------------------------------------------------------------
+void encodeFrame(Opcode opcode, const char* payload, size_t length, std::string* output) {
+  beginFrame(opcode, length, false, output);
+  output->append(payload, length);
+}
+
+void encodeMaskedFrame(Opcode opcode, const char* payload, size_t length, const unsigned char* mask, std::string* output) {
+  beginFrame(opcode, length, true, output);
+  output->append(reinterpret_cast<const char*>(mask), 4);
+  size_t start = output->length();
+  output->append(payload, length);
+  unmask(&(*output)[start], length, mask);  // masking is symmetric
+}
+
+bool encodeHttpResponses(const char* http, size_t length, std::string* output) {
+  static const char STATUS_PREFIX[] = "HTTP/1.1 ";
+  static const char CONTENT_LENGTH[] = "Content-Length: ";
+  const char* end = http + length;
+  while (http < end && *http != '\0') {
+    if (static_cast<size_t>(end - http) < sizeof(STATUS_PREFIX) + 2 ||
+        strncmp(http, STATUS_PREFIX, sizeof(STATUS_PREFIX) - 1) != 0) {
+      return false;
+    }
+    const char* headers_end = find(http, end, "\r\n\r\n");
+    if (headers_end == nullptr) {
+      return false;
+    }
+    const char* body = headers_end + 4;
+    size_t body_length = end - body;  // up to the end, if no Content-Length
+    const char* content_length = find(http, headers_end, CONTENT_LENGTH);
+    if (content_length != nullptr) {
+      body_length = std::min(body_length, static_cast<size_t>(atoi(content_length + sizeof(CONTENT_LENGTH) - 1)));
+    }
+    encodeFrame(Opcode::TEXT, body, body_length, output);
+    http = body + body_length;
+  }
+  return true;
+}
+
+/* Decoding */
+// ----------------------------------------------------------------------------
+FrameDecoder::FrameDecoder(bool is_mask_required)
+  : m_offset(0)
+  , m_message_opcode(Opcode::TEXT)
+  , m_is_mask_required(is_mask_required)
+  , m_is_fragmented(false)
+  , m_is_enabled(false)
+  , m_is_broken(false) {
+}
+
+void FrameDecoder::append(const char* input, size_t length) {
+  if (m_offset > 0) {
+    m_buffer.erase(0, m_offset);  // frames given out before are consumed
+    m_offset = 0;
+  }
+  m_buffer.append(input, length);
+}
+
+bool FrameDecoder::next(Frame* frame) {
+  while (!m_is_broken) {
+    size_t available = m_buffer.length() - m_offset;
+    if (available < 2) {
+      return false;  // wait for the rest of header
+    }
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(m_buffer.data() + m_offset);
+    bool is_final = (header[0] & FINAL_BIT) != 0;
+    bool is_masked = (header[1] & MASK_BIT) != 0;
+    Opcode opcode = static_cast<Opcode>(header[0] & OPCODE_BITS);
+    uint64_t length = header[1] & 0x7F;
+    size_t header_length = 2;
+    if (length == 126) {
+      header_length += 2;
+    } else if (length == 127) {
+      header_length += 8;
+    }
+    if (is_masked) {
+      header_length += 4;
+    }
+    if (available < header_length) {
+      return false;
+    }
+    if (length >= 126) {
+      size_t bytes = length == 126 ? 2 : 8;
+      length = 0;
+      for (size_t i = 0; i < bytes; ++i) {
+        length = (length << 8) | header[2 + i];
+      }
+    }
+
+    if ((header[0] & RESERVED_BITS) != 0 || (m_is_mask_required && !is_masked) ||
+        length > WS_MAX_MESSAGE_LENGTH ||
+        (isControl(opcode) && (!is_final || length > WS_MAX_CONTROL_LENGTH))) {
+      ERR("WebSocket protocol violation, opcode %i, length %zu", static_cast<int>(opcode), static_cast<size_t>(length));
+      m_is_broken = true;
+      return false;
+    }
+    if (available - header_length < length) {
+      return false;  // wait for the rest of frame
+    }
+    char* payload = &m_buffer[m_offset + header_length];
+    if (is_masked) {
+      unmask(payload, length, header + header_length - 4);
+    }
+    m_offset += header_length + length;
+
+    if (isControl(opcode)) {  // could come in between fragments
+      frame->opcode = opcode;
+      frame->payload = payload;
+      frame->length = length;
+      return true;
+    }
+    if (opcode != Opcode::CONTINUATION) {
+      if (m_is_fragmented || (opcode != Opcode::TEXT && opcode != Opcode::BINARY)) {
+        ERR("Unexpected WebSocket opcode %i", static_cast<int>(opcode));
+        m_is_broken = true;
+        return false;
+      }
+      if (is_final) {
+        frame->opcode = opcode;
+        frame->payload = payload;
+        frame->length = length;
+        return true;
+      }
+      m_is_fragmented = true;
+      m_message_opcode = opcode;
+      m_message.assign(payload, length);
+      continue;
+    }
+    if (!m_is_fragmented || m_message.length() + length > WS_MAX_MESSAGE_LENGTH) {
+      ERR("Unexpected WebSocket continuation");
+      m_is_broken = true;
+      return false;
+    }
+    m_message.append(payload, length);
+    if (is_final) {
+      m_is_fragmented = false;
+      frame->opcode = m_message_opcode;
+      frame->payload = m_message.data();
+      frame->length = m_message.length();
+      return true;
+    }
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,445 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "api/api.h"
+#include "logger.h"
+#include "wire.h"
+#include <zlib.h>
+
+namespace wire {
+
+static const char HELLO_MAGIC[] = { 'C', 'H', 'A', 'T', WIRE_VERSION };
+static const unsigned char MESSAGE_FLAG_ENCRYPTED = 0x01;
+static const size_t MESSAGE_FIXED_LENGTH = 8 + 8 + 8 + 4 + 1;
+
+static const int DEFLATE_LEVEL = 6;
+static const int DEFLATE_WINDOW_BITS = 15;
+static const int DEFLATE_MEMORY_LEVEL = 8;
+
+/* Preset dictionary: fragments of json as serialized, most frequent at the end */
+static const char DEFLATE_DICTIONARY[] =
+    "{\"" D_ITEM_SYSTEM "\":\"" "\"" D_ITEM_PAYLOAD "\":\"\"" "{\"" D_ITEM_CHECK "\":"
+    "{\"" D_ITEM_CODE "\":0,\"" D_ITEM_ACTION "\":" ",\"" D_ITEM_TOKEN "\":\""
+    ",\"" D_ITEM_LAST_SEQ "\":" ",\"" D_ITEM_MESSAGES "\":["
+    ",\"" D_ITEM_SIZE "\":" ",\"" D_ITEM_ENCRYPTED "\":0" ",\"" D_ITEM_MESSAGE "\":\""
+    ",\"" D_ITEM_DEST_ID "\":0" ",\"" D_ITEM_TIMESTAMP "\":1"
+    "{\"" D_ITEM_PEERS "\":[" "]," "\"" D_ITEM_CHANNEL "\":"
+    "\"},{\"" D_ITEM_ID "\":" ",\"" D_ITEM_LOGIN "\":\"" "\",\"" D_ITEM_EMAIL "\":\"" "\",\"" D_ITEM_CHANNEL "\":";
+
+/* Varint */
+// ----------------------------------------------------------------------------
+size_t putVarint(uint64_t value, char* output) {
+  size_t i = 0;
+  while (value >= 0x80) {
+    output[i++] = static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  output[i++] = static_cast<char>(value);
+  return i;
+}
+
+size_t getVarint(const char* input, size_t length, uint64_t* value) {
+  uint64_t result = 0;
+  for (size_t i = 0; i < length && i < WIRE_VARINT_MAX_LENGTH; ++i) {
+    unsigned char byte = static_cast<unsigned char>(input[i]);
+    result |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+/* Utility */
+// ----------------------------------------------
+static void appendVarint(uint64_t value, std::string* output) {
+  char buffer[WIRE_VARINT_MAX_LENGTH];
+  output->append(buffer, putVarint(value, buffer));
+}
+
+static void appendFixed(uint64_t value, int bytes, std::string* output) {
+  char buffer[8];
+  for (int i = 0; i < bytes; ++i) {
+    buffer[i] = static_cast<char>(value >> (8 * i));
+  }
+  output->append(buffer, bytes);
+}
+
+static uint64_t readFixed(const char* input, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(input[i])) << (8 * i);
+  }
+  return value;
+}
+
+/* Reads [varint][bytes] and advances position */
+static bool readString(const Frame& frame, size_t& position, std::string* output) {
+  uint64_t length = 0;
+  size_t used = getVarint(frame.payload + position, frame.length - position, &length);
+  if (used == 0 || length > frame.length - position - used) {
+    return false;
+  }
+  output->assign(frame.payload + position + used, length);
+  position += used + length;
+  return true;
+}
+
+/* Bounded strstr(), input is not required to be null-terminated */
+static const char* find(const char* begin, const char* end, const char* needle) {
+  const char* found = std::search(begin, end, needle, needle + strlen(needle));
+  return found == end ? nullptr : found;
+}
+
+/* Writes frame header once payload length is known */
+static void beginFrame(FrameType type, size_t payload_length, std::string* output) {
+  appendVarint(payload_length + 1, output);
+  output->push_back(static_cast<char>(type));
+}
+
+/* Encoding */
+// ----------------------------------------------------------------------------
+void encodeHello(std::string* output, unsigned char flags) {
+  beginFrame(FrameType::HELLO, sizeof(HELLO_MAGIC) + 1, output);
+  output->append(HELLO_MAGIC, sizeof(HELLO_MAGIC));
+  output->push_back(static_cast<char>(flags));
+}
+
+void encodeRequest(const std::string& method, const std::string& path, const std::string& body, std::string* output) {
+  char method_length[WIRE_VARINT_MAX_LENGTH], path_length[WIRE_VARINT_MAX_LENGTH];
+  size_t method_used = putVarint(method.length(), method_length);
+  size_t path_used = putVarint(path.length(), path_length);
+  beginFrame(FrameType::REQUEST, method_used + method.length() + path_used + path.length() + body.length(), output);
+  output->append(method_length, method_used).append(method);
+  output->append(path_length, path_used).append(path);
+  output->append(body);
+}
+
+void encodeResponse(int code, const char* body, size_t length, std::string* output) {
+  char code_buffer[WIRE_VARINT_MAX_LENGTH];
+  size_t code_used = putVarint(static_cast<uint32_t>(code), code_buffer);
+  beginFrame(FrameType::RESPONSE, code_used + length, output);
+  output->append(code_buffer, code_used).append(body, length);
+}
+
+void encodeMessage(const Message& message, std::string* output) {
+  char size_buffer[WIRE_VARINT_MAX_LENGTH], login_buffer[WIRE_VARINT_MAX_LENGTH], email_buffer[WIRE_VARINT_MAX_LENGTH];
+  size_t size_used = putVarint(message.getSize(), size_buffer);
+  size_t login_used = putVarint(message.getLogin().length(), login_buffer);
+  size_t email_used = putVarint(message.getEmail().length(), email_buffer);
+  beginFrame(FrameType::MESSAGE, MESSAGE_FIXED_LENGTH + size_used +
+             login_used + message.getLogin().length() +
+             email_used + message.getEmail().length() +
+             message.getMessage().length(), output);
+  appendFixed(static_cast<uint64_t>(message.getId()), 8, output);
+  appendFixed(static_cast<uint64_t>(message.getDestId()), 8, output);
+  appendFixed(message.getTimestamp(), 8, output);
+  appendFixed(static_cast<uint32_t>(message.getChannel()), 4, output);
+  output->push_back(message.isEncrypted() ? MESSAGE_FLAG_ENCRYPTED : 0);
+  output->append(size_buffer, size_used);
+  output->append(login_buffer, login_used).append(message.getLogin());
+  output->append(email_buffer, email_used).append(message.getEmail());
+  output->append(message.getMessage());
+}
+
+bool encodeHttpRequest(const char* http, size_t length, std::string* output) {
+  const char* end = http + length;
+  const char* method_end = static_cast<const char*>(memchr(http, ' ', length));
+  if (method_end == nullptr) {
+    return false;
+  }
+  const char* path = method_end + 1;
+  const char* path_end = static_cast<const char*>(memchr(path, ' ', end - path));
+  const char* body = path_end == nullptr ? nullptr : find(path_end, end, "\r\n\r\n");
+  if (body == nullptr) {
+    return false;
+  }
+  body += 4;
+  encodeRequest(std::string(http, method_end), std::string(path, path_end), std::string(body, end), output);
+  return true;
+}
+
+bool encodeHttpResponses(const char* http, size_t length, std::string* output) {
+  static const char STATUS_PREFIX[] = "HTTP/1.1 ";
+  static const char CONTENT_LENGTH[] = "Content-Length: ";
+  const char* end = http + length;
+  while (http < end && *http != '\0') {
+    if (static_cast<size_t>(end - http) < sizeof(STATUS_PREFIX) + 2 ||
+        strncmp(http, STATUS_PREFIX, sizeof(STATUS_PREFIX) - 1) != 0) {
+      return false;
+    }
+    int code = atoi(http + sizeof(STATUS_PREFIX) - 1);
+    const char* headers_end = find(http, end, "\r\n\r\n");
+    if (headers_end == nullptr) {
+      return false;
+    }
+    const char* body = headers_end + 4;
+    size_t body_length = end - body;  // up to the end, if no Content-Length
+    const char* content_length = find(http, headers_end, CONTENT_LENGTH);
+    if (content_length != nullptr) {
+      body_length = std::min(body_length, static_cast<size_t>(atoi(content_length + sizeof(CONTENT_LENGTH) - 1)));
+    }
+    encodeResponse(code, body, body_length, output);
+    http = body + body_length;
+  }
+  return true;
+}
+
+/* Decoding */
+// ----------------------------------------------------------------------------
+bool isHello(const char* input, size_t length) {
+  uint64_t frame_length = 0;
+  size_t used = getVarint(input, length, &frame_length);
+  return used > 0 && (frame_length == sizeof(HELLO_MAGIC) + 1 || frame_length == sizeof(HELLO_MAGIC) + 2) &&
+         length >= used + frame_length &&
+         static_cast<FrameType>(input[used]) == FrameType::HELLO &&
+         memcmp(input + used + 1, HELLO_MAGIC, sizeof(HELLO_MAGIC)) == 0;
+}
+
+unsigned char getHelloFlags(const Frame& frame) {
+  // flags are optional, HELLO without them is sent by earlier clients
+  return frame.length > sizeof(HELLO_MAGIC) ? static_cast<unsigned char>(frame.payload[sizeof(HELLO_MAGIC)]) : 0;
+}
+
+bool decodeRequest(const Frame& frame, Request* request) {
+  if (frame.type == FrameType::MESSAGE) {
+    request->startline.method = "POST";
+    request->startline.path = PATH_MESSAGE;
+    request->startline.version = 1;
+    request->headers.assign(1, Header{ "Content-Type", WIRE_CONTENT_TYPE });
+    request->body.assign(frame.payload, frame.length);
+    return true;
+  }
+  size_t position = 0;
+  if (frame.type != FrameType::REQUEST ||
+      !readString(frame, position, &request->startline.method) ||
+      !readString(frame, position, &request->startline.path)) {
+    return false;
+  }
+  request->startline.version = 1;
+  request->headers.clear();
+  request->body.assign(frame.payload + position, frame.length - position);
+  return true;
+}
+
+bool decodeResponse(const Frame& frame, Response* response) {
+  uint64_t code = 0;
+  size_t used = getVarint(frame.payload, frame.length, &code);
+  if (frame.type != FrameType::RESPONSE || used == 0 || code > INT32_MAX) {
+    return false;
+  }
+  response->codeline.version = 1;
+  response->codeline.code = static_cast<int>(code);
+  response->codeline.message.clear();
+  response->headers.clear();
+  response->body.assign(frame.payload + used, frame.length - used);
+  return true;
+}
+
+bool decodeMessage(const Frame& frame, Message* message) {
+  if (frame.type != FrameType::MESSAGE || frame.length < MESSAGE_FIXED_LENGTH) {
+    return false;
+  }
+  const char* fixed = frame.payload;
+  size_t position = MESSAGE_FIXED_LENGTH;
+  uint64_t size = 0;
+  size_t used = getVarint(frame.payload + position, frame.length - position, &size);
+  if (used == 0) {
+    return false;
+  }
+  position += used;
+  std::string login, email;
+  if (!readString(frame, position, &login) || !readString(frame, position, &email)) {
+    return false;
+  }
+  *message = Message::Builder(static_cast<ID_t>(readFixed(fixed, 8)))
+      .setDestId(static_cast<ID_t>(readFixed(fixed + 8, 8)))
+      .setTimestamp(readFixed(fixed + 16, 8))
+      .setChannel(static_cast<int32_t>(readFixed(fixed + 24, 4)))
+      .setEncrypted((fixed[28] & MESSAGE_FLAG_ENCRYPTED) != 0)
+      .setSize(size).setLogin(login).setEmail(email)
+      .setMessage(std::string(frame.payload + position, frame.length - position))
+      .build();
+  return true;
+}
+
+bool isFramed(const Request& request) {
+  return request.headers.size() == 1 && request.headers[0].value.compare(WIRE_CONTENT_TYPE) == 0;
+}
+
+bool decodeMessage(const Request& request, Message* message) {
+  Frame frame = { FrameType::MESSAGE, request.body.data(), request.body.length() };
+  return isFramed(request) && decodeMessage(frame, message);
+}
+
+/* Frame decoder */
+// ----------------------------------------------------------------------------
+/* Compression */
+// ----------------------------------------------------------------------------
+Deflater::Deflater()
+  : m_stream(new z_stream()) {
+  // raw deflate, no zlib header and checksum: frame length already delimits it
+  if (deflateInit2(m_stream, DEFLATE_LEVEL, Z_DEFLATED, -DEFLATE_WINDOW_BITS, DEFLATE_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+    ERR("Failed to init deflate: %s", m_stream->msg != nullptr ? m_stream->msg : "");
+    delete m_stream;  m_stream = nullptr;
+  }
+}
+
+Deflater::~Deflater() {
+  if (m_stream != nullptr) {
+    deflateEnd(m_stream);
+    delete m_stream;  m_stream = nullptr;
+  }
+}
+
+bool Deflater::deflate(const char* frames, size_t length, std::string* output) {
+  if (m_stream == nullptr || length > WIRE_MAX_DOWNSTREAM_LENGTH) {
+    return false;
+  }
+  deflateReset(m_stream);  // keeps buffers allocated, but drops dictionary
+  deflateSetDictionary(m_stream, reinterpret_cast<const Bytef*>(DEFLATE_DICTIONARY), sizeof(DEFLATE_DICTIONARY) - 1);
+
+  // frame header is written once compressed length is known
+  size_t header_length = WIRE_VARINT_MAX_LENGTH + 1;
+  size_t start = output->length();
+  output->resize(start + header_length + deflateBound(m_stream, length));
+  m_stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(frames));
+  m_stream->avail_in = length;
+  m_stream->next_out = reinterpret_cast<Bytef*>(&(*output)[start + header_length]);
+  m_stream->avail_out = output->length() - start - header_length;
+  if (::deflate(m_stream, Z_FINISH) != Z_STREAM_END || m_stream->total_out + header_length >= length) {
+    output->resize(start);
+    return false;
+  }
+  size_t compressed = m_stream->total_out;
+  char header[WIRE_VARINT_MAX_LENGTH + 1];
+  size_t used = putVarint(compressed + 1, header);
+  header[used++] = static_cast<char>(FrameType::DEFLATED);
+  // move payload right behind actual header
+  memmove(&(*output)[start + used], &(*output)[start + header_length], compressed);
+  memcpy(&(*output)[start], header, used);
+  output->resize(start + used + compressed);
+  return true;
+}
+
+Inflater::Inflater()
+  : m_stream(new z_stream()) {
+  if (inflateInit2(m_stream, -DEFLATE_WINDOW_BITS) != Z_OK) {
+    ERR("Failed to init inflate: %s", m_stream->msg != nullptr ? m_stream->msg : "");
+    delete m_stream;  m_stream = nullptr;
+  }
+}
+
+Inflater::~Inflater() {
+  if (m_stream != nullptr) {
+    inflateEnd(m_stream);
+    delete m_stream;  m_stream = nullptr;
+  }
+}
+
+bool Inflater::inflate(const Frame& frame, std::string* output) {
+  if (m_stream == nullptr || frame.type != FrameType::DEFLATED) {
+    return false;
+  }
+  inflateReset(m_stream);
+  inflateSetDictionary(m_stream, reinterpret_cast<const Bytef*>(DEFLATE_DICTIONARY), sizeof(DEFLATE_DICTIONARY) - 1);
+  m_stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(frame.payload));
+  m_stream->avail_in = frame.length;
+  size_t start = output->length();
+  int status = Z_OK;
+  while (status == Z_OK) {
+    size_t produced = output->length() - start;
+    if (produced >= WIRE_MAX_DOWNSTREAM_LENGTH) {
+      ERR("Inflated frame is too long");
+      break;
+    }
+    size_t chunk = std::min(std::max(produced, frame.length * 4), WIRE_MAX_DOWNSTREAM_LENGTH - produced);
+    output->resize(start + produced + chunk);
+    m_stream->next_out = reinterpret_cast<Bytef*>(&(*output)[start + produced]);
+    m_stream->avail_out = chunk;
+    status = ::inflate(m_stream, Z_NO_FLUSH);
+    output->resize(output->length() - m_stream->avail_out);
+  }
+  if (status != Z_STREAM_END) {
+    ERR("Failed to inflate frame: %i", status);
+    output->resize(start);
+    return false;
+  }
+  return true;
+}
+
+FrameDecoder::FrameDecoder(size_t max_length)
+  : m_offset(0)
+  , m_max_length(max_length)
+  , m_is_enabled(false)
+  , m_is_broken(false) {
+}
+
+void FrameDecoder::append(const char* input, size_t length) {
+  if (m_offset > 0) {
+    m_buffer.erase(0, m_offset);  // frames given out before are consumed
+    m_offset = 0;
+  }
+  m_buffer.append(input, length);
+}
+
+bool FrameDecoder::next(Frame* frame) {
+  if (m_is_broken) {
+    return false;
+  }
+  size_t available = m_buffer.length() - m_offset;
+  uint64_t length = 0;
+  size_t used = getVarint(m_buffer.data() + m_offset, available, &length);
+  if (used == 0) {
+    if (available >= WIRE_VARINT_MAX_LENGTH) {
+      ERR("Malformed frame length");
+      m_is_broken = true;
+    }
+    return false;  // wait for the rest of length
+  }
+  if (length == 0 || length > m_max_length) {
+    ERR("Frame length is out of range: %zu", static_cast<size_t>(length));
+    m_is_broken = true;
+    return false;
+  }
+  if (available - used < length) {
+    return false;  // wait for the rest of frame
+  }
+  const char* start = m_buffer.data() + m_offset + used;
+  frame->type = static_cast<FrameType>(start[0]);
+  frame->payload = start + 1;
+  frame->length = length - 1;
+  m_offset += used + length;
+  return true;
+}
+
+}
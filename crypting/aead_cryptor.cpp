@@ -0,0 +1,196 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include "aead_cryptor.h"
+#include "context_pool.h"
+#include "logger.h"
+
+namespace secure {
+
+static const EVP_CIPHER* getCipher(AeadAlgorithm algorithm) {
+  switch (algorithm) {
+    case AeadAlgorithm::AES_256_GCM:
+      return EVP_aes_256_gcm();
+#if !USE_BORINGSSL
+    case AeadAlgorithm::CHACHA20_POLY1305:
+      return EVP_chacha20_poly1305();
+#endif  // USE_BORINGSSL
+    default:
+      return nullptr;
+  }
+}
+
+static void logError(const char* what) {
+  char error_buffer[ERROR_BUFFER_SIZE];
+  ERR_error_string_n(ERR_get_error(), error_buffer, ERROR_BUFFER_SIZE);
+  fprintf(stderr, "%s: %s\n", what, error_buffer);
+}
+
+AeadAlgorithm getPreferredAeadAlgorithm() {
+#if USE_BORINGSSL
+  return AeadAlgorithm::AES_256_GCM;  // ChaCha20-Poly1305 is not an EVP_CIPHER there
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  static const AeadAlgorithm s_algorithm = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul")
+      ? AeadAlgorithm::AES_256_GCM : AeadAlgorithm::CHACHA20_POLY1305;
+  return s_algorithm;
+#elif defined(__ARM_FEATURE_CRYPTO)
+  return AeadAlgorithm::AES_256_GCM;
+#else
+  return AeadAlgorithm::CHACHA20_POLY1305;
+#endif
+}
+
+AEADCryptor::AEADCryptor(const SymmetricKey& key, AeadAlgorithm algorithm)
+  : m_algorithm(algorithm)
+  , m_seal_context(EVP_CIPHER_CTX_new())
+  , m_open_context(EVP_CIPHER_CTX_new())
+  , m_counter(0) {
+  initializeCrypto();
+  const EVP_CIPHER* cipher = getCipher(algorithm);
+  bool result = cipher != nullptr && m_seal_context != nullptr && m_open_context != nullptr &&
+      RAND_bytes(m_nonce, AEAD_NONCE_LENGTH) == 1 &&
+      EVP_EncryptInit_ex(m_seal_context, cipher, nullptr, key.key, nullptr) == 1 &&
+      EVP_DecryptInit_ex(m_open_context, cipher, nullptr, key.key, nullptr) == 1;
+  if (!result) {
+    logError("Failed to initialize AEAD cipher");
+    EVP_CIPHER_CTX_free(m_seal_context);  m_seal_context = nullptr;
+    EVP_CIPHER_CTX_free(m_open_context);  m_open_context = nullptr;
+  }
+}
+
+AEADCryptor::~AEADCryptor() {
+  EVP_CIPHER_CTX_free(m_seal_context);  m_seal_context = nullptr;
+  EVP_CIPHER_CTX_free(m_open_context);  m_open_context = nullptr;
+}
+
+// ----------------------------------------------
+int AEADCryptor::seal(const unsigned char* plain, int plain_len, unsigned char* output,
+                      const unsigned char* aad, int aad_len) {
+  if (!isValid() || !nextNonce(output)) {
+    return -1;
+  }
+  unsigned char* cipher = output + AEAD_NONCE_LENGTH;
+  int length = 0, cipher_len = 0;
+  // key stays expanded in context, only nonce is set per message
+  if (EVP_EncryptInit_ex(m_seal_context, nullptr, nullptr, nullptr, output) != 1 ||
+      (aad_len > 0 && EVP_EncryptUpdate(m_seal_context, nullptr, &length, aad, aad_len) != 1) ||
+      EVP_EncryptUpdate(m_seal_context, cipher, &length, plain, plain_len) != 1) {
+    logError("Failed to seal message");
+    return -1;
+  }
+  cipher_len = length;
+  if (EVP_EncryptFinal_ex(m_seal_context, cipher + cipher_len, &length) != 1 ||
+      EVP_CIPHER_CTX_ctrl(m_seal_context, EVP_CTRL_AEAD_GET_TAG, AEAD_TAG_LENGTH, cipher + cipher_len + length) != 1) {
+    logError("Failed to seal message");
+    return -1;
+  }
+  cipher_len += length;
+  return AEAD_NONCE_LENGTH + cipher_len + AEAD_TAG_LENGTH;
+}
+
+int AEADCryptor::open(const unsigned char* sealed, int sealed_len, unsigned char* plain,
+                      const unsigned char* aad, int aad_len) {
+  if (!isValid() || sealed_len < AEAD_NONCE_LENGTH + AEAD_TAG_LENGTH) {
+    return -1;
+  }
+  const unsigned char* cipher = sealed + AEAD_NONCE_LENGTH;
+  int cipher_len = sealed_len - AEAD_NONCE_LENGTH - AEAD_TAG_LENGTH;
+  unsigned char tag[AEAD_TAG_LENGTH];
+  memcpy(tag, cipher + cipher_len, AEAD_TAG_LENGTH);
+  int length = 0, plain_len = 0;
+  if (EVP_DecryptInit_ex(m_open_context, nullptr, nullptr, nullptr, sealed) != 1 ||
+      (aad_len > 0 && EVP_DecryptUpdate(m_open_context, nullptr, &length, aad, aad_len) != 1) ||
+      EVP_DecryptUpdate(m_open_context, plain, &length, cipher, cipher_len) != 1 ||
+      EVP_CIPHER_CTX_ctrl(m_open_context, EVP_CTRL_AEAD_SET_TAG, AEAD_TAG_LENGTH, tag) != 1) {
+    logError("Failed to open message");
+    return -1;
+  }
+  plain_len = length;
+  if (EVP_DecryptFinal_ex(m_open_context, plain + plain_len, &length) != 1) {
+    WRN("Message authentication failed");
+    ERR_clear_error();
+    return -1;
+  }
+  return plain_len + length;
+}
+
+size_t AEADCryptor::sealBatch(const std::vector<std::string>& plains, unsigned char* output, int* sealed_lens) {
+  size_t sealed = 0;
+  for (auto& plain : plains) {
+    int length = seal((const unsigned char*) plain.c_str(), plain.length(), output);
+    if (length < 0) {
+      break;
+    }
+    sealed_lens[sealed++] = length;
+    output += length;
+  }
+  return sealed;
+}
+
+AEADCryptor& getAEADCryptor(const SymmetricKey& key, AeadAlgorithm algorithm) {
+  static thread_local std::unordered_map<std::string, std::unique_ptr<AEADCryptor>> t_cryptors;
+  std::string id(1, static_cast<char>(algorithm));
+  id.append((const char*) key.key, key.getLength());
+  auto it = t_cryptors.find(id);
+  if (it != t_cryptors.end()) {
+    return *it->second;
+  }
+  if (t_cryptors.size() >= AEAD_CRYPTORS_PER_THREAD) {
+    t_cryptors.clear();
+  }
+  auto& cryptor = t_cryptors[id];
+  cryptor.reset(new AEADCryptor(key, algorithm));
+  return *cryptor;
+}
+
+/* Private */
+// ----------------------------------------------------------------------------
+bool AEADCryptor::nextNonce(unsigned char* output) {
+  if (m_counter == UINT32_MAX) {
+    // new random prefix rather than ever repeating a nonce under the same key
+    if (RAND_bytes(m_nonce, AEAD_NONCE_LENGTH - 4) != 1) {
+      logError("Failed to renew nonce");
+      return false;
+    }
+    m_counter = 0;
+  }
+  ++m_counter;
+  m_nonce[8] = m_counter >> 24;  m_nonce[9] = (m_counter >> 16) & 0xFF;
+  m_nonce[10] = (m_counter >> 8) & 0xFF;  m_nonce[11] = m_counter & 0xFF;
+  memcpy(output, m_nonce, AEAD_NONCE_LENGTH);
+  return true;
+}
+
+}
+
+#endif  // SECURE
@@ -0,0 +1,110 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_AEAD_CRYPTOR__H__
+#define CHAT_SERVER_AEAD_CRYPTOR__H__
+
+#if SECURE
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "includes.h"
+#include "sym_key.h"
+
+#define AEAD_NONCE_LENGTH 12
+#define AEAD_TAG_LENGTH 16
+#define AEAD_CRYPTORS_PER_THREAD 64
+
+namespace secure {
+
+enum class AeadAlgorithm : int {
+  UNKNOWN           = 0,
+  AES_256_GCM       = 1,
+  CHACHA20_POLY1305 = 2
+};
+
+/* AES-256-GCM if CPU has AES instructions, ChaCha20-Poly1305 otherwise */
+AeadAlgorithm getPreferredAeadAlgorithm();
+
+/**
+ * Authenticated encryption with a fixed key. Key schedule is expanded once
+ * in constructor, so each message only costs a fresh nonce. Sealed message
+ * is laid out as [nonce][cipher][tag], where cipher has the same length as
+ * plain text. Nonce is a random 64-bit prefix followed by 32-bit counter.
+ *
+ * Instance is not thread-safe, use one per thread.
+ */
+class AEADCryptor {
+public:
+  AEADCryptor(const SymmetricKey& key, AeadAlgorithm algorithm = getPreferredAeadAlgorithm());
+  virtual ~AEADCryptor();
+
+  inline AeadAlgorithm getAlgorithm() const { return m_algorithm; }
+  inline bool isValid() const { return m_seal_context != nullptr && m_open_context != nullptr; }
+  static inline size_t getSealedLength(size_t plain_len) { return AEAD_NONCE_LENGTH + plain_len + AEAD_TAG_LENGTH; }
+
+  /* Return output length, or -1 on failure, including mismatch of tag or additional data */
+  int seal(const unsigned char* plain, int plain_len, unsigned char* output,
+           const unsigned char* aad = nullptr, int aad_len = 0);
+  int open(const unsigned char* sealed, int sealed_len, unsigned char* plain,
+           const unsigned char* aad = nullptr, int aad_len = 0);
+
+  /**
+   * Seals all messages back to back into 'output', which must hold the sum of
+   * their sealed lengths; 'sealed_lens' receives length of each sealed message.
+   * Returns the number of messages sealed, less than plains.size() on failure.
+   */
+  size_t sealBatch(const std::vector<std::string>& plains, unsigned char* output, int* sealed_lens);
+
+private:
+  AeadAlgorithm m_algorithm;
+  EVP_CIPHER_CTX* m_seal_context;
+  EVP_CIPHER_CTX* m_open_context;
+  unsigned char m_nonce[AEAD_NONCE_LENGTH];
+  uint32_t m_counter;
+
+  bool nextNonce(unsigned char* output);
+
+  AEADCryptor(const AEADCryptor&) = delete;
+  AEADCryptor& operator = (const AEADCryptor&) = delete;
+};
+
+/**
+ * Cryptor of the calling thread for key and algorithm. It is kept across
+ * messages, so that nonce counter advances under the same long-lived key
+ * (session or sender key) rather than each message drawing a random prefix.
+ * Up to AEAD_CRYPTORS_PER_THREAD keys are kept, then all are dropped at once.
+ */
+AEADCryptor& getAEADCryptor(const SymmetricKey& key, AeadAlgorithm algorithm = getPreferredAeadAlgorithm());
+
+}
+
+#endif  // SECURE
+
+#endif  // CHAT_SERVER_AEAD_CRYPTOR__H__
@@ -31,29 +31,23 @@
 #include <cstring>
 #include "aes_cryptor.h"
 #include "common.h"
+#include "context_pool.h"
 #include "logger.h"
 #include "random_util.h"
 
-#define ERROR_BUFFER_SIZE 256
-
 // @see https://wiki.openssl.org/index.php/EVP_Symmetric_Encryption_and_Decryption
 
 namespace secure {
 
 AESCryptor::AESCryptor()
   : m_key()
-  , m_iv(new unsigned char[IV_LENGTH])
-  , m_raw(nullptr)
   , m_raw_length(0) {
-  std::string random = secure::random::generateString(IV_LENGTH);
-  memcpy(m_iv, random.c_str(), IV_LENGTH);
+  secure::random::generateBytes(m_iv, IV_LENGTH);
   init();
 }
 
 AESCryptor::AESCryptor(unsigned char* raw, unsigned char* iv)
   : m_key(raw)
-  , m_iv(new unsigned char[IV_LENGTH])
-  , m_raw(nullptr)
   , m_raw_length(0) {
   memcpy(m_iv, iv, IV_LENGTH);
   init();
@@ -61,15 +55,12 @@ AESCryptor::AESCryptor(unsigned char* raw, unsigned char* iv)
 
 AESCryptor::AESCryptor(const SymmetricKey& key, unsigned char* iv)
   : m_key(key)
-  , m_iv(new unsigned char[IV_LENGTH])
-  , m_raw(nullptr)
   , m_raw_length(0) {
   memcpy(m_iv, iv, IV_LENGTH);
   init();
 }
 
 AESCryptor::~AESCryptor() {
-  release();
 }
 
 unsigned char* AESCryptor::getIVCopy() const {
@@ -84,40 +75,14 @@ void AESCryptor::getIVCopy(unsigned char* output) const {
 
 std::string AESCryptor::encrypt(const std::string& source) {
   TRC("encrypt(%s)", source.c_str());
-  auto size = source.length() * 2;  // large enough
-  m_raw = new unsigned char[size];
-  memset(m_raw, 0, size);
-
-  int result = 1, error_code = 0;
-  int length = 0, cipher_length = 0;
-  EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
-  if (context == nullptr) {
-    ERR("Failed to initialize context!");
+  m_raw.resize(getCipherCapacity(source.length()));  // reuses capacity
+  int cipher_length = encrypt((const unsigned char*) source.c_str(), source.length(), &m_raw[0]);
+  if (cipher_length < 0) {
+    m_raw_length = 0;
     return source;
   }
-  result = EVP_EncryptInit_ex(context, EVP_aes_256_cbc(), nullptr, m_key.key, m_iv);
-  if (result != 1) { error_code = 1;  goto E_ERROR; }
-  result = EVP_EncryptUpdate(context, m_raw, &length, (unsigned char*) source.c_str(), source.length());
-  if (result != 1) { error_code = 2;  goto E_ERROR; }
-  cipher_length = length;
-  result = EVP_EncryptFinal_ex(context, m_raw + length, &length);
-  if (result != 1) { error_code = 3;  goto E_ERROR; }
-  cipher_length += length;
   m_raw_length = cipher_length;
-  EVP_CIPHER_CTX_free(context);
-  return common::bin2hex(m_raw, cipher_length);
-
-  E_ERROR:
-    if (result != 1) {
-      char* error_buffer = new char[ERROR_BUFFER_SIZE];
-      memset(error_buffer, 0, ERROR_BUFFER_SIZE);
-      ERR_error_string_n(ERR_get_error(), error_buffer, ERROR_BUFFER_SIZE);
-      ERR("Error (code %i) during AES encryption: %s", error_code, error_buffer);
-      delete [] error_buffer;  error_buffer = nullptr;
-    }
-
-  EVP_CIPHER_CTX_free(context);
-  return source;
+  return common::bin2hex(&m_raw[0], cipher_length);
 }
 
 std::string AESCryptor::decrypt(const std::string& source) {
@@ -129,58 +94,74 @@ std::string AESCryptor::decrypt(const std::string& source) {
   memset(cipher, 0, size);
   common::hex2bin(source, cipher, cipher_length);
 
+  int plain_length = decrypt(cipher, cipher_length, plain);
+  if (plain_length < 0) {
+    return source;
+  }
+  plain[plain_length] = '\0';
+  return std::string((const char*) plain);
+}
+
+// ----------------------------------------------
+int AESCryptor::encrypt(const unsigned char* plain, int plain_len, unsigned char* cipher) {
+  int result = 1, error_code = 0;
+  int length = 0, cipher_length = 0;
+  CipherContext context;
+  if (context.get() == nullptr) {
+    return -1;
+  }
+  result = EVP_EncryptInit_ex(context.get(), EVP_aes_256_cbc(), nullptr, m_key.key, m_iv);
+  if (result != 1) { error_code = 1;  goto E_ERROR; }
+  result = EVP_EncryptUpdate(context.get(), cipher, &length, plain, plain_len);
+  if (result != 1) { error_code = 2;  goto E_ERROR; }
+  cipher_length = length;
+  result = EVP_EncryptFinal_ex(context.get(), cipher + length, &length);
+  if (result != 1) { error_code = 3;  goto E_ERROR; }
+  cipher_length += length;
+  return cipher_length;
+
+  E_ERROR:
+    char error_buffer[ERROR_BUFFER_SIZE];
+    memset(error_buffer, 0, ERROR_BUFFER_SIZE);
+    ERR_error_string_n(ERR_get_error(), error_buffer, ERROR_BUFFER_SIZE);
+    ERR("Error (code %i) during AES encryption: %s", error_code, error_buffer);
+    return -1;
+}
+
+int AESCryptor::decrypt(const unsigned char* cipher, int cipher_len, unsigned char* plain) {
   int result = 1, error_code = 0;
   int length = 0, plain_length = 0;
-  EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
-  if (context == nullptr) {
-    ERR("Failed to initialize context!");
-    return source;
+  CipherContext context;
+  if (context.get() == nullptr) {
+    return -1;
   }
-  result = EVP_DecryptInit_ex(context, EVP_aes_256_cbc(), nullptr, m_key.key, m_iv);
+  result = EVP_DecryptInit_ex(context.get(), EVP_aes_256_cbc(), nullptr, m_key.key, m_iv);
   if (result != 1) { error_code = 1;  goto D_ERROR; }
-  result = EVP_DecryptUpdate(context, plain, &length, cipher, cipher_length);
+  result = EVP_DecryptUpdate(context.get(), plain, &length, cipher, cipher_len);
   if (result != 1) { error_code = 2;  goto D_ERROR; }
   plain_length = length;
-  result = EVP_DecryptFinal_ex(context, plain + length, &length);
+  result = EVP_DecryptFinal_ex(context.get(), plain + length, &length);
   if (result != 1) { error_code = 3;  goto D_ERROR; }
   plain_length += length;
-  plain[plain_length] = '\0';
-  EVP_CIPHER_CTX_free(context);
-  return std::string((const char*) plain);
+  return plain_length;
 
   D_ERROR:
-    if (result != 1) {
-      char* error_buffer = new char[ERROR_BUFFER_SIZE];
-      memset(error_buffer, 0, ERROR_BUFFER_SIZE);
-      ERR_error_string_n(ERR_get_error(), error_buffer, ERROR_BUFFER_SIZE);
-      ERR("Error (code %i) during AES decryption: %s", error_code, error_buffer);
-      delete [] error_buffer;  error_buffer = nullptr;
-    }
-
-  EVP_CIPHER_CTX_free(context);
-  return source;
+    char error_buffer[ERROR_BUFFER_SIZE];
+    memset(error_buffer, 0, ERROR_BUFFER_SIZE);
+    ERR_error_string_n(ERR_get_error(), error_buffer, ERROR_BUFFER_SIZE);
+    ERR("Error (code %i) during AES decryption: %s", error_code, error_buffer);
+    return -1;
 }
 
 /* Private */
 // ----------------------------------------------------------------------------
 void AESCryptor::init() {
-  ERR_load_crypto_strings();
-  OpenSSL_add_all_algorithms();
-  OPENSSL_config(nullptr);
+  initializeCrypto();
 
   std::string key_hex = common::bin2hex(m_key.key, m_key.getLength());
   TTY("Key[%zu]: %s", m_key.getLength(), key_hex.c_str());
 }
 
-void AESCryptor::release() {
-  EVP_cleanup();
-  ERR_free_strings();
-  delete [] m_raw;  m_raw = nullptr;
-  delete [] m_iv;   m_iv  = nullptr;
-  m_raw_length = 0;
-}
-
 }
 
 #endif  // SECURE
-
@@ -31,6 +31,7 @@
 
 #if SECURE
 
+#include <vector>
 #include "api/icryptor.h"
 #include "includes.h"
 #include "sym_key.h"
@@ -47,23 +48,27 @@ public:
   std::string encrypt(const std::string& source) override;
   std::string decrypt(const std::string& source) override;
 
+  /* Encrypt / decrypt into caller-provided buffer, return output length or -1 on failure */
+  int encrypt(const unsigned char* plain, int plain_len, unsigned char* cipher);
+  int decrypt(const unsigned char* cipher, int cipher_len, unsigned char* plain);
+  static inline size_t getCipherCapacity(size_t plain_len) { return plain_len + EVP_MAX_BLOCK_LENGTH; }
+
   inline const SymmetricKey& getKey() const { return m_key; }
   inline SymmetricKey getKeyCopy() const { return m_key; }
   unsigned char* getIVCopy() const;
   void getIVCopy(unsigned char* output) const;
 
-  inline unsigned char* getRaw() const { return m_raw; }
+  inline const unsigned char* getRaw() const { return m_raw.data(); }
   inline size_t getRawLength() const { return m_raw_length; }
   inline size_t getIVLength() const { return IV_LENGTH; }
 
 private:
   SymmetricKey m_key;
-  unsigned char* m_iv;
-  unsigned char* m_raw;
+  unsigned char m_iv[IV_LENGTH];
+  std::vector<unsigned char> m_raw;
   size_t m_raw_length;
 
   void init();
-  void release();
 };
 
 }
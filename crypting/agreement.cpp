@@ -0,0 +1,397 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <sys/stat.h>
+#include "agreement.h"
+#include "common.h"
+#include "includes.h"
+#include "logger.h"
+
+#if USE_BORINGSSL
+#include <openssl/hkdf.h>
+#else
+#include <openssl/kdf.h>
+#endif  // USE_BORINGSSL
+
+#define HKDF_INFO_PREFIX "chat-session"
+
+namespace secure {
+namespace agreement {
+
+typedef std::unique_ptr<EVP_PKEY, void (*)(EVP_PKEY*)> UniquePKey;
+typedef std::unique_ptr<EVP_PKEY_CTX, void (*)(EVP_PKEY_CTX*)> UniquePKeyContext;
+typedef std::unique_ptr<EVP_MD_CTX, void (*)(EVP_MD_CTX*)> UniqueDigestContext;
+
+static void logError(const char* what) {
+  char error_buffer[ERROR_BUFFER_SIZE];
+  ERR_error_string_n(ERR_get_error(), error_buffer, ERROR_BUFFER_SIZE);
+  fprintf(stderr, "%s: %s\n", what, error_buffer);
+}
+
+static UniquePKey generate(int type) {
+  EVP_PKEY* pkey = nullptr;
+  UniquePKeyContext context(EVP_PKEY_CTX_new_id(type, nullptr), EVP_PKEY_CTX_free);
+  if (!context || EVP_PKEY_keygen_init(context.get()) != 1 || EVP_PKEY_keygen(context.get(), &pkey) != 1) {
+    logError("Failed to generate key");
+  }
+  return UniquePKey(pkey, EVP_PKEY_free);
+}
+
+static void writeId(ID_t id, unsigned char* output) {
+  for (int i = 7; i >= 0; --i, id >>= 8) {
+    output[i] = id & 0xFF;
+  }
+}
+
+static bool decodeKey(const Key& key, unsigned char* output, size_t expected_length) {
+  unsigned char buffer[AGREEMENT_PUBLIC_LENGTH + 3];  // decoded capacity is rounded up to 3 bytes
+  size_t length = 0;
+  if (common::base64DecodedCapacity(key.getKey().length()) > sizeof(buffer) ||
+      !common::base64Decode(key.getKey(), buffer, length) || length != expected_length) {
+    ERR("Malformed agreement key of peer [%lli]", key.getId());
+    return false;
+  }
+  memcpy(output, buffer, length);
+  return true;
+}
+
+static UniquePKey loadIdentity(const unsigned char* private_raw) {
+  UniquePKey identity(EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, nullptr, private_raw, IDENTITY_KEY_LENGTH), EVP_PKEY_free);
+  if (!identity) {
+    logError("Invalid identity key");
+  }
+  return identity;
+}
+
+static bool sign(EVP_PKEY* identity, const unsigned char* message, size_t length, unsigned char* signature) {
+  size_t signature_len = IDENTITY_SIGNATURE_LENGTH;
+  UniqueDigestContext context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+  if (!context ||
+      EVP_DigestSignInit(context.get(), nullptr, nullptr, nullptr, identity) != 1 ||
+      EVP_DigestSign(context.get(), signature, &signature_len, message, length) != 1) {
+    logError("Failed to sign agreement key");
+    return false;
+  }
+  return true;
+}
+
+static bool verify(const unsigned char* identity_raw, const unsigned char* message, size_t length, const unsigned char* signature) {
+  UniquePKey identity(EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, nullptr, identity_raw, IDENTITY_KEY_LENGTH), EVP_PKEY_free);
+  if (!identity) {
+    logError("Invalid identity key");
+    return false;
+  }
+  UniqueDigestContext context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+  if (!context ||
+      EVP_DigestVerifyInit(context.get(), nullptr, nullptr, nullptr, identity.get()) != 1 ||
+      EVP_DigestVerify(context.get(), signature, IDENTITY_SIGNATURE_LENGTH, message, length) != 1) {
+    ERR_clear_error();
+    return false;
+  }
+  return true;
+}
+
+static bool agree(const unsigned char* private_raw, const unsigned char* public_raw, unsigned char* secret) {
+  UniquePKey own(EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, nullptr, private_raw, AGREEMENT_KEY_LENGTH), EVP_PKEY_free);
+  UniquePKey peer(EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, nullptr, public_raw, AGREEMENT_KEY_LENGTH), EVP_PKEY_free);
+  if (!own || !peer) {
+    logError("Invalid agreement key");
+    return false;
+  }
+  size_t secret_len = AGREEMENT_KEY_LENGTH;
+  UniquePKeyContext derive(EVP_PKEY_CTX_new(own.get(), nullptr), EVP_PKEY_CTX_free);
+  if (!derive ||
+      EVP_PKEY_derive_init(derive.get()) != 1 ||
+      EVP_PKEY_derive_set_peer(derive.get(), peer.get()) != 1 ||
+      EVP_PKEY_derive(derive.get(), secret, &secret_len) != 1) {
+    logError("Failed to agree on shared secret");
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------
+Key getIdentityKey(ID_t id) {
+  std::string filename = common::createFilenameWithId(id, IDENTITY_KEY_FILE);
+  if (common::isFileAccessible(filename)) {
+    Key identity_key(id, common::readFileToString(filename), KeyVersion::X25519);
+    unsigned char raw[IDENTITY_KEY_LENGTH];
+    bool is_valid = decodeKey(identity_key, raw, IDENTITY_KEY_LENGTH);
+    OPENSSL_cleanse(raw, sizeof(raw));
+    if (!is_valid) {
+      ERR("Malformed identity key in file: %s", filename.c_str());  // keep it for inspection, don't replace
+      return Key::EMPTY;
+    }
+    return identity_key;
+  }
+
+  UniquePKey identity = generate(EVP_PKEY_ED25519);
+  unsigned char raw[IDENTITY_KEY_LENGTH];
+  size_t raw_len = IDENTITY_KEY_LENGTH;
+  if (!identity || EVP_PKEY_get_raw_private_key(identity.get(), raw, &raw_len) != 1) {
+    logError("Failed to export identity key");
+    return Key::EMPTY;
+  }
+  Key identity_key(id, common::base64Encode(raw, sizeof(raw)), KeyVersion::X25519);
+  OPENSSL_cleanse(raw, sizeof(raw));
+
+  std::ofstream file(filename, std::ios::out | std::ios::trunc);
+  chmod(filename.c_str(), S_IRUSR | S_IWUSR);
+  file << identity_key.getKey();
+  if (!file.good()) {
+    ERR("Failed to store identity key of [%lli], peers will see another one next session", id);
+  }
+  return identity_key;
+}
+
+std::pair<Key, Key> generateKeyPair(ID_t id, const Key& identity_key) {
+  unsigned char public_raw[AGREEMENT_PUBLIC_LENGTH];
+  unsigned char private_raw[AGREEMENT_PRIVATE_LENGTH];
+  if (!decodeKey(identity_key, private_raw + AGREEMENT_KEY_LENGTH, IDENTITY_KEY_LENGTH)) {
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+  UniquePKey agreement = generate(EVP_PKEY_X25519);
+  UniquePKey identity = loadIdentity(private_raw + AGREEMENT_KEY_LENGTH);
+  if (!agreement || !identity) {
+    OPENSSL_cleanse(private_raw, sizeof(private_raw));
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+
+  size_t agreement_len = AGREEMENT_KEY_LENGTH, identity_len = IDENTITY_KEY_LENGTH, agreement_private_len = AGREEMENT_KEY_LENGTH;
+  if (EVP_PKEY_get_raw_public_key(agreement.get(), public_raw, &agreement_len) != 1 ||
+      EVP_PKEY_get_raw_public_key(identity.get(), public_raw + AGREEMENT_KEY_LENGTH, &identity_len) != 1 ||
+      EVP_PKEY_get_raw_private_key(agreement.get(), private_raw, &agreement_private_len) != 1) {
+    logError("Failed to export raw key");
+    OPENSSL_cleanse(private_raw, sizeof(private_raw));
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+
+  unsigned char message[8 + AGREEMENT_KEY_LENGTH];
+  writeId(id, message);
+  memcpy(message + 8, public_raw, AGREEMENT_KEY_LENGTH);
+  if (!sign(identity.get(), message, sizeof(message), public_raw + AGREEMENT_KEY_LENGTH + IDENTITY_KEY_LENGTH)) {
+    OPENSSL_cleanse(private_raw, sizeof(private_raw));
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+
+  Key public_key(id, common::base64Encode(public_raw, sizeof(public_raw)), KeyVersion::X25519);
+  Key private_key(id, common::base64Encode(private_raw, sizeof(private_raw)), KeyVersion::X25519);
+  OPENSSL_cleanse(private_raw, sizeof(private_raw));
+  return std::make_pair(public_key, private_key);
+}
+
+bool verifyPublicKey(const Key& public_key) {
+  unsigned char raw[AGREEMENT_PUBLIC_LENGTH];
+  if (public_key.getVersion() != KeyVersion::X25519 || !decodeKey(public_key, raw, AGREEMENT_PUBLIC_LENGTH)) {
+    return false;
+  }
+  unsigned char message[8 + AGREEMENT_KEY_LENGTH];
+  writeId(public_key.getId(), message);
+  memcpy(message + 8, raw, AGREEMENT_KEY_LENGTH);
+  if (!verify(raw + AGREEMENT_KEY_LENGTH, message, sizeof(message), raw + AGREEMENT_KEY_LENGTH + IDENTITY_KEY_LENGTH)) {
+    WRN("Signature of agreement key of peer [%lli] doesn't match", public_key.getId());
+    return false;
+  }
+  return true;
+}
+
+bool pinIdentity(ID_t id, const Key& peer_public_key) {
+  unsigned char raw[AGREEMENT_PUBLIC_LENGTH];
+  if (!decodeKey(peer_public_key, raw, AGREEMENT_PUBLIC_LENGTH)) {
+    return false;
+  }
+  std::string identity = common::base64Encode(raw + AGREEMENT_KEY_LENGTH, IDENTITY_KEY_LENGTH);
+  std::string filename = common::createFilenameWithId(id, KNOWN_IDENTITIES_FILE);
+
+  // one line per peer: id and its identity key
+  std::ifstream known(filename);
+  ID_t peer_id = UNKNOWN_ID;
+  std::string pinned;
+  while (known >> peer_id >> pinned) {
+    if (peer_id == peer_public_key.getId()) {
+      if (pinned != identity) {
+        WRN("Identity of peer [%lli] differs from the one seen before", peer_id);
+        return false;
+      }
+      return true;
+    }
+  }
+  known.close();
+
+  std::ofstream file(filename, std::ios::out | std::ios::app);
+  file << peer_public_key.getId() << " " << identity << "\n";
+  if (!file.good()) {
+    ERR("Failed to remember identity of peer [%lli]", peer_public_key.getId());
+  }
+  return true;
+}
+
+std::pair<Key, Key> generateEphemeralKeyPair(ID_t peer_id, const Key& private_key) {
+  unsigned char private_raw[AGREEMENT_PRIVATE_LENGTH];
+  if (private_key.getVersion() != KeyVersion::X25519 || !decodeKey(private_key, private_raw, AGREEMENT_PRIVATE_LENGTH)) {
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+  UniquePKey identity = loadIdentity(private_raw + AGREEMENT_KEY_LENGTH);
+  OPENSSL_cleanse(private_raw, sizeof(private_raw));
+  UniquePKey ephemeral = generate(EVP_PKEY_X25519);
+  if (!identity || !ephemeral) {
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+
+  unsigned char public_raw[EPHEMERAL_PUBLIC_LENGTH];
+  unsigned char ephemeral_raw[AGREEMENT_KEY_LENGTH];
+  size_t public_len = AGREEMENT_KEY_LENGTH, ephemeral_len = AGREEMENT_KEY_LENGTH;
+  if (EVP_PKEY_get_raw_public_key(ephemeral.get(), public_raw, &public_len) != 1 ||
+      EVP_PKEY_get_raw_private_key(ephemeral.get(), ephemeral_raw, &ephemeral_len) != 1) {
+    logError("Failed to export raw key");
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+
+  unsigned char message[16 + AGREEMENT_KEY_LENGTH];
+  writeId(private_key.getId(), message);
+  writeId(peer_id, message + 8);
+  memcpy(message + 16, public_raw, AGREEMENT_KEY_LENGTH);
+  if (!sign(identity.get(), message, sizeof(message), public_raw + AGREEMENT_KEY_LENGTH)) {
+    OPENSSL_cleanse(ephemeral_raw, sizeof(ephemeral_raw));
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+
+  Key public_key(private_key.getId(), common::base64Encode(public_raw, sizeof(public_raw)), KeyVersion::X25519);
+  Key ephemeral_key(private_key.getId(), common::base64Encode(ephemeral_raw, sizeof(ephemeral_raw)), KeyVersion::X25519);
+  OPENSSL_cleanse(ephemeral_raw, sizeof(ephemeral_raw));
+  return std::make_pair(public_key, ephemeral_key);
+}
+
+bool verifyEphemeralKey(const Key& ephemeral, ID_t peer_id, const Key& public_key) {
+  unsigned char raw[EPHEMERAL_PUBLIC_LENGTH];
+  unsigned char public_raw[AGREEMENT_PUBLIC_LENGTH];
+  if (ephemeral.getVersion() != KeyVersion::X25519 || ephemeral.getId() != public_key.getId() ||
+      !decodeKey(ephemeral, raw, EPHEMERAL_PUBLIC_LENGTH) ||
+      !decodeKey(public_key, public_raw, AGREEMENT_PUBLIC_LENGTH)) {
+    return false;
+  }
+  unsigned char message[16 + AGREEMENT_KEY_LENGTH];
+  writeId(ephemeral.getId(), message);
+  writeId(peer_id, message + 8);
+  memcpy(message + 16, raw, AGREEMENT_KEY_LENGTH);
+  if (!verify(public_raw + AGREEMENT_KEY_LENGTH, message, sizeof(message), raw + AGREEMENT_KEY_LENGTH)) {
+    WRN("Signature of one-time key of peer [%lli] doesn't match", ephemeral.getId());
+    return false;
+  }
+  return true;
+}
+
+bool deriveSessionKey(const Key& private_key, const Key& ephemeral_private_key,
+                      const Key& peer_public_key, const Key& peer_ephemeral_key, SymmetricKey& session_key) {
+  unsigned char private_raw[AGREEMENT_PRIVATE_LENGTH];
+  unsigned char ephemeral_raw[AGREEMENT_KEY_LENGTH];
+  unsigned char peer_raw[AGREEMENT_PUBLIC_LENGTH];
+  unsigned char peer_ephemeral_raw[EPHEMERAL_PUBLIC_LENGTH];
+  if (private_key.getVersion() != KeyVersion::X25519 || peer_public_key.getVersion() != KeyVersion::X25519 ||
+      !decodeKey(private_key, private_raw, AGREEMENT_PRIVATE_LENGTH) ||
+      !decodeKey(ephemeral_private_key, ephemeral_raw, AGREEMENT_KEY_LENGTH) ||
+      !decodeKey(peer_public_key, peer_raw, AGREEMENT_PUBLIC_LENGTH) ||
+      !decodeKey(peer_ephemeral_key, peer_ephemeral_raw, EPHEMERAL_PUBLIC_LENGTH)) {
+    OPENSSL_cleanse(private_raw, sizeof(private_raw));
+    OPENSSL_cleanse(ephemeral_raw, sizeof(ephemeral_raw));
+    return false;
+  }
+
+  // agreement keys bind session to identities, one-time keys make it forward secret
+  unsigned char secret[2 * AGREEMENT_KEY_LENGTH];
+  size_t secret_len = sizeof(secret);
+  bool agreed = agree(private_raw, peer_raw, secret) &&
+                agree(ephemeral_raw, peer_ephemeral_raw, secret + AGREEMENT_KEY_LENGTH);
+  OPENSSL_cleanse(private_raw, sizeof(private_raw));
+  OPENSSL_cleanse(ephemeral_raw, sizeof(ephemeral_raw));
+  if (!agreed) {
+    OPENSSL_cleanse(secret, sizeof(secret));
+    return false;
+  }
+
+  unsigned char info[sizeof(HKDF_INFO_PREFIX) - 1 + 16];
+  ID_t low = std::min(private_key.getId(), peer_public_key.getId());
+  ID_t high = std::max(private_key.getId(), peer_public_key.getId());
+  memcpy(info, HKDF_INFO_PREFIX, sizeof(HKDF_INFO_PREFIX) - 1);
+  writeId(low, info + sizeof(HKDF_INFO_PREFIX) - 1);
+  writeId(high, info + sizeof(HKDF_INFO_PREFIX) - 1 + 8);
+
+#if USE_BORINGSSL
+  bool result = HKDF(session_key.key, KEY_LENGTH, EVP_sha256(), secret, secret_len, nullptr, 0, info, sizeof(info)) == 1;
+#else
+  size_t key_len = KEY_LENGTH;
+  UniquePKeyContext hkdf(EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr), EVP_PKEY_CTX_free);
+  bool result = hkdf &&
+      EVP_PKEY_derive_init(hkdf.get()) == 1 &&
+      EVP_PKEY_CTX_set_hkdf_md(hkdf.get(), EVP_sha256()) == 1 &&
+      EVP_PKEY_CTX_set1_hkdf_key(hkdf.get(), secret, secret_len) == 1 &&
+      EVP_PKEY_CTX_add1_hkdf_info(hkdf.get(), info, sizeof(info)) == 1 &&
+      EVP_PKEY_derive(hkdf.get(), session_key.key, &key_len) == 1;
+#endif  // USE_BORINGSSL
+  OPENSSL_cleanse(secret, sizeof(secret));
+  if (!result) {
+    logError("Failed to expand session key");
+  }
+  return result;
+}
+
+// ----------------------------------------------
+SenderKey generateSenderKey(ID_t id, int channel, uint32_t generation) {
+  unsigned char raw[KEY_LENGTH];
+  if (RAND_bytes(raw, KEY_LENGTH) != 1) {
+    logError("Failed to generate sender key");
+    return SenderKey::EMPTY;
+  }
+  SenderKey sender_key(id, channel, generation, common::base64Encode(raw, KEY_LENGTH));
+  OPENSSL_cleanse(raw, KEY_LENGTH);
+  return sender_key;
+}
+
+bool decodeSenderKey(const SenderKey& sender_key, SymmetricKey& key) {
+  unsigned char buffer[KEY_LENGTH + 3];  // decoded capacity is rounded up to 3 bytes
+  size_t length = 0;
+  if (common::base64DecodedCapacity(sender_key.getKey().length()) > sizeof(buffer) ||
+      !common::base64Decode(sender_key.getKey(), buffer, length) || length != KEY_LENGTH) {
+    ERR("Malformed sender key of peer [%lli]", sender_key.getId());
+    return false;
+  }
+  memcpy(key.key, buffer, KEY_LENGTH);
+  OPENSSL_cleanse(buffer, sizeof(buffer));
+  return true;
+}
+}
+}
+
+#endif  // SECURE
@@ -0,0 +1,118 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_AGREEMENT__H__
+#define CHAT_SERVER_AGREEMENT__H__
+
+#if SECURE
+
+#include <string>
+#include <utility>
+#include "api/structures.h"
+#include "sym_key.h"
+
+#define AGREEMENT_KEY_LENGTH 32  // X25519 public or private key
+#define IDENTITY_KEY_LENGTH 32   // Ed25519 public or private key
+#define IDENTITY_SIGNATURE_LENGTH 64
+#define AGREEMENT_PUBLIC_LENGTH (AGREEMENT_KEY_LENGTH + IDENTITY_KEY_LENGTH + IDENTITY_SIGNATURE_LENGTH)
+#define AGREEMENT_PRIVATE_LENGTH (AGREEMENT_KEY_LENGTH + IDENTITY_KEY_LENGTH)
+#define EPHEMERAL_PUBLIC_LENGTH (AGREEMENT_KEY_LENGTH + IDENTITY_SIGNATURE_LENGTH)
+#define IDENTITY_KEY_FILE "identity.key"
+#define KNOWN_IDENTITIES_FILE "known_identities"
+
+namespace secure {
+namespace agreement {
+
+/**
+ * Long-term Ed25519 identity of peer 'id', base64 of raw private key. Loaded
+ * from file, or generated and stored once, so that it survives sessions.
+ */
+Key getIdentityKey(ID_t id);
+
+/**
+ * Key pair of KeyVersion::X25519 handshake, both parts are base64-encoded:
+ *
+ *   public  - [X25519 public][Ed25519 public][signature]
+ *   private - [X25519 private][Ed25519 private]
+ *
+ * signature - Ed25519 signature of owner's id (8 bytes, big-endian) followed by
+ *             X25519 public key, made with 'identity_key'.
+ *
+ * Signature only binds agreement key to identity key in the same blob. Peers
+ * trust identity on first use, see pinIdentity().
+ */
+std::pair<Key, Key> generateKeyPair(ID_t id, const Key& identity_key);
+
+/* Checks layout and signature of public key */
+bool verifyPublicKey(const Key& public_key);
+
+/**
+ * Remembers identity within 'peer_public_key' in file of 'id' on first use,
+ * false if another identity has been remembered for that peer before.
+ */
+bool pinIdentity(ID_t id, const Key& peer_public_key);
+
+/**
+ * One-time key pair of handshake with 'peer_id', both parts are base64-encoded:
+ *
+ *   public  - [X25519 public][signature]
+ *   private - [X25519 private]
+ *
+ * signature - Ed25519 signature of owner's and peer's ids (8 bytes each,
+ *             big-endian) followed by X25519 public key, made with identity
+ *             within 'private_key'.
+ */
+std::pair<Key, Key> generateEphemeralKeyPair(ID_t peer_id, const Key& private_key);
+
+/* Checks signature of 'ephemeral' key sent to 'peer_id' against identity within 'public_key' of its owner */
+bool verifyEphemeralKey(const Key& ephemeral, ID_t peer_id, const Key& public_key);
+
+/**
+ * Expands X25519 shared secrets of both agreement keys and of both one-time
+ * keys with HKDF-SHA256 into session key. Ids of both peers go into HKDF info
+ * in ascending order, so both sides derive the same key.
+ */
+bool deriveSessionKey(const Key& private_key, const Key& ephemeral_private_key,
+                      const Key& peer_public_key, const Key& peer_ephemeral_key, SymmetricKey& session_key);
+
+/**
+ * Random sender key of peer 'id' for 'channel'. Sender sends it to each
+ * member over pairwise session key once, then encrypts each channel message
+ * once with it, instead of once per member.
+ */
+SenderKey generateSenderKey(ID_t id, int channel, uint32_t generation);
+
+/* Decodes raw key material of sender key */
+bool decodeSenderKey(const SenderKey& sender_key, SymmetricKey& key);
+
+}
+}
+
+#endif  // SECURE
+
+#endif  // CHAT_SERVER_AGREEMENT__H__
@@ -0,0 +1,106 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <mutex>
+#include <vector>
+#include "context_pool.h"
+#include "logger.h"
+
+namespace secure {
+
+namespace {
+
+class ContextPool {
+public:
+  ContextPool() { m_idle.reserve(CIPHER_CONTEXT_POOL_SIZE); }
+  ~ContextPool() {
+    for (auto* context : m_idle) {
+      EVP_CIPHER_CTX_free(context);
+    }
+  }
+
+  EVP_CIPHER_CTX* acquire() {
+    if (m_idle.empty()) {
+      return EVP_CIPHER_CTX_new();
+    }
+    EVP_CIPHER_CTX* context = m_idle.back();
+    m_idle.pop_back();
+    return context;
+  }
+
+  void release(EVP_CIPHER_CTX* context) {
+    if (m_idle.size() < CIPHER_CONTEXT_POOL_SIZE) {
+      EVP_CIPHER_CTX_reset(context);  // wipes key material, keeps allocation
+      m_idle.push_back(context);
+    } else {
+      EVP_CIPHER_CTX_free(context);
+    }
+  }
+
+  inline size_t size() const { return m_idle.size(); }
+
+private:
+  std::vector<EVP_CIPHER_CTX*> m_idle;
+};
+
+thread_local ContextPool s_pool;
+
+}
+
+CipherContext::CipherContext()
+  : m_context(s_pool.acquire()) {
+  if (m_context == nullptr) {
+    ERR("Failed to allocate cipher context!");
+  }
+}
+
+CipherContext::~CipherContext() {
+  if (m_context != nullptr) {
+    s_pool.release(m_context);
+    m_context = nullptr;
+  }
+}
+
+size_t getIdleCipherContextsCount() {
+  return s_pool.size();
+}
+
+void initializeCrypto() {
+  static std::once_flag s_flag;
+  std::call_once(s_flag, []() {
+    ERR_load_crypto_strings();
+    OpenSSL_add_all_algorithms();
+    OPENSSL_config(nullptr);
+  });
+}
+
+}
+
+#endif  // SECURE
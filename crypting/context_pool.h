@@ -0,0 +1,69 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_CONTEXT_POOL__H__
+#define CHAT_SERVER_CONTEXT_POOL__H__
+
+#if SECURE
+
+#include "includes.h"
+
+#define CIPHER_CONTEXT_POOL_SIZE 8
+
+namespace secure {
+
+/**
+ * Lease of a cipher context from the pool of the calling thread.
+ * Context is reset and returned back to the pool on destruction,
+ * so that per-message encryption doesn't create and free contexts.
+ */
+class CipherContext {
+public:
+  CipherContext();
+  virtual ~CipherContext();
+
+  inline EVP_CIPHER_CTX* get() const { return m_context; }
+
+private:
+  EVP_CIPHER_CTX* m_context;
+
+  CipherContext(const CipherContext&) = delete;
+  CipherContext& operator = (const CipherContext&) = delete;
+};
+
+/* Number of idle contexts in the pool of the calling thread */
+size_t getIdleCipherContextsCount();
+
+/* Loads error strings and algorithms, only the first call has an effect */
+void initializeCrypto();
+
+}
+
+#endif  // SECURE
+
+#endif  // CHAT_SERVER_CONTEXT_POOL__H__
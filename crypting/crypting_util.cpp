@@ -35,6 +35,7 @@
 #include "crypting_util.h"
 #include "logger.h"
 
+#include "crypting/aead_cryptor.h"
 #include "crypting/aes_cryptor.h"
 #include "crypting/cryptor.h"
 #include "crypting/includes.h"
@@ -61,7 +62,8 @@ std::string encryptAndPack(const secure::Key& public_key, const std::string& pla
     TTY("Encrypted symmetric key[%zu]: %s", E_raw_length, E_hex.c_str());
 
     // encrypt IV with public key
-    unsigned char* IV = cryptor.getIVCopy();  // allocates memory
+    unsigned char IV[IV_LENGTH];
+    cryptor.getIVCopy(IV);
     size_t IV_raw_length = cryptor.getIVLength();
     // TODO: encrypt with pub key
     std::string IV_hex = common::bin2hex(IV, IV_raw_length);
@@ -86,8 +88,6 @@ std::string encryptAndPack(const secure::Key& public_key, const std::string& pla
     std::string chunk = oss.str();
     TTY("Output buffer[%zu]: %s", chunk.length(), chunk.c_str());
 
-    delete [] IV;  IV = nullptr;
-
     encrypted = true;
     return chunk;
   }
@@ -156,23 +156,172 @@ std::string unpackAndDecrypt(const secure::Key& private_key, const std::string&
   return chunk;  // not decrypted
 }
 
+/* Binary envelope */
+// ----------------------------------------------------------------------------
+EnvelopeHeader::EnvelopeHeader()
+  : magic(ENVELOPE_MAGIC)
+  , version(ENVELOPE_VERSION)
+  , algorithm(0)
+  , ek_len(0)
+  , iv_len(0)
+  , cipher_len(0) {
+}
+
+void EnvelopeHeader::write(unsigned char* output) const {
+  output[0] = magic;
+  output[1] = version;
+  output[2] = ek_len >> 8;      output[3] = ek_len & 0xFF;
+  output[4] = iv_len >> 8;      output[5] = iv_len & 0xFF;
+  output[6] = algorithm;        output[7] = 0;  // reserved
+  output[8] = cipher_len >> 24; output[9] = (cipher_len >> 16) & 0xFF;
+  output[10] = (cipher_len >> 8) & 0xFF;  output[11] = cipher_len & 0xFF;
+}
+
+bool EnvelopeHeader::read(const unsigned char* input, size_t length) {
+  if (length < ENVELOPE_HEADER_SIZE || input[0] != ENVELOPE_MAGIC) {
+    return false;
+  }
+  magic = input[0];
+  version = input[1];
+  algorithm = input[6];
+  ek_len = (input[2] << 8) | input[3];
+  iv_len = (input[4] << 8) | input[5];
+  cipher_len = (static_cast<uint32_t>(input[8]) << 24) | (input[9] << 16) | (input[10] << 8) | input[11];
+  return version == ENVELOPE_VERSION || version == ENVELOPE_VERSION_AEAD;
+}
+
+bool isBinaryEnvelope(const std::string& chunk) {
+  // legacy envelope starts with decimal length, binary - with base64 of magic byte
+  if (chunk.length() < 4 * ENVELOPE_HEADER_SIZE / 3 || chunk.length() % 4 != 0) {
+    return false;
+  }
+  unsigned char prefix[3];
+  size_t length = 0;
+  return common::base64Decode(chunk.substr(0, 4), prefix, length) && prefix[0] == ENVELOPE_MAGIC;
+}
+
 namespace good {
 
+static std::string unpackAndDecryptBinary(secure::IAsymmetricCryptor& cryptor, const Key& private_key, const std::string& chunk, bool& decrypted) {
+  decrypted = false;
+  size_t length = 0;
+  std::vector<unsigned char> buffer(common::base64DecodedCapacity(chunk.length()));
+  EnvelopeHeader header;
+  if (!common::base64Decode(chunk, &buffer[0], length) || !header.read(&buffer[0], length) ||
+      header.version != ENVELOPE_VERSION) {
+    ERR("Malformed envelope or unsupported version");
+    return chunk;
+  }
+  if (header.ek_len > ENVELOPE_KEY_MAX_LENGTH || header.iv_len > EVP_MAX_IV_LENGTH ||
+      ENVELOPE_HEADER_SIZE + header.ek_len + header.iv_len + header.cipher_len != length) {
+    ERR("Envelope lengths [%i:%i:%u] don't match its size %zu", header.ek_len, header.iv_len, header.cipher_len, length);
+    return chunk;
+  }
+  TTY("Values: EK [%i], IV [%i], cipher [%u]", header.ek_len, header.iv_len, header.cipher_len);
+
+  unsigned char* ek = &buffer[ENVELOPE_HEADER_SIZE];
+  unsigned char* iv = ek + header.ek_len;
+  unsigned char* cipher = iv + header.iv_len;
+  cryptor.setEK(header.ek_len, ek);
+  cryptor.setIV(header.iv_len, iv);
+  cryptor.setCipherLength(header.cipher_len);
+
+  std::vector<unsigned char> plain(header.cipher_len + EVP_MAX_IV_LENGTH + 1);
+  int plain_len = cryptor.decrypt(cipher, header.cipher_len, private_key, &plain[0]);
+  if (plain_len < 0) {
+    return chunk;
+  }
+  decrypted = true;
+  return std::string((const char*) &plain[0], plain_len);
+}
+
 /* Good implementation with Envelope */
 // ----------------------------------------------------------------------------
 std::string encryptAndPack(secure::IAsymmetricCryptor& cryptor, const Key& public_key, const std::string& plain, bool& encrypted) {
+  encrypted = false;
+
+  // cipher is placed after the room for the largest header, EK and IV, and the actual
+  // ones are then written right before it, so the envelope is contiguous without copying
+  const size_t cipher_offset = ENVELOPE_HEADER_SIZE + ENVELOPE_KEY_MAX_LENGTH + EVP_MAX_IV_LENGTH;
+  std::vector<unsigned char> buffer(cipher_offset + plain.length() + EVP_MAX_IV_LENGTH);
+  int cipher_len = cryptor.encrypt(plain, public_key, &buffer[cipher_offset]);
+  if (cipher_len < 0) {
+    return plain;  // not encrypted
+  }
+
+  EnvelopeHeader header;
+  header.ek_len = cryptor.getEKlength();
+  header.iv_len = cryptor.getIVlength();
+  header.cipher_len = cipher_len;
+  size_t offset = cipher_offset - header.iv_len - header.ek_len - ENVELOPE_HEADER_SIZE;
+  header.write(&buffer[offset]);
+  cryptor.getEK(&buffer[offset + ENVELOPE_HEADER_SIZE]);
+  cryptor.getIV(&buffer[offset + ENVELOPE_HEADER_SIZE + header.ek_len]);
+
+  encrypted = true;
+  return common::base64Encode(&buffer[offset], cipher_offset + cipher_len - offset);
+}
+
+// ----------------------------------------------
+std::string encryptAndPack(const SymmetricKey& session_key, const std::string& plain, bool& encrypted) {
+  encrypted = false;
+  AEADCryptor& cryptor = getAEADCryptor(session_key);
+  std::vector<unsigned char> buffer(ENVELOPE_HEADER_SIZE + AEADCryptor::getSealedLength(plain.length()));
+  EnvelopeHeader header;
+  header.version = ENVELOPE_VERSION_AEAD;
+  header.algorithm = static_cast<uint8_t>(cryptor.getAlgorithm());
+  header.iv_len = AEAD_NONCE_LENGTH;
+  header.cipher_len = plain.length() + AEAD_TAG_LENGTH;
+  header.write(&buffer[0]);
+
+  int sealed_len = cryptor.seal((const unsigned char*) plain.c_str(), plain.length(),
+                                &buffer[ENVELOPE_HEADER_SIZE], &buffer[0], ENVELOPE_HEADER_SIZE);
+  if (sealed_len < 0) {
+    return plain;
+  }
+  encrypted = true;
+  return common::base64Encode(&buffer[0], ENVELOPE_HEADER_SIZE + sealed_len);
+}
+
+std::string unpackAndDecrypt(const SymmetricKey& session_key, const std::string& chunk, bool& decrypted) {
+  decrypted = false;
+  size_t length = 0;
+  std::vector<unsigned char> buffer(common::base64DecodedCapacity(chunk.length()) + 1);
+  EnvelopeHeader header;
+  if (!common::base64Decode(chunk, &buffer[0], length) || !header.read(&buffer[0], length) ||
+      header.version != ENVELOPE_VERSION_AEAD) {
+    ERR("Malformed envelope or unsupported version");
+    return chunk;
+  }
+  if (header.ek_len != 0 || header.iv_len != AEAD_NONCE_LENGTH || header.cipher_len < AEAD_TAG_LENGTH ||
+      ENVELOPE_HEADER_SIZE + header.iv_len + header.cipher_len != length) {
+    ERR("Envelope lengths [%i:%i:%u] don't match session envelope of size %zu", header.ek_len, header.iv_len, header.cipher_len, length);
+    return chunk;
+  }
+
+  AEADCryptor& cryptor = getAEADCryptor(session_key, static_cast<AeadAlgorithm>(header.algorithm));
+  std::vector<unsigned char> plain(header.cipher_len);
+  int plain_len = cryptor.open(&buffer[ENVELOPE_HEADER_SIZE], length - ENVELOPE_HEADER_SIZE, &plain[0],
+                               &buffer[0], ENVELOPE_HEADER_SIZE);
+  if (plain_len < 0) {
+    return chunk;
+  }
+  decrypted = true;
+  return std::string((const char*) &plain[0], plain_len);
+}
+
+// ----------------------------------------------
+std::string encryptAndPackLegacy(secure::IAsymmetricCryptor& cryptor, const Key& public_key, const std::string& plain, bool& encrypted) {
   std::string cipher = cryptor.encrypt(plain, public_key, encrypted);
 
   int ek_len = cryptor.getEKlength();
   int iv_len = cryptor.getIVlength();
-  unsigned char* ek = new unsigned char[ek_len];
-  unsigned char* iv = new unsigned char[iv_len];
+  unsigned char ek[ENVELOPE_KEY_MAX_LENGTH];
+  unsigned char iv[EVP_MAX_IV_LENGTH];
   cryptor.getEK(ek);
   cryptor.getIV(iv);
   std::string ek_hex = common::bin2hex(ek, ek_len);
   std::string iv_hex = common::bin2hex(iv, iv_len);
-  delete [] ek;  ek = nullptr;
-  delete [] iv;  iv = nullptr;
 
   std::ostringstream oss;
   oss << ek_len << COMPOUND_MESSAGE_DELIMITER << ek_hex << COMPOUND_MESSAGE_DELIMITER
@@ -183,6 +332,10 @@ std::string encryptAndPack(secure::IAsymmetricCryptor& cryptor, const Key& publi
 
 // ----------------------------------------------
 std::string unpackAndDecrypt(secure::IAsymmetricCryptor& cryptor, const Key& private_key, const std::string& chunk, bool& decrypted) {
+  if (isBinaryEnvelope(chunk)) {
+    return unpackAndDecryptBinary(cryptor, private_key, chunk, decrypted);
+  }
+
   std::vector<std::string> values;
   common::split(chunk, COMPOUND_MESSAGE_DELIMITER, &values);
   int ek_len = std::stoi(values[0]);
@@ -194,16 +347,21 @@ std::string unpackAndDecrypt(secure::IAsymmetricCryptor& cryptor, const Key& pri
   TTY("Values: EK [%i:%s], IV [%i:%s], cipher [%i:%s]",
       ek_len, ek_hex.c_str(), iv_len, iv_hex.c_str(), cipher_len, cipher.c_str());
 
+  if (ek_len < 0 || ek_len > ENVELOPE_KEY_MAX_LENGTH || ek_hex.length() > 2 * ENVELOPE_KEY_MAX_LENGTH ||
+      iv_len < 0 || iv_len > EVP_MAX_IV_LENGTH || iv_hex.length() > 2 * EVP_MAX_IV_LENGTH) {
+    ERR("Envelope key or initial vector is out of bounds");
+    decrypted = false;
+    return chunk;
+  }
+
   size_t o_ek_len = 0, o_iv_len = 0;
-  unsigned char* ek = new unsigned char[ek_len];
-  unsigned char* iv = new unsigned char[iv_len];
+  unsigned char ek[ENVELOPE_KEY_MAX_LENGTH];
+  unsigned char iv[EVP_MAX_IV_LENGTH];
   common::hex2bin(ek_hex, ek, o_ek_len);
   common::hex2bin(iv_hex, iv, o_iv_len);
   cryptor.setEK(ek_len, ek);
   cryptor.setIV(iv_len, iv);
   cryptor.setCipherLength(cipher_len);
-  delete [] ek;  ek = nullptr;
-  delete [] iv;  iv = nullptr;
 
   return cryptor.decrypt(cipher, private_key, decrypted);
 }
@@ -211,21 +369,36 @@ std::string unpackAndDecrypt(secure::IAsymmetricCryptor& cryptor, const Key& pri
 /* Direct RSA */
 // ----------------------------------------------------------------------------
 std::string encryptRSA(const Key& public_key, const std::string& plain, bool& encrypted) {
+  encrypted = false;
+  if (public_key == Key::EMPTY) {
+    WRN("Public key wasn't provided for RSA encryption!");
+    return plain;
+  }
+  return encryptRSA(parsePublicKey(public_key), plain, encrypted);
+}
+
+std::string decryptRSA(const Key& private_key, const std::string& source, bool& decrypted) {
+  decrypted = false;
+  if (private_key == Key::EMPTY) {
+    WRN("Private key wasn't provided for RSA decryption!");
+    return source;
+  }
+  return decryptRSA(parsePrivateKey(private_key), source, decrypted);
+}
+
+// ----------------------------------------------
+std::string encryptRSA(const PKey& public_key, const std::string& plain, bool& encrypted) {
   encrypted = false;
   if (plain.length() > 214) {
     ERR("Input must be no longer than 214 characters! Current length: %zu", plain.length());
     return plain;
   }
-  if (public_key == Key::EMPTY) {
+  if (!public_key) {
     WRN("Public key wasn't provided for RSA encryption!");
     return plain;
   }
 
-  BIO* bio = BIO_new(BIO_s_mem());
-  BIO_write(bio, public_key.getKey().c_str(), public_key.getKey().length());
-  RSA* rsa = RSA_new();
-  PEM_read_bio_RSAPublicKey(bio, &rsa, nullptr, nullptr);
-  BIO_free(bio);
+  RSA* rsa = EVP_PKEY_get1_RSA(public_key.get());  // shares ownership
 
   unsigned char* cipher = new unsigned char[256];
   memset(cipher, 0, 256);
@@ -249,18 +422,14 @@ std::string encryptRSA(const Key& public_key, const std::string& plain, bool& en
   return cipher_str;
 }
 
-std::string decryptRSA(const Key& private_key, const std::string& source, bool& decrypted) {
+std::string decryptRSA(const PKey& private_key, const std::string& source, bool& decrypted) {
   decrypted = false;
-  if (private_key == Key::EMPTY) {
+  if (!private_key) {
     WRN("Private key wasn't provided for RSA decryption!");
     return source;
   }
 
-  BIO* bio = BIO_new(BIO_s_mem());
-  BIO_write(bio, private_key.getKey().c_str(), private_key.getKey().length());
-  RSA* rsa = RSA_new();
-  PEM_read_bio_RSAPrivateKey(bio, &rsa, nullptr, nullptr);
-  BIO_free(bio);
+  RSA* rsa = EVP_PKEY_get1_RSA(private_key.get());  // shares ownership
 
   size_t cipher_len = 0;
   unsigned char* cipher = new unsigned char[256];
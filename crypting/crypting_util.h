@@ -30,29 +30,81 @@
 #define CHAT_SERVER_CRYPTING_UTIL__H__
 
 #include <string>
+#include <cstdint>
 #include "api/structures.h"
 
 #if SECURE
 
+#include "crypting/key_cache.h"
+#include "crypting/sym_key.h"
+
 #define COMPOUND_MESSAGE_DELIMITER ':'
 #define COMPOUND_MESSAGE_DELIMITER_STR ":"
 #define COMPOUND_MESSAGE_SEPARATOR "-----*****-----"
 #define COMPOUND_MESSAGE_SEPARATOR_LENGTH 15
 
+#define ENVELOPE_MAGIC 0xCE
+#define ENVELOPE_VERSION 1
+#define ENVELOPE_VERSION_AEAD 2
+#define ENVELOPE_HEADER_SIZE 12
+
 namespace secure {
 
+/**
+ * Binary envelope, carried base64-encoded in Message:
+ *
+ *  [header][EK][IV][cipher]
+ *
+ *  header - magic, version, then big-endian lengths of EK, IV and cipher;
+ *           12 bytes, so it takes exactly 16 base64 characters;
+ *      EK - symmetric key encrypted with some public key;
+ *      IV - initial vector;
+ *  cipher - message encrypted with symmetric key.
+ *
+ *  Version 2 is sealed with AEAD under session key: EK is empty, IV is nonce,
+ *  cipher is followed by tag, header is authenticated as additional data
+ *  and carries AeadAlgorithm in its byte 6.
+ */
+struct EnvelopeHeader {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t algorithm;  // version 2 only
+  uint16_t ek_len;
+  uint16_t iv_len;
+  uint32_t cipher_len;
+
+  EnvelopeHeader();
+  void write(unsigned char* output) const;
+  bool read(const unsigned char* input, size_t length);
+};
+
+/* Whether chunk is a binary envelope, otherwise it is in legacy colon-separated hex format */
+bool isBinaryEnvelope(const std::string& chunk);
+
 /* These methods do not encrypt symmetric key - it has left unimplemented */
 std::string encryptAndPack(const Key& public_key, const std::string& plain, bool& encrypted);
 std::string unpackAndDecrypt(const Key& private_key, const std::string& chunk, bool& decrypted);
 
 namespace good {
 
+/* Produce binary envelope, accept both binary and legacy ones */
 std::string encryptAndPack(secure::IAsymmetricCryptor& cryptor, const Key& public_key, const std::string& plain, bool& encrypted);
 std::string unpackAndDecrypt(secure::IAsymmetricCryptor& cryptor, const Key& private_key, const std::string& chunk, bool& decrypted);
 
+/* Binary envelope without EK, for peers sharing session key, see crypting/agreement.h */
+std::string encryptAndPack(const SymmetricKey& session_key, const std::string& plain, bool& encrypted);
+std::string unpackAndDecrypt(const SymmetricKey& session_key, const std::string& chunk, bool& decrypted);
+
+/* Legacy format: ek_len:ek_hex:iv_len:iv_hex:cipher_len:cipher_hex */
+std::string encryptAndPackLegacy(secure::IAsymmetricCryptor& cryptor, const Key& public_key, const std::string& plain, bool& encrypted);
+
 std::string encryptRSA(const Key& public_key, const std::string& plain, bool& encrypted);
 std::string decryptRSA(const Key& private_key, const std::string& cipher, bool& decrypted);
 
+/* Same as above, but with keys already parsed, see KeyCache */
+std::string encryptRSA(const PKey& public_key, const std::string& plain, bool& encrypted);
+std::string decryptRSA(const PKey& private_key, const std::string& cipher, bool& decrypted);
+
 }
 
 }
@@ -0,0 +1,157 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <algorithm>
+#include <sstream>
+#include "crypto_pool.h"
+#include "logger.h"
+
+namespace secure {
+
+Log2Histogram::Log2Histogram() {
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    m_buckets[i] = 0;
+  }
+}
+
+void Log2Histogram::record(uint64_t value) {
+  int bucket = 0;
+  while (bucket < HISTOGRAM_BUCKETS - 1 && (1ULL << bucket) < value) {
+    ++bucket;
+  }
+  m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Log2Histogram::getCount() const {
+  uint64_t total = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    total += m_buckets[i].load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+uint64_t Log2Histogram::getPercentile(double fraction) const {
+  uint64_t total = getCount();
+  uint64_t rank = static_cast<uint64_t>(total * fraction + 0.5);
+  uint64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if (total > 0 && seen >= rank) {
+      return 1ULL << i;
+    }
+  }
+  return 0;
+}
+
+std::string Log2Histogram::toString(const char* unit) const {
+  std::ostringstream oss;
+  oss << "count " << getCount()
+      << ", p50 <= " << getPercentile(0.5) << " " << unit
+      << ", p99 <= " << getPercentile(0.99) << " " << unit
+      << ", max <= " << getPercentile(1.0) << " " << unit;
+  return oss.str();
+}
+
+// ----------------------------------------------
+CryptoWorkerPool::CryptoWorkerPool(size_t workers, size_t capacity)
+  : m_capacity(capacity)
+  , m_is_stopped(false)
+  , m_rejected(0) {
+  m_workers_count = workers > 0 ? workers : std::max(1U, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < m_workers_count; ++i) {
+    m_workers.emplace_back(&CryptoWorkerPool::workerThread, this);
+  }
+  INF("Crypto worker pool: %zu workers, queue capacity %zu", m_workers_count, capacity);
+}
+
+CryptoWorkerPool::~CryptoWorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_is_stopped = true;
+  }
+  m_queue_cv.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();  // queued tasks are completed before workers leave
+  }
+}
+
+bool CryptoWorkerPool::execute(const std::function<void()>& task) {
+  std::future<void> result;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t depth = m_queue.size();
+    m_depth_histogram.record(depth);
+    if (m_is_stopped || depth >= m_capacity) {
+      ++m_rejected;
+      return false;
+    }
+    Job job = {std::packaged_task<void()>(task), std::chrono::steady_clock::now()};
+    result = job.task.get_future();
+    m_queue.push_back(std::move(job));
+  }
+  m_queue_cv.notify_one();
+  result.get();  // rethrows exception of task, if any
+  return true;
+}
+
+size_t CryptoWorkerPool::getQueueDepth() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_queue.size();
+}
+
+void CryptoWorkerPool::workerThread() {
+  std::vector<Job> batch;
+  batch.reserve(CRYPTO_BATCH_SIZE);
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_queue_cv.wait(lock, [this](){ return this->m_is_stopped || !this->m_queue.empty(); });
+    if (m_queue.empty()) {
+      break;  // stopped and drained
+    }
+    // fair share of queue, so that other workers aren't left idle
+    size_t take = std::min<size_t>(CRYPTO_BATCH_SIZE, m_queue.size() / m_workers_count + 1);
+    while (!m_queue.empty() && batch.size() < take) {
+      batch.push_back(std::move(m_queue.front()));
+      m_queue.pop_front();
+    }
+    lock.unlock();
+    for (auto& job : batch) {
+      job.task();
+      auto elapsed = std::chrono::steady_clock::now() - job.submitted;
+      m_latency_histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+    batch.clear();
+    lock.lock();
+  }
+}
+
+}
+
+#endif  // SECURE
@@ -0,0 +1,113 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_CRYPTO_POOL__H__
+#define CHAT_SERVER_CRYPTO_POOL__H__
+
+#if SECURE
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CRYPTO_QUEUE_CAPACITY 256
+#define CRYPTO_BATCH_SIZE 16
+#define HISTOGRAM_BUCKETS 24
+
+namespace secure {
+
+/* Counts values in buckets of powers of 2: [0, 1], (1, 2], (2, 4], ... */
+class Log2Histogram {
+public:
+  Log2Histogram();
+
+  void record(uint64_t value);
+  uint64_t getCount() const;
+  uint64_t getPercentile(double fraction) const;  // upper bound of bucket
+  std::string toString(const char* unit) const;
+
+private:
+  std::atomic<uint64_t> m_buckets[HISTOGRAM_BUCKETS];
+};
+
+/**
+ * Fixed set of threads doing expensive private key operations on behalf of
+ * connection threads, so that at most as many of them run at once as there
+ * are cores. Queue is bounded: a task is rejected at once when it is full,
+ * so that overload sheds rather than latency growing without limit. Each
+ * worker takes its share of queue, up to CRYPTO_BATCH_SIZE tasks, per wake-up.
+ */
+class CryptoWorkerPool {
+public:
+  CryptoWorkerPool(size_t workers = 0, size_t capacity = CRYPTO_QUEUE_CAPACITY);  // 0 - one per core
+  virtual ~CryptoWorkerPool();
+
+  /* Runs 'task' on some worker and waits for it, false if queue is full */
+  bool execute(const std::function<void()>& task);
+
+  inline size_t getWorkersCount() const { return m_workers_count; }
+  size_t getQueueDepth() const;
+  inline uint64_t getRejectedCount() const { return m_rejected.load(); }
+  inline const Log2Histogram& getDepthHistogram() const { return m_depth_histogram; }  // at submission
+  inline const Log2Histogram& getLatencyHistogram() const { return m_latency_histogram; }  // wait + run, us
+
+private:
+  struct Job {
+    std::packaged_task<void()> task;
+    std::chrono::steady_clock::time_point submitted;
+  };
+
+  size_t m_capacity;
+  size_t m_workers_count;
+  bool m_is_stopped;
+  std::deque<Job> m_queue;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_queue_cv;
+  std::vector<std::thread> m_workers;
+  std::atomic<uint64_t> m_rejected;
+  Log2Histogram m_depth_histogram;
+  Log2Histogram m_latency_histogram;
+
+  void workerThread();
+
+  CryptoWorkerPool(const CryptoWorkerPool& obj) = delete;
+  CryptoWorkerPool& operator = (const CryptoWorkerPool& rhs) = delete;
+};
+
+}
+
+#endif  // SECURE
+
+#endif  // CHAT_SERVER_CRYPTO_POOL__H__
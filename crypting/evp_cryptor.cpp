@@ -28,7 +28,10 @@
 
 #if SECURE
 
+#include <algorithm>
+#include <vector>
 #include "common.h"
+#include "context_pool.h"
 #include "evp_cryptor.h"
 #include "logger.h"
 
@@ -48,12 +51,12 @@ int envelopeSeal(
     unsigned char* iv,
     unsigned char* ciphertext) {
 
-  EVP_CIPHER_CTX* ctx;
+  CipherContext context;  // reused from pool
+  EVP_CIPHER_CTX* ctx = context.get();
   int ciphertext_len = 0;
   int len = 0;
 
-  /* Create and initialise the context */
-  if (!(ctx = EVP_CIPHER_CTX_new())) {
+  if (ctx == nullptr) {
     ERR("Create context for seal");
     handleErrors();
   }
@@ -87,10 +90,6 @@ int envelopeSeal(
   }
 
   ciphertext_len += len;
-
-  /* Clean up */
-  EVP_CIPHER_CTX_free(ctx);
-
   return ciphertext_len;
 }
 
@@ -101,12 +100,12 @@ int envelopeOpen(
     unsigned char* iv,
     unsigned char* plaintext) {
 
-  EVP_CIPHER_CTX* ctx;
+  CipherContext context;  // reused from pool
+  EVP_CIPHER_CTX* ctx = context.get();
   int len = 0;
   int plaintext_len = 0;
 
-  /* Create and initialise the context */
-  if (!(ctx = EVP_CIPHER_CTX_new())) {
+  if (ctx == nullptr) {
     ERR("Create context for open");
     handleErrors();
   }
@@ -138,10 +137,6 @@ int envelopeOpen(
   }
 
   plaintext_len += len;
-
-  /* Clean up */
-  EVP_CIPHER_CTX_free(ctx);
-
   return plaintext_len;
 }
 
@@ -150,39 +145,40 @@ int envelopeOpen(
 EVPCryptor::EVPCryptor()
   : m_ek_len(0)
   , m_iv_len(EVP_MAX_IV_LENGTH)
-  , m_cipher_len(0)
-  , m_ek(nullptr)
-  , m_iv(nullptr) {
+  , m_cipher_len(0) {
 }
 
 EVPCryptor::~EVPCryptor() {
-  delete [] m_ek;  m_ek = nullptr;
-  delete [] m_iv;  m_iv = nullptr;
+}
+
+void EVPCryptor::setEK(int ek_len, unsigned char* ek) {
+  if (ek_len < 0 || ek_len > ENVELOPE_KEY_MAX_LENGTH) {
+    ERR("Envelope key length %i is out of bounds", ek_len);
+    return;
+  }
+  m_ek_len = ek_len;
+  memcpy(m_ek, ek, ek_len);
+}
+
+void EVPCryptor::setIV(int iv_len, unsigned char* iv) {
+  if (iv_len < 0 || iv_len > EVP_MAX_IV_LENGTH) {
+    ERR("Initial vector length %i is out of bounds", iv_len);
+    return;
+  }
+  m_iv_len = iv_len;
+  memcpy(m_iv, iv, iv_len);
 }
 
 std::string EVPCryptor::encrypt(const std::string& source, const secure::Key& public_pem, bool& encrypted) {
   encrypted = false;
   if (public_pem != Key::EMPTY) {
-    BIO* public_bio = BIO_new(BIO_s_mem());
-    BIO_write(public_bio, public_pem.getKey().c_str(), public_pem.getKey().length());
-    RSA* public_rsa = RSA_new();
-    EVP_PKEY* public_key = EVP_PKEY_new();
-    PEM_read_bio_RSAPublicKey(public_bio, &public_rsa, nullptr, nullptr);
-    EVP_PKEY_assign_RSA(public_key, public_rsa);
-    BIO_free(public_bio);
-
-    int pubkey_len = EVP_PKEY_size(public_key);
-    m_ek = new unsigned char[pubkey_len];
-    m_iv = new unsigned char[EVP_MAX_IV_LENGTH];
-    unsigned char* cipher = new unsigned char[source.length() + EVP_MAX_IV_LENGTH];
-
-    m_cipher_len = envelopeSeal(&public_key, (unsigned char*) source.c_str(), source.length(), &m_ek, &m_ek_len, m_iv, cipher);
-    EVP_PKEY_free(public_key);
-
+    std::vector<unsigned char> cipher(source.length() + EVP_MAX_IV_LENGTH);
+    int cipher_len = encrypt(source, public_pem, &cipher[0]);
+    if (cipher_len < 0) {
+      return source;
+    }
     encrypted = true;
-    std::string message = common::bin2hex(cipher, m_cipher_len);
-    delete [] cipher;  cipher = nullptr;
-    return message;
+    return common::bin2hex(&cipher[0], cipher_len);
   }
   WRN("Public key wasn't provided, source hasn't been encrypted");
   return source;
@@ -191,33 +187,65 @@ std::string EVPCryptor::encrypt(const std::string& source, const secure::Key& pu
 std::string EVPCryptor::decrypt(const std::string& source, const secure::Key& private_pem, bool& decrypted) {
   decrypted = false;
   if (private_pem != Key::EMPTY) {
-    BIO* private_bio = BIO_new(BIO_s_mem());
-    BIO_write(private_bio, private_pem.getKey().c_str(), private_pem.getKey().length());
-    RSA* private_rsa = RSA_new();
-    EVP_PKEY* private_key = EVP_PKEY_new();
-    PEM_read_bio_RSAPrivateKey(private_bio, &private_rsa, nullptr, nullptr);
-    EVP_PKEY_assign_RSA(private_key, private_rsa);
-    BIO_free(private_bio);
-
     size_t o_cipher_len = 0;
-    unsigned char* cipher = new unsigned char[m_cipher_len];
-    unsigned char* plain = new unsigned char[m_cipher_len + m_iv_len];
-    common::hex2bin(source, cipher, o_cipher_len);
-
-    int plain_len = envelopeOpen(private_key, cipher, m_cipher_len, m_ek, m_ek_len, m_iv, plain);
+    std::vector<unsigned char> cipher(std::max(static_cast<size_t>(m_cipher_len), source.length() / 2 + 1));
+    std::vector<unsigned char> plain(m_cipher_len + m_iv_len + 1);
+    common::hex2bin(source, &cipher[0], o_cipher_len);
+
+    int plain_len = decrypt(&cipher[0], m_cipher_len, private_pem, &plain[0]);
+    if (plain_len < 0) {
+      return source;
+    }
     plain[plain_len] = '\0';
-    EVP_PKEY_free(private_key);
 
     decrypted = true;
-    std::string message((const char*) plain);
-    delete [] cipher;  cipher = nullptr;
-    delete [] plain;  plain = nullptr;
-    return message;
+    return std::string((const char*) &plain[0]);
   }
   WRN("Private key wasn't provided, source hasn't been decrypted");
   return source;
 }
 
+// ----------------------------------------------
+int EVPCryptor::encrypt(const std::string& source, const secure::Key& public_pem, unsigned char* cipher) {
+  if (public_pem == Key::EMPTY) {
+    WRN("Public key wasn't provided, source hasn't been encrypted");
+    return -1;
+  }
+  return encrypt(parsePublicKey(public_pem), (const unsigned char*) source.c_str(), source.length(), cipher);
+}
+
+int EVPCryptor::decrypt(const unsigned char* cipher, int cipher_len, const secure::Key& private_pem, unsigned char* plain) {
+  if (private_pem == Key::EMPTY) {
+    WRN("Private key wasn't provided, source hasn't been decrypted");
+    return -1;
+  }
+  return decrypt(parsePrivateKey(private_pem), cipher, cipher_len, plain);
+}
+
+int EVPCryptor::encrypt(const PKey& public_key, const unsigned char* plain, int plain_len, unsigned char* cipher) {
+  if (!public_key) {
+    ERR("Invalid public key, source hasn't been encrypted");
+    return -1;
+  }
+  if (EVP_PKEY_size(public_key.get()) > ENVELOPE_KEY_MAX_LENGTH) {
+    ERR("Public key is too large: %i bytes", EVP_PKEY_size(public_key.get()));
+    return -1;
+  }
+  EVP_PKEY* key = public_key.get();
+  unsigned char* ek = m_ek;
+  m_iv_len = EVP_MAX_IV_LENGTH;
+  m_cipher_len = envelopeSeal(&key, const_cast<unsigned char*>(plain), plain_len, &ek, &m_ek_len, m_iv, cipher);
+  return m_cipher_len;
+}
+
+int EVPCryptor::decrypt(const PKey& private_key, const unsigned char* cipher, int cipher_len, unsigned char* plain) {
+  if (!private_key) {
+    ERR("Invalid private key, source hasn't been decrypted");
+    return -1;
+  }
+  return envelopeOpen(private_key.get(), const_cast<unsigned char*>(cipher), cipher_len, m_ek, m_ek_len, m_iv, plain);
+}
+
 }
 
 #endif  // SECURE
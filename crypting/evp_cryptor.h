@@ -35,6 +35,7 @@
 #include <cstring>
 #include "api/icryptor.h"
 #include "includes.h"
+#include "key_cache.h"
 
 namespace secure {
 
@@ -45,6 +46,16 @@ public:
 
   std::string encrypt(const std::string& source, const secure::Key& public_key, bool& encrypted) override;
   std::string decrypt(const std::string& source, const secure::Key& private_key, bool& decrypted) override;
+  int encrypt(const std::string& source, const secure::Key& public_key, unsigned char* cipher) override;
+  int decrypt(const unsigned char* cipher, int cipher_len, const secure::Key& private_key, unsigned char* plain) override;
+
+  /**
+   * Seal / open into caller-provided buffer with keys already parsed, see KeyCache.
+   * Cipher must hold at least plain_len + EVP_MAX_IV_LENGTH bytes, plain - at least
+   * cipher_len + EVP_MAX_IV_LENGTH bytes. Return output length or -1 on failure.
+   */
+  int encrypt(const PKey& public_key, const unsigned char* plain, int plain_len, unsigned char* cipher);
+  int decrypt(const PKey& private_key, const unsigned char* cipher, int cipher_len, unsigned char* plain);
 
   inline int getEKlength() const override { return m_ek_len; }
   inline int getIVlength() const override { return m_iv_len; }
@@ -53,25 +64,15 @@ public:
   void getIV(unsigned char* iv) const override { memcpy(iv, m_iv, m_iv_len); }
 
   inline void setCipherLength(int cipher_len) override { m_cipher_len = cipher_len; }
-  void setEK(int ek_len, unsigned char* ek) override {
-    if (m_ek != nullptr) { delete [] m_ek;  m_ek = nullptr; }
-    m_ek = new unsigned char[ek_len];
-    m_ek_len = ek_len;
-    memcpy(m_ek, ek, ek_len);
-  }
-  void setIV(int iv_len, unsigned char* iv) override {
-    if (m_iv != nullptr) { delete [] m_iv;  m_iv = nullptr; }
-    m_iv = new unsigned char[iv_len];
-    m_iv_len = iv_len;
-    memcpy(m_iv, iv, iv_len);
-  }
+  void setEK(int ek_len, unsigned char* ek) override;
+  void setIV(int iv_len, unsigned char* iv) override;
 
 private:
   int m_ek_len;
   int m_iv_len;
   int m_cipher_len;
-  unsigned char* m_ek;
-  unsigned char* m_iv;
+  unsigned char m_ek[ENVELOPE_KEY_MAX_LENGTH];
+  unsigned char m_iv[EVP_MAX_IV_LENGTH];
 };
 
 }
@@ -35,7 +35,7 @@
 
 // symmetric key in bytes
 #define KEY_LENGTH SHA256_DIGEST_LENGTH
-#define IV_LENGTH SHA256_DIGEST_LENGTH >> 1
+#define IV_LENGTH (SHA256_DIGEST_LENGTH >> 1)
 
 // key lengths in bits
 #define RSA_KEYLEN 2048
@@ -43,6 +43,9 @@
 #define AES_ROUNDS 6
 
 #define ERROR_BUFFER_SIZE 256
+
+// upper bound of envelope key encrypted with RSA up to 4096 bits
+#define ENVELOPE_KEY_MAX_LENGTH 512
 #define KEY_SIZE_BITS RSA_KEYLEN
 #define KEY_PUBLIC_EXPONENT 65537
 
@@ -0,0 +1,110 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include "key_cache.h"
+#include "logger.h"
+
+namespace secure {
+
+static PKey wrap(RSA* rsa) {
+  if (rsa == nullptr) {
+    return PKey();
+  }
+  EVP_PKEY* key = EVP_PKEY_new();
+  EVP_PKEY_assign_RSA(key, rsa);  // takes ownership
+  return PKey(key, EVP_PKEY_free);
+}
+
+PKey parsePublicKey(const Key& public_pem) {
+  BIO* bio = BIO_new_mem_buf(const_cast<char*>(public_pem.getKey().c_str()), public_pem.getKey().length());
+  RSA* rsa = PEM_read_bio_RSAPublicKey(bio, nullptr, nullptr, nullptr);
+  BIO_free(bio);
+  return wrap(rsa);
+}
+
+PKey parsePrivateKey(const Key& private_pem) {
+  BIO* bio = BIO_new_mem_buf(const_cast<char*>(private_pem.getKey().c_str()), private_pem.getKey().length());
+  RSA* rsa = PEM_read_bio_RSAPrivateKey(bio, nullptr, nullptr, nullptr);
+  BIO_free(bio);
+  return wrap(rsa);
+}
+
+/* Cache */
+// ----------------------------------------------------------------------------
+KeyCache::KeyCache() {
+}
+
+KeyCache::~KeyCache() {
+}
+
+PKey KeyCache::getPublicKey(const Key& public_pem) {
+  return get(m_public_keys, public_pem, parsePublicKey);
+}
+
+PKey KeyCache::getPrivateKey(const Key& private_pem) {
+  return get(m_private_keys, private_pem, parsePrivateKey);
+}
+
+void KeyCache::invalidate(ID_t id) {
+  TRC("invalidate(%lli)", id);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_public_keys.erase(id);
+  m_private_keys.erase(id);
+}
+
+void KeyCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_public_keys.clear();
+  m_private_keys.clear();
+}
+
+PKey KeyCache::get(std::unordered_map<ID_t, Entry>& cache, const Key& pem, PKey (*parse)(const Key&)) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = cache.find(pem.getId());
+    if (it != cache.end() && it->second.pem == pem.getKey()) {
+      return it->second.key;
+    }
+  }
+  PKey key = parse(pem);  // parse out of lock
+  if (!key) {
+    ERR("Failed to parse PEM key of [%lli]", pem.getId());
+    return key;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Entry& entry = cache[pem.getId()];
+  entry.pem = pem.getKey();
+  entry.key = key;
+  return key;
+}
+
+}
+
+#endif  // SECURE
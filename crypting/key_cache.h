@@ -0,0 +1,81 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_KEY_CACHE__H__
+#define CHAT_SERVER_KEY_CACHE__H__
+
+#if SECURE
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "api/structures.h"
+#include "includes.h"
+
+namespace secure {
+
+typedef std::shared_ptr<EVP_PKEY> PKey;
+
+PKey parsePublicKey(const Key& public_pem);
+PKey parsePrivateKey(const Key& private_pem);
+
+/**
+ * Keeps PEM keys parsed into ready EVP_PKEY objects, keyed by owner's id.
+ * Entry is re-parsed only when PEM of the same owner has changed, or after
+ * it has been invalidated explicitly. Returned keys remain valid even if
+ * their entry gets invalidated meanwhile.
+ */
+class KeyCache {
+public:
+  KeyCache();
+  virtual ~KeyCache();
+
+  PKey getPublicKey(const Key& public_pem);
+  PKey getPrivateKey(const Key& private_pem);
+  void invalidate(ID_t id);
+  void clear();
+
+private:
+  struct Entry {
+    std::string pem;
+    PKey key;
+  };
+
+  std::unordered_map<ID_t, Entry> m_public_keys;
+  std::unordered_map<ID_t, Entry> m_private_keys;
+  std::mutex m_mutex;
+
+  PKey get(std::unordered_map<ID_t, Entry>& cache, const Key& pem, PKey (*parse)(const Key&));
+};
+
+}
+
+#endif  // SECURE
+
+#endif  // CHAT_SERVER_KEY_CACHE__H__
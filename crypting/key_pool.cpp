@@ -0,0 +1,106 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include "key_pool.h"
+#include "logger.h"
+#include "random_util.h"
+
+namespace secure {
+
+KeyPool::KeyPool(size_t capacity)
+  : m_demand(capacity)
+  , m_waiting(0)
+  , m_is_stopped(false) {
+  m_generator = std::thread(&KeyPool::generatorThread, this);
+}
+
+KeyPool::~KeyPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_is_stopped = true;
+  }
+  m_demand_cv.notify_all();
+  if (m_generator.joinable()) {
+    m_generator.join();  // waits for key pair being generated, only if requested and not taken yet
+  }
+}
+
+std::pair<Key, Key> KeyPool::take(ID_t id) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  ++m_waiting;
+  if (m_pool.size() + m_demand < m_waiting) {  // no key pair left or on the way for this caller
+    WRN("Key pool is empty, waiting for key pair to be generated");
+    ++m_demand;
+    m_demand_cv.notify_one();
+  }
+  m_ready_cv.wait(lock, [this](){ return !this->m_pool.empty(); });
+  --m_waiting;
+  auto keypair = m_pool.front();
+  m_pool.pop_front();
+  lock.unlock();
+  return std::make_pair(Key(id, keypair.first.getKey()), Key(id, keypair.second.getKey()));
+}
+
+size_t KeyPool::getAvailableCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pool.size();
+}
+
+void KeyPool::generatorThread() {
+  INF("Key pool generator has started");
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_is_stopped) {
+    if (m_demand == 0) {
+      m_demand_cv.wait(lock, [this](){ return this->m_is_stopped || this->m_demand > 0; });
+      continue;
+    }
+    lock.unlock();
+    auto keypair = random::generateKeyPair(UNKNOWN_ID);  // slow part, out of lock
+    lock.lock();
+    if (keypair.first == Key::EMPTY) {
+      ERR("Key pool failed to generate key pair, retry");
+      continue;
+    }
+    m_pool.push_back(keypair);
+    --m_demand;
+    m_ready_cv.notify_all();
+  }
+  INF("Key pool generator has finished");
+}
+
+// ----------------------------------------------
+KeyPool& getKeyPool() {
+  static KeyPool pool;
+  return pool;
+}
+
+}
+
+#endif  // SECURE
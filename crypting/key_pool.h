@@ -0,0 +1,83 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_KEY_POOL__H__
+#define CHAT_SERVER_KEY_POOL__H__
+
+#if SECURE
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "api/structures.h"
+
+#define KEY_POOL_SIZE 1
+
+namespace secure {
+
+/**
+ * Generates 'capacity' RSA key pairs in advance by background thread, so that
+ * the first takes don't wait for generation. Taken pairs are not refilled:
+ * once the pool is drained, each take() asks the thread for one more pair and
+ * waits for it. Key pairs are kept in memory as PEM and get bound to owner's
+ * id only when taken.
+ */
+class KeyPool {
+public:
+  KeyPool(size_t capacity = KEY_POOL_SIZE);
+  virtual ~KeyPool();
+
+  std::pair<Key, Key> take(ID_t id);
+  size_t getAvailableCount() const;
+
+private:
+  size_t m_demand;   // key pairs yet to be generated, including the one in progress
+  size_t m_waiting;  // callers of take() waiting for key pair
+  bool m_is_stopped;
+  std::deque<std::pair<Key, Key>> m_pool;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_demand_cv;  // key pair has been requested
+  std::condition_variable m_ready_cv;   // key pair has been generated
+  std::thread m_generator;
+
+  void generatorThread();
+
+  KeyPool(const KeyPool& obj) = delete;
+  KeyPool& operator = (const KeyPool& rhs) = delete;
+};
+
+/* Process-wide pool, starts generating on first call */
+KeyPool& getKeyPool();
+
+}
+
+#endif  // SECURE
+
+#endif  // CHAT_SERVER_KEY_POOL__H__
@@ -28,34 +28,53 @@
 
 #if SECURE
 
-#include <climits>
-#include <cstdlib>
+#include <fstream>
+#include <iostream>
 #include <cstring>
-#include <ctime>
 #include "common.h"
+#include "exception.h"
 #include "includes.h"
+#include "key_pool.h"
 #include "logger.h"
 #include "random_util.h"
 
 namespace secure {
 namespace random {
 
-int setRandomSeed() {
-  auto current = time(nullptr);
-  srand(current % INT_MAX + 1);
+static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+static unsigned char nextRandomByte() {
+  static thread_local unsigned char buffer[RANDOM_BUFFER_SIZE];
+  static thread_local size_t position = RANDOM_BUFFER_SIZE;
+  if (position == RANDOM_BUFFER_SIZE) {
+    if (RAND_bytes(buffer, RANDOM_BUFFER_SIZE) != 1) {
+      FAT("Failed to obtain random bytes");
+      throw RuntimeException();
+    }
+    position = 0;
+  }
+  unsigned char byte = buffer[position];
+  buffer[position++] = 0;  // don't keep used bytes around
+  return byte;
 }
 
-static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+void generateBytes(unsigned char* output, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    output[i] = nextRandomByte();
+  }
+}
 
 std::string generateString(int length) {
-  setRandomSeed();
-  char* s = new char[length + 1];
+  const unsigned char alphabet_size = sizeof(alphanum) - 1;
+  const unsigned char limit = 256 / alphabet_size * alphabet_size;  // reject to keep distribution uniform
+  std::string result(length, '0');
   for (int i = 0; i < length; ++i) {
-    s[i] = alphanum[rand() % (sizeof(alphanum) - 1)];
+    unsigned char byte = 0;
+    do {
+      byte = nextRandomByte();
+    } while (byte >= limit);
+    result[i] = alphanum[byte % alphabet_size];
   }
-  s[length] = '\0';
-  std::string result = std::string(s);
-  delete [] s;
   return result;
 }
 
@@ -99,6 +118,56 @@ void generateKeyPair(ID_t id, const char* input, size_t size) {
     BN_free(exponent);
 }
 
+static std::string writeToString(RSA* rsa, bool is_public) {
+  std::string pem;
+  BIO* bio = BIO_new(BIO_s_mem());
+  int result = is_public ? PEM_write_bio_RSAPublicKey(bio, rsa)
+                         : PEM_write_bio_RSAPrivateKey(bio, rsa, nullptr, nullptr, 0, nullptr, nullptr);
+  if (result == 1) {
+    char* data = nullptr;
+    long length = BIO_get_mem_data(bio, &data);
+    pem.assign(data, length);
+  }
+  BIO_free_all(bio);
+  return pem;
+}
+
+std::pair<Key, Key> generateKeyPair(ID_t id) {
+  std::string public_pem, private_pem;
+  RSA* rsa = RSA_new();
+  BIGNUM* exponent = BN_new();
+  if (BN_set_word(exponent, RSA_F4) == 1 &&
+      RSA_generate_key_ex(rsa, KEY_SIZE_BITS, exponent, nullptr) == 1) {
+    public_pem = writeToString(rsa, true);
+    private_pem = writeToString(rsa, false);
+  }
+  RSA_free(rsa);
+  BN_free(exponent);
+
+  if (public_pem.empty() || private_pem.empty()) {
+    char error_buffer[ERROR_BUFFER_SIZE];
+    ERR_error_string_n(ERR_get_error(), error_buffer, ERROR_BUFFER_SIZE);
+    ERR("Error during key generation: %s", error_buffer);
+    return std::make_pair(Key::EMPTY, Key::EMPTY);
+  }
+  return std::make_pair(Key(id, public_pem), Key(id, private_pem));
+}
+
+bool storeKeyPair(const std::pair<Key, Key>& keypair) {
+  ID_t id = keypair.first.getId();
+  std::string public_key_filename = common::createFilenameWithId(id, PUBLIC_KEY_FILE);
+  std::string private_key_filename = common::createFilenameWithId(id, PRIVATE_KEY_FILE);
+  std::ofstream public_file(public_key_filename, std::ios::out | std::ios::trunc);
+  std::ofstream private_file(private_key_filename, std::ios::out | std::ios::trunc);
+  if (!public_file.is_open() || !private_file.is_open()) {
+    ERR("Failed to store key pair of [%lli]", id);
+    return false;
+  }
+  public_file << keypair.first.getKey();
+  private_file << keypair.second.getKey();
+  return public_file.good() && private_file.good();
+}
+
 std::pair<Key, Key> loadKeyPair(ID_t id, bool* accessible) {
   std::string public_key_str, private_key_str;
   std::string public_key_filename = common::createFilenameWithId(id, PUBLIC_KEY_FILE);
@@ -135,10 +204,8 @@ std::pair<Key, Key> getKeyPair(ID_t id) {
   bool accessible = false;
   auto keypair = secure::random::loadKeyPair(id, &accessible);
   if (!accessible) {
-    const size_t size = 80;
-    std::string input = secure::random::generateString(size);
-    secure::random::generateKeyPair(id, input.c_str(), size);
-    keypair = secure::random::loadKeyPair(id, &accessible);
+    keypair = getKeyPool().take(id);
+    storeKeyPair(keypair);
   }
   return keypair;
 }
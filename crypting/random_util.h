@@ -33,6 +33,7 @@
 
 #define PUBLIC_KEY_FILE "public.pem"
 #define PRIVATE_KEY_FILE "private.pem"
+#define RANDOM_BUFFER_SIZE 256
 
 #include <string>
 #include "api/structures.h"
@@ -40,11 +41,16 @@
 namespace secure {
 namespace random {
 
-int setRandomSeed();
-
+/* Take bytes from per-thread buffer filled by CSPRNG */
+void generateBytes(unsigned char* output, size_t size);
 std::string generateString(int length);
+
 void generateKeyPair(ID_t id, const char* input, size_t size);
+std::pair<Key, Key> generateKeyPair(ID_t id);  // in memory, PEM
+bool storeKeyPair(const std::pair<Key, Key>& keypair);
 std::pair<Key, Key> loadKeyPair(ID_t id, bool* accessible);
+
+/* Loads key pair from files, or takes pre-generated one from KeyPool and stores it */
 std::pair<Key, Key> getKeyPair(ID_t id);
 
 }
@@ -28,10 +28,13 @@
 
 #if SECURE
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 #include "rsa_cryptor.h"
 #include "common.h"
+#include "context_pool.h"
 #include "logger.h"
 
 // @see https://wiki.openssl.org/index.php/EVP_Asymmetric_Encryption_and_Decryption_of_an_Envelope
@@ -42,16 +45,30 @@ namespace secure {
 RSACryptorRaw::RSACryptorRaw()
   : m_rsa(RSA_new())
   , m_keypair(EVP_PKEY_new())
-  , m_ek(nullptr)
-  , m_iv(nullptr)
   , m_ek_len(0)
   , m_iv_len(EVP_MAX_IV_LENGTH) {
 }
 
 RSACryptorRaw::~RSACryptorRaw() {
   EVP_PKEY_free(m_keypair);  m_keypair = nullptr;
-  delete [] m_ek;  m_ek = nullptr;
-  delete [] m_iv;  m_iv = nullptr;
+}
+
+void RSACryptorRaw::setEK(int ek_len, unsigned char* ek) {
+  if (ek_len < 0 || ek_len > ENVELOPE_KEY_MAX_LENGTH) {
+    ERR("Envelope key length %i is out of bounds", ek_len);
+    return;
+  }
+  m_ek_len = ek_len;
+  memcpy(m_ek, ek, ek_len);
+}
+
+void RSACryptorRaw::setIV(int iv_len, unsigned char* iv) {
+  if (iv_len < 0 || iv_len > EVP_MAX_IV_LENGTH) {
+    ERR("Initial vector length %i is out of bounds", iv_len);
+    return;
+  }
+  m_iv_len = iv_len;
+  memcpy(m_iv, iv, iv_len);
 }
 
 // @see http://stackoverflow.com/questions/17400058/how-to-use-openssl-lib-pem-read-to-read-public-private-key-from-a-string
@@ -78,9 +95,9 @@ void RSACryptorRaw::setKeypair(const std::pair<Key, Key>& keypair) {
   }
 
   EVP_PKEY_assign_RSA(m_keypair, m_rsa);
-  int pubkey_len = EVP_PKEY_size(m_keypair);
-  m_ek = new unsigned char[pubkey_len];
-  m_iv = new unsigned char[EVP_MAX_IV_LENGTH];
+  if (EVP_PKEY_size(m_keypair) > ENVELOPE_KEY_MAX_LENGTH) {
+    ERR("Key pair is too large: %i bytes", EVP_PKEY_size(m_keypair));
+  }
 }
 
 int RSACryptorRaw::encrypt(const std::string& source, unsigned char** cipher) {
@@ -104,16 +121,21 @@ int RSACryptorRaw::decrypt(unsigned char* cipher, int cipher_len, unsigned char*
 }
 
 int RSACryptorRaw::doEncrypt(const std::string& source, unsigned char** cipher) {
+  if (EVP_PKEY_size(m_keypair) > ENVELOPE_KEY_MAX_LENGTH) {
+    ERR("Public key is too large: %i bytes", EVP_PKEY_size(m_keypair));
+    return 0;
+  }
+
   int block_len = 0;
   int cipher_len = 0;
+  unsigned char* ek = m_ek;
 
-  EVP_CIPHER_CTX* rsa_enc_ctx = EVP_CIPHER_CTX_new();
-  EVP_SealInit(rsa_enc_ctx, EVP_aes_256_cbc(), &m_ek, &m_ek_len, m_iv, &m_keypair, 1);
-  EVP_SealUpdate(rsa_enc_ctx, *cipher, &block_len, (unsigned char*) source.c_str(), source.length());
+  CipherContext rsa_enc_ctx;
+  EVP_SealInit(rsa_enc_ctx.get(), EVP_aes_256_cbc(), &ek, &m_ek_len, m_iv, &m_keypair, 1);
+  EVP_SealUpdate(rsa_enc_ctx.get(), *cipher, &block_len, (unsigned char*) source.c_str(), source.length());
   cipher_len += block_len;
-  EVP_SealFinal(rsa_enc_ctx, *cipher + cipher_len, &block_len);
+  EVP_SealFinal(rsa_enc_ctx.get(), *cipher + cipher_len, &block_len);
   cipher_len += block_len;
-  EVP_CIPHER_CTX_free(rsa_enc_ctx);
   INF("RSA Cipher length: %i", cipher_len);
   TTY("RSA Cipher[%i]: %.*s", cipher_len, cipher_len, *cipher);
   return cipher_len;
@@ -123,13 +145,12 @@ int RSACryptorRaw::doDecrypt(unsigned char* cipher, int cipher_len, unsigned cha
   int block_len = 0;
   int plain_len = 0;
 
-  EVP_CIPHER_CTX* rsa_dec_ctx = EVP_CIPHER_CTX_new();
-  EVP_OpenInit(rsa_dec_ctx, EVP_aes_256_cbc(), m_ek, m_ek_len, m_iv, m_keypair);
-  EVP_OpenUpdate(rsa_dec_ctx, *plain, &block_len, cipher, cipher_len);
+  CipherContext rsa_dec_ctx;
+  EVP_OpenInit(rsa_dec_ctx.get(), EVP_aes_256_cbc(), m_ek, m_ek_len, m_iv, m_keypair);
+  EVP_OpenUpdate(rsa_dec_ctx.get(), *plain, &block_len, cipher, cipher_len);
   plain_len += block_len;
-  EVP_OpenFinal(rsa_dec_ctx, *plain + plain_len, &block_len);
+  EVP_OpenFinal(rsa_dec_ctx.get(), *plain + plain_len, &block_len);
   plain_len += block_len;
-  EVP_CIPHER_CTX_free(rsa_dec_ctx);
   INF("RSA Plain length: %i", plain_len);
   TTY("RSA Plain[%i]: %.*s", plain_len, plain_len, *plain);
   (*plain)[plain_len] = '\0';
@@ -189,31 +210,14 @@ std::string RSACryptor::encrypt(const std::string& source, const secure::Key& pu
   TRC("encrypt(%s)", source.c_str());
   encrypted = false;
   if (public_key != Key::EMPTY) {
-    DBG("%s", public_key.getKey().c_str());
-    BIO* bio = BIO_new(BIO_s_mem());
-    BIO_write(bio, public_key.getKey().c_str(), public_key.getKey().length());
-    PEM_read_bio_RSAPublicKey(bio, &m_rsa, nullptr, nullptr);
-    BIO_free(bio);
-
-    EVP_PKEY_set1_RSA(m_keypair, m_rsa);
-
-    int pubkey_len = EVP_PKEY_size(m_keypair);
-    if (m_ek != nullptr) { delete [] m_ek;  m_ek = nullptr; }
-    if (m_iv != nullptr) { delete [] m_iv;  m_iv = nullptr; }
-    m_ek = new unsigned char[pubkey_len];
-    m_iv = new unsigned char[EVP_MAX_IV_LENGTH];
-
-    unsigned char* cipher = new unsigned char[source.length() + EVP_MAX_IV_LENGTH];
-    m_cipher_len = RSACryptorRaw::doEncrypt(source, &cipher);
-    if (m_cipher_len > 0) {
+    std::vector<unsigned char> cipher(source.length() + EVP_MAX_IV_LENGTH);
+    int cipher_len = encrypt(source, public_key, &cipher[0]);
+    if (cipher_len > 0) {
       encrypted = true;
-      std::string result = common::bin2hex(cipher, m_cipher_len);
-      delete [] cipher;  cipher = nullptr;
-      return result;
+      return common::bin2hex(&cipher[0], cipher_len);
     } else {
       ERR("Failed to encrypt");
     }
-    delete [] cipher;  cipher = nullptr;
   }
   WRN("Public key wasn't provided, source hasn't been encrypted");
   return source;
@@ -223,39 +227,59 @@ std::string RSACryptor::decrypt(const std::string& source, const secure::Key& pr
   TRC("decrypt(%s)", source.c_str());
   decrypted = false;
   if (private_key != Key::EMPTY) {
-    DBG("%s", private_key.getKey().c_str());
-    BIO* bio = BIO_new(BIO_s_mem());
-    BIO_write(bio, private_key.getKey().c_str(), private_key.getKey().length());
-    PEM_read_bio_RSAPrivateKey(bio, &m_rsa, nullptr, nullptr);
-    BIO_free(bio);
-
-    EVP_PKEY_set1_RSA(m_keypair, m_rsa);
-
-    unsigned char* cipher = new unsigned char[m_cipher_len];
     size_t cipher_len = 0;
-    common::hex2bin(source, cipher, cipher_len);
-    unsigned char* plain = new unsigned char[m_cipher_len + EVP_MAX_IV_LENGTH];
-    int plain_len = RSACryptorRaw::doDecrypt(cipher, m_cipher_len, &plain);
-
-    //RSA_free(m_rsa);  valgrind requires that, but this causes heisen-crashes
-
+    std::vector<unsigned char> cipher(std::max(static_cast<size_t>(m_cipher_len), source.length() / 2 + 1));
+    common::hex2bin(source, &cipher[0], cipher_len);
+    std::vector<unsigned char> plain(m_cipher_len + EVP_MAX_IV_LENGTH);
+    int plain_len = decrypt(&cipher[0], m_cipher_len, private_key, &plain[0]);
     if (plain_len > 0) {
       decrypted = true;
-      std::string result = std::string((const char*) plain);
-      delete [] cipher;  cipher = nullptr;
-      delete [] plain;   plain  = nullptr;
-      return result;
+      return std::string((const char*) &plain[0]);
     } else {
       ERR("Failed to decrypt");
     }
-    delete [] cipher;  cipher = nullptr;
-    delete [] plain;   plain  = nullptr;
   }
   WRN("Private key wasn't provided, source hasn't been decrypted");
   return source;
 }
 
+// ----------------------------------------------
+int RSACryptor::encrypt(const std::string& source, const secure::Key& public_key, unsigned char* cipher) {
+  if (public_key == Key::EMPTY) {
+    WRN("Public key wasn't provided, source hasn't been encrypted");
+    return -1;
+  }
+  DBG("%s", public_key.getKey().c_str());
+  BIO* bio = BIO_new(BIO_s_mem());
+  BIO_write(bio, public_key.getKey().c_str(), public_key.getKey().length());
+  PEM_read_bio_RSAPublicKey(bio, &m_rsa, nullptr, nullptr);
+  BIO_free(bio);
+
+  EVP_PKEY_set1_RSA(m_keypair, m_rsa);
+
+  m_cipher_len = RSACryptorRaw::doEncrypt(source, &cipher);
+  return m_cipher_len > 0 ? m_cipher_len : -1;
 }
 
-#endif  // SECURE
+int RSACryptor::decrypt(const unsigned char* cipher, int cipher_len, const secure::Key& private_key, unsigned char* plain) {
+  if (private_key == Key::EMPTY) {
+    WRN("Private key wasn't provided, source hasn't been decrypted");
+    return -1;
+  }
+  DBG("%s", private_key.getKey().c_str());
+  BIO* bio = BIO_new(BIO_s_mem());
+  BIO_write(bio, private_key.getKey().c_str(), private_key.getKey().length());
+  PEM_read_bio_RSAPrivateKey(bio, &m_rsa, nullptr, nullptr);
+  BIO_free(bio);
+
+  EVP_PKEY_set1_RSA(m_keypair, m_rsa);
+
+  //RSA_free(m_rsa);  valgrind requires that, but this causes heisen-crashes
 
+  int plain_len = RSACryptorRaw::doDecrypt(const_cast<unsigned char*>(cipher), cipher_len, &plain);
+  return plain_len > 0 ? plain_len : -1;
+}
+
+}
+
+#endif  // SECURE
@@ -32,6 +32,7 @@
 #if SECURE
 
 #include <string>
+#include <cstring>
 #include "api/icryptor.h"
 #include "includes.h"
 
@@ -57,24 +58,14 @@ public:
   void getEK(unsigned char* ek) const { memcpy(ek, m_ek, m_ek_len); }
   void getIV(unsigned char* iv) const { memcpy(iv, m_iv, m_iv_len); }
 
-  void setEK(int ek_len, unsigned char* ek) {
-    if (m_ek != nullptr) { delete [] m_ek;  m_ek = nullptr; }
-    m_ek = new unsigned char[ek_len];
-    m_ek_len = ek_len;
-    memcpy(m_ek, ek, ek_len);
-  }
-  void setIV(int iv_len, unsigned char* iv) {
-    if (m_iv != nullptr) { delete [] m_iv;  m_iv = nullptr; }
-    m_iv = new unsigned char[iv_len];
-    m_iv_len = iv_len;
-    memcpy(m_iv, iv, iv_len);
-  }
+  void setEK(int ek_len, unsigned char* ek);
+  void setIV(int iv_len, unsigned char* iv);
 
 protected:
   RSA* m_rsa;
   EVP_PKEY* m_keypair;
-  unsigned char* m_ek;
-  unsigned char* m_iv;
+  unsigned char m_ek[ENVELOPE_KEY_MAX_LENGTH];
+  unsigned char m_iv[EVP_MAX_IV_LENGTH];
   int m_ek_len;
   int m_iv_len;
 
@@ -108,6 +99,8 @@ public:
 
   std::string encrypt(const std::string& source, const secure::Key& public_key, bool& encrypted) override;
   std::string decrypt(const std::string& source, const secure::Key& private_key, bool& decrypted) override;
+  int encrypt(const std::string& source, const secure::Key& public_key, unsigned char* cipher) override;
+  int decrypt(const unsigned char* cipher, int cipher_len, const secure::Key& private_key, unsigned char* plain) override;
 
   int getEKlength() const override { return RSACryptorRaw::getEKlength(); }
   int getIVlength() const override { return RSACryptorRaw::getIVlength(); }
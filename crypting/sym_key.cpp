@@ -35,10 +35,7 @@
 namespace secure {
 
 SymmetricKey::SymmetricKey() {
-  random::setRandomSeed();
-  int length = rand() % 71 + 10;
-  std::string source = random::generateString(length);
-  generate(source);
+  random::generateBytes(key, KEY_LENGTH);
 }
 
 SymmetricKey::SymmetricKey(unsigned char* i_key) {
@@ -0,0 +1,263 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <openssl/err.h>
+#include "includes.h"
+#include "logger.h"
+#include "tls_terminator.h"
+
+#define TLS_SESSION_ID_CONTEXT "chat-server"
+
+namespace secure {
+
+static void logError(const char* what) {
+  char error_buffer[ERROR_BUFFER_SIZE];
+  ERR_error_string_n(ERR_get_error(), error_buffer, ERROR_BUFFER_SIZE);
+  fprintf(stderr, "%s: %s\n", what, error_buffer);
+}
+
+/* Waits for socket to become ready as SSL wants, false on timeout or error */
+static bool waitFor(int socket, int error, int timeout) {
+  pollfd descriptor;
+  descriptor.fd = socket;
+  descriptor.events = error == SSL_ERROR_WANT_WRITE ? POLLOUT : POLLIN;
+  descriptor.revents = 0;
+  return poll(&descriptor, 1, timeout) > 0;
+}
+
+TlsTerminator::TlsTerminator()
+  : m_context(nullptr)
+  , m_full_handshakes(0)
+  , m_resumed_handshakes(0)
+  , m_kernel_offloaded(0) {
+}
+
+TlsTerminator::~TlsTerminator() {
+  m_connections.clear();
+  SSL_CTX_free(m_context);
+}
+
+bool TlsTerminator::init(const std::string& cert_file, const std::string& key_file) {
+  SSL_CTX* context = SSL_CTX_new(TLS_server_method());
+  if (context == nullptr) {
+    logError("Failed to create TLS context");
+    return false;
+  }
+  SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+  if (SSL_CTX_use_certificate_chain_file(context, cert_file.c_str()) != 1 ||
+      SSL_CTX_use_PrivateKey_file(context, key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+      SSL_CTX_check_private_key(context) != 1) {
+    logError("Failed to load TLS certificate or key");
+    SSL_CTX_free(context);
+    return false;
+  }
+
+  // resumption: stateful cache for TLS 1.2 session ids, tickets for the rest
+  SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_sess_set_cache_size(context, TLS_SESSION_CACHE_SIZE);
+  SSL_CTX_set_timeout(context, TLS_SESSION_TIMEOUT);
+  SSL_CTX_set_session_id_context(context, (const unsigned char*) TLS_SESSION_ID_CONTEXT, sizeof(TLS_SESSION_ID_CONTEXT) - 1);
+#if !USE_BORINGSSL
+  SSL_CTX_set_num_tickets(context, TLS_TICKETS_COUNT);
+#endif  // USE_BORINGSSL
+#ifdef SSL_OP_ENABLE_KTLS
+  SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);  // used only if kernel has 'tls' module
+#endif  // SSL_OP_ENABLE_KTLS
+  SSL_CTX_set_mode(context, SSL_MODE_RELEASE_BUFFERS);  // idle connections don't hold 34 KB of buffers
+  SSL_CTX_set_mode(context, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);  // see writeSome()
+
+  m_context = context;
+  INF("TLS termination enabled with certificate: %s", cert_file.c_str());
+  return true;
+}
+
+bool TlsTerminator::accept(int socket) {
+  SSL* ssl = SSL_new(m_context);
+  if (ssl == nullptr || SSL_set_fd(ssl, socket) != 1) {
+    logError("Failed to create TLS connection");
+    SSL_free(ssl);
+    return false;
+  }
+  int flags = fcntl(socket, F_GETFL, 0);
+  fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TLS_HANDSHAKE_TIMEOUT);
+  int result = 0;
+  while ((result = SSL_accept(ssl)) != 1) {
+    int error = SSL_get_error(ssl, result);
+    int left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    if ((error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) || left <= 0 || !waitFor(socket, error, left)) {
+      WRN("TLS handshake failed on socket %i, error %i", socket, error);
+      ERR_clear_error();
+      SSL_free(ssl);
+      return false;
+    }
+  }
+
+  if (SSL_session_reused(ssl)) {
+    ++m_resumed_handshakes;
+  } else {
+    ++m_full_handshakes;
+  }
+#ifdef SSL_OP_ENABLE_KTLS
+  if (BIO_get_ktls_send(SSL_get_wbio(ssl))) {
+    ++m_kernel_offloaded;
+  }
+#endif  // SSL_OP_ENABLE_KTLS
+  DBG("TLS handshake completed on socket %i: %s, %s", socket, SSL_get_version(ssl), SSL_get_cipher_name(ssl));
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_connections[socket] = std::make_shared<Connection>(ssl);
+  return true;
+}
+
+bool TlsTerminator::isSecure(int socket) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_connections.find(socket) != m_connections.end();
+}
+
+bool TlsTerminator::hasPending(int socket) const {
+  auto connection = get(socket);
+  if (!connection) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(connection->mutex);
+  return SSL_has_pending(connection->ssl) == 1;
+}
+
+int TlsTerminator::read(int socket, char* buffer, int size) {
+  auto connection = get(socket);
+  if (!connection) {
+    return -1;
+  }
+  while (true) {
+    int result = 0, error = SSL_ERROR_NONE;
+    {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      result = SSL_read(connection->ssl, buffer, size);
+      if (result > 0) {
+        return result;
+      }
+      error = SSL_get_error(connection->ssl, result);
+    }
+    if (error == SSL_ERROR_ZERO_RETURN) {
+      return 0;  // close_notify
+    }
+    if ((error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) || !waitFor(socket, error, -1)) {
+      ERR_clear_error();
+      return -1;
+    }
+  }
+}
+
+int TlsTerminator::write(int socket, const char* buffer, int size) {
+  auto connection = get(socket);
+  if (!connection) {
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(connection->mutex);
+  int written = 0;
+  while (written < size) {
+    int result = SSL_write(connection->ssl, buffer + written, size - written);
+    if (result > 0) {
+      written += result;
+      continue;
+    }
+    int error = SSL_get_error(connection->ssl, result);
+    if ((error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) || !waitFor(socket, error, TLS_HANDSHAKE_TIMEOUT)) {
+      ERR_clear_error();
+      return -1;
+    }
+  }
+  return written;
+}
+
+int TlsTerminator::writeSome(int socket, const char* buffer, int size) {
+  auto connection = get(socket);
+  if (!connection) {
+    errno = EBADF;
+    return -1;
+  }
+  std::unique_lock<std::mutex> lock(connection->mutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    errno = EAGAIN;  // busy with other writer
+    return -1;
+  }
+  int written = 0;
+  while (written < size) {
+    int result = SSL_write(connection->ssl, buffer + written, size - written);
+    if (result > 0) {
+      written += result;
+      continue;
+    }
+    int error = SSL_get_error(connection->ssl, result);
+    if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+      ERR_clear_error();
+      errno = EPIPE;
+      return -1;
+    }
+    if (written == 0) {
+      errno = EAGAIN;  // pending record is kept by SSL, retried with the same bytes
+      return -1;
+    }
+    break;
+  }
+  return written;
+}
+
+void TlsTerminator::close(int socket) {
+  std::shared_ptr<Connection> connection;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) {
+      return;
+    }
+    connection = it->second;
+    m_connections.erase(it);
+  }
+  std::lock_guard<std::mutex> lock(connection->mutex);
+  SSL_shutdown(connection->ssl);  // best effort, don't wait for peer's close_notify
+  ERR_clear_error();
+}
+
+std::shared_ptr<TlsTerminator::Connection> TlsTerminator::get(int socket) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_connections.find(socket);
+  return it != m_connections.end() ? it->second : nullptr;
+}
+
+}
+
+#endif  // SECURE
@@ -0,0 +1,104 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_TLS_TERMINATOR__H__
+#define CHAT_SERVER_TLS_TERMINATOR__H__
+
+#if SECURE
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <openssl/ssl.h>
+
+#define TLS_HANDSHAKE_TIMEOUT 5000  // ms
+#define TLS_SESSION_CACHE_SIZE 20000
+#define TLS_SESSION_TIMEOUT 7200  // s
+#define TLS_TICKETS_COUNT 2
+
+namespace secure {
+
+/**
+ * Terminates TLS on accepted sockets, so that Server needs no proxy in front.
+ * Connections are still identified by socket: once handshake has succeeded,
+ * read() and write() replace recv() and send() for that socket. Handshake is
+ * non-blocking and bounded by TLS_HANDSHAKE_TIMEOUT. Returning clients skip
+ * full handshake with session tickets (stateless) or session cache (stateful).
+ * Kernel TLS offload is requested where OpenSSL and the kernel support it.
+ * writeSome() never waits: it returns what went out before socket (or other
+ * writer) would block, the rest must be passed again at the front of next call.
+ */
+class TlsTerminator {
+public:
+  TlsTerminator();
+  virtual ~TlsTerminator();
+
+  bool init(const std::string& cert_file, const std::string& key_file);
+  inline bool isEnabled() const { return m_context != nullptr; }
+
+  bool accept(int socket);
+  bool isSecure(int socket) const;
+  bool hasPending(int socket) const;  // received data already buffered by SSL
+  int read(int socket, char* buffer, int size);         // as recv()
+  int write(int socket, const char* buffer, int size);  // writes all, as send()
+  int writeSome(int socket, const char* buffer, int size);  // as send() with MSG_DONTWAIT
+  void close(int socket);  // sends close_notify, socket itself remains open
+
+  inline uint64_t getFullHandshakesCount() const { return m_full_handshakes.load(); }
+  inline uint64_t getResumedHandshakesCount() const { return m_resumed_handshakes.load(); }
+  inline uint64_t getKernelOffloadedCount() const { return m_kernel_offloaded.load(); }
+
+private:
+  struct Connection {
+    SSL* ssl;
+    std::mutex mutex;  // SSL object must not be used by reader and writers at once
+
+    Connection(SSL* ssl) : ssl(ssl) {}
+    ~Connection() { SSL_free(ssl); }
+  };
+
+  SSL_CTX* m_context;
+  std::unordered_map<int, std::shared_ptr<Connection>> m_connections;
+  mutable std::mutex m_mutex;
+  std::atomic<uint64_t> m_full_handshakes;
+  std::atomic<uint64_t> m_resumed_handshakes;
+  std::atomic<uint64_t> m_kernel_offloaded;
+
+  std::shared_ptr<Connection> get(int socket) const;
+
+  TlsTerminator(const TlsTerminator& obj) = delete;
+  TlsTerminator& operator = (const TlsTerminator& rhs) = delete;
+};
+
+}
+
+#endif  // SECURE
+
+#endif  // CHAT_SERVER_TLS_TERMINATOR__H__
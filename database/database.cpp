@@ -334,17 +334,24 @@ ID_t Database::__read_last_id__(const std::string& i_table_name) {
   return (last_id);
 }
 
-void Database::__drop_table__(const std::string& i_table_name) {
+bool Database::__drop_table__(const std::string& i_table_name) {
   DBG("enter Database::__drop_table__().");
   std::string drop_statement = "DROP TABLE IF EXISTS '";
   drop_statement += i_table_name;
   drop_statement += "';";
   this->__prepare_statement__(drop_statement);
-  sqlite3_step(this->m_db_statement);
+  int result = sqlite3_step(this->m_db_statement);
   this->__finalize__(drop_statement.c_str());
+  if (result != SQLITE_DONE) {
+    ERR("Unable to drop table ["%s"], error code [%i]!",
+        i_table_name.c_str(), result);
+    DBG("exit Database::__drop_table__().");
+    return false;
+  }
   DBG("Table with records ["%s"] has been dropped.",
       i_table_name.c_str());
   DBG("exit Database::__drop_table__().");
+  return true;
 }
 
 void Database::__vacuum__() {
@@ -32,8 +32,8 @@
 
 KeyDTO KeyDTO::EMPTY = KeyDTO(UNKNOWN_ID, "");
 
-KeyDTO::KeyDTO(ID_t id, const std::string& key)
-  : m_id(id), m_key(key) {
+KeyDTO::KeyDTO(ID_t id, const std::string& key, int version)
+  : m_id(id), m_key(key), m_version(version) {
 }
 
 #endif  // SECURE
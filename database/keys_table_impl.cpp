@@ -36,6 +36,7 @@
 
 const char* COLUMN_NAME_SOURCE_ID = D_COLUMN_NAME_SOURCE_ID;
 const char* COLUMN_NAME_KEY = D_COLUMN_NAME_KEY;
+const char* COLUMN_NAME_VERSION = D_COLUMN_NAME_VERSION;
 
 namespace db {
 
@@ -61,8 +62,8 @@ void KeysTable::addKey(ID_t src_id, const KeyDTO& key) {
   INF("enter KeysTable::addKey().");
   std::string insert_statement = "INSERT OR REPLACE INTO '";
   insert_statement += this->m_table_name;
-  insert_statement += "' ('" D_COLUMN_NAME_SOURCE_ID "', '" D_COLUMN_NAME_KEY "')";
-  insert_statement += " VALUES(?1, ?2);";  // "' VALUES(?1, ?2, ?3);";
+  insert_statement += "' ('" D_COLUMN_NAME_SOURCE_ID "', '" D_COLUMN_NAME_KEY "', '" D_COLUMN_NAME_VERSION "')";
+  insert_statement += " VALUES(?1, ?2, ?3);";
   this->__prepare_statement__(insert_statement);
 
   bool accumulate = true;
@@ -81,6 +82,10 @@ void KeysTable::addKey(ID_t src_id, const KeyDTO& key) {
   DBG("Key ["%s"] has been stored in table ["%s"], SQLite database ["%s"].",
       i_key.c_str(), this->m_table_name.c_str(), this->m_db_name.c_str());
 
+  accumulate = accumulate && (sqlite3_bind_int(this->m_db_statement, 3, key.getVersion()) == SQLITE_OK);
+  DBG("Version [%i] has been stored in table ["%s"], SQLite database ["%s"].",
+      key.getVersion(), this->m_table_name.c_str(), this->m_db_name.c_str());
+
   sqlite3_step(this->m_db_statement);
   if (!accumulate) {
     ERR("Error during saving data into table ["%s"], database ["%s"] by statement ["%s"]!",
@@ -141,8 +146,9 @@ KeyDTO KeysTable::getKey(ID_t src_id) {
     const void* raw_key = reinterpret_cast<const char*>(sqlite3_column_text(this->m_db_statement, 2));
     WrappedString key_str(raw_key);
 
-    DBG("Loaded column data: " D_COLUMN_NAME_KEY " ["%s"].", key_str.c_str());
-    key = KeyDTO(src_id, key_str.get());
+    int version = sqlite3_column_int(this->m_db_statement, 3);
+    DBG("Loaded column data: " D_COLUMN_NAME_KEY " ["%s"]; " D_COLUMN_NAME_VERSION " [%i].", key_str.c_str(), version);
+    key = KeyDTO(src_id, key_str.get(), version);
     DBG("Proper key instance has been constructed.");
   } else {
     WRN("Key with src_id [%lli] is missing in table ["%s"] of database %p!",
@@ -157,6 +163,7 @@ KeyDTO KeysTable::getKey(ID_t src_id) {
 void KeysTable::__init__() {
   DBG("enter KeysTable::__init__().");
   Database::__init__();
+  this->__add_version_column__();
   ID_t last_row_id = this->__read_last_id__(this->m_table_name);
   this->m_next_id = last_row_id == 0 ? BASE_ID : last_row_id + 1;
   TRC("Initialization has completed: total rows [%i], last row id [%lli], next_id [%lli].",
@@ -171,6 +178,7 @@ void KeysTable::__create_table__() {
   statement += "('ID' INTEGER PRIMARY KEY AUTOINCREMENT DEFAULT " STR_UNKNOWN_ID ", "
       "'" D_COLUMN_NAME_SOURCE_ID "' INTEGER UNIQUE DEFAULT " STR_UNKNOWN_ID ", "
       "'" D_COLUMN_NAME_KEY "' TEXT, "
+      "'" D_COLUMN_NAME_VERSION "' INTEGER DEFAULT 1, "
       "FOREIGN KEY(" D_COLUMN_NAME_SOURCE_ID ") REFERENCES " D_PEERS_TABLE_NAME "(ID));";
   this->__prepare_statement__(statement);
   sqlite3_step(this->m_db_statement);
@@ -179,6 +187,27 @@ void KeysTable::__create_table__() {
   DBG("exit KeysTable::__create_table__().");
 }
 
+// tables created before key versions were introduced store RSA PEM only
+void KeysTable::__add_version_column__() {
+  DBG("enter KeysTable::__add_version_column__().");
+  std::string check_statement = "SELECT " D_COLUMN_NAME_VERSION " FROM '";
+  check_statement += this->m_table_name;
+  check_statement += "' LIMIT 1;";
+  sqlite3_stmt* statement = nullptr;
+  int result = sqlite3_prepare_v2(this->m_db_handler, check_statement.c_str(), -1, &statement, nullptr);
+  sqlite3_finalize(statement);
+  if (result != SQLITE_OK) {
+    std::string alter_statement = "ALTER TABLE '";
+    alter_statement += this->m_table_name;
+    alter_statement += "' ADD COLUMN '" D_COLUMN_NAME_VERSION "' INTEGER DEFAULT 1;";
+    this->__prepare_statement__(alter_statement);
+    sqlite3_step(this->m_db_statement);
+    this->__finalize__(alter_statement.c_str());
+    DBG("Column ["%s"] has been added to table ["%s"].", COLUMN_NAME_VERSION, this->m_table_name.c_str());
+  }
+  DBG("exit KeysTable::__add_version_column__().");
+}
+
 }
 
 #endif  // SECURE
@@ -37,6 +37,7 @@
 
 #define D_COLUMN_NAME_SOURCE_ID "SourceID"
 #define D_COLUMN_NAME_KEY "Key"
+#define D_COLUMN_NAME_VERSION "Version"
 
 namespace db {
 
@@ -53,6 +54,7 @@ public:
 private:
   void __init__() override;
   void __create_table__() override;
+  void __add_version_column__();
 
   KeysTable(const KeysTable& obj) = delete;
   KeysTable& operator = (const KeysTable& rhs) = delete;
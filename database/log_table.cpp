@@ -26,13 +26,19 @@
  *   Only the original author - Maxim Alov - has right to do any of the above actions.
  */
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <ctime>
 #include "logger.h"
 #include "log_table.h"
 
 #define TABLE_NAME "logs"
+#define PARTITION_PREFIX "logs_"
 #define BASE_ID 1
 
+static const uint64_t MILLIS_IN_DAY = 86400000;
+
 namespace db {
 
 const char* COLUMN_NAME_CONNECTION_ID = D_COLUMN_NAME_CONNECTION_ID;
@@ -59,15 +65,145 @@ LogRecord::LogRecord(
   , m_payload(payload) {
 }
 
-LogTable::LogTable()
-  : Database(TABLE_NAME) {
+static LogRecord readLogRecord(DB_Statement statement) {
+  ID_t connection_id = sqlite3_column_int64(statement, 1);
+  uint64_t launch_timestamp = sqlite3_column_int64(statement, 2);
+  uint64_t timestamp = sqlite3_column_int64(statement, 3);
+  const void* raw_startline = reinterpret_cast<const char*>(sqlite3_column_text(statement, 4));
+  WrappedString startline(raw_startline);
+  const void* raw_headers = reinterpret_cast<const char*>(sqlite3_column_text(statement, 5));
+  WrappedString headers(raw_headers);
+  const void* raw_payload = reinterpret_cast<const char*>(sqlite3_column_text(statement, 6));
+  WrappedString payload(raw_payload);
+
+  DBG("Loaded column data: " D_COLUMN_NAME_CONNECTION_ID " [%lli]; " D_COLUMN_NAME_LAUNCH_TIMESTAMP " [%lu]; " D_COLUMN_NAME_LOG_TIMESTAMP " [%lu]; " D_COLUMN_NAME_START_LINE " ["%s"]; " D_COLUMN_NAME_HEADERS " ["%s"]; " D_COLUMN_NAME_PAYLOAD " ["%s"].",
+       connection_id, launch_timestamp, timestamp, startline.c_str(), headers.c_str(), payload.c_str());
+  return LogRecord(connection_id, launch_timestamp, timestamp, startline.get(), headers.get(), payload.get());
+}
+
+/* Cursor */
+// ----------------------------------------------------------------------------
+LogCursor::LogCursor(
+    LogTable* table,
+    const std::vector<std::string>& partitions,
+    uint64_t from,
+    uint64_t to,
+    ID_t connection_id)
+  : m_table(table)
+  , m_partitions(partitions)
+  , m_partition_index(0)
+  , m_from(from)
+  , m_to(to)
+  , m_connection_id(connection_id)
+  , m_last_timestamp(from)
+  , m_last_id(0)
+  , m_batch_index(0) {
+}
+
+LogCursor::LogCursor(LogCursor&& rval_obj)
+  : m_table(rval_obj.m_table)
+  , m_partitions(std::move(rval_obj.m_partitions))
+  , m_partition_index(rval_obj.m_partition_index)
+  , m_from(rval_obj.m_from)
+  , m_to(rval_obj.m_to)
+  , m_connection_id(rval_obj.m_connection_id)
+  , m_last_timestamp(rval_obj.m_last_timestamp)
+  , m_last_id(rval_obj.m_last_id)
+  , m_batch(std::move(rval_obj.m_batch))
+  , m_batch_index(rval_obj.m_batch_index) {
+  rval_obj.m_table = nullptr;
+}
+
+LogCursor::~LogCursor() {
+  this->m_table = nullptr;
+}
+
+bool LogCursor::next(LogRecord* record) {
+  if (this->m_batch_index >= this->m_batch.size() && !this->__read_batch__()) {
+    return false;
+  }
+  *record = this->m_batch[this->m_batch_index++];
+  return true;
+}
+
+bool LogCursor::__read_batch__() {
+  this->m_batch.clear();
+  this->m_batch_index = 0;
+  if (this->m_table == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(this->m_table->m_mutex);
+  while (this->m_partition_index < this->m_partitions.size()) {
+    const std::string& partition = this->m_partitions[this->m_partition_index];
+    if (this->m_table->m_partitions.find(partition) != this->m_table->m_partitions.end()) {
+      this->__read_partition__(partition);
+    } else {
+      DBG("Partition ["%s"] has been dropped meanwhile, skip it.", partition.c_str());
+    }
+    if (this->m_batch.size() >= LOG_CURSOR_BATCH) {
+      return true;  // partition may have more records
+    }
+    ++this->m_partition_index;  // partition exhausted, proceed to the next one
+    this->m_last_timestamp = this->m_from;
+    this->m_last_id = 0;
+    if (!this->m_batch.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void LogCursor::__read_partition__(const std::string& partition) {
+  // continue right after the last record read, records are ordered by (timestamp, id)
+  std::string select_statement = "SELECT * FROM '";
+  select_statement += partition;
+  select_statement += "' WHERE ((" D_COLUMN_NAME_LOG_TIMESTAMP " == ?1 AND ID > ?2) OR " D_COLUMN_NAME_LOG_TIMESTAMP " > ?1)";
+  select_statement += " AND " D_COLUMN_NAME_LOG_TIMESTAMP " <= ?3";
+  if (this->m_connection_id != UNKNOWN_ID) {
+    select_statement += " AND " D_COLUMN_NAME_CONNECTION_ID " == ?4";
+  }
+  select_statement += " ORDER BY " D_COLUMN_NAME_LOG_TIMESTAMP ", ID LIMIT ";
+  select_statement += std::to_string(LOG_CURSOR_BATCH);
+  select_statement += ";";
+
+  DB_Handler handler = this->m_table->m_db_handler;
+  DB_Statement statement = nullptr;
+  int result = sqlite3_prepare_v2(handler, select_statement.c_str(), static_cast<int>(select_statement.length()), &statement, nullptr);
+  bool accumulate = (result == SQLITE_OK);
+  accumulate = accumulate && (sqlite3_bind_int64(statement, 1, this->m_last_timestamp) == SQLITE_OK);
+  accumulate = accumulate && (sqlite3_bind_int64(statement, 2, this->m_last_id) == SQLITE_OK);
+  accumulate = accumulate && (sqlite3_bind_int64(statement, 3, this->m_to) == SQLITE_OK);
+  if (this->m_connection_id != UNKNOWN_ID) {
+    accumulate = accumulate && (sqlite3_bind_int64(statement, 4, this->m_connection_id) == SQLITE_OK);
+  }
+  if (!accumulate) {
+    ERR("Unable to prepare statement ["%s"] for partition ["%s"]!", select_statement.c_str(), partition.c_str());
+    sqlite3_finalize(statement);
+    throw TableException("Unable to prepare statement!", result != SQLITE_OK ? result : SQLITE_ACCUMULATED_PREPARE_ERROR);
+  }
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    this->m_last_id = sqlite3_column_int64(statement, 0);
+    this->m_batch.push_back(readLogRecord(statement));
+    this->m_last_timestamp = this->m_batch.back().getTimestamp();
+  }
+  sqlite3_finalize(statement);
+  TRC("Cursor has read %zu records from partition ["%s"].", this->m_batch.size(), partition.c_str());
+}
+
+/* Table */
+// ----------------------------------------------------------------------------
+LogTable::LogTable(int retention_days)
+  : Database(TABLE_NAME)
+  , m_retention_days(retention_days) {
   INF("enter LogTable constructor.");
   this->__init__();
   INF("exit LogTable constructor.");
 }
 
 LogTable::LogTable(LogTable&& rval_obj)
-  : Database(std::move(static_cast<Database&>(rval_obj))) {
+  : Database(std::move(static_cast<Database&>(rval_obj)))
+  , m_retention_days(rval_obj.m_retention_days)
+  , m_partitions(std::move(rval_obj.m_partitions)) {
 }
 
 LogTable::~LogTable() {
@@ -79,8 +215,14 @@ LogTable::~LogTable() {
 // ----------------------------------------------
 ID_t LogTable::addLog(const LogRecord& log) {
   INF("enter LogTable::addLog().");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::string partition = partitionName(log.getTimestamp());
+  if (this->m_partitions.find(partition) == this->m_partitions.end()) {
+    this->__create_partition__(partition);
+  }
+
   std::string insert_statement = "INSERT INTO '";
-  insert_statement += this->m_table_name;
+  insert_statement += partition;
   insert_statement += "' VALUES(?1, ?2, ?3, ?4, ?5, ?6, ?7);";
   this->__prepare_statement__(insert_statement);
 
@@ -88,40 +230,45 @@ ID_t LogTable::addLog(const LogRecord& log) {
   ID_t log_id = this->m_next_id++;
   accumulate = accumulate && (sqlite3_bind_int64(this->m_db_statement, 1, log_id) == SQLITE_OK);
   DBG("ID [%lli] has been stored in table ["%s"], SQLite database ["%s"].",
-      log_id, this->m_table_name.c_str(), this->m_db_name.c_str());
+      log_id, partition.c_str(), this->m_db_name.c_str());
+
+  ID_t i_connection_id = log.getConnectionId();
+  accumulate = accumulate && (sqlite3_bind_int64(this->m_db_statement, 2, i_connection_id) == SQLITE_OK);
+  DBG("Connection ID [%lli] has been stored in table ["%s"], SQLite database ["%s"].",
+      i_connection_id, partition.c_str(), this->m_db_name.c_str());
 
   uint64_t i_launch_timestamp = log.getLaunchTimestamp();
-  accumulate = accumulate && (sqlite3_bind_int64(this->m_db_statement, 2, i_launch_timestamp) == SQLITE_OK);
+  accumulate = accumulate && (sqlite3_bind_int64(this->m_db_statement, 3, i_launch_timestamp) == SQLITE_OK);
   DBG("Launch timestamp [%lu] has been stored in table ["%s"], SQLite database ["%s"].",
-      i_launch_timestamp, this->m_table_name.c_str(), this->m_db_name.c_str());
+      i_launch_timestamp, partition.c_str(), this->m_db_name.c_str());
 
   uint64_t i_timestamp = log.getTimestamp();
-  accumulate = accumulate && (sqlite3_bind_int64(this->m_db_statement, 3, i_timestamp) == SQLITE_OK);
+  accumulate = accumulate && (sqlite3_bind_int64(this->m_db_statement, 4, i_timestamp) == SQLITE_OK);
   DBG("Timestamp [%lu] has been stored in table ["%s"], SQLite database ["%s"].",
-      i_timestamp, this->m_table_name.c_str(), this->m_db_name.c_str());
+      i_timestamp, partition.c_str(), this->m_db_name.c_str());
 
   WrappedString i_startline = WrappedString(log.getStartLine());
   int startline_n_bytes = i_startline.n_bytes();
-  accumulate = accumulate && (sqlite3_bind_text(this->m_db_statement, 4, i_startline.c_str(), startline_n_bytes, SQLITE_TRANSIENT) == SQLITE_OK);
+  accumulate = accumulate && (sqlite3_bind_text(this->m_db_statement, 5, i_startline.c_str(), startline_n_bytes, SQLITE_TRANSIENT) == SQLITE_OK);
   DBG("Start Line ["%s"] has been stored in table ["%s"], SQLite database ["%s"].",
-      i_startline.c_str(), this->m_table_name.c_str(), this->m_db_name.c_str());
+      i_startline.c_str(), partition.c_str(), this->m_db_name.c_str());
 
   WrappedString i_headers = WrappedString(log.getHeaders());
   int headers_n_bytes = i_headers.n_bytes();
-  accumulate = accumulate && (sqlite3_bind_text(this->m_db_statement, 5, i_headers.c_str(), headers_n_bytes, SQLITE_TRANSIENT) == SQLITE_OK);
+  accumulate = accumulate && (sqlite3_bind_text(this->m_db_statement, 6, i_headers.c_str(), headers_n_bytes, SQLITE_TRANSIENT) == SQLITE_OK);
   DBG("Headers ["%s"] has been stored in table ["%s"], SQLite database ["%s"].",
-      i_headers.c_str(), this->m_table_name.c_str(), this->m_db_name.c_str());
+      i_headers.c_str(), partition.c_str(), this->m_db_name.c_str());
 
   WrappedString i_payload = WrappedString(log.getPayload());
   int payload_n_bytes = i_payload.n_bytes();
-  accumulate = accumulate && (sqlite3_bind_text(this->m_db_statement, 6, i_payload.c_str(), payload_n_bytes, SQLITE_TRANSIENT) == SQLITE_OK);
+  accumulate = accumulate && (sqlite3_bind_text(this->m_db_statement, 7, i_payload.c_str(), payload_n_bytes, SQLITE_TRANSIENT) == SQLITE_OK);
   DBG("Payload ["%s"] has been stored in table ["%s"], SQLite database ["%s"].",
-      i_payload.c_str(), this->m_table_name.c_str(), this->m_db_name.c_str());
+      i_payload.c_str(), partition.c_str(), this->m_db_name.c_str());
 
   sqlite3_step(this->m_db_statement);
   if (!accumulate) {
     ERR("Error during saving data into table ["%s"], database ["%s"] by statement ["%s"]!",
-        this->m_table_name.c_str(), this->m_db_name.c_str(), insert_statement.c_str());
+        partition.c_str(), this->m_db_name.c_str(), insert_statement.c_str());
     this->__finalize_and_throw__(insert_statement.c_str(), SQLITE_ACCUMULATED_PREPARE_ERROR);
   } else {
     DBG("All insertions have succeeded.");
@@ -136,8 +283,15 @@ ID_t LogTable::addLog(const LogRecord& log) {
 // ----------------------------------------------
 void LogTable::removeLog(ID_t id) {
   INF("enter LogTable::removeLog().");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::string partition = this->__find_partition__(id);
+  if (partition.empty()) {
+    WRN("ID [%lli] is missing in all partitions of table ["%s"]!", id, this->m_table_name.c_str());
+    INF("exit LogTable::removeLog().");
+    return;
+  }
   std::string delete_statement = "DELETE FROM '";
-  delete_statement += this->m_table_name;
+  delete_statement += partition;
   delete_statement += "' WHERE ID == '";
   delete_statement += std::to_string(id);
   delete_statement += "';";
@@ -145,24 +299,29 @@ void LogTable::removeLog(ID_t id) {
   sqlite3_step(this->m_db_statement);
   this->__finalize__(delete_statement.c_str());
   this->__decrement_rows__();
-  if (id + 1 == this->m_next_id) {
-    ID_t last_row_id = this->__read_last_id__(this->m_table_name);
-    this->m_next_id = last_row_id + 1;
-    DBG("Deleted log with largest ID. Next ID value is set to [%lli].", this->m_next_id);
-  }
   if (this->__empty__()) {
     DBG("Table ["%s"] has become empty. Next ID value is set to zero.", this->m_table_name.c_str());
     this->m_next_id = BASE_ID;
   }
-  DBG("Deleted log [ID: %lli] in table ["%s"].", id, this->m_table_name.c_str());
+  DBG("Deleted log [ID: %lli] in table ["%s"].", id, partition.c_str());
   INF("exit LogTable::removeLog().");
 }
 
 // ----------------------------------------------
 LogRecord LogTable::getLog(ID_t i_log_id) {
   INF("enter LogTable::getLog().");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  LogRecord log = LogRecord::EMPTY;
+  std::string partition = this->__find_partition__(i_log_id);
+  if (partition.empty()) {
+    WRN("ID [%lli] is missing in table ["%s"] of database %p!",
+        i_log_id, this->m_table_name.c_str(), this->m_db_handler);
+    INF("exit LogTable::getLog().");
+    return (log);
+  }
+
   std::string select_statement = "SELECT * FROM '";
-  select_statement += this->m_table_name;
+  select_statement += partition;
   select_statement += "' WHERE ID == '";
   select_statement += std::to_string(i_log_id);
   select_statement += "';";
@@ -171,47 +330,100 @@ LogRecord LogTable::getLog(ID_t i_log_id) {
   sqlite3_step(this->m_db_statement);
   ID_t id = sqlite3_column_int64(this->m_db_statement, 0);
   DBG("Read id [%lli] from  table ["%s"] of database ["%s"], input id was [%lli].",
-      id, this->m_table_name.c_str(), this->m_db_name.c_str(), i_log_id);
+      id, partition.c_str(), this->m_db_name.c_str(), i_log_id);
   TABLE_ASSERT("Input log id does not equal to primary key value from database!" && id == i_log_id);
 
-  LogRecord log = LogRecord::EMPTY;
-  if (i_log_id != UNKNOWN_ID) {
-    DBG("Read id [%lli] from  table ["%s"] of database ["%s"].",
-        id, this->m_table_name.c_str(), this->m_db_name.c_str());
-
-    ID_t connection_id = sqlite3_column_int64(this->m_db_statement, 1);
-    uint64_t launch_timestamp = sqlite3_column_int64(this->m_db_statement, 2);
-    uint64_t timestamp = sqlite3_column_int64(this->m_db_statement, 3);
-    const void* raw_startline = reinterpret_cast<const char*>(sqlite3_column_text(this->m_db_statement, 4));
-    WrappedString startline(raw_startline);
-    const void* raw_headers = reinterpret_cast<const char*>(sqlite3_column_text(this->m_db_statement, 5));
-    WrappedString headers(raw_headers);
-    const void* raw_payload = reinterpret_cast<const char*>(sqlite3_column_text(this->m_db_statement, 6));
-    WrappedString payload(raw_payload);
-
-    DBG("Loaded column data: " COLUMN_NAME_CONNECTION_ID " [%lli]; " D_COLUMN_NAME_TIMESTAMP " [%lu]; " D_COLUMN_NAME_TIMESTAMP " [%lu]; " D_COLUMN_NAME_START_LINE " ["%s"]; " D_COLUMN_NAME_HEADERS " ["%s"]; " D_COLUMN_NAME_PAYLOAD " ["%s"].",
-         connection_id, launch_timestamp, timestamp, startline.c_str(), headers.c_str(), payload.c_str());
-    log = LogRecord(connection_id, launch_timestamp, timestamp, startline.get(), headers.get(), payload.get());
-    DBG("Proper log instance has been constructed.");
-  } else {
-    WRN("ID [%lli] is missing in table ["%s"] of database %p!",
-        i_log_id, this->m_table_name.c_str(), this->m_db_handler);
-  }
+  log = readLogRecord(this->m_db_statement);
+  DBG("Proper log instance has been constructed.");
 
   this->__finalize__(select_statement.c_str());
   INF("exit LogTable::getLog().");
   return (log);
 }
 
+// ----------------------------------------------
+LogCursor LogTable::getLogs(uint64_t from, uint64_t to, ID_t connection_id) {
+  INF("enter LogTable::getLogs().");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::string first = partitionName(from);
+  std::string last = partitionName(to);
+  std::vector<std::string> partitions;
+  for (auto it = this->m_partitions.lower_bound(first); it != this->m_partitions.end() && *it <= last; ++it) {
+    partitions.push_back(*it);  // only partitions overlapping with the range
+  }
+  DBG("Range [%lu, %lu] covers %zu partitions.", from, to, partitions.size());
+  INF("exit LogTable::getLogs().");
+  return LogCursor(this, partitions, from, to, connection_id);
+}
+
+int LogTable::applyRetention(uint64_t now) {
+  INF("enter LogTable::applyRetention().");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (this->m_retention_days <= 0) {
+    DBG("Retention is disabled, keep all partitions.");
+    INF("exit LogTable::applyRetention().");
+    return 0;
+  }
+  uint64_t span = static_cast<uint64_t>(this->m_retention_days) * MILLIS_IN_DAY;
+  std::string oldest = partitionName(now > span ? now - span : 0);
+
+  int dropped = 0;
+  auto it = this->m_partitions.begin();
+  while (it != this->m_partitions.end() && *it < oldest) {
+    int rows = this->__count_partition__(*it);
+    if (!this->__drop_table__(*it)) {
+      WRN("Partition ["%s"] has not been dropped, retry on next run.", it->c_str());
+      ++it;
+      continue;
+    }
+    this->__decrease_rows__(rows);
+    DBG("Dropped partition ["%s"] with %i rows.", it->c_str(), rows);
+    it = this->m_partitions.erase(it);
+    ++dropped;
+  }
+  if (dropped > 0) {
+    this->__vacuum__();  // give freed pages back to file system
+  }
+  INF("exit LogTable::applyRetention().");
+  return dropped;
+}
+
+// ----------------------------------------------
+std::string LogTable::partitionName(uint64_t timestamp) {
+  time_t seconds = static_cast<time_t>(timestamp / 1000);
+  tm date;
+  gmtime_r(&seconds, &date);
+  char buffer[16];
+  strftime(buffer, sizeof(buffer), "%Y%m%d", &date);
+  return std::string(PARTITION_PREFIX) + buffer;
+}
+
+bool LogTable::dayToRange(const std::string& day, uint64_t* from, uint64_t* to) {
+  tm date;
+  memset(&date, 0, sizeof(date));
+  if (day.length() != 8 || strptime(day.c_str(), "%Y%m%d", &date) == nullptr) {
+    return false;
+  }
+  uint64_t start = static_cast<uint64_t>(timegm(&date)) * 1000;
+  *from = start;
+  *to = start + MILLIS_IN_DAY - 1;
+  return true;
+}
+
 /* Private members */
 // ----------------------------------------------------------------------------
 void LogTable::__init__() {
   DBG("enter LogTable::__init__().");
   Database::__init__();
+  this->__read_partitions__();
   ID_t last_row_id = this->__read_last_id__(this->m_table_name);
+  for (auto& partition : this->m_partitions) {
+    last_row_id = std::max(last_row_id, this->__read_last_id__(partition));
+    this->__increase_rows__(this->__count_partition__(partition));
+  }
   this->m_next_id = last_row_id == 0 ? BASE_ID : last_row_id + 1;
-  TRC("Initialization has completed: total rows [%i], last row id [%lli], next_id [%lli].",
-      this->m_rows, last_row_id, this->m_next_id);
+  TRC("Initialization has completed: total rows [%i], partitions [%zu], last row id [%lli], next_id [%lli].",
+      this->m_rows, this->m_partitions.size(), last_row_id, this->m_next_id);
   DBG("exit LogTable::__init__().");
 }
 
@@ -233,5 +445,90 @@ void LogTable::__create_table__() {
   DBG("exit LogTable::__create_table__().");
 }
 
+void LogTable::__create_partition__(const std::string& partition) {
+  DBG("enter LogTable::__create_partition__().");
+  std::string statement = "CREATE TABLE IF NOT EXISTS '";
+  statement += partition;
+  statement += "'('ID' INTEGER PRIMARY KEY UNIQUE DEFAULT " STR_UNKNOWN_ID ", "
+      "'" D_COLUMN_NAME_CONNECTION_ID "' INTEGER, "
+      "'" D_COLUMN_NAME_LAUNCH_TIMESTAMP "' INTEGER, "
+      "'" D_COLUMN_NAME_LOG_TIMESTAMP "' INTEGER, "
+      "'" D_COLUMN_NAME_START_LINE "' TEXT, "
+      "'" D_COLUMN_NAME_HEADERS "' TEXT, "
+      "'" D_COLUMN_NAME_PAYLOAD "' TEXT);";
+  this->__prepare_statement__(statement);
+  sqlite3_step(this->m_db_statement);
+  this->__finalize__(statement.c_str());
+
+  std::string timestamp_index = "CREATE INDEX IF NOT EXISTS '";
+  timestamp_index += partition;
+  timestamp_index += "_ts' ON '";
+  timestamp_index += partition;
+  timestamp_index += "'(" D_COLUMN_NAME_LOG_TIMESTAMP ");";
+  this->__prepare_statement__(timestamp_index);
+  sqlite3_step(this->m_db_statement);
+  this->__finalize__(timestamp_index.c_str());
+
+  std::string connection_index = "CREATE INDEX IF NOT EXISTS '";
+  connection_index += partition;
+  connection_index += "_conn' ON '";
+  connection_index += partition;
+  connection_index += "'(" D_COLUMN_NAME_CONNECTION_ID ", " D_COLUMN_NAME_LOG_TIMESTAMP ");";
+  this->__prepare_statement__(connection_index);
+  sqlite3_step(this->m_db_statement);
+  this->__finalize__(connection_index.c_str());
+
+  this->m_partitions.insert(partition);
+  DBG("Partition ["%s"] has been successfully created.", partition.c_str());
+  DBG("exit LogTable::__create_partition__().");
 }
 
+void LogTable::__read_partitions__() {
+  DBG("enter LogTable::__read_partitions__().");
+  std::string statement = "SELECT name FROM sqlite_master WHERE type == 'table' AND name GLOB '" PARTITION_PREFIX "[0-9]*';";
+  this->__prepare_statement__(statement);
+  while (sqlite3_step(this->m_db_statement) == SQLITE_ROW) {
+    const void* raw_name = reinterpret_cast<const char*>(sqlite3_column_text(this->m_db_statement, 0));
+    WrappedString name(raw_name);
+    this->m_partitions.insert(name.get());
+  }
+  this->__finalize__(statement.c_str());
+  DBG("Found %zu partitions.", this->m_partitions.size());
+  DBG("exit LogTable::__read_partitions__().");
+}
+
+std::string LogTable::__find_partition__(ID_t id) {
+  DBG("enter LogTable::__find_partition__().");
+  std::vector<std::string> candidates(this->m_partitions.rbegin(), this->m_partitions.rend());
+  candidates.push_back(this->m_table_name);  // records stored before partitioning
+  for (auto& candidate : candidates) {
+    std::string statement = "SELECT EXISTS(SELECT 1 FROM '";
+    statement += candidate;
+    statement += "' WHERE ID == '";
+    statement += std::to_string(id);
+    statement += "');";
+    this->__prepare_statement__(statement);
+    sqlite3_step(this->m_db_statement);
+    bool exists = sqlite3_column_int64(this->m_db_statement, 0) != 0;
+    this->__finalize__(statement.c_str());
+    if (exists) {
+      DBG("exit LogTable::__find_partition__().");
+      return candidate;
+    }
+  }
+  DBG("exit LogTable::__find_partition__().");
+  return "";
+}
+
+int LogTable::__count_partition__(const std::string& partition) {
+  std::string count_statement = "SELECT COUNT(*) FROM '";
+  count_statement += partition;
+  count_statement += "';";
+  this->__prepare_statement__(count_statement);
+  sqlite3_step(this->m_db_statement);
+  int answer = sqlite3_column_int(this->m_db_statement, 0);
+  this->__finalize__(count_statement.c_str());
+  return (answer);
+}
+
+}
@@ -29,7 +29,10 @@
 #ifndef CHAT_SERVER_LOG_TABLE__H__
 #define CHAT_SERVER_LOG_TABLE__H__
 
+#include <mutex>
+#include <set>
 #include <string>
+#include <vector>
 #include "database.h"
 
 #define D_COLUMN_NAME_CONNECTION_ID "ConnectionID"
@@ -39,6 +42,9 @@
 #define D_COLUMN_NAME_HEADERS "Headers"
 #define D_COLUMN_NAME_PAYLOAD "Payload"
 
+#define DEFAULT_LOG_RETENTION_DAYS 7
+#define LOG_CURSOR_BATCH 256
+
 namespace db {
 
 class LogRecord {
@@ -63,10 +69,55 @@ private:
   std::string m_payload;
 };
 
+class LogTable;
+
 // ----------------------------------------------
+/**
+ * Forward-only cursor over log records within a time range, optionally
+ * restricted to a single connection. Records are read in batches of
+ * LOG_CURSOR_BATCH rows from each matching partition, every batch under
+ * the table's lock with no statement left open in between, so a whole day
+ * could be exported without loading it into memory or racing writers.
+ * Partitions dropped by retention meanwhile are skipped. Must not outlive
+ * the table it has been obtained from.
+ */
+class LogCursor {
+public:
+  LogCursor(LogTable* table, const std::vector<std::string>& partitions, uint64_t from, uint64_t to, ID_t connection_id);
+  LogCursor(LogCursor&& rval_obj);
+  virtual ~LogCursor();
+
+  bool next(LogRecord* record);
+
+private:
+  LogTable* m_table;
+  std::vector<std::string> m_partitions;
+  size_t m_partition_index;
+  uint64_t m_from;
+  uint64_t m_to;
+  ID_t m_connection_id;
+  uint64_t m_last_timestamp;  // position of the last record read within current partition
+  ID_t m_last_id;
+  std::vector<LogRecord> m_batch;
+  size_t m_batch_index;
+
+  bool __read_batch__();
+  void __read_partition__(const std::string& partition);
+
+  LogCursor(const LogCursor& obj) = delete;
+  LogCursor& operator = (const LogCursor& rhs) = delete;
+  LogCursor& operator = (LogCursor&& rval_rhs) = delete;
+};
+
+// ----------------------------------------------
+/**
+ * Request logs are stored in per-day partitions 'logs_YYYYMMDD' (UTC day of
+ * record's timestamp), each indexed by timestamp and connection id. Retention
+ * drops whole partitions instead of deleting rows one-by-one.
+ */
 class LogTable : private Database {
 public:
-  LogTable();
+  LogTable(int retention_days = DEFAULT_LOG_RETENTION_DAYS);
   LogTable(LogTable&& rval_obj);
   virtual ~LogTable();
 
@@ -74,9 +125,28 @@ public:
   void removeLog(ID_t id);
   LogRecord getLog(ID_t id);
 
+  LogCursor getLogs(uint64_t from, uint64_t to, ID_t connection_id = UNKNOWN_ID);
+  int applyRetention(uint64_t now);
+
+  inline int getRetentionDays() const { return m_retention_days; }
+  inline void setRetentionDays(int days) { m_retention_days = days; }
+
+  static std::string partitionName(uint64_t timestamp);
+  static bool dayToRange(const std::string& day, uint64_t* from, uint64_t* to);
+
 private:
+  friend class LogCursor;
+
+  int m_retention_days;
+  std::set<std::string> m_partitions;
+  std::mutex m_mutex;
+
   void __init__() override;
   void __create_table__() override;
+  void __create_partition__(const std::string& partition);
+  void __read_partitions__();
+  std::string __find_partition__(ID_t id);
+  int __count_partition__(const std::string& partition);
 
   LogTable(const LogTable& obj) = delete;
   LogTable& operator = (const LogTable& rhs) = delete;
@@ -0,0 +1,152 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include "logger.h"
+#include "message_history.h"
+
+namespace db {
+
+MessageHistory::MessageHistory(MessageJournal* journal, size_t capacity)
+  : m_journal(journal)
+  , m_capacity(capacity) {
+}
+
+MessageHistory::~MessageHistory() {
+  m_journal = nullptr;
+}
+
+// ----------------------------------------------
+uint64_t MessageHistory::append(int channel, uint64_t timestamp, const std::string& json) {
+  Ring* ring = getRing(channel, true);
+  std::lock_guard<std::mutex> lock(ring->mutex);  // keeps order of seqs within channel
+  uint64_t seq = m_journal->append(channel, timestamp, json);
+  if (seq == 0) {
+    return seq;  // not persisted, so not to be served either
+  }
+  Slot& slot = ring->slots[seq % m_capacity];
+  slot.seq = seq;
+  slot.frame = frame(seq, json);
+  if (ring->first_seq == 0) {
+    ring->first_seq = seq;
+  }
+  ring->last_seq = seq;
+  if (ring->last_seq - ring->first_seq + 1 > m_capacity) {
+    ring->first_seq = ring->last_seq - m_capacity + 1;  // oldest frame has been overwritten
+  }
+  return seq;
+}
+
+size_t MessageHistory::read(int channel, uint64_t since_seq, size_t limit, std::string* frames) {
+  limit = std::min(limit, static_cast<size_t>(HISTORY_MAX_LIMIT));
+  const char* delimiter = "";
+  Ring* ring = getRing(channel, false);
+  if (ring == nullptr) {
+    return readFromDisk(channel, &since_seq, limit, frames, &delimiter);  // nothing new since launch
+  }
+
+  size_t total = 0;
+  while (total < limit) {
+    uint64_t first_seq = 0;
+    {
+      std::lock_guard<std::mutex> lock(ring->mutex);
+      first_seq = ring->first_seq;
+      if (first_seq != 0 && since_seq + 1 >= first_seq) {
+        for (uint64_t seq = since_seq + 1; total < limit && seq <= ring->last_seq; ++seq, ++total) {
+          frames->append(delimiter).append(ring->slots[seq % m_capacity].frame);
+          delimiter = ",";
+        }
+        return total;
+      }
+    }
+    // older part of range has already left the ring, it may move on while reading disk,
+    // so continue from the last frame actually read and check the ring again
+    size_t disk_limit = limit - total;
+    if (first_seq != 0) {
+      disk_limit = std::min(disk_limit, static_cast<size_t>(first_seq - 1 - since_seq));
+    }
+    size_t read = readFromDisk(channel, &since_seq, disk_limit, frames, &delimiter);
+    total += read;
+    if (read == 0) {
+      break;  // not on disk either
+    }
+  }
+  return total;
+}
+
+uint64_t MessageHistory::getLastSeq(int channel) {
+  Ring* ring = getRing(channel, false);
+  if (ring != nullptr) {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    return ring->last_seq;
+  }
+  return m_journal->getLastSeq(channel);
+}
+
+int MessageHistory::compact() {
+  return m_journal->compact();
+}
+
+std::string MessageHistory::frame(uint64_t seq, const std::string& json) {
+  std::string frame;
+  frame.reserve(json.length() + 32);
+  frame.append("{\"seq\":").append(std::to_string(seq)).append(",\"message\":").append(json).append("}");
+  return frame;
+}
+
+/* Private */
+// ----------------------------------------------------------------------------
+MessageHistory::Ring* MessageHistory::getRing(int channel, bool create) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_rings.find(channel);
+  if (it != m_rings.end()) {
+    return it->second.get();
+  }
+  if (!create) {
+    return nullptr;
+  }
+  Ring* ring = new Ring();
+  ring->slots.resize(m_capacity);
+  m_rings[channel].reset(ring);
+  DBG("Created history ring for channel [%i]", channel);
+  return ring;
+}
+
+size_t MessageHistory::readFromDisk(int channel, uint64_t* since_seq, size_t limit, std::string* frames, const char** delimiter) {
+  std::vector<SegmentRecord> records;
+  m_journal->read(channel, *since_seq, limit, &records);
+  for (auto& record : records) {
+    frames->append(*delimiter).append(frame(record.getSeq(), record.getPayload()));
+    *delimiter = ",";
+    *since_seq = record.getSeq();
+  }
+  DBG("Read %zu history records of channel [%i] from disk", records.size(), channel);
+  return records.size();
+}
+
+}
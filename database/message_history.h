@@ -0,0 +1,93 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_MESSAGE_HISTORY__H__
+#define CHAT_SERVER_MESSAGE_HISTORY__H__
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "message_journal.h"
+
+#define HISTORY_RING_CAPACITY 1024
+#define HISTORY_DEFAULT_LIMIT 50
+#define HISTORY_MAX_LIMIT 500
+
+namespace db {
+
+/**
+ * Two-tier history of broadcast messages: recent frames of each channel are
+ * kept in fixed-capacity ring buffer already serialized as:
+ *
+ *   {"seq":INT,"message":{...}}
+ *
+ * so pages of recent history are just concatenations of ready frames.
+ * Older ranges fall back to the journal on disk.
+ */
+class MessageHistory {
+public:
+  MessageHistory(MessageJournal* journal, size_t capacity = HISTORY_RING_CAPACITY);
+  virtual ~MessageHistory();
+
+  uint64_t append(int channel, uint64_t timestamp, const std::string& json);
+  size_t read(int channel, uint64_t since_seq, size_t limit, std::string* frames);
+  uint64_t getLastSeq(int channel);
+  int compact();
+
+  static std::string frame(uint64_t seq, const std::string& json);
+
+private:
+  struct Slot {
+    uint64_t seq = 0;
+    std::string frame;
+  };
+
+  struct Ring {
+    std::mutex mutex;
+    std::vector<Slot> slots;
+    uint64_t first_seq = 0;  // oldest seq still in ring
+    uint64_t last_seq = 0;
+  };
+
+  MessageJournal* m_journal;
+  size_t m_capacity;
+  std::unordered_map<int, std::unique_ptr<Ring>> m_rings;
+  std::mutex m_mutex;
+
+  Ring* getRing(int channel, bool create);
+  size_t readFromDisk(int channel, uint64_t* since_seq, size_t limit, std::string* frames, const char** delimiter);  // advances since_seq
+
+  MessageHistory(const MessageHistory& obj) = delete;
+  MessageHistory& operator = (const MessageHistory& rhs) = delete;
+};
+
+}
+
+#endif  // CHAT_SERVER_MESSAGE_HISTORY__H__
@@ -0,0 +1,220 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <dirent.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include "logger.h"
+#include "message_journal.h"
+
+#define SEGMENT_FILENAME_PREFIX "segment_"
+#define SEGMENT_FILENAME_SUFFIX ".log"
+
+namespace db {
+
+MessageJournal::MessageJournal(const std::string& directory, size_t segment_size, int flush_interval)
+  : m_directory(directory)
+  , m_segment_size(segment_size)
+  , m_flush_interval(flush_interval)
+  , m_is_stopped(false)
+  , m_synced_size(SEGMENT_HEADER_SIZE) {
+  INF("enter MessageJournal constructor.");
+  mkdir(m_directory.c_str(), 0755);  // ok if already exists
+  openSegments();
+  if (m_flush_interval > 0) {
+    m_flusher = std::thread(&MessageJournal::flusherThread, this);
+  }
+  INF("exit MessageJournal constructor.");
+}
+
+MessageJournal::~MessageJournal() {
+  INF("enter MessageJournal destructor.");
+  {
+    std::lock_guard<std::mutex> lock(m_flush_mutex);
+    m_is_stopped = true;
+  }
+  m_flush_cv.notify_all();
+  if (m_flusher.joinable()) {
+    m_flusher.join();
+  }
+  flush();
+  INF("exit MessageJournal destructor.");
+}
+
+// ----------------------------------------------
+uint64_t MessageJournal::append(int channel, uint64_t timestamp, const std::string& payload) {
+  if (payload.empty() || Segment::recordSize(payload.length()) + SEGMENT_HEADER_SIZE > m_segment_size) {
+    WRN("Payload of %zu bytes could not be stored in journal", payload.length());
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  uint64_t seq = m_last_seq[channel] + 1;
+  if (!m_segments.back()->append(channel, seq, timestamp, payload.c_str(), payload.length())) {
+    rollSegment();
+    m_segments.back()->append(channel, seq, timestamp, payload.c_str(), payload.length());
+  }
+  m_last_seq[channel] = seq;
+  return seq;
+}
+
+size_t MessageJournal::read(int channel, uint64_t since_seq, size_t limit, std::vector<SegmentRecord>* records) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  size_t total = 0;
+  for (auto& segment : m_segments) {
+    if (total >= limit) {
+      break;
+    }
+    if (segment->getLastSeq(channel) <= since_seq) {
+      continue;  // segment has no newer records on this channel
+    }
+    total += segment->read(channel, since_seq, limit - total, records);
+  }
+  return total;
+}
+
+uint64_t MessageJournal::getLastSeq(int channel) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_last_seq.find(channel);
+  return it != m_last_seq.end() ? it->second : 0;
+}
+
+int MessageJournal::compact(uint64_t retain_per_channel) {
+  INF("enter MessageJournal::compact().");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  int removed = 0;
+  auto it = m_segments.begin();
+  while (it + 1 != m_segments.end()) {  // never touch active segment
+    bool obsolete = true;
+    for (auto& last : (*it)->getLastSeqs()) {
+      if (last.second + retain_per_channel > m_last_seq[last.first]) {
+        obsolete = false;  // segment still holds some recent records
+        break;
+      }
+    }
+    if (obsolete) {
+      DBG("Removing obsolete segment [%" PRIu64 "]", (*it)->getNumber());
+      (*it)->remove();
+      it = m_segments.erase(it);
+      ++removed;
+    } else {
+      ++it;
+    }
+  }
+  INF("exit MessageJournal::compact().");
+  return removed;
+}
+
+void MessageJournal::flush() {
+  std::vector<std::pair<std::shared_ptr<Segment>, size_t>> sealed;
+  std::shared_ptr<Segment> segment;
+  size_t from = 0, to = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_segments.empty()) {
+      return;
+    }
+    sealed.swap(m_sealed);
+    segment = m_segments.back();
+    from = m_synced_size;
+    to = segment->getSize();
+    m_synced_size = to;
+  }
+  // slow part is out of lock, appends proceed
+  for (auto& item : sealed) {
+    item.first->sync(item.second, item.first->getSize());  // sealed segments don't grow anymore
+  }
+  if (to > from) {
+    segment->sync(from, to);
+  }
+}
+
+size_t MessageJournal::getSegmentsCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_segments.size();
+}
+
+/* Private */
+// ----------------------------------------------------------------------------
+void MessageJournal::openSegments() {
+  std::vector<uint64_t> numbers;
+  DIR* dir = opendir(m_directory.c_str());
+  if (dir != nullptr) {
+    dirent* entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+      uint64_t number = 0;
+      if (sscanf(entry->d_name, SEGMENT_FILENAME_PREFIX "%" SCNu64 SEGMENT_FILENAME_SUFFIX, &number) == 1) {
+        numbers.push_back(number);
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(numbers.begin(), numbers.end());
+
+  for (uint64_t number : numbers) {
+    auto segment = std::make_shared<Segment>(segmentFilename(number), number, m_segment_size);
+    for (auto& last : segment->getLastSeqs()) {
+      m_last_seq[last.first] = std::max(m_last_seq[last.first], last.second);
+    }
+    m_segments.push_back(segment);
+  }
+  if (m_segments.empty()) {
+    m_segments.push_back(std::make_shared<Segment>(segmentFilename(0), 0, m_segment_size));
+  }
+  m_synced_size = m_segments.back()->getSize();
+  INF("Journal has opened %zu segments", m_segments.size());
+}
+
+void MessageJournal::rollSegment() {
+  auto& active = m_segments.back();
+  m_sealed.emplace_back(active, m_synced_size);  // flusher will sync its tail
+  uint64_t number = active->getNumber() + 1;
+  m_segments.push_back(std::make_shared<Segment>(segmentFilename(number), number, m_segment_size));
+  m_synced_size = SEGMENT_HEADER_SIZE;
+  DBG("Rolled new active segment [%" PRIu64 "]", number);
+}
+
+void MessageJournal::flusherThread() {
+  INF("Journal flusher has started");
+  std::unique_lock<std::mutex> latch(m_flush_mutex);
+  while (!m_is_stopped) {
+    m_flush_cv.wait_for(latch, std::chrono::milliseconds(m_flush_interval), [this](){ return this->m_is_stopped; });
+    flush();  // group sync: all records appended during interval at once
+  }
+  INF("Journal flusher has finished");
+}
+
+std::string MessageJournal::segmentFilename(uint64_t number) const {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), SEGMENT_FILENAME_PREFIX "%016" PRIu64 SEGMENT_FILENAME_SUFFIX, number);
+  return m_directory + "/" + buffer;
+}
+
+}
@@ -0,0 +1,96 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_MESSAGE_JOURNAL__H__
+#define CHAT_SERVER_MESSAGE_JOURNAL__H__
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "segment.h"
+
+#define JOURNAL_DIRECTORY "journal"
+#define JOURNAL_SEGMENT_SIZE (16 * 1024 * 1024)  // 16 MB
+#define JOURNAL_FLUSH_INTERVAL 20  // ms
+#define JOURNAL_RETAIN_PER_CHANNEL 10000
+
+namespace db {
+
+/**
+ * Append-only history of broadcast messages, split into fixed-size memory
+ * mapped segments. Each channel has its own sequence of message numbers,
+ * starting from 1. Appends only copy record into the active segment, while
+ * background thread syncs dirty pages to disk once per flush interval.
+ */
+class MessageJournal {
+public:
+  MessageJournal(
+      const std::string& directory = JOURNAL_DIRECTORY,
+      size_t segment_size = JOURNAL_SEGMENT_SIZE,
+      int flush_interval = JOURNAL_FLUSH_INTERVAL);
+  virtual ~MessageJournal();
+
+  uint64_t append(int channel, uint64_t timestamp, const std::string& payload);
+  size_t read(int channel, uint64_t since_seq, size_t limit, std::vector<SegmentRecord>* records) const;
+  uint64_t getLastSeq(int channel) const;
+  int compact(uint64_t retain_per_channel = JOURNAL_RETAIN_PER_CHANNEL);
+  void flush();
+
+  size_t getSegmentsCount() const;
+
+private:
+  std::string m_directory;
+  size_t m_segment_size;
+  int m_flush_interval;
+  bool m_is_stopped;
+  std::vector<std::shared_ptr<Segment>> m_segments;  // the last one is active
+  std::unordered_map<int64_t, uint64_t> m_last_seq;
+  size_t m_synced_size;
+  std::vector<std::pair<std::shared_ptr<Segment>, size_t>> m_sealed;  // rolled segments not synced yet, with synced size
+  mutable std::mutex m_mutex;
+  std::mutex m_flush_mutex;
+  std::condition_variable m_flush_cv;
+  std::thread m_flusher;
+
+  void openSegments();
+  void rollSegment();
+  void flusherThread();
+  std::string segmentFilename(uint64_t number) const;
+
+  MessageJournal(const MessageJournal& obj) = delete;
+  MessageJournal& operator = (const MessageJournal& rhs) = delete;
+};
+
+}
+
+#endif  // CHAT_SERVER_MESSAGE_JOURNAL__H__
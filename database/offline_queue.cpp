@@ -0,0 +1,225 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include "logger.h"
+#include "offline_queue.h"
+
+#define SEGMENT_FILENAME_PREFIX "offline_"
+#define SEGMENT_FILENAME_SUFFIX ".log"
+
+namespace db {
+
+OfflineQueue::OfflineQueue(const std::string& directory, size_t segment_size, size_t quota, uint64_t ttl, size_t capacity)
+  : m_directory(directory)
+  , m_segment_size(segment_size)
+  , m_quota(quota)
+  , m_ttl(ttl)
+  , m_capacity(capacity) {
+  INF("enter OfflineQueue constructor.");
+  mkdir(m_directory.c_str(), 0755);  // ok if already exists
+  openSegments();
+  INF("exit OfflineQueue constructor.");
+}
+
+OfflineQueue::~OfflineQueue() {
+  INF("enter OfflineQueue destructor.");
+  INF("exit OfflineQueue destructor.");
+}
+
+// ----------------------------------------------
+bool OfflineQueue::push(ID_t dest_id, uint64_t timestamp, const std::string& frame) {
+  if (dest_id <= 0 || frame.empty() || Segment::recordSize(frame.length()) + SEGMENT_HEADER_SIZE > m_segment_size) {
+    WRN("Frame of %zu bytes to [%lli] could not be queued", frame.length(), dest_id);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_last_seq[dest_id] - m_delivered[dest_id] >= m_quota) {
+    WRN("Offline quota of %zu frames is exhausted for [%lli]", m_quota, dest_id);
+    return false;
+  }
+  auto& active = m_segments.back();
+  if (active->getSize() + Segment::recordSize(frame.length()) > active->getCapacity() &&
+      (m_segments.size() + 1) * m_segment_size > m_capacity) {
+    WRN("Offline queue is full: %zu segments, frame to [%lli] is dropped", m_segments.size(), dest_id);
+    return false;
+  }
+  appendRecord(dest_id, timestamp, frame.c_str(), frame.length());
+  return true;
+}
+
+size_t OfflineQueue::peek(ID_t dest_id, uint64_t timestamp, std::vector<SegmentRecord>* frames, uint64_t* last_seq) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  *last_seq = 0;
+  auto last_it = m_last_seq.find(dest_id);
+  uint64_t delivered = m_delivered[dest_id];
+  if (last_it == m_last_seq.end() || last_it->second <= delivered) {
+    return 0;  // nothing pending
+  }
+  *last_seq = last_it->second;
+  size_t total = 0;
+  std::vector<SegmentRecord> records;
+  for (auto& segment : m_segments) {
+    if (segment->getLastSeq(dest_id) <= delivered) {
+      continue;  // segment has no pending frames for recipient
+    }
+    segment->read(dest_id, delivered, *last_seq - delivered, &records);
+  }
+  for (auto& record : records) {
+    if (record.getTimestamp() + m_ttl >= timestamp) {
+      frames->push_back(std::move(record));
+      ++total;
+    }
+  }
+  DBG("Peeked %zu frames of %zu for [%lli]", total, records.size(), dest_id);
+  return total;
+}
+
+void OfflineQueue::acknowledge(ID_t dest_id, uint64_t last_seq, uint64_t timestamp) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (last_seq <= m_delivered[dest_id]) {
+    return;  // already acknowledged
+  }
+  uint64_t ack = last_seq;
+  appendRecord(-dest_id, timestamp, reinterpret_cast<const char*>(&ack), sizeof(ack));
+  m_delivered[dest_id] = last_seq;
+}
+
+size_t OfflineQueue::pop(ID_t dest_id, uint64_t timestamp, std::vector<SegmentRecord>* frames) {
+  uint64_t last_seq = 0;
+  size_t total = peek(dest_id, timestamp, frames, &last_seq);
+  if (last_seq > 0) {
+    acknowledge(dest_id, last_seq, timestamp);
+  }
+  return total;
+}
+
+size_t OfflineQueue::getPendingCount(ID_t dest_id) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto last_it = m_last_seq.find(dest_id);
+  auto delivered_it = m_delivered.find(dest_id);
+  uint64_t last_seq = last_it != m_last_seq.end() ? last_it->second : 0;
+  uint64_t delivered = delivered_it != m_delivered.end() ? delivered_it->second : 0;
+  return last_seq - delivered;
+}
+
+int OfflineQueue::compact(uint64_t timestamp) {
+  INF("enter OfflineQueue::compact().");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  int removed = 0;
+  // only the head is dropped: acknowledgements always follow frames they cover
+  while (m_segments.size() > 1) {
+    auto& segment = m_segments.front();
+    bool expired = segment->getLastTimestamp() + m_ttl < timestamp;
+    bool obsolete = true;
+    for (auto& last : segment->getLastSeqs()) {
+      if (!expired && last.first > 0 && last.second > m_delivered[last.first]) {
+        obsolete = false;  // segment still holds pending frames
+        break;
+      }
+    }
+    if (!obsolete) {
+      break;
+    }
+    DBG("Removing obsolete offline segment [%" PRIu64 "]", segment->getNumber());
+    segment->remove();
+    m_segments.erase(m_segments.begin());
+    ++removed;
+  }
+  INF("exit OfflineQueue::compact().");
+  return removed;
+}
+
+/* Private */
+// ----------------------------------------------------------------------------
+void OfflineQueue::openSegments() {
+  std::vector<uint64_t> numbers;
+  DIR* dir = opendir(m_directory.c_str());
+  if (dir != nullptr) {
+    dirent* entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+      uint64_t number = 0;
+      if (sscanf(entry->d_name, SEGMENT_FILENAME_PREFIX "%" SCNu64 SEGMENT_FILENAME_SUFFIX, &number) == 1) {
+        numbers.push_back(number);
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(numbers.begin(), numbers.end());
+
+  for (uint64_t number : numbers) {
+    auto segment = std::make_shared<Segment>(segmentFilename(number), number, m_segment_size);
+    for (auto& last : segment->getLastSeqs()) {
+      m_last_seq[last.first] = std::max(m_last_seq[last.first], last.second);
+      if (last.first < 0) {  // restore delivery cursor from the latest acknowledgement
+        std::vector<SegmentRecord> acks;
+        segment->read(last.first, last.second - 1, 1, &acks);
+        if (!acks.empty() && acks[0].getPayload().length() == sizeof(uint64_t)) {
+          uint64_t ack = 0;
+          memcpy(&ack, acks[0].getPayload().c_str(), sizeof(ack));
+          m_delivered[-last.first] = std::max(m_delivered[-last.first], ack);
+        }
+      }
+    }
+    m_segments.push_back(segment);
+  }
+  for (auto& delivered : m_delivered) {  // frames could have been compacted, but not their acknowledgement
+    m_last_seq[delivered.first] = std::max(m_last_seq[delivered.first], delivered.second);
+  }
+  if (m_segments.empty()) {
+    m_segments.push_back(std::make_shared<Segment>(segmentFilename(0), 0, m_segment_size));
+  }
+  INF("Offline queue has opened %zu segments", m_segments.size());
+}
+
+void OfflineQueue::appendRecord(int64_t key, uint64_t timestamp, const char* payload, size_t length) {
+  uint64_t seq = m_last_seq[key] + 1;
+  size_t from = m_segments.back()->getSize();
+  if (!m_segments.back()->append(key, seq, timestamp, payload, length)) {
+    uint64_t number = m_segments.back()->getNumber() + 1;
+    m_segments.push_back(std::make_shared<Segment>(segmentFilename(number), number, m_segment_size));
+    DBG("Rolled new active offline segment [%" PRIu64 "]", number);
+    from = m_segments.back()->getSize();
+    m_segments.back()->append(key, seq, timestamp, payload, length);
+  }
+  m_segments.back()->sync(from, m_segments.back()->getSize());  // rare and must survive restart
+  m_last_seq[key] = seq;
+}
+
+std::string OfflineQueue::segmentFilename(uint64_t number) const {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), SEGMENT_FILENAME_PREFIX "%016" PRIu64 SEGMENT_FILENAME_SUFFIX, number);
+  return m_directory + "/" + buffer;
+}
+
+}
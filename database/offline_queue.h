@@ -0,0 +1,103 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_OFFLINE_QUEUE__H__
+#define CHAT_SERVER_OFFLINE_QUEUE__H__
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "segment.h"
+
+#define OFFLINE_DIRECTORY "offline"
+#define OFFLINE_SEGMENT_SIZE (4 * 1024 * 1024)  // 4 MB
+#define OFFLINE_QUOTA_PER_PEER 256  // pending messages
+#define OFFLINE_TTL (7ULL * 24 * 3600 * 1000)  // in ms, 7 days
+#define OFFLINE_CAPACITY (256 * 1024 * 1024)  // 256 MB of segments for all recipients
+
+namespace db {
+
+/**
+ * Store-and-forward queue of dedicated messages for peers being offline.
+ * Ready-to-send frames are appended into memory mapped segments, keyed by
+ * recipient's id. Delivery appends acknowledgement record, keyed by negated
+ * recipient's id and holding the last delivered seq, so the same frames are
+ * not delivered twice after restart.
+ *
+ * Each recipient could have at most 'quota' pending frames; frames older
+ * than 'ttl' are never delivered. Segments are dropped from the head once
+ * all their frames have been delivered or expired, and all of them could
+ * take at most 'capacity' bytes.
+ *
+ * Frames are read with peek() and stay pending until acknowledge() is called
+ * after they have been actually sent.
+ */
+class OfflineQueue {
+public:
+  OfflineQueue(
+      const std::string& directory = OFFLINE_DIRECTORY,
+      size_t segment_size = OFFLINE_SEGMENT_SIZE,
+      size_t quota = OFFLINE_QUOTA_PER_PEER,
+      uint64_t ttl = OFFLINE_TTL,
+      size_t capacity = OFFLINE_CAPACITY);
+  virtual ~OfflineQueue();
+
+  bool push(ID_t dest_id, uint64_t timestamp, const std::string& frame);
+  /* Frames not yet expired, 'last_seq' is to be acknowledged, 0 if nothing is pending */
+  size_t peek(ID_t dest_id, uint64_t timestamp, std::vector<SegmentRecord>* frames, uint64_t* last_seq);
+  void acknowledge(ID_t dest_id, uint64_t last_seq, uint64_t timestamp);
+  size_t pop(ID_t dest_id, uint64_t timestamp, std::vector<SegmentRecord>* frames);  // peek and acknowledge
+  size_t getPendingCount(ID_t dest_id) const;
+  int compact(uint64_t timestamp);
+
+  inline size_t getSegmentsCount() const { return m_segments.size(); }
+
+private:
+  std::string m_directory;
+  size_t m_segment_size;
+  size_t m_quota;
+  uint64_t m_ttl;
+  size_t m_capacity;
+  std::vector<std::shared_ptr<Segment>> m_segments;  // the last one is active
+  std::unordered_map<int64_t, uint64_t> m_last_seq;   // by recipient and by acknowledgement key
+  std::unordered_map<int64_t, uint64_t> m_delivered;  // by recipient
+  mutable std::mutex m_mutex;
+
+  void openSegments();
+  void appendRecord(int64_t key, uint64_t timestamp, const char* payload, size_t length);
+  std::string segmentFilename(uint64_t number) const;
+
+  OfflineQueue(const OfflineQueue& obj) = delete;
+  OfflineQueue& operator = (const OfflineQueue& rhs) = delete;
+};
+
+}
+
+#endif  // CHAT_SERVER_OFFLINE_QUEUE__H__
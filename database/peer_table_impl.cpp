@@ -138,6 +138,21 @@ PeerDTO PeerTable::getPeerByEmail(const std::string& email, ID_t* id) {
   return getPeerBySymbolic(COLUMN_NAME_EMAIL, email, id);
 }
 
+// ----------------------------------------------
+bool PeerTable::hasPeer(ID_t id) {
+  TRC("hasPeer(%lli)", id);
+  std::string select_statement = "SELECT EXISTS(SELECT * FROM '";
+  select_statement += this->m_table_name;
+  select_statement += "' WHERE ID == '";
+  select_statement += std::to_string(id);
+  select_statement += "');";
+  this->__prepare_statement__(select_statement);
+  sqlite3_step(this->m_db_statement);
+  bool exists = sqlite3_column_int64(this->m_db_statement, 0) != 0;
+  this->__finalize__(select_statement.c_str());
+  return exists;
+}
+
 /* Private members */
 // ----------------------------------------------------------------------------
 PeerDTO PeerTable::getPeerBySymbolic(
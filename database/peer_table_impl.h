@@ -49,6 +49,7 @@ public:
   void removePeer(ID_t id) override;
   PeerDTO getPeerByLogin(const std::string& login, ID_t* id) override;
   PeerDTO getPeerByEmail(const std::string& email, ID_t* id) override;
+  bool hasPeer(ID_t id) override;
 
 private:
   PeerDTO getPeerBySymbolic(
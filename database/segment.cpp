@@ -0,0 +1,214 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "exception.h"
+#include "logger.h"
+#include "segment.h"
+
+static const char SEGMENT_MAGIC[8] = {'C', 'H', 'S', 'E', 'G', 'M', 'N', 'T'};
+static_assert(SEGMENT_HEADER_SIZE % alignof(db::RecordHeader) == 0, "First record must be aligned");
+
+namespace db {
+
+SegmentRecord::SegmentRecord(int64_t key, uint64_t seq, uint64_t timestamp, const char* payload, size_t length)
+  : m_key(key)
+  , m_seq(seq)
+  , m_timestamp(timestamp)
+  , m_payload(payload, length) {
+}
+
+/* Segment */
+// ----------------------------------------------------------------------------
+Segment::Segment(const std::string& filename, uint64_t number, size_t capacity)
+  : m_filename(filename)
+  , m_number(number)
+  , m_fd(-1)
+  , m_data(nullptr)
+  , m_capacity(capacity)
+  , m_size(SEGMENT_HEADER_SIZE)
+  , m_last_timestamp(0) {
+  m_fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0) {
+    ERR("Failed to open segment file: %s", filename.c_str());
+    throw RuntimeException();
+  }
+
+  struct stat info;
+  fstat(m_fd, &info);
+  bool is_new = info.st_size == 0;
+  if (info.st_size > 0) {
+    m_capacity = static_cast<size_t>(info.st_size);  // existing segment keeps its size
+  } else if (ftruncate(m_fd, m_capacity) != 0) {
+    ERR("Failed to allocate %zu bytes for segment file: %s", m_capacity, filename.c_str());
+    close(m_fd);
+    throw RuntimeException();
+  }
+
+  void* data = mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (data == MAP_FAILED) {
+    ERR("Failed to map segment file: %s", filename.c_str());
+    close(m_fd);
+    throw RuntimeException();
+  }
+  m_data = static_cast<char*>(data);
+
+  if (is_new) {
+    memcpy(m_data, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    memcpy(m_data + sizeof(SEGMENT_MAGIC), &m_number, sizeof(m_number));
+  } else if (memcmp(m_data, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0) {
+    ERR("Segment file is corrupted: %s", filename.c_str());
+    munmap(m_data, m_capacity);
+    close(m_fd);
+    throw RuntimeException();
+  } else {
+    recover();
+  }
+  DBG("Opened segment [%" PRIu64 "] of %zu bytes, %zu bytes used", m_number, m_capacity, m_size);
+}
+
+Segment::~Segment() {
+  if (m_data != nullptr) {
+    munmap(m_data, m_capacity);
+    m_data = nullptr;
+  }
+  if (m_fd >= 0) {
+    close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool Segment::append(int64_t key, uint64_t seq, uint64_t timestamp, const char* payload, size_t length) {
+  if (m_size + recordSize(length) > m_capacity) {
+    return false;  // segment is full
+  }
+  RecordHeader header;
+  header.length = 0;
+  header.reserved = 0;
+  header.key = key;
+  header.seq = seq;
+  header.timestamp = timestamp;
+
+  char* record = m_data + m_size;
+  memcpy(record + sizeof(RecordHeader), payload, length);
+  memcpy(record, &header, sizeof(RecordHeader));
+  uint32_t record_length = static_cast<uint32_t>(length);
+  __atomic_store(reinterpret_cast<uint32_t*>(record), &record_length, __ATOMIC_RELEASE);  // commit record
+
+  indexRecord(key, seq, timestamp, m_size);
+  m_size += recordSize(length);
+  return true;
+}
+
+size_t Segment::read(int64_t key, uint64_t since_seq, size_t limit, std::vector<SegmentRecord>* records) const {
+  auto index_it = m_index.find(key);
+  if (index_it == m_index.end() || limit == 0) {
+    return 0;
+  }
+  // start from the closest indexed record, preceding 'since_seq'
+  auto& index = index_it->second;
+  auto it = std::upper_bound(index.begin(), index.end(), std::make_pair(since_seq, m_capacity));
+  size_t offset = it == index.begin() ? it->second : (it - 1)->second;
+
+  size_t total = 0;
+  while (offset + sizeof(RecordHeader) <= m_size && total < limit) {
+    RecordHeader header;
+    memcpy(&header, m_data + offset, sizeof(RecordHeader));
+    if (header.key == key && header.seq > since_seq) {
+      records->emplace_back(header.key, header.seq, header.timestamp, m_data + offset + sizeof(RecordHeader), header.length);
+      ++total;
+    }
+    offset += recordSize(header.length);
+  }
+  return total;
+}
+
+void Segment::sync(size_t from, size_t to) {
+  long page = sysconf(_SC_PAGESIZE);
+  size_t start = from - from % page;
+  if (to > start && msync(m_data + start, to - start, MS_SYNC) != 0) {
+    ERR("Failed to sync segment [%" PRIu64 "]", m_number);
+  }
+}
+
+void Segment::remove() {
+  if (unlink(m_filename.c_str()) != 0) {
+    ERR("Failed to remove segment file: %s", m_filename.c_str());
+  }
+}
+
+bool Segment::contains(int64_t key) const {
+  return m_last_seq.find(key) != m_last_seq.end();
+}
+
+uint64_t Segment::getFirstSeq(int64_t key) const {
+  auto it = m_first_seq.find(key);
+  return it != m_first_seq.end() ? it->second : 0;
+}
+
+uint64_t Segment::getLastSeq(int64_t key) const {
+  auto it = m_last_seq.find(key);
+  return it != m_last_seq.end() ? it->second : 0;
+}
+
+/* Private */
+// ----------------------------------------------------------------------------
+void Segment::recover() {
+  size_t offset = SEGMENT_HEADER_SIZE;
+  while (offset + sizeof(RecordHeader) <= m_capacity) {
+    RecordHeader header;
+    memcpy(&header, m_data + offset, sizeof(RecordHeader));
+    if (header.length == 0 || offset + recordSize(header.length) > m_capacity) {
+      break;  // end of written records
+    }
+    indexRecord(header.key, header.seq, header.timestamp, offset);
+    offset += recordSize(header.length);
+  }
+  m_size = offset;
+}
+
+void Segment::indexRecord(int64_t key, uint64_t seq, uint64_t timestamp, size_t offset) {
+  uint64_t& count = m_count[key];
+  if (count % SEGMENT_INDEX_STRIDE == 0) {
+    m_index[key].emplace_back(seq, offset);
+  }
+  if (count == 0) {
+    m_first_seq[key] = seq;
+  }
+  ++count;
+  m_last_seq[key] = seq;
+  m_last_timestamp = std::max(m_last_timestamp, timestamp);
+}
+
+}
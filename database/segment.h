@@ -0,0 +1,126 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_SEGMENT__H__
+#define CHAT_SERVER_SEGMENT__H__
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include "api/types.h"
+
+#define SEGMENT_HEADER_SIZE 16
+#define SEGMENT_INDEX_STRIDE 32
+
+namespace db {
+
+/**
+ * Record layout within segment:
+ *
+ *   [length:4][reserved:4][key:8][seq:8][timestamp:8][payload:length][padding]
+ *
+ * Length is written last, so a torn record is seen as the end of segment.
+ * Records are padded to alignment of header, so that length is stored atomically.
+ */
+struct RecordHeader {
+  uint32_t length;
+  uint32_t reserved;
+  int64_t key;
+  uint64_t seq;
+  uint64_t timestamp;
+};
+
+class SegmentRecord {
+public:
+  SegmentRecord(int64_t key, uint64_t seq, uint64_t timestamp, const char* payload, size_t length);
+
+  inline int64_t getKey() const { return m_key; }
+  inline uint64_t getSeq() const { return m_seq; }
+  inline uint64_t getTimestamp() const { return m_timestamp; }
+  inline const std::string& getPayload() const { return m_payload; }
+
+private:
+  int64_t m_key;
+  uint64_t m_seq;
+  uint64_t m_timestamp;
+  std::string m_payload;
+};
+
+// ----------------------------------------------
+/**
+ * Fixed-size append-only file mapped into memory. Keeps sparse index of
+ * offsets: one entry per SEGMENT_INDEX_STRIDE records of the same key.
+ */
+class Segment {
+public:
+  Segment(const std::string& filename, uint64_t number, size_t capacity);
+  virtual ~Segment();
+
+  bool append(int64_t key, uint64_t seq, uint64_t timestamp, const char* payload, size_t length);
+  size_t read(int64_t key, uint64_t since_seq, size_t limit, std::vector<SegmentRecord>* records) const;
+  void sync(size_t from, size_t to);
+  void remove();
+
+  bool contains(int64_t key) const;
+  uint64_t getFirstSeq(int64_t key) const;
+  uint64_t getLastSeq(int64_t key) const;
+
+  inline uint64_t getNumber() const { return m_number; }
+  inline size_t getSize() const { return m_size; }
+  inline size_t getCapacity() const { return m_capacity; }
+  inline uint64_t getLastTimestamp() const { return m_last_timestamp; }
+  inline const std::unordered_map<int64_t, uint64_t>& getLastSeqs() const { return m_last_seq; }
+
+  static size_t recordSize(size_t length) {
+    return (sizeof(RecordHeader) + length + alignof(RecordHeader) - 1) & ~(alignof(RecordHeader) - 1);
+  }
+
+private:
+  std::string m_filename;
+  uint64_t m_number;
+  int m_fd;
+  char* m_data;
+  size_t m_capacity;
+  size_t m_size;  // bytes written including segment header
+  uint64_t m_last_timestamp;
+  std::unordered_map<int64_t, uint64_t> m_first_seq;
+  std::unordered_map<int64_t, uint64_t> m_last_seq;
+  std::unordered_map<int64_t, uint64_t> m_count;
+  std::unordered_map<int64_t, std::vector<std::pair<uint64_t, size_t>>> m_index;
+
+  void recover();
+  void indexRecord(int64_t key, uint64_t seq, uint64_t timestamp, size_t offset);
+
+  Segment(const Segment& obj) = delete;
+  Segment& operator = (const Segment& rhs) = delete;
+};
+
+}
+
+#endif  // CHAT_SERVER_SEGMENT__H__
@@ -54,7 +54,7 @@ size_t WrappedString::length() const {
 }
 
 int WrappedString::n_bytes() const {
-  return (static_cast<int>(this->m_string.length()) * sizeof(Char_t) * 2);
+  return (static_cast<int>(this->m_string.length() * sizeof(Char_t)));
 }
 
 const WrappedString::Char_t* WrappedString::c_str() const {
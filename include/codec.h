@@ -0,0 +1,73 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_CODEC__H__
+#define CHAT_SERVER_CODEC__H__
+
+#include <cstddef>
+
+/**
+ * Hex and base64 codecs writing into caller-provided buffers.
+ *
+ * Every codec has table-driven scalar implementation and, on x86, SSSE3 and
+ * AVX2 ones picked at runtime according to what CPU supports. Decoders are
+ * strict: any character out of alphabet, odd hex length, base64 length not
+ * multiple of 4, misplaced padding or non-zero trailing bits fail decoding.
+ */
+namespace codec {
+
+enum Level {
+  SCALAR = 0,
+  SSSE3  = 1,
+  AVX2   = 2
+};
+
+/* Best level supported by CPU */
+Level getSupportedLevel();
+/* Level in use, could be lowered to compare implementations */
+Level getLevel();
+Level setLevel(Level level);  // returns the level actually set
+
+inline size_t hexEncodedLength(size_t size) { return size * 2; }
+inline size_t hexDecodedLength(size_t length) { return length / 2; }
+inline size_t base64EncodedLength(size_t size) { return (size + 2) / 3 * 4; }
+inline size_t base64DecodedCapacity(size_t length) { return length / 4 * 3; }
+
+/* Lowercase hex, output must hold hexEncodedLength(size) characters */
+size_t hexEncode(const unsigned char* src, size_t size, char* output);
+/* Either case, output must hold hexDecodedLength(length) bytes */
+bool hexDecode(const char* src, size_t length, unsigned char* output, size_t& output_size);
+
+/* Standard alphabet with padding, output must hold base64EncodedLength(size) characters */
+size_t base64Encode(const unsigned char* src, size_t size, char* output);
+/* Output must hold base64DecodedCapacity(length) bytes */
+bool base64Decode(const char* src, size_t length, unsigned char* output, size_t& output_size);
+
+}
+
+#endif  // CHAT_SERVER_CODEC__H__
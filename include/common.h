@@ -67,6 +67,11 @@ bool isNumber(const std::string& str, ID_t& id);
 std::string bin2hex(unsigned char* src, size_t size);
 void hex2bin(const std::string& source, unsigned char* target, size_t& target_length);
 
+/* Standard base64 with padding, decoder rejects any other characters */
+std::string base64Encode(const unsigned char* src, size_t size);
+bool base64Decode(const std::string& source, unsigned char* target, size_t& target_length);
+inline size_t base64DecodedCapacity(size_t encoded_length) { return encoded_length / 4 * 3; }
+
 bool isMessageForbidden(const std::string& message);
 
 /* Dictionary */
@@ -0,0 +1,117 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_JSON_READER__H__
+#define CHAT_SERVER_JSON_READER__H__
+
+#include <cstdint>
+#include <string>
+#include "api/types.h"
+
+#define JSON_READER_MAX_FIELDS 24
+#define JSON_STACK_ARENA_SIZE 1024  // parse stack of nested values, per thread
+
+/**
+ * Typed JSON readers over RapidJSON SAX, without intermediate Document trees.
+ *
+ * Input is parsed in-situ: strings are decoded inside the input buffer and
+ * copied once into bound variables. Parse stack is taken from thread-local
+ * arena which is reset after each read, so steady-state parsing allocates
+ * nothing but the resulting strings.
+ */
+namespace json {
+
+/**
+ * Binds fields of an object to variables:
+ *
+ *   json::Reader reader;
+ *   reader.bind(ITEM_ID, &id).bind(ITEM_LOGIN, &login);
+ *   if (!reader.read(json)) { ... }
+ *
+ * read() fails on malformed JSON, on value of bound field of unexpected type
+ * or out of range, and on missing required field. Unbound fields are skipped.
+ *
+ * Fields of several nested objects can be read in the same pass:
+ *
+ *   reader.bind(ITEM_CODE, &code, false)
+ *         .within(ITEM_PRIVATE_PUBKEY).bind(ITEM_ID, &id, false);
+ */
+class Reader {
+public:
+  /* reads fields of nested object with given name instead of root's ones */
+  explicit Reader(const char* object = nullptr);
+
+  Reader& bind(const char* name, std::string* value, bool required = true);
+  Reader& bind(const char* name, ID_t* value, bool required = true);
+  Reader& bind(const char* name, uint64_t* value, bool required = true);  // in int64 range
+  Reader& bind(const char* name, int* value, bool required = true);
+  Reader& bind(const char* name, uint32_t* value, bool required = true);
+
+  /* fields bound next belong to nested object with given name, nullptr for root */
+  Reader& within(const char* object);
+
+  /* copies input into thread-local buffer and parses it in-situ */
+  bool read(const std::string& json);
+  /* null-terminated buffer is modified */
+  bool readInsitu(char* buffer);
+
+  bool isSet(const char* name) const;  // for optional fields
+  bool isSet(const char* name, const char* object) const;
+
+private:
+  friend class ReaderHandler;
+
+  enum class Type : int { STRING, INT64, UINT64, INT, UINT };
+
+  struct Field {
+    const char* object;  // nullptr for root
+    size_t object_length;
+    const char* name;
+    size_t length;
+    Type type;
+    void* target;
+    bool required;
+    bool is_set;
+  };
+
+  const char* m_object;  // must be present, if given
+  const char* m_scope;
+  Field m_fields[JSON_READER_MAX_FIELDS];
+  int m_size;
+
+  Reader& add(const char* name, Type type, void* target, bool required);
+  int find(const char* object, size_t object_length, const char* name, size_t length) const;
+};
+
+/* Writes nested object with given name into output, nothing else is kept */
+bool extractObject(const std::string& json, const char* field, std::string* output);
+bool extractObjectInsitu(char* buffer, const char* field, std::string* output);
+
+}
+
+#endif  // CHAT_SERVER_JSON_READER__H__
@@ -0,0 +1,110 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_JSON_WRITER__H__
+#define CHAT_SERVER_JSON_WRITER__H__
+
+#include <string>
+#include <cstring>
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#define RESPONSE_HEADER_RESERVE 256  // room for status line and headers before body
+
+/**
+ * JSON serialization over rapidjson::Writer, so every string gets escaped.
+ */
+namespace json {
+
+typedef rapidjson::StringBuffer Buffer;
+
+/* Strings with nothing to escape, the usual case, are copied at once */
+class Writer : public rapidjson::Writer<Buffer> {
+public:
+  explicit Writer(Buffer& buffer) : rapidjson::Writer<Buffer>(buffer) {}
+
+  bool String(const char* str, rapidjson::SizeType length, bool copy = false);
+  inline bool String(const char* str) { return String(str, strlen(str)); }
+  inline bool String(const std::string& str) { return String(str.c_str(), str.length()); }
+  inline bool Key(const char* str, rapidjson::SizeType length, bool /* copy */ = false) { return String(str, length); }
+  inline bool Key(const char* str) { return String(str, strlen(str)); }
+};
+
+/* Any structure with write(json::Writer&) */
+template <typename T>
+std::string toString(const T& value) {
+  Buffer buffer;
+  Writer writer(buffer);
+  value.write(writer);
+  return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+/* Pre-rendered status line and headers, up to and including "Content-Length: " */
+struct HeaderPrefix {
+  const char* data;
+  size_t length;
+};
+
+#define HEADER_PREFIX(status, headers) \
+  { "HTTP/1.1 " status "\r\n" headers "\r\nContent-Length: ", \
+    sizeof("HTTP/1.1 " status "\r\n" headers "\r\nContent-Length: ") - 1 }
+
+/**
+ * HTTP response serialized in per-thread buffer. Body is written first,
+ * after a gap of RESPONSE_HEADER_RESERVE bytes; then status line and
+ * headers with the actual Content-Length are placed into that gap right
+ * before the body, so the whole response is one contiguous range.
+ *
+ * Buffer and writer are reused by the next Response on the same thread,
+ * so only one Response per thread may be alive at a time.
+ */
+class Response {
+public:
+  Response();
+
+  inline Writer& getWriter() { return m_writer; }
+
+  /* "HTTP/1.1 <status>\r\n<headers>\r\nContent-Length: <body length>\r\n\r\n" */
+  void finish(const char* status, const char* headers);
+  /* single copy of prefix, then Content-Length digits */
+  void finish(const HeaderPrefix& prefix);
+
+  inline const char* getData() const { return m_buffer.GetString() + m_start; }
+  inline size_t getLength() const { return m_buffer.GetSize() - m_start; }
+
+private:
+  Buffer& m_buffer;
+  Writer& m_writer;
+  size_t m_start;
+
+  char* reserveHeader(size_t header_length);
+};
+
+}
+
+#endif  // CHAT_SERVER_JSON_WRITER__H__
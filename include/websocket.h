@@ -0,0 +1,120 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_WEBSOCKET__H__
+#define CHAT_SERVER_WEBSOCKET__H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "parser/my_parser.h"
+
+#define WS_VERSION "13"
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_PROTOCOL_FRAME "chat.frame"  // subprotocol: binary frames instead of text
+#define WS_MAX_CONTROL_LENGTH 125
+#define WS_MAX_MESSAGE_LENGTH 1048576
+#define WS_PING_INTERVAL 30  // in seconds, peer is dropped after two missed pongs
+
+/**
+ * WebSocket (RFC 6455) transport, alternative to HTTP on a connection.
+ *
+ * Client upgrades connection with GET to PATH_WEBSOCKET. Chat traffic then
+ * maps onto messages, one request or response per message:
+ *
+ *   text   - client sends either Message json (posted as to PATH_MESSAGE)
+ *            or HTTP request for any other endpoint, server sends json body
+ *            of each response and pushed message;
+ *
+ *   binary - negotiated with WS_PROTOCOL_FRAME subprotocol, messages in both
+ *            directions carry binary frames, see wire.h.
+ *
+ * Server pings peers every WS_PING_INTERVAL seconds and answers their pings.
+ */
+namespace ws {
+
+enum class Opcode : unsigned char {
+  CONTINUATION = 0x0,
+  TEXT         = 0x1,
+  BINARY       = 0x2,
+  CLOSE        = 0x8,
+  PING         = 0x9,
+  PONG         = 0xA
+};
+
+struct Frame {
+  Opcode opcode;  // never CONTINUATION, fragments are reassembled
+  const char* payload;
+  size_t length;
+};
+
+/* Handshake */
+// ----------------------------------------------------------------------------
+/* Sec-WebSocket-Accept for Sec-WebSocket-Key */
+std::string acceptKey(const std::string& key);
+/* Writes either 101 or 400 response, true if connection has switched */
+bool acceptUpgrade(const Request& request, std::string* response, bool* is_binary);
+
+/* Encoding, frames are appended to output */
+// ----------------------------------------------------------------------------
+/* Server frames are never masked, so the same frame is sent to every peer */
+void encodeFrame(Opcode opcode, const char* payload, size_t length, std::string* output);
+/* Client frames, 'mask' is 4 bytes */
+void encodeMaskedFrame(Opcode opcode, const char* payload, size_t length, const unsigned char* mask, std::string* output);
+/* HTTP responses as prepared for text protocol, body of each goes in TEXT frame */
+bool encodeHttpResponses(const char* http, size_t length, std::string* output);
+
+/* Decoding */
+// ----------------------------------------------------------------------------
+/* Splits stream into messages, unmasks payloads in place */
+class FrameDecoder {
+public:
+  explicit FrameDecoder(bool is_mask_required = true);  // frames from client must be masked
+
+  void append(const char* input, size_t length);
+  /* frame points into decoder and is valid until next call */
+  bool next(Frame* frame);
+
+  inline bool isEnabled() const { return m_is_enabled; }  // connection has switched to WebSocket
+  inline void enable() { m_is_enabled = true; }
+  inline bool isBroken() const { return m_is_broken; }  // protocol violation
+
+private:
+  std::string m_buffer;
+  std::string m_message;  // fragments received so far
+  size_t m_offset;
+  Opcode m_message_opcode;
+  bool m_is_mask_required;
+  bool m_is_fragmented;
+  bool m_is_enabled;
+  bool m_is_broken;
+};
+
+}
+
+#endif  // CHAT_SERVER_WEBSOCKET__H__
@@ -0,0 +1,167 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_WIRE__H__
+#define CHAT_SERVER_WIRE__H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "api/structures.h"
+#include "parser/my_parser.h"
+
+struct z_stream_s;
+
+#define WIRE_VERSION 1
+#define WIRE_VARINT_MAX_LENGTH 10
+#define WIRE_MAX_FRAME_LENGTH 65536  // frames from client, as received by server
+#define WIRE_MAX_DOWNSTREAM_LENGTH 16777216  // frames from server and inflated DEFLATED ones, as received by client
+#define WIRE_DEFLATE_THRESHOLD 512  // shorter frames are not worth compressing
+#define WIRE_HELLO_DEFLATE 0x01  // flag of HELLO: peer accepts DEFLATED frames
+#define WIRE_CONTENT_TYPE "application/x-chat-frame"  // body of request is MESSAGE frame payload
+
+/**
+ * Compact binary framing, alternative to HTTP on a connection:
+ *
+ *   [varint length][type][payload]
+ *
+ * where length covers type and payload. Server offers framing in the payload
+ * of its hello ("framing=1"), client switches connection by sending HELLO
+ * frame before any other request. All traffic is framed afterwards.
+ *
+ * If server also offers compression ("deflate=1") and client sets the flag
+ * in its HELLO, server wraps frames longer than WIRE_DEFLATE_THRESHOLD into
+ * DEFLATED ones. Each is compressed on its own, so that the same DEFLATED
+ * frame could be sent to many peers.
+ */
+namespace wire {
+
+enum class FrameType : unsigned char {
+  HELLO    = 1,  // "CHAT", version and optional flags
+  REQUEST  = 2,  // [varint][method][varint][path][body]
+  RESPONSE = 3,  // [varint code][body]
+  MESSAGE  = 4,  // [id:8][dest_id:8][timestamp:8][channel:4][flags:1][varint size]
+                 // [varint][login][varint][email][message], little-endian
+  DEFLATED = 5   // whole frames, raw deflate with preset dictionary of json keys
+};
+
+struct Frame {
+  FrameType type;
+  const char* payload;
+  size_t length;
+};
+
+/* Varint */
+// ----------------------------------------------------------------------------
+/* Output must hold WIRE_VARINT_MAX_LENGTH bytes */
+size_t putVarint(uint64_t value, char* output);
+/* Returns number of bytes read, 0 if input is incomplete or malformed */
+size_t getVarint(const char* input, size_t length, uint64_t* value);
+
+/* Encoding, frames are appended to output */
+// ----------------------------------------------------------------------------
+void encodeHello(std::string* output, unsigned char flags = 0);
+void encodeRequest(const std::string& method, const std::string& path, const std::string& body, std::string* output);
+void encodeResponse(int code, const char* body, size_t length, std::string* output);
+void encodeMessage(const Message& message, std::string* output);
+
+/* HTTP requests and responses as prepared for text protocol */
+bool encodeHttpRequest(const char* http, size_t length, std::string* output);
+bool encodeHttpResponses(const char* http, size_t length, std::string* output);  // one frame per response
+
+/* Decoding */
+// ----------------------------------------------------------------------------
+/* Whether input starts with HELLO frame of supported version */
+bool isHello(const char* input, size_t length);
+unsigned char getHelloFlags(const Frame& frame);
+
+/* MESSAGE frame becomes POST request to message path with WIRE_CONTENT_TYPE body */
+bool decodeRequest(const Frame& frame, Request* request);
+bool decodeResponse(const Frame& frame, Response* response);
+bool decodeMessage(const Frame& frame, Message* message);
+
+bool isFramed(const Request& request);
+bool decodeMessage(const Request& request, Message* message);
+
+/* Compression */
+// ----------------------------------------------------------------------------
+/* Compression context, reused from frame to frame */
+class Deflater {
+public:
+  Deflater();
+  ~Deflater();
+
+  /* Appends DEFLATED frame made of whole frames, false if it is not shorter */
+  bool deflate(const char* frames, size_t length, std::string* output);
+
+private:
+  z_stream_s* m_stream;
+
+  Deflater(const Deflater&) = delete;
+  Deflater& operator = (const Deflater&) = delete;
+};
+
+class Inflater {
+public:
+  Inflater();
+  ~Inflater();
+
+  /* Output receives whole frames, as they were before compression */
+  bool inflate(const Frame& frame, std::string* output);
+
+private:
+  z_stream_s* m_stream;
+
+  Inflater(const Inflater&) = delete;
+  Inflater& operator = (const Inflater&) = delete;
+};
+
+/* Splits stream into frames, keeps incomplete tail until more input comes */
+class FrameDecoder {
+public:
+  explicit FrameDecoder(size_t max_length = WIRE_MAX_FRAME_LENGTH);
+
+  void append(const char* input, size_t length);
+  /* frame points into decoder and is valid until next append */
+  bool next(Frame* frame);
+
+  inline bool isEnabled() const { return m_is_enabled; }  // connection has switched to frames
+  inline void enable() { m_is_enabled = true; }
+  inline bool isBroken() const { return m_is_broken; }  // malformed or oversized frame
+
+private:
+  std::string m_buffer;
+  size_t m_offset;
+  size_t m_max_length;
+  bool m_is_enabled;
+  bool m_is_broken;
+};
+
+}
+
+#endif  // CHAT_SERVER_WIRE__H__
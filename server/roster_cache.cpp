@@ -0,0 +1,75 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include "api/types.h"
+#include "roster_cache.h"
+
+namespace server {
+
+RosterCache::RosterCache() {
+}
+
+RosterCache::~RosterCache() {
+}
+
+RosterCache::Response RosterCache::get(int channel, uint64_t version) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_entries.find(channel);
+  if (it == m_entries.end() || it->second.version != version) {
+    return nullptr;
+  }
+  return it->second.response;
+}
+
+void RosterCache::put(int channel, uint64_t version, const Response& response) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_entries.find(channel);
+  if (it == m_entries.end()) {
+    m_entries.insert(std::make_pair(channel, Entry{version, response}));
+  } else if (it->second.version <= version) {
+    it->second = Entry{version, response};
+  }
+}
+
+void RosterCache::invalidate(int channel) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.erase(channel);
+  m_entries.erase(WRONG_CHANNEL);
+}
+
+void RosterCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+}
+
+size_t RosterCache::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_entries.size();
+}
+
+}  // namespace server
@@ -0,0 +1,70 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_ROSTER_CACHE__H__
+#define CHAT_SERVER_ROSTER_CACHE__H__
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace server {
+
+/**
+ * Response with the whole list of peers on channel, serialized once per version
+ * of the list, see RosterLog. Concurrent requests of the same version share one
+ * immutable buffer, a change of the list makes it stale for the next request.
+ */
+class RosterCache {
+public:
+  typedef std::shared_ptr<const std::string> Response;
+
+  RosterCache();
+  virtual ~RosterCache();
+
+  Response get(int channel, uint64_t version) const;  // null, if missing or stale
+  void put(int channel, uint64_t version, const Response& response);  // newer version wins
+  void invalidate(int channel);  // and the list of all peers as well
+  void clear();
+
+  size_t size() const;
+
+private:
+  struct Entry {
+    uint64_t version;
+    Response response;
+  };
+
+  std::unordered_map<int, Entry> m_entries;  // channel, WRONG_CHANNEL for all -> response
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace server
+
+#endif  // CHAT_SERVER_ROSTER_CACHE__H__
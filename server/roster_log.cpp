@@ -0,0 +1,118 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include <inttypes.h>
+#include "logger.h"
+#include "roster_log.h"
+
+namespace server {
+
+RosterLog::RosterLog(uint64_t base_version, size_t capacity)
+  : m_version(base_version)
+  , m_oldest_version(base_version)
+  , m_capacity(capacity) {
+}
+
+RosterLog::~RosterLog() {
+}
+
+uint64_t RosterLog::join(const ::Peer& peer) {
+  return record(RosterMove::JOIN, peer, peer.getChannel());
+}
+
+uint64_t RosterLog::leave(const ::Peer& peer) {
+  return record(RosterMove::LEAVE, peer, peer.getChannel());
+}
+
+uint64_t RosterLog::move(const ::Peer& peer, int previous_channel) {
+  return record(RosterMove::MOVE, peer, previous_channel);
+}
+
+uint64_t RosterLog::getVersion(int channel) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (channel == WRONG_CHANNEL) {
+    return m_version;
+  }
+  auto it = m_versions.find(channel);
+  return it != m_versions.end() ? it->second : m_oldest_version;
+}
+
+bool RosterLog::getChanges(uint64_t since_version, int channel, std::vector<std::pair<RosterMove, ::Peer>>* deltas) const {
+  TRC("getChanges(%" PRIu64 ", %i)", since_version, channel);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (since_version > m_version) {
+    DBG("Version %" PRIu64 " is ahead of roster, issued before restart", since_version);
+    return false;
+  }
+  if (channel != WRONG_CHANNEL) {
+    auto it = m_versions.find(channel);
+    if (it == m_versions.end() || it->second <= since_version) {
+      return true;  // nothing has changed on channel
+    }
+  }
+  if (since_version < m_oldest_version) {
+    DBG("Changes after version %" PRIu64 " are not kept, oldest is %" PRIu64, since_version, m_oldest_version);
+    return false;
+  }
+
+  auto it = std::upper_bound(m_changes.begin(), m_changes.end(), since_version,
+      [](uint64_t version, const Change& change) { return version < change.version; });
+  for (; it != m_changes.end(); ++it) {
+    if (channel == WRONG_CHANNEL) {
+      deltas->emplace_back(it->move, it->peer);
+    } else if (it->peer.getChannel() == channel) {
+      deltas->emplace_back(it->move == RosterMove::MOVE ? RosterMove::JOIN : it->move, it->peer);
+    } else if (it->move == RosterMove::MOVE && it->previous_channel == channel) {
+      deltas->emplace_back(RosterMove::LEAVE, it->peer);
+    }
+  }
+  return true;
+}
+
+size_t RosterLog::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_changes.size();
+}
+
+/* Internal */
+// ----------------------------------------------------------------------------
+uint64_t RosterLog::record(RosterMove move, const ::Peer& peer, int previous_channel) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  uint64_t version = ++m_version;
+  m_changes.push_back({version, move, peer, previous_channel});
+  m_versions[peer.getChannel()] = version;
+  m_versions[previous_channel] = version;
+  while (m_changes.size() > m_capacity) {
+    m_oldest_version = m_changes.front().version;
+    m_changes.pop_front();
+  }
+  return version;
+}
+
+}  // namespace server
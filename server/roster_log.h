@@ -0,0 +1,93 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_ROSTER_LOG__H__
+#define CHAT_SERVER_ROSTER_LOG__H__
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "api/api.h"
+
+#define ROSTER_LOG_CAPACITY 4096  // changes kept for delta sync
+
+namespace server {
+
+/**
+ * Versioned log of changes of logged in peers, backs GET /all_peers?since_version=V.
+ *
+ * Every login, logout and channel switch gets next version. Version of channel
+ * is the version of last change touching it, the whole list is versioned by the
+ * last change at all. Only ROSTER_LOG_CAPACITY most recent changes are kept,
+ * older versions could only be caught up with the whole list.
+ *
+ * Versions start from base given, so that versions seen by clients before
+ * Server restart never look recent.
+ */
+class RosterLog {
+public:
+  RosterLog(uint64_t base_version, size_t capacity = ROSTER_LOG_CAPACITY);
+  virtual ~RosterLog();
+
+  uint64_t join(const ::Peer& peer);
+  uint64_t leave(const ::Peer& peer);
+  uint64_t move(const ::Peer& peer, int previous_channel);
+
+  uint64_t getVersion(int channel) const;  // WRONG_CHANNEL for the whole list
+
+  /**
+   * Changes after since_version in order, on channel or everywhere if WRONG_CHANNEL.
+   * Returns false if some of them are not kept anymore, so whole list must be sent.
+   */
+  bool getChanges(uint64_t since_version, int channel, std::vector<std::pair<RosterMove, ::Peer>>* deltas) const;
+
+  size_t size() const;
+
+private:
+  struct Change {
+    uint64_t version;
+    RosterMove move;
+    ::Peer peer;
+    int previous_channel;
+  };
+
+  std::deque<Change> m_changes;
+  std::unordered_map<int, uint64_t> m_versions;  // channel -> version of last change on it
+  uint64_t m_version;
+  uint64_t m_oldest_version;  // changes after it are kept
+  size_t m_capacity;
+  mutable std::mutex m_mutex;
+
+  uint64_t record(RosterMove move, const ::Peer& peer, int previous_channel);
+};
+
+}  // namespace server
+
+#endif  // CHAT_SERVER_ROSTER_LOG__H__
@@ -27,12 +27,15 @@
  */
 
 #include <thread>
+#include <inttypes.h>
 #include <errno.h>
+#include <poll.h>
 #include "common.h"
 #include "server.h"
 #include "server_api_impl.h"
 #include "server_menu.h"
 #if SECURE
+#include "crypting/key_pool.h"
 #include "crypting/random_util.h"
 #endif  // SECURE
 
@@ -40,6 +43,12 @@
 
 static const uint64_t MODERATION_TIMEOUT = 2400;  // in seconds, 40 minutes
 
+/* Whether peer sends request without waiting for hello, within delay in ms */
+static bool isSpeakingFirst(int socket, int delay) {
+  pollfd descriptor = { socket, POLLIN, 0 };
+  return poll(&descriptor, 1, delay) > 0;
+}
+
 /* Connection structure */
 // ----------------------------------------------------------------------------
 Connection Connection::EMPTY = Connection(0, 0, "", 0);
@@ -56,10 +65,16 @@ Connection::Connection(ID_t id, uint64_t timestamp, const std::string& ip_addres
 
 /* Server */
 // ----------------------------------------------------------------------------
-Server::Server(int port_number)
+Server::Server(int port_number, uint64_t session_grace_period)
   : m_next_accepted_connection_id(BASE_CONNECTION_ID)
   , m_is_stopped(false)
-  , m_should_store_requests(false) {
+  , m_should_store_requests(false)
+  , m_hello_delay(DEFAULT_HELLO_DELAY) {
+#if SECURE
+  if (!common::isFileAccessible(common::createFilenameWithId(SERVER_ID, PUBLIC_KEY_FILE))) {
+    secure::getKeyPool();  // generate first key pair while Server is initializing
+  }
+#endif  // SECURE
   std::string port = std::to_string(port_number);
 
   // prepare address structure
@@ -119,6 +134,11 @@ Server::Server(int port_number)
   m_paths[PATH_CHECK_AUTH]     = Path::CHECK_AUTH;
   m_paths[PATH_KICK_BY_AUTH]   = Path::KICK_BY_AUTH;
   m_paths[PATH_ALL_PEERS]      = Path::ALL_PEERS;
+  m_paths[PATH_HISTORY]        = Path::HISTORY;
+  m_paths[PATH_RESUME]         = Path::RESUME;
+  m_paths[PATH_WEBSOCKET]      = Path::WEBSOCKET;
+  m_paths[PATH_STREAM]         = Path::STREAM;
+  m_paths[PATH_HELLO]          = Path::HELLO;
 #if SECURE
   m_paths[PATH_PRIVATE_REQUEST] = Path::PRIVATE_REQUEST;
   m_paths[PATH_PRIVATE_CONFIRM] = Path::PRIVATE_CONFIRM;
@@ -127,7 +147,7 @@ Server::Server(int port_number)
   m_paths[PATH_PRIVATE_PUBKEY_EXCHANGE] = Path::PRIVATE_PUBKEY_EXCHANGE;
 #endif  // SECURE
 
-  m_api_impl = new ServerApiImpl();
+  m_api_impl = new ServerApiImpl(session_grace_period);
   m_log_database = new db::LogTable();
   m_system_database = new db::SystemTable();
 }
@@ -148,8 +168,10 @@ void Server::run() {
 #endif  // SECURE
   m_launch_timestamp = common::getCurrentTime();  // launch timestamp
   std::thread m(&Server::moderationDaemon, this);
+  std::thread p(&Server::pingDaemon, this);
   std::thread t(&Server::runListener, this);
   m.detach();
+  p.detach();
   t.detach();
 
   menu::printHelp();
@@ -165,6 +187,7 @@ void Server::run() {
 void Server::stop() {
   m_is_stopped = true;
   m_moderator_cv.notify_all();
+  m_ping_cv.notify_all();
   m_api_impl->terminate();
   close(m_socket);
 }
@@ -184,10 +207,45 @@ void Server::logIncoming() {
   }
 }
 
+void Server::exportLogs(const std::string& day, ID_t connection_id) {
+  uint64_t from = 0, to = 0;
+  if (!db::LogTable::dayToRange(day, &from, &to)) {
+    printf("\e[5;00;33mWrong day format, expected YYYYMMDD: %s\e[m\n", day.c_str());
+    return;
+  }
+  std::string filename = "logs_" + day + ".txt";
+  std::fstream fs;
+  fs.open(filename, std::fstream::out | std::fstream::trunc);
+  if (!fs.is_open()) {
+    ERR("Failed to open file for export: %s", filename.c_str());
+    return;
+  }
+
+  int total = 0;
+  db::LogRecord log = db::LogRecord::EMPTY;
+  db::LogCursor cursor = m_log_database->getLogs(from, to, connection_id);
+  while (cursor.next(&log)) {
+    fs << log.getTimestamp() << " [" << log.getConnectionId() << "] " << log.getStartLine()
+       << " " << log.getHeaders() << " " << log.getPayload() << "\n";
+    ++total;
+  }
+  fs.close();
+  printf("\e[5;00;32mExported %i log records into:\e[m %s\n", total, filename.c_str());
+}
+
 void Server::listAllPeers() {
   static_cast<ServerApiImpl*>(m_api_impl)->listAllPeers();
 }
 
+void Server::issueReadToken(int channel) {
+  std::string token = static_cast<ServerApiImpl*>(m_api_impl)->issueReadToken(channel);
+  if (channel == WRONG_CHANNEL) {
+    printf("Read token for all channels: %s\n", token.c_str());
+  } else {
+    printf("Read token for channel [%i]: %s\n", channel, token.c_str());
+  }
+}
+
 void Server::sendMessage(ID_t id, char* message) {
   if (message == nullptr) {
     ERR("Null message not allowed !");
@@ -207,6 +265,14 @@ void Server::sendMessage(ID_t id, char* message) {
 void Server::listPrivateCommunications() {
   static_cast<ServerApiImpl*>(m_api_impl)->listPrivateCommunications();
 }
+
+void Server::printCryptoStats() {
+  static_cast<ServerApiImpl*>(m_api_impl)->printCryptoStats();
+  if (m_tls.isEnabled()) {
+    printf("TLS handshakes: full %" PRIu64 ", resumed %" PRIu64 ", kernel offloaded %" PRIu64 "\n",
+           m_tls.getFullHandshakesCount(), m_tls.getResumedHandshakesCount(), m_tls.getKernelOffloadedCount());
+  }
+}
 #endif  // SECURE
 
 /* Looper */
@@ -225,10 +291,7 @@ void Server::runListener() {
 
     Connection connection = storeClientInfo(peer_address_structure);  // log incoming connection
 
-    // send hello to new peer (only once)
-    m_api_impl->sendHello(peer_socket);
-
-    // get incoming message
+    // get incoming message, TLS handshake and hello are done there not to stall accept loop
     std::thread t(&Server::handleRequest, this, peer_socket, connection.getId());
     t.detach();
   }
@@ -285,10 +348,14 @@ Path Server::getPath(const std::string& path) const {
 
 /* Process request */
 // ----------------------------------------------
-Request Server::getRequest(int socket, bool* is_closed, std::vector<Request>* requests) {
+Request Server::getRequest(int socket, bool* is_closed, std::vector<Request>* requests, wire::FrameDecoder* decoder, ws::FrameDecoder* websocket) {
   char buffer[MESSAGE_SIZE];
   memset(buffer, 0, MESSAGE_SIZE);
+#if SECURE
+  int read_bytes = m_tls.isEnabled() ? m_tls.read(socket, buffer, MESSAGE_SIZE) : recv(socket, buffer, MESSAGE_SIZE, 0);
+#else
   int read_bytes = recv(socket, buffer, MESSAGE_SIZE, 0);
+#endif  // SECURE
   if (read_bytes <= 0) {
     if (read_bytes == -1) {
       ERR("getRequest() error: %s", strerror(errno));
@@ -297,6 +364,12 @@ Request Server::getRequest(int socket, bool* is_closed, std::vector<Request>* re
     *is_closed = true;
     return Request::EMPTY;
   }
+  if (websocket->isEnabled()) {
+    return getWebSocketRequests(socket, buffer, read_bytes, is_closed, requests, websocket);
+  }
+  if (decoder->isEnabled() || wire::isHello(buffer, read_bytes)) {
+    return getFramedRequests(socket, buffer, read_bytes, requests, decoder);
+  }
   try {
     DBG("Raw request[%i bytes]: %.*s", read_bytes, (int) read_bytes, buffer);
     common::printReadableTimestampNow();
@@ -307,15 +380,117 @@ Request Server::getRequest(int socket, bool* is_closed, std::vector<Request>* re
   }
 }
 
+Request Server::getFramedRequests(int socket, const char* buffer, int length, std::vector<Request>* requests, wire::FrameDecoder* decoder) {
+  decoder->append(buffer, length);
+  wire::Frame frame;
+  while (decoder->next(&frame)) {
+    if (frame.type == wire::FrameType::HELLO) {
+      if (!decoder->isEnabled()) {
+        bool is_deflated = (wire::getHelloFlags(frame) & WIRE_HELLO_DEFLATE) != 0;
+        INF("Connection on socket %i has switched to binary frames%s", socket, is_deflated ? ", compressed" : "");
+        decoder->enable();
+        static_cast<ServerApiImpl*>(m_api_impl)->setFramed(socket, true, is_deflated);
+      }
+      continue;
+    }
+    Request request;
+    if (wire::decodeRequest(frame, &request)) {
+      requests->push_back(request);
+    } else {
+      ERR("Invalid frame of type %i - ignored", static_cast<int>(frame.type));
+    }
+  }
+  if (decoder->isBroken()) {
+    FAT("Broken frame stream on socket %i", socket);
+  }
+  return requests->empty() ? Request::EMPTY : requests->front();
+}
+
+Request Server::getWebSocketRequests(int socket, const char* buffer, int length, bool* is_closed, std::vector<Request>* requests, ws::FrameDecoder* websocket) {
+  auto api_impl = static_cast<ServerApiImpl*>(m_api_impl);
+  api_impl->touchWebSocket(socket);  // any traffic from peer is as good as pong
+  websocket->append(buffer, length);
+  ws::Frame frame;
+  while (websocket->next(&frame)) {
+    switch (frame.opcode) {
+      case ws::Opcode::TEXT:
+        if (frame.length > 0 && frame.payload[0] == '{') {  // Message json
+          Request request;
+          request.startline.method = "POST";
+          request.startline.path = PATH_MESSAGE;
+          request.startline.version = 1;
+          request.body.assign(frame.payload, frame.length);
+          requests->push_back(request);
+        } else {
+          std::string http(frame.payload, frame.length);
+          try {
+            m_parser.parseBufferedRequests(&http[0], http.length(), requests);
+          } catch (ParseException exception) {
+            FAT("ParseException on WebSocket request[%zu bytes]: %s", http.length(), http.c_str());
+          }
+        }
+        break;
+      case ws::Opcode::BINARY:
+        {
+          wire::FrameDecoder frames;  // whole binary frames, see wire.h
+          frames.append(frame.payload, frame.length);
+          wire::Frame inner;
+          while (frames.next(&inner)) {
+            Request request;
+            if (wire::decodeRequest(inner, &request)) {
+              requests->push_back(request);
+            } else {
+              ERR("Invalid frame of type %i - ignored", static_cast<int>(inner.type));
+            }
+          }
+        }
+        break;
+      case ws::Opcode::PING:
+        api_impl->sendWebSocketFrame(socket, ws::Opcode::PONG, frame.payload, frame.length);
+        break;
+      case ws::Opcode::CLOSE:
+        DBG("WebSocket on socket %i is closed by peer", socket);
+        api_impl->sendWebSocketFrame(socket, ws::Opcode::CLOSE, frame.payload, std::min(frame.length, static_cast<size_t>(2)));  // echo status code
+        *is_closed = true;
+        return Request::EMPTY;
+      default:
+        break;
+    }
+  }
+  if (websocket->isBroken()) {
+    FAT("Broken WebSocket stream on socket %i", socket);
+  }
+  return requests->empty() ? Request::EMPTY : requests->front();
+}
+
 void Server::handleRequest(int socket, ID_t connection_id) {
+#if SECURE
+  if (m_tls.isEnabled() && !m_tls.accept(socket)) {
+    close(socket);
+    return;
+  }
+#endif  // SECURE
+
+  // peer speaking first asks for hello itself (GET /hello) or doesn't expect it (WebSocket, SSE),
+  // silent peer is an older client waiting for hello unasked
+  bool is_speaking_first = false;
+#if SECURE
+  is_speaking_first = m_tls.isEnabled() && m_tls.hasPending(socket);  // already read with handshake
+#endif  // SECURE
+  if (!is_speaking_first && (m_hello_delay <= 0 || !isSpeakingFirst(socket, m_hello_delay))) {
+    m_api_impl->sendHello(socket);
+  }
+
+  wire::FrameDecoder decoder;  // enabled once peer switches to binary frames
+  ws::FrameDecoder websocket;  // enabled once peer upgrades to WebSocket
   while (!m_is_stopped) {
     bool is_closed = false;
     std::vector<Request> requests;
-    Request request = getRequest(socket, &is_closed, &requests);
-    if (is_closed) {
+    Request request = getRequest(socket, &is_closed, &requests, &decoder, &websocket);
+    if (is_closed || decoder.isBroken() || websocket.isBroken()) {
       DBG("Stopping peer thread...");
       m_api_impl->logoutPeerAtConnectionReset(socket);
-      close(socket);
+      closeSocket(socket);
       return;
     }
 
@@ -356,6 +531,9 @@ void Server::handleRequest(int socket, ID_t connection_id) {
                 ID_t id = UNKNOWN_ID;
                 auto login_status = m_api_impl->login(socket, request.body, id);
                 m_api_impl->sendStatus(socket, login_status, path, id);
+                if (login_status == StatusCode::SUCCESS) {
+                  m_api_impl->sendOfflineMessages(socket, id);
+                }
                 m_api_impl->updateLastActivityTimestampOfPeer(id, path);  // set-up activity timestamp
               }
               break;
@@ -381,7 +559,15 @@ void Server::handleRequest(int socket, ID_t connection_id) {
             case Method::POST:
               {
                 ID_t id = UNKNOWN_ID;
-                auto message_status = m_api_impl->message(request.body, id);
+                StatusCode message_status = StatusCode::INVALID_FORM;
+                if (wire::isFramed(request)) {
+                  Message message;
+                  if (wire::decodeMessage(request, &message)) {
+                    message_status = m_api_impl->message(message, id);
+                  }
+                } else {
+                  message_status = m_api_impl->message(request.body, id);
+                }
                 m_api_impl->sendStatus(socket, message_status, path, id);
                 m_api_impl->updateLastActivityTimestampOfPeer(id, path);  // action during chat
               }
@@ -395,7 +581,7 @@ void Server::handleRequest(int socket, ID_t connection_id) {
               ID_t id = UNKNOWN_ID;
               auto logout_status = m_api_impl->logout(request.startline.path, id);
               m_api_impl->sendStatus(socket, logout_status, path, id);
-              close(socket);  // shutdown peer socket
+              closeSocket(socket);  // shutdown peer socket
               return;  // terminate current peer thread
             }
           }
@@ -471,14 +657,77 @@ void Server::handleRequest(int socket, ID_t connection_id) {
           switch (method) {
             case Method::GET:
             {
-              std::vector<Peer> peers;
+              Roster roster;
+              auto get_all_status = m_api_impl->getAllPeers(request.startline.path, &roster);
+              if (get_all_status == StatusCode::SUCCESS) {
+                m_api_impl->sendPeers(socket, get_all_status, roster);
+              } else {
+                m_api_impl->sendStatus(socket, get_all_status, path, UNKNOWN_ID);
+              }
+            }
+            break;
+          }
+          break;
+        case Path::HISTORY:
+          switch (method) {
+            case Method::GET:
+            {
+              std::string frames;
               int channel = WRONG_CHANNEL;
-              auto get_all_status = m_api_impl->getAllPeers(request.startline.path, &peers, channel);
-              m_api_impl->sendPeers(socket, get_all_status, peers, channel);
+              uint64_t last_seq = 0;
+              auto history_status = m_api_impl->getHistory(socket, request.startline.path, &frames, channel, last_seq);
+              m_api_impl->sendHistory(socket, history_status, frames, channel, last_seq);
+            }
+            break;
+          }
+          break;
+        case Path::RESUME:
+          switch (method) {
+            case Method::PUT:
+            {
+              ID_t id = UNKNOWN_ID;
+              int channel = DEFAULT_CHANNEL;
+              uint64_t since_seq = 0;
+              auto resume_status = m_api_impl->resume(socket, request.startline.path, id, channel, since_seq);
+              m_api_impl->sendStatus(socket, resume_status, path, id);
+              if (resume_status == StatusCode::SUCCESS) {
+                m_api_impl->sendMissedMessages(socket, channel, since_seq);
+                m_api_impl->sendOfflineMessages(socket, id);
+                m_api_impl->updateLastActivityTimestampOfPeer(id, path);  // action during chat
+              }
+            }
+            break;
+          }
+          break;
+        case Path::HELLO:
+          switch (method) {
+            case Method::GET:
+              m_api_impl->sendHello(socket);
+              break;
+          }
+          break;
+        case Path::STREAM:
+          switch (method) {
+            case Method::GET:
+            {
+              auto status = static_cast<ServerApiImpl*>(m_api_impl)->subscribe(socket, request.startline.path);
+              if (status == StatusCode::SUCCESS) {
+                return;  // socket is owned by subscribers now, terminate current peer thread
+              }
+              m_api_impl->sendStatus(socket, status, path, UNKNOWN_ID);
             }
             break;
           }
           break;
+        case Path::WEBSOCKET:
+          switch (method) {
+            case Method::GET:
+              if (!websocket.isEnabled() && static_cast<ServerApiImpl*>(m_api_impl)->upgradeToWebSocket(socket, request)) {
+                websocket.enable();
+              }
+              break;
+          }
+          break;
 #if SECURE
         case Path::PRIVATE_REQUEST:
           switch (method) {
@@ -533,7 +782,7 @@ void Server::handleRequest(int socket, ID_t connection_id) {
             case Method::POST:
             {
               ID_t id = UNKNOWN_ID;
-              auto status = m_api_impl->privatePubKeysExchange(request.startline.path, id);
+              auto status = m_api_impl->privatePubKeysExchange(request.startline.path, request.body, id);
               m_api_impl->sendStatus(socket, status, path, id);
               m_api_impl->updateLastActivityTimestampOfPeer(id, path);  // action during chat
             }
@@ -581,6 +830,15 @@ void Server::storeRequest(ID_t connection_id, const Request& request) {
   }
 }
 
+void Server::closeSocket(int socket) {
+  static_cast<ServerApiImpl*>(m_api_impl)->setFramed(socket, false);
+  static_cast<ServerApiImpl*>(m_api_impl)->removeWebSocket(socket);
+#if SECURE
+  m_tls.close(socket);
+#endif  // SECURE
+  close(socket);
+}
+
 void Server::moderationDaemon() {
   INF("Moderation Daemon has started");
   while (!m_is_stopped) {
@@ -592,13 +850,45 @@ void Server::moderationDaemon() {
     DBG("Moderation Daemon working...");
     int total = m_api_impl->checkActivityAndKick();
     DBG("Moderation Daemon, total kicked: %i", total);
-    printf("\e[5;00;36mModeration Daemon, total kicked:\e[m %i", total);
+    printf("\e[5;00;36mModeration Daemon, total kicked:\e[m %i\n", total);
+    int dropped = m_log_database->applyRetention(common::getCurrentTime());
+    DBG("Moderation Daemon, total log partitions dropped: %i", dropped);
+    printf("\e[5;00;36mModeration Daemon, total log partitions dropped:\e[m %i\n", dropped);
+    int compacted = static_cast<ServerApiImpl*>(m_api_impl)->compactJournal();
+    DBG("Moderation Daemon, total journal segments compacted: %i", compacted);
+    printf("\e[5;00;36mModeration Daemon, total journal segments compacted:\e[m %i\n", compacted);
+    int expired = static_cast<ServerApiImpl*>(m_api_impl)->expireSessions();
+    DBG("Moderation Daemon, total sessions expired: %i", expired);
+    printf("\e[5;00;36mModeration Daemon, total sessions expired:\e[m %i\n", expired);
+    int offline = static_cast<ServerApiImpl*>(m_api_impl)->compactOfflineQueue();
+    DBG("Moderation Daemon, total offline segments compacted: %i", offline);
+    printf("\e[5;00;36mModeration Daemon, total offline segments compacted:\e[m %i\n", offline);
   }
   INF("Moderation Daemon has finished");
 }
 
+void Server::pingDaemon() {
+  while (!m_is_stopped) {
+    std::unique_lock<std::mutex> latch(m_ping_mutex);
+    m_ping_cv.wait_for(latch, std::chrono::seconds(WS_PING_INTERVAL), [this](){ return this->m_is_stopped; });
+    if (m_is_stopped) {
+      break;
+    }
+    static_cast<ServerApiImpl*>(m_api_impl)->pingWebSockets();
+    static_cast<ServerApiImpl*>(m_api_impl)->heartbeatSubscribers();
+  }
+}
+
 #if SECURE
 
+bool Server::enableTls(const std::string& cert_file, const std::string& key_file) {
+  if (!m_tls.init(cert_file, key_file)) {
+    return false;
+  }
+  static_cast<ServerApiImpl*>(m_api_impl)->setTlsTerminator(&m_tls);
+  return true;
+}
+
 void Server::getKeyPair() {
   m_api_impl->setKeyPair(secure::random::getKeyPair(SERVER_ID));
 }
@@ -607,12 +897,46 @@ void Server::getKeyPair() {
 
 /* Main */
 // ----------------------------------------------------------------------------
+/**
+ * server [port] [session grace period, s] [--hello-delay ms] [--tls-cert file --tls-key file]
+ */
 int main(int argc, char** argv) {
   int port = 80;
-  if (argc > 1) {
-    port = std::atoi(argv[1]);
+  uint64_t session_grace_period = DEFAULT_SESSION_GRACE_PERIOD;
+  int hello_delay = DEFAULT_HELLO_DELAY;
+  std::string cert_file, key_file;
+  int position = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "--hello-delay" && i + 1 < argc) {
+      hello_delay = std::atoi(argv[++i]);  // in ms, 0 sends hello at once
+    } else if (arg == "--tls-cert" && i + 1 < argc) {
+      cert_file = argv[++i];  // certificate chain, PEM
+    } else if (arg == "--tls-key" && i + 1 < argc) {
+      key_file = argv[++i];  // private key, PEM
+    } else if (position == 0) {
+      port = std::atoi(argv[i]);
+      ++position;
+    } else if (position == 1) {
+      session_grace_period = std::strtoull(argv[i], nullptr, 10) * 1000;  // in seconds, 0 disables resumption
+      ++position;
+    } else {
+      ERR("Unknown argument: %s", argv[i]);
+      return 1;
+    }
+  }
+  Server server(port, session_grace_period);
+  server.setHelloDelay(hello_delay);
+  if (!cert_file.empty() || !key_file.empty()) {
+#if SECURE
+    if (!server.enableTls(cert_file, key_file)) {
+      return 1;
+    }
+#else
+    ERR("TLS is only supported in secure build");
+    return 1;
+#endif  // SECURE
   }
-  Server server(port);
   server.run();
   return 0;
 }
@@ -39,11 +39,17 @@
 #include "database/system_table.h"
 #include "exception.h"
 #include "parser/my_parser.h"
+#include "session_table.h"
+#include "websocket.h"
+#include "wire.h"
 
 #if SECURE
 #include "crypting/sym_key.h"
+#include "crypting/tls_terminator.h"
 #endif  // SECURE
 
+#define DEFAULT_HELLO_DELAY 200  // in ms, for older clients waiting for hello unasked
+
 // ----------------------------------------------
 class Connection {
 public:
@@ -67,23 +73,34 @@ private:
 // ----------------------------------------------
 class Server {
 public:
-  Server(int port_number);
+  Server(int port_number, uint64_t session_grace_period = DEFAULT_SESSION_GRACE_PERIOD);
   virtual ~Server();
 
   void run();
   void stop();
   void kick(ID_t id);
   void logIncoming();
+  void exportLogs(const std::string& day, ID_t connection_id);
   void listAllPeers();
+  void issueReadToken(int channel);
   void sendMessage(ID_t id, char* message);
+  /**
+   * Hello is sent only to peer staying silent for that time after connect,
+   * see GET /hello. 0 sends hello to everyone at once, which breaks browsers
+   * and other standard HTTP clients (WebSocket, SSE) speaking first.
+   */
+  inline void setHelloDelay(int delay) { m_hello_delay = delay; }  // in ms
 #if SECURE
   void listPrivateCommunications();
+  void printCryptoStats();
+  bool enableTls(const std::string& cert_file, const std::string& key_file);
 #endif  // SECURE
 
 private:
   ID_t m_next_accepted_connection_id;
   bool m_is_stopped;
   bool m_should_store_requests;
+  int m_hello_delay;  // in ms, 0 - hello is sent at once
   int m_socket;
   uint64_t m_launch_timestamp;
   std::unordered_map<std::string, Method> m_methods;
@@ -95,19 +112,26 @@ private:
   db::SystemTable* m_system_database;
 #if SECURE
   secure::SymmetricKey m_sym_key;
+  secure::TlsTerminator m_tls;
 #endif  // SECURE
   std::mutex m_moderator_mutex;
   std::condition_variable m_moderator_cv;
+  std::mutex m_ping_mutex;
+  std::condition_variable m_ping_cv;
 
   void runListener();
   void printClientInfo(sockaddr_in& peeraddr);
   Connection storeClientInfo(sockaddr_in& peeraddr);
-  Request getRequest(int socket, bool* is_closed, std::vector<Request>* requests);
+  Request getRequest(int socket, bool* is_closed, std::vector<Request>* requests, wire::FrameDecoder* decoder, ws::FrameDecoder* websocket);
+  Request getFramedRequests(int socket, const char* buffer, int length, std::vector<Request>* requests, wire::FrameDecoder* decoder);
+  Request getWebSocketRequests(int socket, const char* buffer, int length, bool* is_closed, std::vector<Request>* requests, ws::FrameDecoder* websocket);
   Method getMethod(const std::string& method) const;
   Path getPath(const std::string& path) const;
   void handleRequest(int socket, ID_t connection_id);  // other thread
+  void closeSocket(int socket);
   void storeRequest(ID_t connection_id, const Request& request);
   void moderationDaemon();  // other thread
+  void pingDaemon();  // other thread
 
 #if SECURE
   void getKeyPair();
@@ -26,24 +26,30 @@
  *   Only the original author - Maxim Alov - has right to do any of the above actions.
  */
 
+#include <climits>
 #include <cstdlib>
 #include <sstream>
 #include <utility>
 #include <vector>
 #include <inttypes.h>
 #include <unistd.h>
+#include <sys/socket.h>
 #include "all.h"
 #include "common.h"
 #include "database/peer_table_impl.h"
+#include "json_writer.h"
+#include "wire.h"
 #if SECURE
+#include "crypting/agreement.h"
 #include "crypting/crypting_util.h"
 #include "crypting/evp_cryptor.h"
 #include "database/keys_table_impl.h"
 #endif  // SECURE
 #include "server_api_impl.h"
 
-static const char* STANDARD_HEADERS = "Server: ChatServer-" D_VERSION "\r\nContent-Type: application/json";
-static const char* CONTENT_LENGTH_HEADER = "Content-Length: ";
+#define D_STANDARD_HEADERS "Server: ChatServer-" D_VERSION "\r\nContent-Type: application/json"
+
+static const char* STANDARD_HEADERS = D_STANDARD_HEADERS;
 static const char* CONNECTION_CLOSE_HEADER = "Connection: close";
 
 static const char* NULL_PAYLOAD = "";
@@ -51,6 +57,51 @@ static const char* FILENAME_ADMIN_CERT = "admin_cert.pem";
 
 static const uint64_t PEER_ACTIVITY_TIMEOUT = 12 * 3600 * 1000;  // 12 hours if inactivity
 
+/* Complete status line and headers of response by StatusCode, see sendStatus() */
+static constexpr json::HeaderPrefix STATUS_HEADER_PREFIXES[] = {
+  HEADER_PREFIX("500 Internal server error", D_STANDARD_HEADERS),      // UNKNOWN
+  HEADER_PREFIX("200 OK", D_STANDARD_HEADERS),                         // SUCCESS
+  HEADER_PREFIX("200 Wrong password", D_STANDARD_HEADERS),             // WRONG_PASSWORD
+  HEADER_PREFIX("200 Not registered", D_STANDARD_HEADERS),             // NOT_REGISTERED
+  HEADER_PREFIX("200 Already registered", D_STANDARD_HEADERS),         // ALREADY_REGISTERED
+  HEADER_PREFIX("200 Already logged in", D_STANDARD_HEADERS),          // ALREADY_LOGGED_IN
+  HEADER_PREFIX("400 Invalid form", D_STANDARD_HEADERS),               // INVALID_FORM
+  HEADER_PREFIX("400 Invalid query", D_STANDARD_HEADERS),              // INVALID_QUERY
+  HEADER_PREFIX("401 Unauthorized", D_STANDARD_HEADERS),               // UNAUTHORIZED
+  HEADER_PREFIX("400 Wrong channel", D_STANDARD_HEADERS),              // WRONG_CHANNEL
+  HEADER_PREFIX("400 Same channel", D_STANDARD_HEADERS),               // SAME_CHANNEL
+  HEADER_PREFIX("404 No such peer", D_STANDARD_HEADERS),               // NO_SUCH_PEER
+  HEADER_PREFIX("412 Not requested", D_STANDARD_HEADERS),              // NOT_REQUESTED
+  HEADER_PREFIX("200 Already requested", D_STANDARD_HEADERS),          // ALREADY_REQUESTED
+  HEADER_PREFIX("200 Already responded", D_STANDARD_HEADERS),          // ALREADY_RESPONDED
+  HEADER_PREFIX("200 Confirmation rejected", D_STANDARD_HEADERS),      // REJECTED
+  HEADER_PREFIX("200 Another action is required", D_STANDARD_HEADERS), // ANOTHER_ACTION_REQUIRED
+  HEADER_PREFIX("404 Public key is missing", D_STANDARD_HEADERS),      // PUBLIC_KEY_MISSING
+  HEADER_PREFIX("403 Permission denied", D_STANDARD_HEADERS),          // PERMISSION_DENIED
+  HEADER_PREFIX("200 Kicked by administrator", D_STANDARD_HEADERS),    // KICKED
+  HEADER_PREFIX("403 Forbidden message", D_STANDARD_HEADERS),          // FORBIDDEN_MESSAGE
+  HEADER_PREFIX("200 Request rejected", D_STANDARD_HEADERS),           // REQUEST_REJECTED
+  HEADER_PREFIX("401 Session expired", D_STANDARD_HEADERS),            // SESSION_EXPIRED
+  HEADER_PREFIX("503 Server busy", D_STANDARD_HEADERS),                // SERVER_BUSY
+};
+static_assert(sizeof(STATUS_HEADER_PREFIXES) / sizeof(STATUS_HEADER_PREFIXES[0]) == static_cast<int>(StatusCode::SERVER_BUSY) + 2,
+              "Every StatusCode must have its header prefix");
+
+static inline const json::HeaderPrefix& getHeaderPrefix(StatusCode status) {
+  return STATUS_HEADER_PREFIXES[static_cast<int>(status) + 1];
+}
+
+/* Notifications of other peers */
+static constexpr json::HeaderPrefix LOGGED_IN_HEADER_PREFIX = HEADER_PREFIX("200 Logged In", D_STANDARD_HEADERS);
+static constexpr json::HeaderPrefix LOGGED_OUT_HEADER_PREFIX = HEADER_PREFIX("200 Logged Out", D_STANDARD_HEADERS);
+static constexpr json::HeaderPrefix SWITCHED_CHANNEL_HEADER_PREFIX = HEADER_PREFIX("200 Switched channel", D_STANDARD_HEADERS);
+static constexpr json::HeaderPrefix MESSAGE_HEADER_PREFIX = HEADER_PREFIX("102 Processing", D_STANDARD_HEADERS);
+#if SECURE
+static constexpr json::HeaderPrefix HANDSHAKE_REQUEST_HEADER_PREFIX = HEADER_PREFIX("200 Handshake request", D_STANDARD_HEADERS);
+static constexpr json::HeaderPrefix HANDSHAKE_CONFIRMED_HEADER_PREFIX = HEADER_PREFIX("200 Handshake confirmed", D_STANDARD_HEADERS);
+static constexpr json::HeaderPrefix HANDSHAKE_REJECTED_HEADER_PREFIX = HEADER_PREFIX("200 Handshake rejected", D_STANDARD_HEADERS);
+#endif  // SECURE
+
 /* Mapping */
 // ----------------------------------------------------------------------------
 PeerDTO LoginToPeerDTOMapper::map(const LoginForm& form) {
@@ -63,22 +114,43 @@ PeerDTO RegistrationToPeerDTOMapper::map(const RegistrationForm& form) {
 
 #if SECURE
 secure::Key KeyDTOtoKeyMapper::map(const KeyDTO& key) {
-  return secure::Key(key.getId(), key.getKey());
+  return secure::Key(key.getId(), key.getKey(), static_cast<secure::KeyVersion>(key.getVersion()));
 }
 #endif  // SECURE
 
 /* Server implementation */
 // ----------------------------------------------------------------------------
-ServerApiImpl::ServerApiImpl()
-  : m_payload(NULL_PAYLOAD) {
+ServerApiImpl::ServerApiImpl(uint64_t session_grace_period)
+  : m_payload(NULL_PAYLOAD)
+  , m_sessions(session_grace_period)
+  , m_roster(common::getCurrentTime()) {
   m_peers_database = new db::PeerTable();
+  m_journal = new db::MessageJournal();
+  m_history = new db::MessageHistory(m_journal);
+  m_offline_queue = new db::OfflineQueue();
 #if SECURE
   m_keys_database = new db::KeysTable();
+  m_tls = nullptr;
+  m_subscribers.setWriter([this](int socket, const char* buffer, size_t length) -> ssize_t {
+    if (m_tls != nullptr && m_tls->isSecure(socket)) {
+      return m_tls->writeSome(socket, buffer, length);  // rest is left in subscriber's backlog
+    }
+    return send(socket, buffer, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+  });
+  m_subscribers.setCloser([this](int socket) {
+    if (m_tls != nullptr) {
+      m_tls->close(socket);
+    }
+    close(socket);
+  });
 #endif  // SECURE
 }
 
 ServerApiImpl::~ServerApiImpl() {
   delete m_peers_database;  m_peers_database = nullptr;
+  delete m_offline_queue;  m_offline_queue = nullptr;
+  delete m_history;  m_history = nullptr;
+  delete m_journal;  m_journal = nullptr;
 #if SECURE
   delete m_keys_database;  m_keys_database = nullptr;
 #endif  // SECURE
@@ -113,33 +185,49 @@ void ServerApiImpl::gainAdminPriviledges(ID_t id) {
 
 void ServerApiImpl::sendHello(int socket) {
   TRC("sendHello");
-  std::ostringstream oss, json;
-  json << "{\"" D_ITEM_SYSTEM "\":\"Server greetings you!\""
-       << ",\"" D_ITEM_PAYLOAD "\":\"";
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  writer.Key(ITEM_SYSTEM);   writer.String("Server greetings you!");
+  writer.Key(ITEM_PAYLOAD);
 #if SECURE
   std::string public_key = common::preparse(m_key_pair.first.getKey(), common::PreparseLeniency::STRICT);
-  json << ITEM_PRIVATE_PUBKEY << "=" << public_key;
+  writer.String(std::string(ITEM_PRIVATE_PUBKEY) + "=" + public_key + "&" D_ITEM_FRAMING "=1&" D_ITEM_DEFLATE "=1");
+#else
+  writer.String(D_ITEM_FRAMING "=1&" D_ITEM_DEFLATE "=1");  // binary frames are offered, see wire.h
 #endif  // SECURE
-  json << "\"}";
-  oss << "HTTP/1.1 200 OK\r\n" << STANDARD_HEADERS << "\r\n"
-      << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-      << json.str();
-  MSG("Response: %s", oss.str().c_str());
-  sendToSocket(socket, oss.str().c_str(), oss.str().length());
+  writer.EndObject();
+  response.finish(getHeaderPrefix(StatusCode::SUCCESS));
+  MSG("Response: %s", response.getData());
+  sendToSocket(socket, response.getData(), response.getLength());
 }
 
 void ServerApiImpl::logoutPeerAtConnectionReset(int socket) {
   TRC("logoutPeerAtConnectionReset(%i)", socket);
-  for (auto& it : m_peers) {
-    if (it.second.getSocket() == socket) {
-      INF("Logout peer with ID[%lli] at connection reset", it.first);
-      std::ostringstream oss;
-      oss << PATH_LOGOUT << "?" D_ITEM_ID "=" << it.first << "&" D_ITEM_LOGIN "=" << it.second.getLogin(); 
-      ID_t id = UNKNOWN_ID;
-      logout(oss.str(), id);
-      break;
-    }
+  expireSessions();
+  auto sit = m_socket_peers.find(socket);
+  if (sit == m_socket_peers.end()) {
+    return;  // nobody is logged in over socket
+  }
+  auto it = m_peers.find(sit->second);
+  if (it == m_peers.end()) {
+    m_socket_peers.erase(sit);
+    return;
+  }
+  int channel = it->second.getChannel();
+  if (m_sessions.detach(it->first, channel, m_history->getLastSeq(channel), common::getCurrentTime())) {
+    INF("Detach session of peer with ID[%lli] at connection reset, grace period %" PRIu64 " ms", it->first, m_sessions.getGracePeriod());
+    it->second.setSocket(-1);  // keep peer logged in until session expires or is resumed
+    m_socket_peers.erase(sit);
+    m_roster.leave(getListedPeer(it->second));  // but not listed meanwhile
+    m_roster_cache.invalidate(channel);
+    return;
   }
+  INF("Logout peer with ID[%lli] at connection reset", it->first);
+  std::ostringstream oss;
+  oss << PATH_LOGOUT << "?" D_ITEM_ID "=" << it->first << "&" D_ITEM_LOGIN "=" << it->second.getLogin(); 
+  ID_t id = UNKNOWN_ID;
+  logout(oss.str(), id);
 }
 
 void ServerApiImpl::updateLastActivityTimestampOfPeer(ID_t id, Path action) {
@@ -200,171 +288,198 @@ void ServerApiImpl::sendSystemMessage(ID_t id, const std::string& message) {
 void ServerApiImpl::sendLoginForm(int socket) {
   TRC("sendLoginForm");
   LoginForm form("", "");
-  std::string json = form.toJson();
-  std::ostringstream oss;
-  oss << "HTTP/1.1 200 OK\r\n" << STANDARD_HEADERS << "\r\n"
-      << CONTENT_LENGTH_HEADER << json.length() << "\r\n\r\n"
-      << json;
-  MSG("Response: %s", oss.str().c_str());
-  sendToSocket(socket, oss.str().c_str(), oss.str().length());
+  json::Response response;
+  form.write(response.getWriter());
+  response.finish(getHeaderPrefix(StatusCode::SUCCESS));
+  MSG("Response: %s", response.getData());
+  sendToSocket(socket, response.getData(), response.getLength());
 }
 
 void ServerApiImpl::sendRegistrationForm(int socket) {
   TRC("sendRegistrationForm");
   RegistrationForm form("", "", "");
-  std::string json = form.toJson();
-  std::ostringstream oss;
-  oss << "HTTP/1.1 200 OK\r\n" << STANDARD_HEADERS << "\r\n"
-      << CONTENT_LENGTH_HEADER << json.length() << "\r\n\r\n"
-      << json;
-  MSG("Response: %s", oss.str().c_str());
-  sendToSocket(socket, oss.str().c_str(), oss.str().length());
+  json::Response response;
+  form.write(response.getWriter());
+  response.finish(getHeaderPrefix(StatusCode::SUCCESS));
+  MSG("Response: %s", response.getData());
+  sendToSocket(socket, response.getData(), response.getLength());
 }
 
 void ServerApiImpl::sendStatus(int socket, StatusCode status, Path action, ID_t id) {
   TRC("sendStatus(%i, %i, %lli)", static_cast<int>(status), static_cast<int>(action), id);
-  std::ostringstream oss, json;
-  oss << "HTTP/1.1 ";
-  switch (status) {
-    case StatusCode::SUCCESS:
-      oss << "200 OK\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::WRONG_PASSWORD:
-      oss << "200 Wrong password\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::NOT_REGISTERED:
-      oss << "200 Not registered\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::ALREADY_REGISTERED:
-      oss << "200 Already registered\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::ALREADY_LOGGED_IN:
-      oss << "200 Already logged in\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::INVALID_FORM:
-      oss << "400 Invalid form\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::INVALID_QUERY:
-      oss << "400 Invalid query\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::UNAUTHORIZED:
-      oss << "401 Unauthorized\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::WRONG_CHANNEL:
-      oss << "400 Wrong channel\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::SAME_CHANNEL:
-      oss << "400 Same channel\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::NO_SUCH_PEER:
-      oss << "404 No such peer\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::NOT_REQUESTED:
-      oss << "412 Not requested\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::ALREADY_REQUESTED:
-      oss  << "200 Already requested\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::ALREADY_RESPONDED:
-      oss << "200 Already responded\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::REJECTED:
-      oss  << "200 Confirmation rejected\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::ANOTHER_ACTION_REQUIRED:
-      oss << "200 Another action is required\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::PUBLIC_KEY_MISSING:
-      oss << "404 Public key is missing\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::PERMISSION_DENIED:
-      oss << "403 Permission denied\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::KICKED:
-      oss << "200 Kicked by administrator\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::FORBIDDEN_MESSAGE:
-      oss << "403 Forbidden message\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::REQUEST_REJECTED:
-      oss << "200 Request rejected\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    case StatusCode::UNKNOWN:
-      oss << "500 Internal server error\r\n" << STANDARD_HEADERS << "\r\n";
-      break;
-    default:
-      return;
+  if (status < StatusCode::UNKNOWN || status > StatusCode::SERVER_BUSY) {
+    return;
   }
 
-  auto it_peer = m_peers.find(id);
-  Token token = it_peer != m_peers.end() ? it_peer->second.getToken() : Token::EMPTY;
+  // session token is the secret of resume, so only its owner gets it and only once it is granted
+  const Token* token = &Token::EMPTY;
+  if (status == StatusCode::SUCCESS &&
+      (action == Path::LOGIN || action == Path::REGISTER || action == Path::RESUME)) {
+    auto it_peer = m_peers.find(id);
+    if (it_peer != m_peers.end() && it_peer->second.getSocket() == socket) {
+      token = &it_peer->second.getToken();
+    }
+  }
 
-  json << "{\"" D_ITEM_CODE "\":" << static_cast<int>(status)
-       << ",\"" D_ITEM_ACTION "\":" << static_cast<int>(action)
-       << ",\"" D_ITEM_ID "\":" << id
-       << ",\"" D_ITEM_TOKEN "\":\"" << token << "\""
-       << ",\"" D_ITEM_PAYLOAD "\":\"" << m_payload << "\"}";
-  oss << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-      << json.str() << "\0";
-  MSG("Response: %s", oss.str().c_str());
-  sendToSocket(socket, oss.str().c_str(), oss.str().length());
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  writer.Key(ITEM_CODE);     writer.Int(static_cast<int>(status));
+  writer.Key(ITEM_ACTION);   writer.Int(static_cast<int>(action));
+  writer.Key(ITEM_ID);       writer.Int64(id);
+  writer.Key(ITEM_TOKEN);    writer.String(token->get());
+  writer.Key(ITEM_PAYLOAD);  writer.String(m_payload);
+  writer.EndObject();
+  response.finish(getHeaderPrefix(status));
+  MSG("Response: %s", response.getData());
+  sendToSocket(socket, response.getData(), response.getLength());
 
   m_payload = NULL_PAYLOAD;  // drop extra data
 }
 
 void ServerApiImpl::sendCheck(int socket, bool check, Path action, ID_t id) {
   TRC("sendCheck(%i, %i, %lli)", check, static_cast<int>(action), id);
-  std::ostringstream oss, json;
-  json << "{\"" D_ITEM_CHECK "\":" << (check ? 1 : 0)
-       << ",\"" D_ITEM_ACTION "\":" << static_cast<int>(action)
-       << ",\"" D_ITEM_ID "\":" << id << "}";
-  oss << "HTTP/1.1 200 OK\r\n"
-      << STANDARD_HEADERS << "\r\n"
-      << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-      << json.str() << "\0";
-  MSG("Response: %s", oss.str().c_str());
-  sendToSocket(socket, oss.str().c_str(), oss.str().length());
-}
-
-void ServerApiImpl::sendPeers(int socket, StatusCode status, const std::vector<Peer>& peers, int channel) {
-  TRC("sendPeers(size = %zu, channel = %i)", peers.size(), channel);
-  std::string delimiter = "";
-  std::ostringstream oss, json;
-  json << "{\"" D_ITEM_PEERS "\":[";
-  for (auto it = peers.begin(); it != peers.end(); ++it) {
-    json << delimiter << it->toJson();
-    delimiter = ",";
-  }
-  json << "]";
-  if (channel != WRONG_CHANNEL) {
-    json << ",\"" D_ITEM_CHANNEL "\":" << channel;
-  }
-  json << "}";
-  oss << "HTTP/1.1 200 OK\r\n"
-      << STANDARD_HEADERS << "\r\n"
-      << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-      << json.str() << "\0";
-  MSG("Response: %s", oss.str().c_str());
-  sendToSocket(socket, oss.str().c_str(), oss.str().length());
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  writer.Key(ITEM_CHECK);   writer.Int(check ? 1 : 0);
+  writer.Key(ITEM_ACTION);  writer.Int(static_cast<int>(action));
+  writer.Key(ITEM_ID);      writer.Int64(id);
+  writer.EndObject();
+  response.finish(getHeaderPrefix(StatusCode::SUCCESS));
+  MSG("Response: %s", response.getData());
+  sendToSocket(socket, response.getData(), response.getLength());
+}
+
+void ServerApiImpl::sendPeers(int socket, StatusCode status, const Roster& roster) {
+  TRC("sendPeers(size = %zu, deltas = %zu, channel = %i)", roster.peers.size(), roster.deltas.size(), roster.channel);
+  if (roster.response != nullptr) {
+    MSG("Response: %s", roster.response->c_str());
+    sendToSocket(socket, roster.response->c_str(), roster.response->length());
+    return;
+  }
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  if (roster.is_delta) {
+    writer.Key(ITEM_DELTAS);
+    writer.StartArray();
+    for (auto& delta : roster.deltas) {
+      writer.StartObject();
+      writer.Key(ITEM_MOVE);     writer.Int(static_cast<int>(delta.first));
+      writer.Key(ITEM_ID);       writer.Int64(delta.second.getId());
+      writer.Key(ITEM_LOGIN);    writer.String(delta.second.getLogin());
+      writer.Key(ITEM_EMAIL);    writer.String(delta.second.getEmail());
+      writer.Key(ITEM_CHANNEL);  writer.Int(delta.second.getChannel());
+      writer.EndObject();
+    }
+    writer.EndArray();
+  } else {
+    writer.Key(ITEM_PEERS);
+    writer.StartArray();
+    for (auto& peer : roster.peers) {
+      peer.write(writer);
+    }
+    writer.EndArray();
+  }
+  if (roster.channel != WRONG_CHANNEL) {
+    writer.Key(ITEM_CHANNEL);  writer.Int(roster.channel);
+  }
+  writer.Key(ITEM_VERSION);  writer.Uint64(roster.version);
+  if (roster.is_delta) {
+    writer.Key(ITEM_SINCE_VERSION);  writer.Uint64(roster.since_version);
+  }
+  writer.EndObject();
+  response.finish(getHeaderPrefix(StatusCode::SUCCESS));
+  MSG("Response: %s", response.getData());
+  if (!roster.is_delta && status == StatusCode::SUCCESS) {
+    // next requests get the same bytes until the list changes
+    m_roster_cache.put(roster.channel, roster.version,
+        std::make_shared<std::string>(response.getData(), response.getLength()));
+  }
+  sendToSocket(socket, response.getData(), response.getLength());
+}
+
+void ServerApiImpl::sendHistory(int socket, StatusCode status, const std::string& frames, int channel, uint64_t last_seq) {
+  TRC("sendHistory(size = %zu, channel = %i)", frames.length(), channel);
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  writer.Key(ITEM_CODE);      writer.Int(static_cast<int>(status));
+  writer.Key(ITEM_CHANNEL);   writer.Int(channel);
+  writer.Key(ITEM_LAST_SEQ);  writer.Uint64(last_seq);
+  writer.Key(ITEM_MESSAGES);
+  writer.StartArray();
+  if (!frames.empty()) {
+    writer.RawValue(frames.c_str(), frames.length(), rapidjson::kObjectType);  // frames are ready, joined with comma
+  }
+  writer.EndArray();
+  writer.EndObject();
+  response.finish(getHeaderPrefix(status));
+  MSG("Response: %s", response.getData());
+  sendToSocket(socket, response.getData(), response.getLength());
+}
+
+void ServerApiImpl::sendMissedMessages(int socket, int channel, uint64_t since_seq) {
+  TRC("sendMissedMessages(channel = %i, since_seq = %" PRIu64 ")", channel, since_seq);
+  uint64_t last_seq = m_history->getLastSeq(channel);
+  if (last_seq <= since_seq) {
+    DBG("No messages were missed on channel %i", channel);
+    return;
+  }
+  std::string frames;
+  m_history->read(channel, since_seq, HISTORY_MAX_LIMIT, &frames);
+  sendHistory(socket, StatusCode::SUCCESS, frames, channel, last_seq);
+}
+
+void ServerApiImpl::sendOfflineMessages(int socket, ID_t id) {
+  TRC("sendOfflineMessages(%lli)", id);
+  std::vector<db::SegmentRecord> frames;
+  uint64_t last_seq = 0;
+  m_offline_queue->peek(id, common::getCurrentTime(), &frames, &last_seq);
+  if (last_seq == 0) {
+    return;  // nothing pending
+  }
+  if (frames.empty()) {  // all pending have expired
+    m_offline_queue->acknowledge(id, last_seq, common::getCurrentTime());
+    return;
+  }
+  std::vector<iovec> buffers;
+  buffers.reserve(frames.size());
+  for (auto& frame : frames) {
+    iovec buffer;
+    buffer.iov_base = const_cast<char*>(frame.getPayload().c_str());
+    buffer.iov_len = frame.getPayload().length();
+    buffers.push_back(buffer);
+  }
+  INF("Delivering %zu offline messages to peer with ID [%lli]", frames.size(), id);
+  if (!sendToSocket(socket, buffers)) {  // all pending frames in one vectored write
+    WRN("Failed to deliver offline messages to peer with ID [%lli], kept pending", id);
+    return;
+  }
+  m_offline_queue->acknowledge(id, last_seq, common::getCurrentTime());
 }
 
 #if SECURE
 
-void ServerApiImpl::sendPubKey(const secure::Key& key, ID_t dest_id) {
+void ServerApiImpl::sendPubKey(const secure::Key& key, const secure::Key& ephemeral, ID_t dest_id) {
   TRC("sendPubKey(dest_id = %lli)", dest_id);
   auto dest_peer_it = m_peers.find(dest_id);
   if (dest_peer_it == m_peers.end()) {
     ERR("Destination peer with id [%lli] is not authorized!", dest_id);
     return;
   }
-  std::ostringstream oss, json;
-  json << "{\"" D_ITEM_PRIVATE_PUBKEY "\":" << key.toJson() << "}";
-  oss << "HTTP/1.1 200 OK\r\n"
-      << STANDARD_HEADERS << "\r\n"
-      << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-      << json.str() << "\0";
-  MSG("Response: %s", oss.str().c_str());
-  sendToSocket(dest_peer_it->second.getSocket(), oss.str().c_str(), oss.str().length());
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  writer.Key(ITEM_PRIVATE_PUBKEY);  key.write(writer);
+  if (ephemeral != secure::Key::EMPTY) {
+    writer.Key(ITEM_PRIVATE_EPHEMERAL);  ephemeral.write(writer);
+  }
+  writer.EndObject();
+  response.finish(getHeaderPrefix(StatusCode::SUCCESS));
+  MSG("Response: %s", response.getData());
+  sendToSocket(dest_peer_it->second.getSocket(), response.getData(), response.getLength());
 }
 
 #endif  // SECURE
@@ -377,7 +492,10 @@ StatusCode ServerApiImpl::login(int socket, const std::string& json, ID_t& id) {
 #if SECURE
     if (form.isEncrypted()) {
       DBG("Decrypt received login form before login");
-      form.decrypt(m_key_pair.second);
+      if (!decryptPassword(form)) {
+        WRN("Login rejected: crypto workers are overloaded");
+        return StatusCode::SERVER_BUSY;
+      }
     }
 #endif  // SECURE
     return loginPeer(socket, form, id);
@@ -394,7 +512,10 @@ StatusCode ServerApiImpl::registrate(int socket, const std::string& json, ID_t&
 #if SECURE
     if (form.isEncrypted()) {
       DBG("Decrypt received registration form before registration");
-      form.decrypt(m_key_pair.second);
+      if (!decryptPassword(form)) {
+        WRN("Registration rejected: crypto workers are overloaded");
+        return StatusCode::SERVER_BUSY;
+      }
     }
 #endif  // SECURE
     id = registerPeer(socket, form);
@@ -415,29 +536,32 @@ StatusCode ServerApiImpl::message(const std::string& json, ID_t& id) {
   TRC("message(%s)", json.c_str());
   try {
     Message message = Message::fromJson(json);
-
-    id = message.getId();
-    if (!isAuthorized(id)) {
-      ERR("Peer with id [%lli] is not authorized", id);
-      return StatusCode::UNAUTHORIZED;
-    }
-
-    {
-      const std::string& message_str = message.getMessage();
-      if (common::isMessageForbidden(message_str)) {
-        ERR("Forbidden message: %s", message_str.c_str());
-        return StatusCode::FORBIDDEN_MESSAGE;
-      }
-    }
-
-    broadcast(message);
-    return StatusCode::SUCCESS;
+    return this->message(message, id);
   } catch (ConvertException e) {
     FAT("Message failed: invalid json: %s", json.c_str());
   }
   return StatusCode::INVALID_FORM;
 }
 
+StatusCode ServerApiImpl::message(const Message& message, ID_t& id) {
+  id = message.getId();
+  if (!isAuthorized(id)) {
+    ERR("Peer with id [%lli] is not authorized", id);
+    return StatusCode::UNAUTHORIZED;
+  }
+
+  {
+    const std::string& message_str = message.getMessage();
+    if (common::isMessageForbidden(message_str)) {
+      ERR("Forbidden message: %s", message_str.c_str());
+      return StatusCode::FORBIDDEN_MESSAGE;
+    }
+  }
+
+  broadcast(message);
+  return StatusCode::SUCCESS;
+}
+
 StatusCode ServerApiImpl::logout(const std::string& path, ID_t& id) {
   TRC("logout(%s)", path.c_str());
   id = UNKNOWN_ID;
@@ -459,33 +583,37 @@ StatusCode ServerApiImpl::logout(const std::string& path, ID_t& id) {
     name = it->second.getLogin();
     email = it->second.getEmail();
     channel = it->second.getChannel();
+    if (it->second.getSocket() >= 0) {  // detached one has left the roster already
+      m_socket_peers.erase(it->second.getSocket());
+      m_roster.leave(getListedPeer(it->second));
+      m_roster_cache.invalidate(channel);
+    }
   } else {
     ERR("Peer with id [%lli] is not logged in!", id);
     return StatusCode::UNAUTHORIZED;
   }
   m_peers.erase(id);
+  m_sessions.close(id);
 #if SECURE
   eraseAllPendingHandshakes(id);
 #endif  // SECURE
 
-  // notify other peers
-  std::ostringstream oss, json;
+  // notify other peers, the same for everyone
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  writer.Key(ITEM_SYSTEM);   writer.String(name + " has logged out");
+  writer.Key(ITEM_ACTION);   writer.Int(static_cast<int>(Path::LOGOUT));
+  writer.Key(ITEM_ID);       writer.Int64(id);
+  writer.Key(ITEM_PAYLOAD);  writer.String(std::string(D_ITEM_LOGIN "=") + name +
+                                           "&" D_ITEM_EMAIL "=" + email +
+                                           "&" D_ITEM_CHANNEL "=" + std::to_string(channel));
+  writer.EndObject();
+  response.finish(LOGGED_OUT_HEADER_PREFIX);
+  // MSG("Response: %s", response.getData());
   for (auto& it : m_peers) {
     if (it.first != id) {
-      json << "{\"" D_ITEM_SYSTEM "\":\"" << name << " has logged out\""
-           << ",\"" D_ITEM_ACTION "\":" << static_cast<int>(Path::LOGOUT)
-           << ",\"" D_ITEM_ID "\":" << id
-           << ",\"" D_ITEM_PAYLOAD "\":" << "\"" D_ITEM_LOGIN "=" << name
-                                         << "&" D_ITEM_EMAIL "=" << email
-                                         << "&" D_ITEM_CHANNEL "=" << channel
-           << "\"}";
-      oss << "HTTP/1.1 200 Logged Out\r\n" << STANDARD_HEADERS << "\r\n"
-          << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-          << json.str() << "\0";
-      // MSG("Response: %s", oss.str().c_str());
-      sendToSocket(it.second.getSocket(), oss.str().c_str(), oss.str().length());
-      oss.str("");
-      json.str("");
+      sendToSocket(it.second.getSocket(), response.getData(), response.getLength());
     }
   }
   return StatusCode::SUCCESS;
@@ -529,36 +657,32 @@ StatusCode ServerApiImpl::switchChannel(const std::string& path, ID_t& id) {
     WRN("Attempt to switch to same channel! Return with status.");
     return StatusCode::SAME_CHANNEL;
   }
+  m_roster.move(getListedPeer(it->second), previous_channel);
+  m_roster_cache.invalidate(channel);
+  m_roster_cache.invalidate(previous_channel);
 
-  // notify other peers
-  std::ostringstream oss, json;
+  // notify other peers on both channels
+  std::string payload = std::string(D_ITEM_LOGIN "=") + name +
+      "&" D_ITEM_EMAIL "=" + email +
+      "&" D_ITEM_CHANNEL_PREV "=" + std::to_string(previous_channel) +
+      "&" D_ITEM_CHANNEL_NEXT "=" + std::to_string(channel) +
+      "&" D_ITEM_CHANNEL_MOVE "=";
   for (auto& it : m_peers) {
     if (it.first != id &&
         (it.second.getChannel() == channel || it.second.getChannel() == previous_channel)) {
-      ChannelMove move = ChannelMove::UNKNOWN;
-      json << "{\"" D_ITEM_SYSTEM "\":\"" << name;
-      if (it.second.getChannel() == channel) {
-        json << " has joined the channel\"";
-        move = ChannelMove::ENTER;
-      } else if (it.second.getChannel() == previous_channel) {
-        json << " has left the channel\"";
-        move = ChannelMove::EXIT;
-      }
-      json << ",\"" D_ITEM_ACTION "\":" << static_cast<int>(Path::SWITCH_CHANNEL)
-           << ",\"" D_ITEM_ID "\":" << id
-           << ",\"" D_ITEM_PAYLOAD "\":" << "\"" D_ITEM_LOGIN "=" << name
-                                         << "&" D_ITEM_EMAIL "=" << email
-                                         << "&" D_ITEM_CHANNEL_PREV "=" << previous_channel
-                                         << "&" D_ITEM_CHANNEL_NEXT "=" << channel
-                                         << "&" D_ITEM_CHANNEL_MOVE "=" << static_cast<int>(move)
-           << "\"}";
-      oss << "HTTP/1.1 200 Switched channel\r\n" << STANDARD_HEADERS << "\r\n"
-          << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-          << json.str() << "\0";
-      // MSG("Response: %s", oss.str().c_str());
-      sendToSocket(it.second.getSocket(), oss.str().c_str(), oss.str().length());
-      oss.str("");
-      json.str("");
+      bool is_entered = it.second.getChannel() == channel;
+      ChannelMove move = is_entered ? ChannelMove::ENTER : ChannelMove::EXIT;
+      json::Response response;
+      json::Writer& writer = response.getWriter();
+      writer.StartObject();
+      writer.Key(ITEM_SYSTEM);   writer.String(name + (is_entered ? " has joined the channel" : " has left the channel"));
+      writer.Key(ITEM_ACTION);   writer.Int(static_cast<int>(Path::SWITCH_CHANNEL));
+      writer.Key(ITEM_ID);       writer.Int64(id);
+      writer.Key(ITEM_PAYLOAD);  writer.String(payload + std::to_string(static_cast<int>(move)));
+      writer.EndObject();
+      response.finish(SWITCHED_CHANNEL_HEADER_PREFIX);
+      // MSG("Response: %s", response.getData());
+      sendToSocket(it.second.getSocket(), response.getData(), response.getLength());
     }
   }
   return StatusCode::SUCCESS;
@@ -622,7 +746,7 @@ bool ServerApiImpl::checkAuth(const std::string& path, ID_t& id) {
   if (encrypted) {
     DBG("Password is encrypted, decrypting...");
     bool decrypted = false;
-    password = secure::good::decryptRSA(m_key_pair.second, password, decrypted);
+    password = secure::good::decryptRSA(m_key_cache.getPrivateKey(m_key_pair.second), password, decrypted);
     SYS("Decrypted password[%i]: %s", !decrypted, password.c_str());
   } else {
     DBG("Password is not encrypted");
@@ -652,67 +776,310 @@ bool ServerApiImpl::kickByAuth(const std::string& path, ID_t& id) {
 }
 
 // ----------------------------------------------
-StatusCode ServerApiImpl::getAllPeers(const std::string& path, std::vector<Peer>* peers, int& channel) {
+StatusCode ServerApiImpl::getAllPeers(const std::string& path, Roster* roster) {
   TRC("getAllPeers(%s)", path.c_str());
-  channel = WRONG_CHANNEL;
+  roster->channel = WRONG_CHANNEL;
+  bool has_since_version = false;
   std::vector<Query> params;
   m_parser.parsePath(path, &params);
   for (auto& query : params) {
     DBG("Query: %s: %s", query.key.c_str(), query.value.c_str());
-  }
-  if (params.empty()) {  // no channel
-    for (auto& it : m_peers) {
-      Peer peer = Peer::Builder(it.first)
-          .setLogin(it.second.getLogin())
-          .setEmail(it.second.getEmail())
-          .setChannel(it.second.getChannel())
-          .build();
-      peers->emplace_back(peer);
+    ID_t value = 0;
+    bool is_known = query.key.compare(ITEM_CHANNEL) == 0 || query.key.compare(ITEM_SINCE_VERSION) == 0;
+    if (is_known && !common::isNumber(query.value, value)) {
+      ERR("Get all peers failed: not a number in query params: %s", path.c_str());
+      return StatusCode::INVALID_QUERY;
     }
-  } else if (params[0].key.compare(ITEM_CHANNEL) == 0) {
-    channel = std::stoi(params[0].value.c_str());
-    for (auto& it : m_peers) {
-      if (channel == it.second.getChannel()) {
-        Peer peer = Peer::Builder(it.first)
-            .setLogin(it.second.getLogin())
-            .setEmail(it.second.getEmail())
-            .setChannel(it.second.getChannel())
-            .build();
-        peers->emplace_back(peer);
+    if (query.key.compare(ITEM_CHANNEL) == 0) {
+      roster->channel = static_cast<int>(value);
+    } else if (query.key.compare(ITEM_SINCE_VERSION) == 0) {
+      if (value < 0) {
+        ERR("Get all peers failed: negative version in query params: %s", path.c_str());
+        return StatusCode::INVALID_QUERY;
       }
+      roster->since_version = static_cast<uint64_t>(value);
+      has_since_version = true;
+    }  // other params are ignored, as before
+  }
+
+  // version is taken before the list, so changes made meanwhile come again next time
+  roster->version = m_roster.getVersion(roster->channel);
+  if (has_since_version) {
+    roster->is_delta = m_roster.getChanges(roster->since_version, roster->channel, &roster->deltas);
+    if (roster->is_delta) {
+      DBG("Roster changes since version %" PRIu64 ": %zu", roster->since_version, roster->deltas.size());
+      return StatusCode::SUCCESS;
     }
-  } else {
-    ERR("Get all peers failed: wrong query params: %s", path.c_str());
+    roster->deltas.clear();
+  }
+  roster->response = m_roster_cache.get(roster->channel, roster->version);
+  if (roster->response != nullptr) {
+    DBG("Roster of version %" PRIu64 " is cached", roster->version);
+    return StatusCode::SUCCESS;
+  }
+  for (auto& it : m_peers) {
+    if (it.second.getSocket() >= 0 &&  // not detached
+        (roster->channel == WRONG_CHANNEL || roster->channel == it.second.getChannel())) {
+      roster->peers.emplace_back(getListedPeer(it.second));
+    }
+  }
+  return StatusCode::SUCCESS;
+}
+
+StatusCode ServerApiImpl::getHistory(int socket, const std::string& path, std::string* frames, int& channel, uint64_t& last_seq) {
+  TRC("getHistory(%s)", path.c_str());
+  std::vector<Query> params;
+  m_parser.parsePath(path, &params);
+  bool has_channel = false;
+  bool has_since = false;
+  uint64_t since_seq = 0;
+  size_t limit = HISTORY_DEFAULT_LIMIT;
+  std::string token;
+  for (auto& query : params) {
+    DBG("Query: %s: %s", query.key.c_str(), query.value.c_str());
+    if (query.key.compare(ITEM_TOKEN) == 0) {
+      token = query.value;
+      continue;
+    }
+    ID_t value = 0;
+    if (!common::isNumber(query.value, value) || value < 0) {
+      ERR("Get history failed: not a number in query params: %s", path.c_str());
+      return StatusCode::INVALID_QUERY;
+    }
+    if (query.key.compare(ITEM_CHANNEL) == 0) {
+      channel = static_cast<int>(value);
+      has_channel = true;
+    } else if (query.key.compare(ITEM_SINCE_SEQ) == 0) {
+      since_seq = static_cast<uint64_t>(value);
+      has_since = true;
+    } else if (query.key.compare(ITEM_LIMIT) == 0) {
+      limit = static_cast<size_t>(value);
+    }
+  }
+  if (!has_channel) {
+    ERR("Get history failed: wrong query params: %s", path.c_str());
     return StatusCode::INVALID_QUERY;
   }
+  if (!isLoggedIn(socket) && !m_sessions.checkReadToken(token, channel)) {
+    WRN("Get history failed: neither logged in peer nor read token for channel [%i]", channel);
+    return StatusCode::UNAUTHORIZED;
+  }
+
+  last_seq = m_history->getLastSeq(channel);
+  if (!has_since) {
+    since_seq = last_seq > limit ? last_seq - limit : 0;  // latest page
+  }
+  m_history->read(channel, since_seq, limit, frames);
+  return StatusCode::SUCCESS;
+}
+
+StatusCode ServerApiImpl::resume(int socket, const std::string& path, ID_t& id, int& channel, uint64_t& since_seq) {
+  TRC("resume(%i)", socket);
+  id = UNKNOWN_ID;
+  std::vector<Query> params;
+  m_parser.parsePath(path, &params);
+  if (params.size() < 2 || params[0].key.compare(ITEM_ID) != 0 ||
+      params[1].key.compare(ITEM_TOKEN) != 0 || !common::isNumber(params[0].value, id)) {
+    ERR("Resume failed: wrong query params: %s", path.c_str());
+    return StatusCode::INVALID_QUERY;
+  }
+
+  server::Session session;
+  switch (m_sessions.resume(id, params[1].value, common::getCurrentTime(), &session)) {
+    case server::ResumeStatus::NO_SUCH_SESSION:
+      ERR("Resume failed: no session for peer with id [%lli]", id);
+      return StatusCode::UNAUTHORIZED;
+    case server::ResumeStatus::EXPIRED:
+      WRN("Resume failed: session of peer with id [%lli] has expired", id);
+      return StatusCode::SESSION_EXPIRED;
+    case server::ResumeStatus::ATTACHED:
+      ERR("Resume failed: session of peer with id [%lli] is still attached", id);
+      return StatusCode::UNAUTHORIZED;
+    default:
+      break;
+  }
+
+  auto it = m_peers.find(id);
+  if (it == m_peers.end()) {
+    ERR("Peer with id [%lli] is not logged in!", id);
+    m_sessions.close(id);
+    return StatusCode::UNAUTHORIZED;
+  }
+  it->second.setSocket(socket);
+  m_socket_peers[socket] = id;
+  channel = it->second.getChannel();
+  since_seq = session.last_seq;
+  m_roster.join(getListedPeer(it->second));
+  m_roster_cache.invalidate(channel);
+  INF("Peer with ID[%lli] has resumed session on socket %i", id, socket);
+
+  std::ostringstream oss_payload;
+  oss_payload << "" D_ITEM_LOGIN "=" << it->second.getLogin()
+              << "&" D_ITEM_EMAIL "=" << it->second.getEmail()
+              << "&" D_ITEM_CHANNEL "=" << channel;
+  m_payload = oss_payload.str();  // extra data
   return StatusCode::SUCCESS;
 }
 
 // ----------------------------------------------
 void ServerApiImpl::terminate() {
   TRC("terminate");
-  std::ostringstream oss;
+  json::Response response;
+  prepareSimpleResponse(response, TERMINATE_CODE, "Terminate");
+  MSG("Response: %s", response.getData());
   for (auto& it : m_peers) {
-    prepareSimpleResponse(oss, TERMINATE_CODE, "Terminate");
-    MSG("Response: %s", oss.str().c_str());
-    sendToSocket(it.second.getSocket(), oss.str().c_str(), oss.str().length());
-    oss.str("");
+    sendToSocket(it.second.getSocket(), response.getData(), response.getLength());
   }
+  m_subscribers.clear();
 }
 
 void ServerApiImpl::sendToSocket(int socket, const char* buffer, int length) {
+  if (socket < 0) {
+    return;  // peer is detached, see SessionTable
+  }
+  std::lock_guard<std::mutex> latch(m_mutex);
+  auto websocket = m_websockets.find(socket);
+  if (websocket != m_websockets.end()) {
+    std::string frames;
+    bool is_encoded = false;
+    if (websocket->second.is_binary) {
+      std::string payload;
+      is_encoded = wire::encodeHttpResponses(buffer, length, &payload);
+      ws::encodeFrame(ws::Opcode::BINARY, payload.data(), payload.length(), &frames);
+    } else {
+      is_encoded = ws::encodeHttpResponses(buffer, length, &frames);
+    }
+    if (!is_encoded) {
+      ERR("Failed to frame response to WebSocket %i: %.*s", socket, length, buffer);
+      return;
+    }
+    writeToSocket(socket, frames.data(), frames.length());
+    return;
+  }
+  if (m_framed_sockets.find(socket) != m_framed_sockets.end()) {
+    std::string frames;
+    if (!wire::encodeHttpResponses(buffer, length, &frames)) {
+      ERR("Failed to frame response to socket %i: %.*s", socket, length, buffer);
+      return;
+    }
+    writeFramesToSocket(socket, frames);
+    return;
+  }
+  writeToSocket(socket, buffer, length);
+}
+
+bool ServerApiImpl::sendToSocket(int socket, std::vector<iovec>& buffers) {
+  if (socket < 0) {
+    return false;
+  }
+  std::lock_guard<std::mutex> latch(m_mutex);
+  auto websocket = m_websockets.find(socket);
+  if (websocket != m_websockets.end()) {
+    std::string frames, payload;
+    for (auto& buffer : buffers) {
+      const char* http = static_cast<const char*>(buffer.iov_base);
+      bool is_encoded = websocket->second.is_binary ?
+          wire::encodeHttpResponses(http, buffer.iov_len, &payload) :
+          ws::encodeHttpResponses(http, buffer.iov_len, &frames);
+      if (!is_encoded) {
+        ERR("Failed to frame response to WebSocket %i", socket);
+        return false;
+      }
+    }
+    if (websocket->second.is_binary) {
+      ws::encodeFrame(ws::Opcode::BINARY, payload.data(), payload.length(), &frames);
+    }
+    return writeToSocket(socket, frames.data(), frames.length());
+  }
+  if (m_framed_sockets.find(socket) != m_framed_sockets.end()) {
+    std::string frames;
+    for (auto& buffer : buffers) {
+      if (!wire::encodeHttpResponses(static_cast<const char*>(buffer.iov_base), buffer.iov_len, &frames)) {
+        ERR("Failed to frame response to socket %i", socket);
+        return false;
+      }
+    }
+    return writeFramesToSocket(socket, frames);
+  }
+#if SECURE
+  if (m_tls != nullptr && m_tls->isSecure(socket)) {
+    // coalesce into one record instead of one record per frame
+    std::string joined;
+    for (auto& buffer : buffers) {
+      joined.append(static_cast<const char*>(buffer.iov_base), buffer.iov_len);
+    }
+    return m_tls->write(socket, joined.c_str(), joined.length()) == static_cast<int>(joined.length());
+  }
+#endif  // SECURE
+  size_t index = 0;
+  while (index < buffers.size()) {
+    int count = std::min(buffers.size() - index, static_cast<size_t>(IOV_MAX));
+    ssize_t written = writev(socket, &buffers[index], count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ERR("Failed to write %zu buffers to socket %i: %s", buffers.size() - index, socket, strerror(errno));
+      return false;
+    }
+    // skip buffers written completely, advance partially written one
+    while (index < buffers.size() && static_cast<size_t>(written) >= buffers[index].iov_len) {
+      written -= buffers[index].iov_len;
+      ++index;
+    }
+    if (written > 0) {
+      buffers[index].iov_base = static_cast<char*>(buffers[index].iov_base) + written;
+      buffers[index].iov_len -= written;
+    }
+  }
+  return true;
+}
+
+void ServerApiImpl::sendToSocket(int socket, const PushedMessage& message) {
+  if (socket < 0) {
+    return;
+  }
   std::lock_guard<std::mutex> latch(m_mutex);
-  send(socket, buffer, length, 0);
+  const std::string* data = &message.http;
+  auto websocket = m_websockets.find(socket);
+  if (websocket != m_websockets.end()) {
+    data = websocket->second.is_binary ? &message.ws_binary : &message.ws_text;
+  } else if (m_framed_sockets.find(socket) != m_framed_sockets.end()) {
+    bool is_deflated = !message.deflated.empty() && m_deflated_sockets.find(socket) != m_deflated_sockets.end();
+    data = is_deflated ? &message.deflated : &message.frame;
+  }
+  writeToSocket(socket, data->c_str(), data->length());
+}
+
+bool ServerApiImpl::writeFramesToSocket(int socket, std::string& frames) {
+  if (frames.length() >= WIRE_DEFLATE_THRESHOLD && m_deflated_sockets.find(socket) != m_deflated_sockets.end()) {
+    std::string deflated;
+    std::lock_guard<std::mutex> latch(m_deflater_mutex);
+    if (m_deflater.deflate(frames.data(), frames.length(), &deflated)) {
+      frames.swap(deflated);
+    }
+  }
+  return writeToSocket(socket, frames.data(), frames.length());
+}
+
+bool ServerApiImpl::writeToSocket(int socket, const char* buffer, int length) {
+#if SECURE
+  if (m_tls != nullptr && m_tls->isSecure(socket)) {
+    return m_tls->write(socket, buffer, length) == length;
+  }
+#endif  // SECURE
+  return send(socket, buffer, length, 0) == length;
 }
 
 void ServerApiImpl::sendSystemMessage(int socket, const std::string& message) {
-  std::ostringstream oss, json;
-  json << "{\"" D_ITEM_SYSTEM "\":\"" << message << "\"}";
-  oss << "HTTP/1.1 200 OK\r\n" << STANDARD_HEADERS << "\r\n"
-      << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-      << json.str();
-  MSG("Response: %s", oss.str().c_str());
-  sendToSocket(socket, oss.str().c_str(), oss.str().length());
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  writer.Key(ITEM_SYSTEM);  writer.String(message);
+  writer.EndObject();
+  response.finish(getHeaderPrefix(StatusCode::SUCCESS));
+  MSG("Response: %s", response.getData());
+  sendToSocket(socket, response.getData(), response.getLength());
 }
 
 /* Internal */
@@ -736,6 +1103,147 @@ void ServerApiImpl::listAllPeers() const {
   }
 }
 
+int ServerApiImpl::compactJournal() {
+  TRC("compactJournal");
+  return m_history->compact();
+}
+
+void ServerApiImpl::setFramed(int socket, bool is_framed, bool is_deflated) {
+  std::lock_guard<std::mutex> latch(m_mutex);
+  if (is_framed) {
+    m_framed_sockets.insert(socket);
+  } else {
+    m_framed_sockets.erase(socket);
+  }
+  if (is_framed && is_deflated) {
+    m_deflated_sockets.insert(socket);
+  } else {
+    m_deflated_sockets.erase(socket);
+  }
+}
+
+bool ServerApiImpl::hasDeflatedSockets() {
+  std::lock_guard<std::mutex> latch(m_mutex);
+  return !m_deflated_sockets.empty();
+}
+
+bool ServerApiImpl::upgradeToWebSocket(int socket, const Request& request) {
+  std::string response;
+  bool is_binary = false;
+  bool is_accepted = ws::acceptUpgrade(request, &response, &is_binary);
+  std::lock_guard<std::mutex> latch(m_mutex);
+  writeToSocket(socket, response.c_str(), response.length());  // handshake itself goes in plain HTTP
+  if (is_accepted) {
+    m_framed_sockets.erase(socket);
+    m_websockets[socket] = WebSocket{is_binary, common::getCurrentTime()};
+    INF("Connection on socket %i has switched to WebSocket, %s frames", socket, is_binary ? "binary" : "text");
+  }
+  return is_accepted;
+}
+
+void ServerApiImpl::removeWebSocket(int socket) {
+  std::lock_guard<std::mutex> latch(m_mutex);
+  m_websockets.erase(socket);
+}
+
+void ServerApiImpl::touchWebSocket(int socket) {
+  std::lock_guard<std::mutex> latch(m_mutex);
+  auto it = m_websockets.find(socket);
+  if (it != m_websockets.end()) {
+    it->second.last_seen_timestamp = common::getCurrentTime();
+  }
+}
+
+void ServerApiImpl::sendWebSocketFrame(int socket, ws::Opcode opcode, const char* payload, size_t length) {
+  std::string frame;
+  ws::encodeFrame(opcode, payload, length, &frame);
+  std::lock_guard<std::mutex> latch(m_mutex);
+  writeToSocket(socket, frame.c_str(), frame.length());
+}
+
+StatusCode ServerApiImpl::subscribe(int socket, const std::string& path) {
+  TRC("subscribe(%s)", path.c_str());
+  static const char SSE_RESPONSE[] = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+      "Cache-Control: no-cache\r\nConnection: keep-alive\r\n\r\nretry: 3000\n\n";
+  std::vector<Query> params;
+  m_parser.parsePath(path, &params);
+  ID_t channel = WRONG_CHANNEL;
+  std::string token;
+  for (auto& query : params) {
+    if (query.key.compare(ITEM_CHANNEL) == 0 && !common::isNumber(query.value, channel)) {
+      channel = WRONG_CHANNEL;
+    } else if (query.key.compare(ITEM_TOKEN) == 0) {
+      token = query.value;
+    }
+  }
+  if (channel < 0) {
+    ERR("Subscribe failed: wrong query params: %s", path.c_str());
+    return StatusCode::INVALID_QUERY;
+  }
+  if (!m_sessions.checkReadToken(token, channel)) {
+    WRN("Subscribe failed: read token is not valid for channel [%lli]", channel);
+    return StatusCode::UNAUTHORIZED;
+  }
+  {
+    std::lock_guard<std::mutex> latch(m_mutex);
+    m_framed_sockets.erase(socket);
+    m_websockets.erase(socket);
+    writeToSocket(socket, SSE_RESPONSE, sizeof(SSE_RESPONSE) - 1);
+  }
+  m_subscribers.subscribe(socket, channel);
+  INF("Socket %i has subscribed to channel [%lli], total subscribers: %zu", socket, channel, m_subscribers.size());
+  return StatusCode::SUCCESS;
+}
+
+std::string ServerApiImpl::issueReadToken(int channel) {
+  return m_sessions.openReadToken(channel);
+}
+
+int ServerApiImpl::heartbeatSubscribers() {
+  static const std::string HEARTBEAT = ": ping\n\n";  // comment line, ignored by clients
+  return m_subscribers.publishAll(HEARTBEAT);
+}
+
+int ServerApiImpl::pingWebSockets() {
+  std::string ping;  // server frames are not masked, the same for everyone
+  ws::encodeFrame(ws::Opcode::PING, "", 0, &ping);
+  uint64_t now = common::getCurrentTime();
+  int total = 0;
+  std::lock_guard<std::mutex> latch(m_mutex);
+  for (auto& it : m_websockets) {
+    if (now - it.second.last_seen_timestamp > 2 * WS_PING_INTERVAL * 1000) {
+      WRN("WebSocket %i has missed pongs, dropping connection", it.first);
+      shutdown(it.first, SHUT_RDWR);  // peer thread sees connection reset and cleans up
+      continue;
+    }
+    writeToSocket(it.first, ping.c_str(), ping.length());
+    ++total;
+  }
+  return total;
+}
+
+int ServerApiImpl::compactOfflineQueue() {
+  TRC("compactOfflineQueue");
+  return m_offline_queue->compact(common::getCurrentTime());
+}
+
+int ServerApiImpl::expireSessions() {
+  TRC("expireSessions");
+  std::vector<ID_t> expired;
+  m_sessions.expire(common::getCurrentTime(), &expired);
+  for (auto& id : expired) {
+    auto it = m_peers.find(id);
+    if (it != m_peers.end()) {
+      INF("Logout peer with ID[%lli] at session expiration", id);
+      std::ostringstream oss;
+      oss << PATH_LOGOUT << "?" D_ITEM_ID "=" << id << "&" D_ITEM_LOGIN "=" << it->second.getLogin();
+      ID_t o_id = UNKNOWN_ID;
+      logout(oss.str(), o_id);
+    }
+  }
+  return expired.size();
+}
+
 #if SECURE
 void ServerApiImpl::listPrivateCommunications() const {
   printf("\e[5;00;33m    ***    Handshakes    ***\e[m\n");
@@ -778,35 +1286,36 @@ PeerDTO ServerApiImpl::getPeerFromDatabase(const std::string& symbolic, ID_t& id
   return peer;
 }
 
-std::ostringstream& ServerApiImpl::prepareSimpleResponse(std::ostringstream& out, int code, const std::string& message) const {
+Peer ServerApiImpl::getListedPeer(const server::Peer& peer) const {
+  return Peer::Builder(peer.getId())
+      .setLogin(peer.getLogin())
+      .setEmail(peer.getEmail())
+      .setChannel(peer.getChannel())
+      .build();
+}
+
+void ServerApiImpl::prepareSimpleResponse(json::Response& response, int code, const std::string& message) const {
   TRC("prepareSimpleResponse(%i, %s)", code, message.c_str());
-  out << "HTTP/1.1 " << code << " " << message << "\r\n"
-      << STANDARD_HEADERS << "\r\n"
-      << CONTENT_LENGTH_HEADER << 0 << "\r\n\r\n";
-  return out;
+  std::string status = std::to_string(code) + " " + message;
+  response.finish(status.c_str(), STANDARD_HEADERS);  // empty body
 }
 
 void ServerApiImpl::simpleResponse(const std::vector<ID_t>& ids, int code, const std::string& message) {
   TRC("simpleResponse(size = %zu)", ids.size());
-  std::ostringstream oss;
+  json::Response response;
+  prepareSimpleResponse(response, code, message);  // the same for everyone
+  MSG("Response: %s", response.getData());
   if (ids.empty()) {
     DBG("Broadcasting simple response");
     for (auto& it : m_peers) {
-      prepareSimpleResponse(oss, code, message);
-      MSG("Response: %s", oss.str().c_str());
-      sendToSocket(it.second.getSocket(), oss.str().c_str(), oss.str().length());
-      oss.str("");
+      sendToSocket(it.second.getSocket(), response.getData(), response.getLength());
     }
   } else {
     for (auto& it : ids) {
       auto peer_it = m_peers.find(it);
       if (peer_it != m_peers.end()) {
         DBG("Sending simple response to peer with id [%lli]...", peer_it->first);
-        int socket = peer_it->second.getSocket();
-        prepareSimpleResponse(oss, code, message);
-        MSG("Response: %s", oss.str().c_str());
-        sendToSocket(socket, oss.str().c_str(), oss.str().length());
-        oss.str("");
+        sendToSocket(peer_it->second.getSocket(), response.getData(), response.getLength());
       } else {
         WRN("Peer with id [%lli] not found!", it);  // skip
       }
@@ -823,7 +1332,7 @@ bool ServerApiImpl::checkForAdmin(ID_t id, const std::string& cert_cipher) const
   bool result = false;
 #if SECURE
   bool decrypted = false;
-  std::string cert_plain = secure::good::decryptRSA(m_key_pair.second, cert_cipher, decrypted);
+  std::string cert_plain = secure::good::decryptRSA(m_key_cache.getPrivateKey(m_key_pair.second), cert_cipher, decrypted);
   if (!decrypted) {
     WRN("Failed to decrypt certificate: rejected to give administrating priviledges to source peer with ID [%lli]", id);
   } else {
@@ -850,6 +1359,13 @@ StatusCode ServerApiImpl::loginPeer(int socket, const LoginForm& form, ID_t& id)
   PeerDTO peer = getPeerFromDatabase(form.getLogin(), id);
   if (id != UNKNOWN_ID) {
     if (authenticate(peer.getPassword(), form.getPassword())) {
+      if (m_sessions.isDetached(id)) {
+        INF("Peer with ID[%lli] logs in again instead of resuming detached session", id);
+        std::ostringstream oss;
+        oss << PATH_LOGOUT << "?" D_ITEM_ID "=" << id << "&" D_ITEM_LOGIN "=" << peer.getLogin();
+        ID_t o_id = UNKNOWN_ID;
+        logout(oss.str(), o_id);
+      }
       if (m_peers.find(id) != m_peers.end()) {
         ERR("Authentication failed: already logged in");
         return StatusCode::ALREADY_LOGGED_IN;
@@ -889,31 +1405,33 @@ bool ServerApiImpl::authenticate(const std::string& expected_pass, const std::st
 void ServerApiImpl::doLogin(int socket, ID_t id, const std::string& name, const std::string& email) {
   TRC("doLogin(%lli, %s, %s)", id, name.c_str(), email.c_str());
   server::Peer peer(id, name, email);
-  peer.setToken(name);
+  peer.setToken(m_sessions.open(id));
   peer.setSocket(socket);
-  m_peers.insert(std::make_pair(id, peer));
+  if (m_peers.insert(std::make_pair(id, peer)).second) {
+    m_socket_peers[socket] = id;
+    m_roster.join(getListedPeer(peer));
+    m_roster_cache.invalidate(peer.getChannel());
+  }
 
   std::ostringstream oss_payload;
   oss_payload << "" D_ITEM_LOGIN "=" << name
               << "&" D_ITEM_EMAIL "=" << email;
   m_payload = oss_payload.str();  // extra data
 
-  // notify other peers
-  std::ostringstream oss, json;
+  // notify other peers, the same for everyone
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  writer.Key(ITEM_SYSTEM);   writer.String(name + " has logged in");
+  writer.Key(ITEM_ACTION);   writer.Int(static_cast<int>(Path::LOGIN));
+  writer.Key(ITEM_ID);       writer.Int64(id);
+  writer.Key(ITEM_PAYLOAD);  writer.String(m_payload);
+  writer.EndObject();
+  response.finish(LOGGED_IN_HEADER_PREFIX);
+  // MSG("Response: %s", response.getData());
   for (auto& it : m_peers) {
     if (it.first != id) {
-      json << "{\"" D_ITEM_SYSTEM "\":\"" << name << " has logged in\""
-           << ",\"" D_ITEM_ACTION "\":" << static_cast<int>(Path::LOGIN)
-           << ",\"" D_ITEM_ID "\":" << id
-           << ",\"" D_ITEM_PAYLOAD "\":\"" << m_payload
-           << "\"}";
-      oss << "HTTP/1.1 200 Logged In\r\n" << STANDARD_HEADERS << "\r\n"
-          << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-          << json.str() << "\0";
-      // MSG("Response: %s", oss.str().c_str());
-      sendToSocket(it.second.getSocket(), oss.str().c_str(), oss.str().length());
-      oss.str("");
-      json.str("");
+      sendToSocket(it.second.getSocket(), response.getData(), response.getLength());
     }
   }
 }
@@ -923,9 +1441,30 @@ bool ServerApiImpl::isAuthorized(ID_t id) const {
   return m_peers.find(id) != m_peers.end();
 }
 
+bool ServerApiImpl::isLoggedIn(int socket) const {
+  TRC("isLoggedIn(%i)", socket);
+  return m_socket_peers.find(socket) != m_socket_peers.end();
+}
+
 void ServerApiImpl::broadcast(const Message& message) {
   TRC("broadcast");
-  std::ostringstream oss;
+  std::string json = message.toJson();  // goes to history as is
+  // the same for every recipient, whatever it speaks
+  PushedMessage pushed;
+  {
+    json::Response response;
+    response.getWriter().RawValue(json.c_str(), json.length(), rapidjson::kObjectType);
+    response.finish(MESSAGE_HEADER_PREFIX);
+    pushed.http.assign(response.getData(), response.getLength());
+  }
+  wire::encodeMessage(message, &pushed.frame);
+  if (pushed.frame.length() >= WIRE_DEFLATE_THRESHOLD && hasDeflatedSockets()) {
+    std::lock_guard<std::mutex> latch(m_deflater_mutex);  // sending goes on meanwhile
+    m_deflater.deflate(pushed.frame.data(), pushed.frame.length(), &pushed.deflated);
+  }
+  ws::encodeFrame(ws::Opcode::TEXT, json.data(), json.length(), &pushed.ws_text);
+  ws::encodeFrame(ws::Opcode::BINARY, pushed.frame.data(), pushed.frame.length(), &pushed.ws_binary);
+  pushed.sse.append("event: message\ndata: ").append(json).append("\n\n");
 
   // send to dedicated peer
   ID_t dest_id = message.getDestId();
@@ -934,25 +1473,26 @@ void ServerApiImpl::broadcast(const Message& message) {
 #if ENABLED_LOGGING
     printf("Sending message to dedicated peer with id [%lli]......     ", dest_id);
 #endif
-    if (dest_id != message.getId() && it != m_peers.end()) {
+    if (dest_id != message.getId() && it != m_peers.end() && it->second.getSocket() >= 0) {
 #if ENABLED_LOGGING
       printf("\e[5;00;32mOK\e[m\n");
 #endif
-      std::string json = message.toJson();
-      oss << "HTTP/1.1 102 Processing\r\n" << STANDARD_HEADERS << "\r\n"
-          << CONTENT_LENGTH_HEADER << json.length() << "\r\n\r\n"
-          << json;
-      MSG("Response: %s", oss.str().c_str());
-      sendToSocket(it->second.getSocket(), oss.str().c_str(), oss.str().length());
-      oss.str("");
+      MSG("Response: %s", pushed.http.c_str());
+      sendToSocket(it->second.getSocket(), pushed);
     } else if (dest_id == message.getId()) {
 #if ENABLED_LOGGING
       printf("\e[5;00;33mNot sent: same peer\e[m\n");
 #endif
-    } else if (it == m_peers.end()) {
+    } else if (it == m_peers.end() || it->second.getSocket() < 0) {
+      // recipient is offline or its session is detached: store and forward later, expiring since now
+      if ((it != m_peers.end() || m_peers_database->hasPeer(dest_id)) &&
+          m_offline_queue->push(dest_id, common::getCurrentTime(), pushed.http)) {
 #if ENABLED_LOGGING
-      printf("\e[5;00;31mRecepient not found\e[m\n");
+        printf("\e[5;00;33mQueued: recepient is offline\e[m\n");
 #endif
+      } else {
+        printf("\e[5;00;31mMessage to peer [%lli] is lost: recepient is not registered or offline queue is full\e[m\n", dest_id);
+      }
     } else {
 #if ENABLED_LOGGING
       printf("\e[5;00;31mError\e[m\n");
@@ -961,6 +1501,9 @@ void ServerApiImpl::broadcast(const Message& message) {
     return;  // do not broadcast dedicated messages
   }
 
+  m_history->append(message.getChannel(), message.getTimestamp(), json);
+  DBG("Message has been recorded in journal at channel [%i]", message.getChannel());
+
   MSG("Broadcasting... total peers: %zu", m_peers.size());
   for (auto& it : m_peers) {
     ID_t id = it.first;
@@ -972,13 +1515,8 @@ void ServerApiImpl::broadcast(const Message& message) {
 #if ENABLED_LOGGING
       printf("\e[5;00;32mOK\e[m\n");
 #endif
-      std::string json = message.toJson();
-      oss << "HTTP/1.1 102 Processing\r\n" << STANDARD_HEADERS << "\r\n"
-          << CONTENT_LENGTH_HEADER << json.length() << "\r\n\r\n"
-          << json;
-      // MSG("Response: %s", oss.str().c_str());
-      sendToSocket(it.second.getSocket(), oss.str().c_str(), oss.str().length());
-      oss.str("");
+      // MSG("Response: %s", pushed.http.c_str());
+      sendToSocket(it.second.getSocket(), pushed);
     } else if (id == message.getId()) {
 #if ENABLED_LOGGING
       printf("\e[5;00;33mNot sent: same peer\e[m\n");
@@ -993,6 +1531,7 @@ void ServerApiImpl::broadcast(const Message& message) {
 #endif
     }
   }
+  m_subscribers.publish(message.getChannel(), pushed.sse);
 }
 
 /* Private secure communication */
@@ -1046,17 +1585,18 @@ StatusCode ServerApiImpl::privateRequest(const std::string& path, ID_t& id) {
         return StatusCode::ALREADY_RESPONDED;
     }
     recordPendingHandshake(id, dest_id);  // id --> dest_id
-    std::ostringstream oss, json;
-    json << "{\"" D_ITEM_PRIVATE_REQUEST "\":{\"" D_ITEM_SRC_ID "\":" << id
-         << ",\"" D_ITEM_DEST_ID "\":" << dest_id
-         << "}}";
-    oss << "HTTP/1.1 200 Handshake request\r\n" << STANDARD_HEADERS << "\r\n"
-        << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-        << json.str() << "\0";
-    MSG("Response: %s", oss.str().c_str());
-    sendToSocket(dest_peer_it->second.getSocket(), oss.str().c_str(), oss.str().length());
-    oss.str("");
-    json.str("");
+    json::Response response;
+    json::Writer& writer = response.getWriter();
+    writer.StartObject();
+    writer.Key(ITEM_PRIVATE_REQUEST);
+    writer.StartObject();
+    writer.Key(ITEM_SRC_ID);   writer.Int64(id);
+    writer.Key(ITEM_DEST_ID);  writer.Int64(dest_id);
+    writer.EndObject();
+    writer.EndObject();
+    response.finish(HANDSHAKE_REQUEST_HEADER_PREFIX);
+    MSG("Response: %s", response.getData());
+    sendToSocket(dest_peer_it->second.getSocket(), response.getData(), response.getLength());
   } else {
     ERR("Destination peer hasn't logged in, dest_id [%lli]", dest_id);
     return StatusCode::NO_SUCH_PEER;
@@ -1093,6 +1633,10 @@ StatusCode ServerApiImpl::privatePubKey(const std::string& path, const std::stri
     auto unwrapped_json = common::unwrapJsonObject(ITEM_PRIVATE_PUBKEY, json, common::PreparseLeniency::STRICT);
     try {
       secure::Key key = secure::Key::fromJson(unwrapped_json);
+      if (key.getVersion() == secure::KeyVersion::X25519 && !secure::agreement::verifyPublicKey(secure::Key(id, key.getKey(), key.getVersion()))) {
+        ERR("Agreement key of peer [%lli] has invalid signature", id);
+        return StatusCode::INVALID_FORM;
+      }
       storePublicKey(id, key);
     } catch (ConvertException e) {
       FAT("Key failed: invalid json: %s", unwrapped_json.c_str());
@@ -1105,7 +1649,7 @@ StatusCode ServerApiImpl::privatePubKey(const std::string& path, const std::stri
   return StatusCode::SUCCESS;
 }
 
-StatusCode ServerApiImpl::privatePubKeysExchange(const std::string& path, ID_t& id) {
+StatusCode ServerApiImpl::privatePubKeysExchange(const std::string& path, const std::string& json, ID_t& id) {
   TRC("privatePubKeysExchange(%s)", path.c_str());
   id = UNKNOWN_ID;
   std::vector<Query> params;
@@ -1139,15 +1683,56 @@ StatusCode ServerApiImpl::privatePubKeysExchange(const std::string& path, ID_t&
     return StatusCode::PUBLIC_KEY_MISSING;
   }
   auto src_public_key = m_keys_mapper.map(src_public_key_dto);
-  sendPubKey(src_public_key, dest_id);
+  secure::Key ephemeral = secure::Key::EMPTY;
+  if (!json.empty()) {
+    auto unwrapped_json = common::unwrapJsonObject(ITEM_PRIVATE_EPHEMERAL, json, common::PreparseLeniency::STRICT);
+    try {
+      ephemeral = secure::Key::fromJson(unwrapped_json);
+    } catch (ConvertException e) {
+      ERR("Private public keys exchange failed: invalid json: %s", unwrapped_json.c_str());
+      return StatusCode::INVALID_FORM;
+    }
+    if (!secure::agreement::verifyEphemeralKey(ephemeral, dest_id, src_public_key)) {
+      ERR("One-time key of peer [%lli] doesn't match its public key", src_id);
+      return StatusCode::INVALID_FORM;
+    }
+  }
+  sendPubKey(src_public_key, ephemeral, dest_id);
+  return StatusCode::SUCCESS;
 }
 
 void ServerApiImpl::setKeyPair(const std::pair<secure::Key, secure::Key>& keypair) {
   m_key_pair = keypair;
+  m_key_cache.invalidate(m_key_pair.second.getId());
+  m_key_cache.getPrivateKey(m_key_pair.second);  // parse once in advance
 }
 
 /* Utility */
 // ----------------------------------------------
+bool ServerApiImpl::decryptPassword(LoginForm& form) const {
+  bool decrypted = false;
+  std::string password;
+  secure::PKey private_key = m_key_cache.getPrivateKey(m_key_pair.second);
+  const std::string& cipher = form.getPassword();
+  if (!m_crypto_pool.execute([&private_key, &cipher, &password, &decrypted]() {
+        password = secure::good::decryptRSA(private_key, cipher, decrypted);
+      })) {
+    return false;
+  }
+  form.setPassword(password);
+  form.setEncrypted(!decrypted);
+  SYS("Decrypted password[%i]: %s", form.isEncrypted(), form.getPassword().c_str());
+  return true;
+}
+
+void ServerApiImpl::printCryptoStats() const {
+  printf("\e[5;00;33m    ***    Crypto workers    ***\e[m\n");
+  printf("  workers: %zu, queue depth: %zu, rejected: %" PRIu64 "\n",
+         m_crypto_pool.getWorkersCount(), m_crypto_pool.getQueueDepth(), m_crypto_pool.getRejectedCount());
+  printf("  queue depth at submission: %s\n", m_crypto_pool.getDepthHistogram().toString("tasks").c_str());
+  printf("  decrypt latency: %s\n", m_crypto_pool.getLatencyHistogram().toString("us").c_str());
+}
+
 StatusCode ServerApiImpl::sendPrivateConfirm(const std::string& path, bool i_abort, ID_t& src_id, ID_t& dest_id) {
   TRC("sendPrivateConfirm(%s, %i)", path.c_str(), static_cast<int>(i_abort));
   src_id = UNKNOWN_ID, dest_id = UNKNOWN_ID;
@@ -1224,25 +1809,19 @@ StatusCode ServerApiImpl::sendPrivateConfirm(const std::string& path, bool i_abo
       erasePendingHandshake(src_id, dest_id);  // handshake must be erased symmetrically
       DBG("Peer [%lli] has aborted previously established handshake with peer [%lli]", src_id, dest_id);
     }
-    std::ostringstream oss, json;
-    json << "{\"";
-    if (i_abort) {
-      json << D_ITEM_PRIVATE_ABORT;
-    } else {
-      json << D_ITEM_PRIVATE_CONFIRM;
-    }
-    json << "\":{\"" D_ITEM_SRC_ID "\":" << src_id
-         << ",\"" D_ITEM_DEST_ID "\":" << dest_id
-         << ",\"" D_ITEM_ACCEPT "\":" << (accept ? 1 : 0)
-         << "}}";
-    oss << "HTTP/1.1 200 Handshake " << (accept ? "confirmed" : "rejected") << "\r\n"
-        << STANDARD_HEADERS << "\r\n"
-        << CONTENT_LENGTH_HEADER << json.str().length() << "\r\n\r\n"
-        << json.str() << "\0";
-    MSG("Response: %s", oss.str().c_str());
-    sendToSocket(dest_peer_it->second.getSocket(), oss.str().c_str(), oss.str().length());
-    oss.str("");
-    json.str("");
+    json::Response response;
+    json::Writer& writer = response.getWriter();
+    writer.StartObject();
+    writer.Key(i_abort ? ITEM_PRIVATE_ABORT : ITEM_PRIVATE_CONFIRM);
+    writer.StartObject();
+    writer.Key(ITEM_SRC_ID);   writer.Int64(src_id);
+    writer.Key(ITEM_DEST_ID);  writer.Int64(dest_id);
+    writer.Key(ITEM_ACCEPT);   writer.Int(accept ? 1 : 0);
+    writer.EndObject();
+    writer.EndObject();
+    response.finish(accept ? HANDSHAKE_CONFIRMED_HEADER_PREFIX : HANDSHAKE_REJECTED_HEADER_PREFIX);
+    MSG("Response: %s", response.getData());
+    sendToSocket(dest_peer_it->second.getSocket(), response.getData(), response.getLength());
   } else {
     ERR("Destination peer hasn't logged in, dest_id [%lli]", dest_id);
     return StatusCode::NO_SUCH_PEER;
@@ -1252,16 +1831,20 @@ StatusCode ServerApiImpl::sendPrivateConfirm(const std::string& path, bool i_abo
 
 void ServerApiImpl::storePublicKey(ID_t id, const secure::Key& key) {
   TRC("storePublicKey(%lli)", id);
-  KeyDTO key_dto(id, key.getKey());
+  KeyDTO key_dto(id, key.getKey(), static_cast<int>(key.getVersion()));
   m_keys_database->addKey(id, key_dto);
+  m_key_cache.invalidate(id);  // drop previous key of this peer
+  if (key.getVersion() == secure::KeyVersion::RSA_PEM && !m_key_cache.getPublicKey(secure::Key(id, key.getKey()))) {
+    WRN("Public key of peer with ID [%lli] is not a valid PEM", id);
+  }
 }
 
 void ServerApiImpl::exchangePublicKeys(const secure::Key& src_key, const secure::Key& dest_key) {
   ID_t src_id = src_key.getId();
   ID_t dest_id = dest_key.getId();
   TRC("exchangePublicKeys(%lli, %lli)", src_id, dest_id);
-  sendPubKey(src_key, dest_id);
-  sendPubKey(dest_key, src_id);
+  sendPubKey(src_key, secure::Key::EMPTY, dest_id);
+  sendPubKey(dest_key, secure::Key::EMPTY, src_id);
 }
 
 /* Handshake */
@@ -31,13 +31,28 @@
 
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <sys/uio.h>
 #include "api/api.h"
 #include "api/structures.h"
+#include "database/message_history.h"
+#include "database/message_journal.h"
+#include "database/offline_queue.h"
+#include "json_writer.h"
 #include "mapper.h"
 #include "parser/my_parser.h"
 #include "peer.h"
+#include "roster_cache.h"
+#include "roster_log.h"
+#include "session_table.h"
 #include "storage/peer_table.h"
+#include "subscriber_table.h"
+#include "websocket.h"
+#include "wire.h"
 #if SECURE
+#include "crypting/crypto_pool.h"
+#include "crypting/key_cache.h"
+#include "crypting/tls_terminator.h"
 #include "storage/keys_table.h"
 #endif  // SECURE
 
@@ -64,7 +79,7 @@ public:
 // ----------------------------------------------------------------------------
 class ServerApiImpl : public ServerApi {
 public:
-  ServerApiImpl();
+  ServerApiImpl(uint64_t session_grace_period = DEFAULT_SESSION_GRACE_PERIOD);
   virtual ~ServerApiImpl();
 
   void kickPeer(ID_t id) override;
@@ -83,14 +98,18 @@ public:
   void sendRegistrationForm(int socket) override;
   void sendStatus(int socket, StatusCode status, Path action, ID_t id) override;
   void sendCheck(int socket, bool check, Path action, ID_t id) override;
-  void sendPeers(int socket, StatusCode status, const std::vector<Peer>& peers, int channel) override;
+  void sendPeers(int socket, StatusCode status, const Roster& roster) override;
+  void sendHistory(int socket, StatusCode status, const std::string& frames, int channel, uint64_t last_seq) override;
+  void sendMissedMessages(int socket, int channel, uint64_t since_seq) override;
+  void sendOfflineMessages(int socket, ID_t id) override;
 #if SECURE
-  void sendPubKey(const secure::Key& key, ID_t dest_id) override;
+  void sendPubKey(const secure::Key& key, const secure::Key& ephemeral, ID_t dest_id) override;
 #endif
 
   StatusCode login(int socket, const std::string& json, ID_t& id) override;
   StatusCode registrate(int socket, const std::string& json, ID_t& id) override;
   StatusCode message(const std::string& json, ID_t& id) override;
+  StatusCode message(const Message& message, ID_t& id) override;
   StatusCode logout(const std::string& path, ID_t& id) override;
   StatusCode switchChannel(const std::string& path, ID_t& id) override;
   bool getPeerId(const std::string& path, ID_t& id) override;
@@ -98,13 +117,15 @@ public:
   bool checkRegistered(const std::string& path, ID_t& id) override;
   bool checkAuth(const std::string& path, ID_t& id) override;
   bool kickByAuth(const std::string& path, ID_t& id) override;
-  StatusCode getAllPeers(const std::string& path, std::vector<Peer>* peers, int& channel) override;
+  StatusCode getAllPeers(const std::string& path, Roster* roster) override;
+  StatusCode getHistory(int socket, const std::string& path, std::string* frames, int& channel, uint64_t& last_seq) override;
+  StatusCode resume(int socket, const std::string& path, ID_t& id, int& channel, uint64_t& since_seq) override;
 #if SECURE
   StatusCode privateRequest(const std::string& path, ID_t& id) override;
   StatusCode privateConfirm(const std::string& path, ID_t& id) override;
   StatusCode privateAbort(const std::string& path, ID_t& id) override;
   StatusCode privatePubKey(const std::string& path, const std::string& json, ID_t& id) override;
-  StatusCode privatePubKeysExchange(const std::string& path, ID_t& id) override;
+  StatusCode privatePubKeysExchange(const std::string& path, const std::string& json, ID_t& id) override;
 
   void setKeyPair(const std::pair<secure::Key, secure::Key>& keypair) override;
 #endif  // SECURE
@@ -116,15 +137,52 @@ public:
   /* Internal */
   // --------------------------------------------
   void listAllPeers() const;
+  int compactJournal();
+  int expireSessions();
+  int compactOfflineQueue();
+  void setFramed(int socket, bool is_framed, bool is_deflated = false);  // responses go as binary frames, see wire.h
+  bool upgradeToWebSocket(int socket, const Request& request);  // answers handshake, see websocket.h
+  void removeWebSocket(int socket);
+  void touchWebSocket(int socket);  // peer has shown it is alive
+  void sendWebSocketFrame(int socket, ws::Opcode opcode, const char* payload, size_t length);
+  int pingWebSockets();  // drops peers which missed pongs, returns total pinged
+  StatusCode subscribe(int socket, const std::string& path);  // takes over socket, see subscriber_table.h
+  std::string issueReadToken(int channel);
+  int heartbeatSubscribers();  // returns total dropped
 #if SECURE
   void listPrivateCommunications() const;
+  void printCryptoStats() const;
+  inline void setTlsTerminator(secure::TlsTerminator* tls) { m_tls = tls; }
 #endif  // SECURE
 
 private:
+  /* Message pushed to peers, prepared once in every encoding they could speak */
+  struct PushedMessage {
+    std::string http;
+    std::string frame;      // see wire.h
+    std::string deflated;   // frame compressed, if worth it
+    std::string ws_text;    // see websocket.h
+    std::string ws_binary;
+    std::string sse;        // Server-Sent Event
+  };
+
+  struct WebSocket {
+    bool is_binary;  // WS_PROTOCOL_FRAME negotiated
+    uint64_t last_seen_timestamp;
+  };
+
   std::string m_payload;  // extra data
   MyParser m_parser;
   std::unordered_map<ID_t, server::Peer> m_peers;
+  std::unordered_map<int, ID_t> m_socket_peers;  // socket -> id of peer logged in over it, attached ones only
   IPeerTable* m_peers_database;
+  db::MessageJournal* m_journal;
+  db::MessageHistory* m_history;
+  db::OfflineQueue* m_offline_queue;
+  server::SessionTable m_sessions;
+  server::SubscriberTable m_subscribers;  // read-only, not peers
+  server::RosterLog m_roster;  // changes of 'm_peers', for delta sync
+  server::RosterCache m_roster_cache;  // whole lists serialized, by channel
 #if SECURE
   IKeysTable* m_keys_database;
   std::unordered_map<ID_t, std::unordered_map<ID_t, HandshakeStatus>> m_handshakes;
@@ -134,10 +192,23 @@ private:
 #if SECURE
   KeyDTOtoKeyMapper m_keys_mapper;
   std::pair<secure::Key, secure::Key> m_key_pair;
+  mutable secure::KeyCache m_key_cache;  // parsed server's key pair and peers' public keys
+  mutable secure::CryptoWorkerPool m_crypto_pool;  // private key operations of login and registration
+  secure::TlsTerminator* m_tls;  // not owned, null if TLS is terminated elsewhere
 #endif  // SECURE
+  std::unordered_set<int> m_framed_sockets;
+  std::unordered_set<int> m_deflated_sockets;  // framed, accept DEFLATED frames
+  wire::Deflater m_deflater;
+  std::mutex m_deflater_mutex;  // taken after m_mutex, if both
+  std::unordered_map<int, WebSocket> m_websockets;
   std::mutex m_mutex;
 
   void sendToSocket(int socket, const char* buffer, int length);
+  bool sendToSocket(int socket, std::vector<iovec>& buffers);  // false if not written completely
+  void sendToSocket(int socket, const PushedMessage& message);  // whichever connection speaks
+  bool writeToSocket(int socket, const char* buffer, int length);
+  bool writeFramesToSocket(int socket, std::string& frames);  // compressed, if peer accepts
+  bool hasDeflatedSockets();  // otherwise broadcast is not worth compressing
   void sendSystemMessage(int socket, const std::string& message);
 
   StatusCode loginPeer(int socket, const LoginForm& form, ID_t& id);
@@ -145,16 +216,19 @@ private:
   bool authenticate(const std::string& expected_pass, const std::string& actual_pass) const;
   void doLogin(int socket, ID_t id, const std::string& name, const std::string& email);
   bool isAuthorized(ID_t id) const;
+  bool isLoggedIn(int socket) const;  // some peer is logged in over socket
   void broadcast(const Message& message);
 
   /* Utility */
   std::string getSymbolicFromQuery(const std::string& path) const;
   PeerDTO getPeerFromDatabase(const std::string& symbolic, ID_t& id) const;
-  std::ostringstream& prepareSimpleResponse(std::ostringstream& out, int code, const std::string& message) const;
+  Peer getListedPeer(const server::Peer& peer) const;  // as seen in list of peers
+  void prepareSimpleResponse(json::Response& response, int code, const std::string& message) const;
   void simpleResponse(const std::vector<ID_t>& ids, int code, const std::string& message);
   bool checkPermission(ID_t id) const;
   bool checkForAdmin(ID_t id, const std::string& payload) const;
 #if SECURE
+  bool decryptPassword(LoginForm& form) const;  // false if crypto workers are overloaded
   StatusCode sendPrivateConfirm(const std::string& path, bool i_abort, ID_t& src_id, ID_t& dest_id);
   void storePublicKey(ID_t id, const secure::Key& key);
   void exchangePublicKeys(const secure::Key& src_key, const secure::Key& dest_key);
@@ -29,20 +29,25 @@
 #include <string>
 #include <cstdio>
 #include <cstring>
+#include <vector>
+#include "common.h"
 #include "logger.h"
 #include "server_menu.h"
 
 namespace menu {
 
+const char* EXPO = "expo";
 const char* HELP = "help";
 const char* KICK = "kick";
 const char* LOGI = "logi";
 const char* LIST = "list";
 const char* MESG = "mesg";
 #if SECURE
+const char* CRYP = "cryp";
 const char* PRIV = "priv";
 #endif  // SECURE
 const char* STOP = "stop";
+const char* STRM = "strm";
 
 static bool evaluateKick(const std::string& command, ID_t& id) {
   id = UNKNOWN_ID;
@@ -57,6 +62,25 @@ static bool evaluateKick(const std::string& command, ID_t& id) {
   return false;
 }
 
+static bool evaluateExport(const std::string& command, std::string& day, ID_t& id) {
+  id = UNKNOWN_ID;
+  if (command.length() >= 13 &&
+      command[0] == EXPO[0] && command[1] == EXPO[1] && command[2] == EXPO[2] && command[3] == EXPO[3]) {
+    std::vector<std::string> tokens;
+    common::split(command, ' ', &tokens);
+    if (tokens.size() >= 2) {
+      day = tokens[1];
+      if (tokens.size() >= 3) {
+        if (!common::isNumber(tokens[2], id)) {
+          id = UNKNOWN_ID;
+        }
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
 static bool evaluateMessage(const std::string& command, ID_t& id, char*& message) {
   id = UNKNOWN_ID;
   if (command.length() >= 6 &&
@@ -80,23 +104,46 @@ static bool evaluateMessage(const std::string& command, ID_t& id, char*& message
   return false;
 }
 
+static bool evaluateStream(const std::string& command, int& channel) {
+  channel = WRONG_CHANNEL;
+  if (command.length() >= 4 &&
+      command[0] == STRM[0] && command[1] == STRM[1] && command[2] == STRM[2] && command[3] == STRM[3]) {
+    std::vector<std::string> tokens;
+    common::split(command, ' ', &tokens);
+    ID_t value = WRONG_CHANNEL;
+    if (tokens.size() >= 2 && common::isNumber(tokens[1], value)) {
+      channel = value;
+    }
+    return true;
+  }
+  return false;
+}
+
 bool evaluate(Server* server, const std::string& command) {
   ID_t id = UNKNOWN_ID;
+  int channel = WRONG_CHANNEL;
   char* message = nullptr;
+  std::string day;
   if (strcmp(HELP, command.c_str()) == 0) {
     printHelp();
+  } else if (evaluateExport(command, day, id)) {
+    server->exportLogs(day, id);
   } else if (evaluateKick(command, id)) {
     server->kick(id);
   } else if (strcmp(LOGI, command.c_str()) == 0) {
     server->logIncoming();
   } else if (strcmp(LIST, command.c_str()) == 0) {
     server->listAllPeers();
+  } else if (evaluateStream(command, channel)) {
+    server->issueReadToken(channel);
   } else if (evaluateMessage(command, id, message)) {
     server->sendMessage(id, message);
     delete [] message;  message = nullptr;
 #if SECURE
   } else if (strcmp(PRIV, command.c_str()) == 0) {
     server->listPrivateCommunications();
+  } else if (strcmp(CRYP, command.c_str()) == 0) {
+    server->printCryptoStats();
 #endif  // SECURE
   } else if (strcmp(STOP, command.c_str()) == 0) {
     server->stop();
@@ -112,10 +159,13 @@ void printHelp() {
   printf("Commands:\n\t%s - print this help \
                    \n\t%s - force logout peer with <id> \
                    \n\t%s - enable / disable incoming requests logging \
+                   \n\t%s - export logs of <YYYYMMDD> day into file, optionally for <connection id> \
                    \n\t%s - list all logged in peers \
-                   \n\t%s - broadcast system message to all peers", HELP, KICK, LOGI, LIST, MESG);
+                   \n\t%s - broadcast system message to all peers \
+                   \n\t%s - issue read token to stream <channel>, or all channels if omitted", HELP, KICK, LOGI, EXPO, LIST, MESG, STRM);
 #if SECURE
   printf("\n\t%s - show list of private communications", PRIV);
+  printf("\n\t%s - show crypto workers queue depth and latencies", CRYP);
 #endif  // SECURE
   printf("\n\t%s - send terminate signal to all peers and stop server\n", STOP);
 }
@@ -0,0 +1,166 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+#include "common.h"
+#include "logger.h"
+#include "session_table.h"
+
+namespace server {
+
+SessionTable::SessionTable(uint64_t grace_period)
+  : m_grace_period(grace_period) {
+  m_random_fd = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+  if (m_random_fd < 0) {
+    WRN("Failed to open /dev/urandom, falling back to std::random_device for session tokens");
+  }
+}
+
+SessionTable::~SessionTable() {
+  if (m_random_fd >= 0) {
+    ::close(m_random_fd);
+  }
+}
+
+std::string SessionTable::open(ID_t id) {
+  TRC("open(%lli)", id);
+  std::string token = generateToken();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_tokens.find(id);
+  if (it != m_tokens.end()) {
+    m_sessions.erase(it->second);  // previous session is superseded
+  }
+  Session session;
+  session.id = id;
+  m_sessions[token] = session;
+  m_tokens[id] = token;
+  return token;
+}
+
+void SessionTable::close(ID_t id) {
+  TRC("close(%lli)", id);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_tokens.find(id);
+  if (it != m_tokens.end()) {
+    m_sessions.erase(it->second);
+    m_tokens.erase(it);
+  }
+}
+
+bool SessionTable::detach(ID_t id, int channel, uint64_t last_seq, uint64_t timestamp) {
+  TRC("detach(%lli)", id);
+  if (m_grace_period == 0) {
+    return false;  // resumption disabled
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_tokens.find(id);
+  if (it == m_tokens.end()) {
+    return false;
+  }
+  Session& session = m_sessions[it->second];
+  session.is_detached = true;
+  session.detach_timestamp = timestamp;
+  session.channel = channel;
+  session.last_seq = last_seq;
+  return true;
+}
+
+bool SessionTable::isDetached(ID_t id) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_tokens.find(id);
+  return it != m_tokens.end() && m_sessions[it->second].is_detached;
+}
+
+ResumeStatus SessionTable::resume(ID_t id, const std::string& token, uint64_t timestamp, Session* session) {
+  TRC("resume(%lli)", id);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_sessions.find(token);
+  if (it == m_sessions.end() || it->second.id != id) {
+    return ResumeStatus::NO_SUCH_SESSION;
+  }
+  if (!it->second.is_detached) {
+    return ResumeStatus::ATTACHED;  // peer's connection is alive, nothing to take over
+  }
+  if (timestamp - it->second.detach_timestamp > m_grace_period) {
+    return ResumeStatus::EXPIRED;  // will be swept by expire()
+  }
+  *session = it->second;
+  it->second.is_detached = false;
+  return ResumeStatus::SUCCESS;
+}
+
+void SessionTable::expire(uint64_t timestamp, std::vector<ID_t>* expired) {
+  TRC("expire");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_sessions.begin(); it != m_sessions.end(); ) {
+    if (it->second.is_detached && timestamp - it->second.detach_timestamp > m_grace_period) {
+      expired->push_back(it->second.id);
+      m_tokens.erase(it->second.id);
+      it = m_sessions.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+std::string SessionTable::openReadToken(int channel) {
+  TRC("openReadToken(%i)", channel);
+  std::string token = generateToken();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_read_tokens[token] = channel;
+  return token;
+}
+
+bool SessionTable::checkReadToken(const std::string& token, int channel) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_read_tokens.find(token);
+  return it != m_read_tokens.end() && (it->second == WRONG_CHANNEL || it->second == channel);
+}
+
+std::string SessionTable::generateToken() {
+  unsigned char buffer[SESSION_TOKEN_BYTES];
+  size_t total = 0;
+  while (m_random_fd >= 0 && total < SESSION_TOKEN_BYTES) {
+    ssize_t read_bytes = ::read(m_random_fd, buffer + total, SESSION_TOKEN_BYTES - total);
+    if (read_bytes <= 0) {
+      break;
+    }
+    total += read_bytes;
+  }
+  if (total < SESSION_TOKEN_BYTES) {
+    std::random_device device;
+    for (size_t i = 0; i < SESSION_TOKEN_BYTES; ++i) {
+      buffer[i] = static_cast<unsigned char>(device());
+    }
+  }
+  return common::bin2hex(buffer, SESSION_TOKEN_BYTES);
+}
+
+}  // namespace server
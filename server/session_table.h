@@ -0,0 +1,91 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_SESSION_TABLE__H__
+#define CHAT_SERVER_SESSION_TABLE__H__
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "api/types.h"
+
+#define SESSION_TOKEN_BYTES 16
+#define DEFAULT_SESSION_GRACE_PERIOD 60000  // in ms, 1 minute
+
+namespace server {
+
+/**
+ * Live session of logged in peer, addressed by random token issued at login.
+ * Session gets 'detached' when peer's connection drops and could be resumed
+ * on another socket until grace period expires.
+ */
+struct Session {
+  ID_t id = UNKNOWN_ID;
+  bool is_detached = false;
+  uint64_t detach_timestamp = 0;
+  int channel = DEFAULT_CHANNEL;
+  uint64_t last_seq = 0;  // last message seen on channel before detach
+};
+
+enum class ResumeStatus : int {
+  SUCCESS = 0, NO_SUCH_SESSION = 1, EXPIRED = 2, ATTACHED = 3
+};
+
+class SessionTable {
+public:
+  SessionTable(uint64_t grace_period = DEFAULT_SESSION_GRACE_PERIOD);
+  virtual ~SessionTable();
+
+  std::string open(ID_t id);
+  void close(ID_t id);
+  bool detach(ID_t id, int channel, uint64_t last_seq, uint64_t timestamp);
+  bool isDetached(ID_t id);
+  ResumeStatus resume(ID_t id, const std::string& token, uint64_t timestamp, Session* session);
+  void expire(uint64_t timestamp, std::vector<ID_t>* expired);
+
+  /* Read-only access to channel stream, WRONG_CHANNEL grants every channel */
+  std::string openReadToken(int channel);
+  bool checkReadToken(const std::string& token, int channel);
+
+  inline uint64_t getGracePeriod() const { return m_grace_period; }
+
+private:
+  uint64_t m_grace_period;
+  int m_random_fd;
+  std::unordered_map<std::string, Session> m_sessions;  // token -> session
+  std::unordered_map<ID_t, std::string> m_tokens;       // peer id -> token
+  std::unordered_map<std::string, int> m_read_tokens;   // read token -> channel
+  std::mutex m_mutex;
+
+  std::string generateToken();
+};
+
+}  // namespace server
+
+#endif  // CHAT_SERVER_SESSION_TABLE__H__
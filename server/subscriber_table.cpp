@@ -0,0 +1,141 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "logger.h"
+#include "subscriber_table.h"
+
+namespace server {
+
+SubscriberTable::SubscriberTable()
+  : m_writer([](int socket, const char* buffer, size_t length) {
+      return send(socket, buffer, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    })
+  , m_closer([](int socket) { ::close(socket); })
+  , m_total(0) {
+}
+
+SubscriberTable::~SubscriberTable() {
+  clear();
+}
+
+void SubscriberTable::subscribe(int socket, int channel) {
+  TRC("subscribe(%i, %i)", socket, channel);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_channels[channel].emplace(socket, Subscriber()).second) {
+    ++m_total;
+  }
+}
+
+int SubscriberTable::publish(int channel, const std::string& event) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it_channel = m_channels.find(channel);
+  if (it_channel == m_channels.end()) {
+    return 0;
+  }
+  int total = 0;
+  auto& subscribers = it_channel->second;
+  for (auto it = subscribers.begin(); it != subscribers.end(); ) {
+    if (write(it->first, it->second, event)) {
+      ++total;
+      ++it;
+    } else {
+      m_closer(it->first);
+      it = subscribers.erase(it);
+      --m_total;
+    }
+  }
+  return total;
+}
+
+int SubscriberTable::publishAll(const std::string& event) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  int dropped = 0;
+  for (auto& it_channel : m_channels) {
+    auto& subscribers = it_channel.second;
+    for (auto it = subscribers.begin(); it != subscribers.end(); ) {
+      if (write(it->first, it->second, event)) {
+        ++it;
+      } else {
+        m_closer(it->first);
+        it = subscribers.erase(it);
+        --m_total;
+        ++dropped;
+      }
+    }
+  }
+  return dropped;
+}
+
+void SubscriberTable::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& it_channel : m_channels) {
+    for (auto& it : it_channel.second) {
+      m_closer(it.first);
+    }
+  }
+  m_channels.clear();
+  m_total = 0;
+}
+
+size_t SubscriberTable::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_total;
+}
+
+bool SubscriberTable::write(int socket, Subscriber& subscriber, const std::string& event) {
+  if (!subscriber.pending.empty()) {
+    subscriber.pending.append(event);  // batch with backlog
+  }
+  const std::string& data = subscriber.pending.empty() ? event : subscriber.pending;
+  ssize_t written = m_writer(socket, data.c_str(), data.length());
+  if (written < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      DBG("Subscriber on socket %i has gone: %s", socket, strerror(errno));
+      return false;
+    }
+    written = 0;
+  }
+  if (subscriber.pending.empty()) {
+    if (static_cast<size_t>(written) < event.length()) {
+      subscriber.pending.assign(event, written, std::string::npos);
+    }
+  } else {
+    subscriber.pending.erase(0, written);
+  }
+  if (subscriber.pending.length() > SSE_MAX_PENDING_BYTES) {
+    WRN("Subscriber on socket %i is too slow, %zu bytes behind", socket, subscriber.pending.length());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace server
@@ -0,0 +1,88 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_SUBSCRIBER_TABLE__H__
+#define CHAT_SERVER_SUBSCRIBER_TABLE__H__
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/types.h>
+
+#define SSE_MAX_PENDING_BYTES 262144  // subscriber lagging behind more is dropped
+
+namespace server {
+
+/* Writes without blocking, returns number of bytes written or -1 and errno */
+typedef std::function<ssize_t (int socket, const char* buffer, size_t length)> SocketWriter;
+typedef std::function<void (int socket)> SocketCloser;
+
+/**
+ * Read-only subscribers of channels, streamed with Server-Sent Events.
+ *
+ * Subscriber is not a peer: it has neither id nor slot in peer registry and
+ * no thread reading its socket, table owns the socket once subscribed. Every
+ * event is sent to all subscribers of channel as the same buffer. Events for
+ * a backed up socket are kept and go out together with next ones in a single
+ * write, subscriber is dropped once that backlog exceeds SSE_MAX_PENDING_BYTES.
+ */
+class SubscriberTable {
+public:
+  SubscriberTable();
+  virtual ~SubscriberTable();
+
+  inline void setWriter(const SocketWriter& writer) { m_writer = writer; }
+  inline void setCloser(const SocketCloser& closer) { m_closer = closer; }
+
+  void subscribe(int socket, int channel);
+  /* Returns total of subscribers event was sent or queued to */
+  int publish(int channel, const std::string& event);
+  /* Same, for every channel, returns total of dropped subscribers */
+  int publishAll(const std::string& event);
+  void clear();  // closes all sockets
+
+  size_t size() const;
+
+private:
+  struct Subscriber {
+    std::string pending;  // events not yet written
+  };
+
+  std::unordered_map<int, std::unordered_map<int, Subscriber>> m_channels;  // channel -> socket -> subscriber
+  SocketWriter m_writer;
+  SocketCloser m_closer;
+  size_t m_total;
+  mutable std::mutex m_mutex;
+
+  bool write(int socket, Subscriber& subscriber, const std::string& event);  // false if should be dropped
+};
+
+}  // namespace server
+
+#endif  // CHAT_SERVER_SUBSCRIBER_TABLE__H__
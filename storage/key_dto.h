@@ -38,10 +38,11 @@ class KeyDTO {
 public:
   static KeyDTO EMPTY;
 
-  KeyDTO(ID_t id, const std::string& key);
+  KeyDTO(ID_t id, const std::string& key, int version = 1);  // see secure::KeyVersion
 
   inline ID_t getId() const { return m_id; }
   inline const std::string& getKey() const { return m_key; }
+  inline int getVersion() const { return m_version; }
 
   inline bool operator == (const KeyDTO& rhs) const { return m_id == rhs.m_id; }
   inline bool operator != (const KeyDTO& rhs) const { return !(*this == rhs); }
@@ -49,6 +50,7 @@ public:
 private:
   ID_t m_id;
   std::string m_key;
+  int m_version;
 };
 
 #endif  // SECURE
@@ -41,6 +41,7 @@ public:
   virtual void removePeer(ID_t id) = 0;
   virtual PeerDTO getPeerByLogin(const std::string& login, ID_t* id) = 0;
   virtual PeerDTO getPeerByEmail(const std::string& email, ID_t* id) = 0;
+  virtual bool hasPeer(ID_t id) = 0;  // registered
 };
 
 #endif  // CHAT_SERVER_PEER_TABLE__H__
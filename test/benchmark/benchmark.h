@@ -0,0 +1,122 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#ifndef CHAT_SERVER_BENCHMARK__H__
+#define CHAT_SERVER_BENCHMARK__H__
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+
+/**
+ * Minimal benchmark harness: each BENCHMARK(group, name) body is registered
+ * at static initialization and run from main(), optionally filtered by name.
+ */
+namespace bench {
+
+typedef void (*Function)();
+
+struct Entry {
+  std::string name;
+  Function function;
+};
+
+inline std::vector<Entry>& registry() {
+  static std::vector<Entry> entries;
+  return entries;
+}
+
+struct Registrar {
+  Registrar(const char* name, Function function) {
+    registry().push_back({name, function});
+  }
+};
+
+inline void report(const char* label, size_t operations, double seconds) {
+  printf("  %-48s %12zu ops %10.3f s %14.0f ops/s\n", label, operations, seconds, operations / seconds);
+}
+
+/* Runs 'function(i)' for 'iterations' times and prints throughput */
+template <typename Function>
+double measure(const char* label, size_t iterations, Function function) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    function(i);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report(label, iterations, seconds);
+  return seconds;
+}
+
+/* Same as above, but spreads iterations over 'threads' concurrent threads */
+template <typename Function>
+double measureConcurrent(const char* label, size_t threads, size_t iterations, Function function) {
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([t, threads, iterations, &function]() {
+      for (size_t i = t; i < iterations; i += threads) {
+        function(i);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report(label, iterations, seconds);
+  return seconds;
+}
+
+inline void removeDirectory(const std::string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir != nullptr) {
+    dirent* entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+      std::string name(entry->d_name);
+      if (name != "." && name != "..") {
+        unlink((directory + "/" + name).c_str());
+      }
+    }
+    closedir(dir);
+  }
+  rmdir(directory.c_str());
+}
+
+}  // namespace bench
+
+#define BENCHMARK(group, name)                                                  \
+  static void group##_##name##_Benchmark();                                     \
+  static bench::Registrar group##_##name##_registrar(#group "." #name, &group##_##name##_Benchmark); \
+  static void group##_##name##_Benchmark()
+
+#endif  // CHAT_SERVER_BENCHMARK__H__
@@ -0,0 +1,83 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <string>
+#include "api/api.h"
+#include "api/structures.h"
+#include "client/utils.h"
+#include "common.h"
+#include "rapidjson/document.h"
+
+namespace bench {
+
+// previous classification in Client::receiverThread: status, check, system message
+// and private handshake were probed in turn, parsing the body each time
+static bool documentHasMember(const std::string& json, const char* item) {
+  rapidjson::Document document;
+  auto prepared_json = common::preparse(json);
+  document.Parse(prepared_json.c_str());
+  return document.IsObject() && document.HasMember(item);
+}
+
+static bool documentClassify(const std::string& json, Message* message) {
+  if (documentHasMember(json, ITEM_CODE) || documentHasMember(json, ITEM_CHECK) ||
+      documentHasMember(json, ITEM_SYSTEM)) {
+    return false;
+  }
+#if SECURE
+  if (documentHasMember(json, ITEM_PRIVATE_REQUEST)) {
+    return false;
+  }
+#endif  // SECURE
+  *message = Message::fromJson(json);
+  return true;
+}
+
+BENCHMARK(Client, Receive) {
+  common::Dictionary dictionary;
+  const size_t iterations = 200000;
+  std::string json = Message::Builder(1000).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(500)
+      .setDestId(0).setTimestamp(1461516681500)
+      .setMessage(dictionary.getMessage(16)).build().toJson();
+
+  Message message;
+  measure("message, probe with four parses", iterations, [&json, &message](size_t i) {
+    documentClassify(json, &message);
+  });
+  util::ResponseEvent event;
+  measure("message, single-pass classification", iterations, [&json, &event](size_t i) {
+    util::classifyResponse(json, &event);
+  });
+
+  std::string system = "{\"system\":\"Peer has logged out\",\"action\":4,\"id\":1000,\"payload\":\"\"}";
+  measure("system message, single-pass classification", iterations, [&system, &event](size_t i) {
+    util::classifyResponse(system, &event);
+  });
+}
+
+}
@@ -0,0 +1,101 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "codec.h"
+
+namespace bench {
+
+static const char* CODEC_LEVEL_NAMES[] = {"scalar", "ssse3", "avx2"};
+
+static void reportBandwidth(const char* label, size_t iterations, size_t bytes, double seconds) {
+  printf("  %-48s %14.3f GB/s\n", label, iterations * bytes / seconds / 1e9);
+}  // namespace bench
+
+// previous implementation of common::bin2hex, kept here as a baseline
+static std::string streamHex(const unsigned char* src, size_t size) {
+  std::ostringstream oss;
+  for (size_t i = 0; i < size; ++i) {
+    int value = static_cast<int>(src[i]);
+    if (value < 16) {
+      oss << '0';
+    }
+    oss << std::hex << value;
+  }
+  return oss.str();
+}  // namespace bench
+
+BENCHMARK(Codec, Bandwidth) {
+  const size_t size = 64 * 1024;
+  std::vector<unsigned char> bytes(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = rand() & 0xFF;
+  }
+  std::string hex(codec::hexEncodedLength(size), '\0');
+  std::string base64(codec::base64EncodedLength(size), '\0');
+  std::vector<unsigned char> decoded(size);
+  size_t length = 0;
+
+  double seconds = measure("hex encode, ostringstream", 100, [&bytes](size_t i) {
+    streamHex(bytes.data(), bytes.size());
+  });
+  reportBandwidth("hex encode, ostringstream", 100, size, seconds);
+
+  codec::Level supported = codec::getSupportedLevel();
+  const size_t iterations = 20000;
+  for (int level = codec::Level::SCALAR; level <= supported; ++level) {
+    codec::setLevel(static_cast<codec::Level>(level));
+    std::string name = CODEC_LEVEL_NAMES[level];
+
+    seconds = measure(("hex encode, " + name).c_str(), iterations, [&bytes, &hex](size_t i) {
+      codec::hexEncode(bytes.data(), bytes.size(), &hex[0]);
+    });
+    reportBandwidth(("hex encode, " + name).c_str(), iterations, size, seconds);
+
+    seconds = measure(("hex decode, " + name).c_str(), iterations, [&hex, &decoded, &length](size_t i) {
+      codec::hexDecode(hex.c_str(), hex.length(), decoded.data(), length);
+    });
+    reportBandwidth(("hex decode, " + name).c_str(), iterations, size, seconds);
+
+    seconds = measure(("base64 encode, " + name).c_str(), iterations, [&bytes, &base64](size_t i) {
+      codec::base64Encode(bytes.data(), bytes.size(), &base64[0]);
+    });
+    reportBandwidth(("base64 encode, " + name).c_str(), iterations, size, seconds);
+
+    seconds = measure(("base64 decode, " + name).c_str(), iterations, [&base64, &decoded, &length](size_t i) {
+      codec::base64Decode(base64.c_str(), base64.length(), decoded.data(), length);
+    });
+    reportBandwidth(("base64 decode, " + name).c_str(), iterations, size, seconds);
+  }
+  codec::setLevel(supported);
+}  // namespace bench
+
+}  // namespace bench
@@ -0,0 +1,75 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <string>
+#include "api/structures.h"
+#include "database/message_history.h"
+#include "database/message_journal.h"
+
+#define BENCHMARK_JOURNAL_DIRECTORY "bench_journal"
+
+namespace bench {
+
+static std::string historyMessage(int i) {
+  Message message = Message::Builder(1000 + i % 16)
+      .setLogin("peer").setEmail("peer@server.ru").setChannel(0).setDestId(UNKNOWN_ID)
+      .setTimestamp(1461516681500 + i).setSize(64).setEncrypted(false)
+      .setMessage("Hello, this is message number " + std::to_string(i) + " sent to the channel").build();
+  return message.toJson();
+}
+
+BENCHMARK(History, Requests) {
+  removeDirectory(BENCHMARK_JOURNAL_DIRECTORY);
+  {
+    const size_t total = 100000;
+    db::MessageJournal journal(BENCHMARK_JOURNAL_DIRECTORY);
+    db::MessageHistory history(&journal);
+
+    measure("append", total, [&history](size_t i) {
+      history.append(0, i, historyMessage(i));
+    });
+
+    measure("last 50 from memory, 1 thread", 100000, [&history, total](size_t i) {
+      std::string frames;
+      history.read(0, total - 50, 50, &frames);
+    });
+
+    measureConcurrent("last 50 from memory, 8 threads", 8, 400000, [&history, total](size_t i) {
+      std::string frames;
+      history.read(0, total - 50, 50, &frames);
+    });
+
+    measure("50 from disk, 1 thread", 20000, [&history](size_t i) {
+      std::string frames;
+      history.read(0, (i * 997) % 90000, 50, &frames);
+    });
+  }
+  removeDirectory(BENCHMARK_JOURNAL_DIRECTORY);
+}
+
+}  // namespace bench
@@ -0,0 +1,190 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include "api/api.h"
+#include "api/structures.h"
+#include "common.h"
+#include "json_writer.h"
+#include "rapidjson/document.h"
+
+namespace bench {
+
+// previous implementation of Message::fromJson, kept here as a baseline
+static Message documentMessage(const std::string& json) {
+  rapidjson::Document document;
+  document.Parse(json.c_str());
+  return Message::Builder(document[ITEM_ID].GetInt64()).setLogin(document[ITEM_LOGIN].GetString())
+      .setEmail(document[ITEM_EMAIL].GetString()).setChannel(document[ITEM_CHANNEL].GetInt())
+      .setDestId(document[ITEM_DEST_ID].GetInt64()).setTimestamp(document[ITEM_TIMESTAMP].GetInt64())
+      .setSize(document[ITEM_SIZE].GetInt()).setEncrypted(document[ITEM_ENCRYPTED].GetInt() != 0)
+      .setMessage(document[ITEM_MESSAGE].GetString()).build();
+}
+
+BENCHMARK(Json, Parse) {
+  common::Dictionary dictionary;
+  const size_t iterations = 200000;
+  for (size_t words : {4, 16, 64}) {  // up to USER_MESSAGE_MAX_SIZE
+    std::string json = Message::Builder(1000).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(500)
+        .setDestId(0).setTimestamp(1461516681500)
+        .setMessage(dictionary.getMessage(words)).build().toJson();
+    std::string suffix = ", " + std::to_string(json.length()) + " bytes";
+
+    measure(("message, Document" + suffix).c_str(), iterations, [&json](size_t i) {
+      documentMessage(json);
+    });
+    measure(("message, in-situ typed reader" + suffix).c_str(), iterations, [&json](size_t i) {
+      Message::fromJson(json);
+    });
+  }
+
+  std::string form = LoginForm("Maxim", "qwerty123").toJson();
+  measure("login form, in-situ typed reader", iterations, [&form](size_t i) {
+    LoginForm::fromJson(form);
+  });
+
+  std::string wrapped = "{\"peer\":" + Peer::Builder(1000).setLogin("Oleg")
+      .setEmail("oleg@ya.ru").setChannel(500).build().toJson() + "}";
+  measure("unwrap object and read peer", iterations, [&wrapped](size_t i) {
+    Peer::fromJson(common::unwrapJsonObject("peer", wrapped));
+  });
+}
+
+#define BENCH_STANDARD_HEADERS "Server: ChatServer-" D_VERSION "\r\nContent-Type: application/json"
+
+static const char* BENCH_HEADERS = BENCH_STANDARD_HEADERS;
+static constexpr json::HeaderPrefix BENCH_OK_PREFIX = HEADER_PREFIX("200 OK", BENCH_STANDARD_HEADERS);
+
+// previous ostringstream assembly of status response, kept here as a baseline
+static std::string streamStatus(int code, int action, ID_t id, const std::string& token) {
+  std::ostringstream oss, json;
+  oss << "HTTP/1.1 " << "200 OK\r\n" << BENCH_HEADERS << "\r\n";
+  json << "{\"" D_ITEM_CODE "\":" << code << ",\"" D_ITEM_ACTION "\":" << action
+       << ",\"" D_ITEM_ID "\":" << id << ",\"" D_ITEM_TOKEN "\":\"" << token << "\""
+       << ",\"" D_ITEM_PAYLOAD "\":\"" << "" << "\"}";
+  oss << "Content-Length: " << json.str().length() << "\r\n\r\n" << json.str();
+  return oss.str();
+}
+
+// previous ostringstream assembly of peers response, kept here as a baseline
+static std::string streamPeers(const std::vector<Peer>& peers, int channel) {
+  std::string delimiter = "";
+  std::ostringstream oss, json;
+  json << "{\"" D_ITEM_PEERS "\":[";
+  for (auto& peer : peers) {
+    json << delimiter << peer.toJson();
+    delimiter = ",";
+  }
+  json << "],\"" D_ITEM_CHANNEL "\":" << channel << "}";
+  oss << "HTTP/1.1 200 OK\r\n" << BENCH_HEADERS << "\r\n"
+      << "Content-Length: " << json.str().length() << "\r\n\r\n" << json.str();
+  return oss.str();
+}
+
+BENCHMARK(Json, Response) {
+  const size_t iterations = 500000;
+  std::string token(64, 'a');
+  std::vector<Peer> peers;
+  for (int i = 0; i < 20; ++i) {
+    peers.push_back(Peer::Builder(1000 + i).setLogin("peer_" + std::to_string(i))
+        .setEmail("peer_" + std::to_string(i) + "@ya.ru").setChannel(500).build());
+  }
+  Message message = Message::Builder(1000).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(500)
+      .setDestId(0).setTimestamp(1461516681500).setMessage(common::Dictionary().getMessage(16)).build();
+
+  measure("status, ostringstream", iterations, [&token](size_t i) {
+    streamStatus(0, 1, 1000, token);
+  });
+  measure("status, writer into per-thread buffer", iterations, [&token](size_t i) {
+    json::Response response;
+    json::Writer& writer = response.getWriter();
+    writer.StartObject();
+    writer.Key(ITEM_CODE);     writer.Int(0);
+    writer.Key(ITEM_ACTION);   writer.Int(1);
+    writer.Key(ITEM_ID);       writer.Int64(1000);
+    writer.Key(ITEM_TOKEN);    writer.String(token);
+    writer.Key(ITEM_PAYLOAD);  writer.String("");
+    writer.EndObject();
+    response.finish("200 OK", BENCH_HEADERS);
+  });
+  double seconds = measure("status, writer and pre-rendered header prefix", iterations, [&token](size_t i) {
+    json::Response response;
+    json::Writer& writer = response.getWriter();
+    writer.StartObject();
+    writer.Key(ITEM_CODE);     writer.Int(0);
+    writer.Key(ITEM_ACTION);   writer.Int(1);
+    writer.Key(ITEM_ID);       writer.Int64(1000);
+    writer.Key(ITEM_TOKEN);    writer.String(token);
+    writer.Key(ITEM_PAYLOAD);  writer.String("");
+    writer.EndObject();
+    response.finish(BENCH_OK_PREFIX);
+  });
+  printf("  %-48s %14.0f ns/response\n", "", seconds / iterations * 1e9);
+  measure("check, writer into per-thread buffer", iterations, [](size_t i) {
+    json::Response response;
+    json::Writer& writer = response.getWriter();
+    writer.StartObject();
+    writer.Key(ITEM_CHECK);   writer.Int(1);
+    writer.Key(ITEM_ACTION);  writer.Int(1);
+    writer.Key(ITEM_ID);      writer.Int64(1000);
+    writer.EndObject();
+    response.finish("200 OK", BENCH_HEADERS);
+  });
+  measure("system message, writer into per-thread buffer", iterations, [](size_t i) {
+    json::Response response;
+    response.getWriter().StartObject();
+    response.getWriter().Key(ITEM_SYSTEM);
+    response.getWriter().String("Server is going down for maintenance in 5 minutes");
+    response.getWriter().EndObject();
+    response.finish("200 OK", BENCH_HEADERS);
+  });
+  measure("20 peers, ostringstream", iterations / 10, [&peers](size_t i) {
+    streamPeers(peers, 500);
+  });
+  measure("20 peers, writer into per-thread buffer", iterations / 10, [&peers](size_t i) {
+    json::Response response;
+    json::Writer& writer = response.getWriter();
+    writer.StartObject();
+    writer.Key(ITEM_PEERS);
+    writer.StartArray();
+    for (auto& peer : peers) {
+      peer.write(writer);
+    }
+    writer.EndArray();
+    writer.Key(ITEM_CHANNEL);  writer.Int(500);
+    writer.EndObject();
+    response.finish("200 OK", BENCH_HEADERS);
+  });
+  measure("message frame, Message::toJson", iterations, [&message](size_t i) {
+    message.toJson();
+  });
+}
+
+}  // namespace bench
@@ -0,0 +1,169 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "api/api.h"
+#include "api/structures.h"
+#include "common.h"
+#include "json_writer.h"
+#include "server/roster_cache.h"
+#include "server/roster_log.h"
+
+namespace bench {
+
+// same body as ServerApiImpl::sendPeers()
+static size_t writeRoster(const Roster& roster, server::RosterCache* cache = nullptr) {
+  json::Response response;
+  json::Writer& writer = response.getWriter();
+  writer.StartObject();
+  if (roster.is_delta) {
+    writer.Key(ITEM_DELTAS);
+    writer.StartArray();
+    for (auto& delta : roster.deltas) {
+      writer.StartObject();
+      writer.Key(ITEM_MOVE);     writer.Int(static_cast<int>(delta.first));
+      writer.Key(ITEM_ID);       writer.Int64(delta.second.getId());
+      writer.Key(ITEM_LOGIN);    writer.String(delta.second.getLogin());
+      writer.Key(ITEM_EMAIL);    writer.String(delta.second.getEmail());
+      writer.Key(ITEM_CHANNEL);  writer.Int(delta.second.getChannel());
+      writer.EndObject();
+    }
+    writer.EndArray();
+  } else {
+    writer.Key(ITEM_PEERS);
+    writer.StartArray();
+    for (auto& peer : roster.peers) {
+      peer.write(writer);
+    }
+    writer.EndArray();
+  }
+  writer.Key(ITEM_CHANNEL);  writer.Int(roster.channel);
+  writer.Key(ITEM_VERSION);  writer.Uint64(roster.version);
+  writer.EndObject();
+  response.finish(HEADER_PREFIX("200 OK", "Content-Type: application/json"));
+  if (cache != nullptr && !roster.is_delta) {
+    cache->put(roster.channel, roster.version, std::make_shared<std::string>(response.getData(), response.getLength()));
+  }
+  return response.getLength();
+}
+
+BENCHMARK(Roster, Delta) {
+  const int peers = 10000;
+  const int changes = 10;  // between two polls of a client
+  const size_t iterations = 500;
+  common::Dictionary dictionary;
+  std::vector<Peer> online;
+  server::RosterLog log(1461516681500);
+  for (int i = 0; i < peers; ++i) {
+    Peer peer = Peer::Builder(1000 + i).setLogin(dictionary.getMessage(1))
+        .setEmail(dictionary.getMessage(1) + "@ya.ru").setChannel(500).build();
+    online.push_back(peer);
+    log.join(peer);
+  }
+  uint64_t since_version = log.getVersion(500);
+  for (int i = 0; i < changes; ++i) {
+    if (i % 2 == 0) {
+      log.move(Peer::Builder(1000 + i).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(600).build(), 500);
+    } else {
+      log.join(Peer::Builder(100000 + i).setLogin("Maxim").setEmail("orcchg@yandex.ru").setChannel(500).build());
+    }
+  }
+
+  size_t full_bytes = 0, delta_bytes = 0;
+  measure("whole list, 10000 peers", iterations, [&](size_t i) {
+    Roster roster;
+    roster.channel = 500;
+    roster.version = log.getVersion(500);
+    for (auto& peer : online) {
+      roster.peers.emplace_back(peer);
+    }
+    full_bytes = writeRoster(roster);
+  });
+  measure("changes since version, 10 peers", iterations * 100, [&](size_t i) {
+    Roster roster;
+    roster.channel = 500;
+    roster.version = log.getVersion(500);
+    roster.since_version = since_version;
+    roster.is_delta = log.getChanges(since_version, 500, &roster.deltas);
+    delta_bytes = writeRoster(roster);
+  });
+  printf("  %-48s %12zu bytes %10zu delta\n", "response", full_bytes, delta_bytes);
+}
+
+BENCHMARK(Roster, Cached) {
+  const int peers = 10000;
+  const size_t iterations = 500;
+  common::Dictionary dictionary;
+  std::vector<Peer> online;
+  server::RosterLog log(1461516681500);
+  for (int i = 0; i < peers; ++i) {
+    Peer peer = Peer::Builder(1000 + i).setLogin(dictionary.getMessage(1))
+        .setEmail(dictionary.getMessage(1) + "@ya.ru").setChannel(500).build();
+    online.push_back(peer);
+    log.join(peer);
+  }
+
+  // same as ServerApiImpl::getAllPeers() followed by sendPeers(), minus socket
+  server::RosterCache cache;
+  auto request = [&](server::RosterCache* cache) -> size_t {
+    Roster roster;
+    roster.channel = 500;
+    roster.version = log.getVersion(500);
+    if (cache != nullptr) {
+      roster.response = cache->get(roster.channel, roster.version);
+    }
+    if (roster.response != nullptr) {
+      return roster.response->length();
+    }
+    for (auto& peer : online) {
+      roster.peers.emplace_back(peer);
+    }
+    return writeRoster(roster, cache);
+  };
+
+  measure("serialized on every request", iterations, [&](size_t i) {
+    request(nullptr);
+  });
+  measure("cached", iterations * 10000, [&](size_t i) {
+    request(&cache);
+  });
+  measureConcurrent("cached, 4 threads", 4, iterations * 10000, [&](size_t i) {
+    request(&cache);
+  });
+  measure("cached, list changes every 1000 requests", iterations * 100, [&](size_t i) {
+    if (i % 1000 == 999) {
+      log.move(online[i % peers], 600);  // back from channel 600
+      cache.invalidate(500);
+    }
+    request(&cache);
+  });
+}
+
+}  // namespace bench
@@ -0,0 +1,78 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <cerrno>
+#include <string>
+#include "api/structures.h"
+#include "common.h"
+#include "server/subscriber_table.h"
+
+namespace bench {
+
+BENCHMARK(Subscribers, Publish) {
+  const int subscribers = 100000;
+  const size_t events = 50;
+  common::Dictionary dictionary;
+  std::string json = Message::Builder(1000).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(500)
+      .setDestId(0).setTimestamp(1461516681500).setMessage(dictionary.getMessage(16)).build().toJson();
+  std::string event = "event: message\ndata: " + json + "\n\n";
+
+  // sockets are not real, every other one is backed up and takes nothing
+  size_t writes = 0, bytes = 0;
+  bool is_backed_up = false;
+  server::SubscriberTable table;
+  table.setWriter([&writes, &bytes, &is_backed_up](int socket, const char* buffer, size_t length) -> ssize_t {
+    ++writes;
+    if (is_backed_up && socket % 2 == 1) {
+      errno = EAGAIN;
+      return -1;
+    }
+    bytes += length;
+    return length;
+  });
+  table.setCloser([](int socket) {});
+  for (int socket = 0; socket < subscribers; ++socket) {
+    table.subscribe(socket, 500);
+  }
+
+  double seconds = measure("event to 100k subscribers", events, [&table, &event](size_t i) {
+    table.publish(500, event);
+  });
+  printf("  %-48s %12.1f ns/subscriber\n", "", seconds * 1e9 / (events * subscribers));
+
+  is_backed_up = true;
+  measure("event to 100k subscribers, half backed up", events, [&table, &event](size_t i) {
+    table.publish(500, event);
+  });
+  is_backed_up = false;
+  writes = 0;  bytes = 0;
+  table.publish(500, event);  // backlog of each backed up subscriber goes in one write
+  printf("  %-48s %12zu writes %10zu bytes\n", "draining backlog", writes, bytes);
+}
+
+}
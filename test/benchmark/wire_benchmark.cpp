@@ -0,0 +1,156 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "api/api.h"
+#include "api/structures.h"
+#include "common.h"
+#include "parser/my_parser.h"
+#include "wire.h"
+
+namespace bench {
+
+// message pushed to recipient in text protocol, as assembled in ServerApiImpl::broadcast
+static std::string httpMessage(const Message& message) {
+  std::string json = message.toJson();
+  std::ostringstream oss;
+  oss << "HTTP/1.1 102 Processing\r\nServer: ChatServer-" D_VERSION "\r\nContent-Type: application/json\r\n"
+      << "Content-Length: " << json.length() << "\r\n\r\n" << json;
+  return oss.str();
+}
+
+BENCHMARK(Wire, Message) {
+  common::Dictionary dictionary;
+  const size_t iterations = 200000;
+  Message message = Message::Builder(1000).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(500)
+      .setDestId(0).setTimestamp(1461516681500).setMessage(dictionary.getMessage(16)).build();
+
+  std::string http = httpMessage(message);
+  std::string frame;
+  wire::encodeMessage(message, &frame);
+  printf("  %-48s %12zu bytes\n", "message, text protocol", http.length());
+  printf("  %-48s %12zu bytes\n", "message, binary frame", frame.length());
+
+  measure("encode, text protocol", iterations, [&message](size_t i) {
+    httpMessage(message);
+  });
+  std::string output;
+  measure("encode, binary frame", iterations, [&message, &output](size_t i) {
+    output.clear();
+    wire::encodeMessage(message, &output);
+  });
+
+  MyParser parser;
+  std::vector<char> buffer(http.begin(), http.end());
+  std::vector<Response> responses;
+  Message decoded;
+  measure("decode, text protocol", iterations, [&parser, &http, &buffer, &responses, &decoded](size_t i) {
+    std::copy(http.begin(), http.end(), buffer.begin());  // parser works in-situ
+    responses.clear();
+    parser.parseBufferedResponses(&buffer[0], buffer.size(), &responses);
+    decoded = Message::fromJson(responses[0].body);
+  });
+  wire::FrameDecoder decoder;
+  measure("decode, binary frame", iterations, [&frame, &decoder, &decoded](size_t i) {
+    wire::Frame next;
+    decoder.append(frame.data(), frame.length());
+    decoder.next(&next);
+    wire::decodeMessage(next, &decoded);
+  });
+}
+
+BENCHMARK(Wire, Deflate) {
+  common::Dictionary dictionary;
+  std::string roster = "{\"" D_ITEM_PEERS "\":[";
+  for (int i = 0; i < 2000; ++i) {
+    roster += (i > 0 ? "," : "") + Peer::Builder(1000 + i).setLogin("peer_" + std::to_string(i))
+        .setEmail("peer_" + std::to_string(i) + "@ya.ru").setChannel(500).build().toJson();
+  }
+  roster += "],\"" D_ITEM_CHANNEL "\":500}";
+  std::string history = "{\"" D_ITEM_CODE "\":0,\"" D_ITEM_CHANNEL "\":500,\"" D_ITEM_LAST_SEQ "\":200,\"" D_ITEM_MESSAGES "\":[";
+  for (int i = 0; i < 200; ++i) {
+    history += (i > 0 ? "," : "") + Message::Builder(1000 + i % 16).setLogin("peer_" + std::to_string(i % 16))
+        .setEmail("peer_" + std::to_string(i % 16) + "@ya.ru").setChannel(500).setDestId(0)
+        .setTimestamp(1461516681500 + i * 1000).setMessage(dictionary.getMessage(16)).build().toJson();
+  }
+  history += "]}";
+  std::string small_roster = "{\"" D_ITEM_PEERS "\":[";
+  for (int i = 0; i < 8; ++i) {
+    small_roster += (i > 0 ? "," : "") + Peer::Builder(1000 + i * 37).setLogin(dictionary.getMessage(1))
+        .setEmail(dictionary.getMessage(1) + "@ya.ru").setChannel(500).build().toJson();
+  }
+  small_roster += "],\"" D_ITEM_CHANNEL "\":500}";
+  std::string status = "{\"" D_ITEM_CODE "\":0,\"" D_ITEM_ACTION "\":0,\"" D_ITEM_ID "\":1000,\"" D_ITEM_TOKEN "\":\""
+      "3f7a9c2e5b8d1f4a6c0e9b2d7f5a3c1e\",\"" D_ITEM_PAYLOAD "\":\"\"}";
+
+  wire::Deflater deflater;
+  wire::Inflater inflater;
+  struct Payload { const char* label; const std::string* json; size_t iterations; };
+  Payload payloads[] = {
+    { "roster, 2000 peers", &roster, 200 },
+    { "history, 200 messages", &history, 200 },
+    { "roster, 8 peers", &small_roster, 20000 },
+    { "status, below threshold", &status, 0 }
+  };
+  for (auto& payload : payloads) {
+    std::string frame, deflated;
+    wire::encodeResponse(200, payload.json->c_str(), payload.json->length(), &frame);
+    bool is_deflated = frame.length() >= WIRE_DEFLATE_THRESHOLD && deflater.deflate(frame.data(), frame.length(), &deflated);
+
+    // the same with no preset dictionary, to see what dictionary is worth
+    uLongf plain_length = compressBound(frame.length());
+    std::string plain(plain_length, '\0');
+    compress2(reinterpret_cast<Bytef*>(&plain[0]), &plain_length, reinterpret_cast<const Bytef*>(frame.data()), frame.length(), 6);
+    printf("  %-48s %12zu bytes %10zu deflated %8lu without dictionary\n", payload.label,
+           frame.length(), is_deflated ? deflated.length() : frame.length(), plain_length);
+    if (!is_deflated) {
+      continue;
+    }
+
+    std::string output;
+    double seconds = measure("deflate", payload.iterations, [&deflater, &frame, &output](size_t i) {
+      output.clear();
+      deflater.deflate(frame.data(), frame.length(), &output);
+    });
+    printf("  %-48s %12.1f MB/s\n", "", payload.iterations * frame.length() / seconds / 1e6);
+    wire::Frame compressed;
+    wire::FrameDecoder decoder;
+    decoder.append(deflated.data(), deflated.length());
+    decoder.next(&compressed);
+    seconds = measure("inflate", payload.iterations, [&inflater, &compressed, &output](size_t i) {
+      output.clear();
+      inflater.inflate(compressed, &output);
+    });
+    printf("  %-48s %12.1f MB/s\n", "", payload.iterations * frame.length() / seconds / 1e6);
+  }
+}
+
+}
@@ -26,9 +26,17 @@
  *   Only the original author - Maxim Alov - has right to do any of the above actions.
  */
 
+#include <algorithm>
 #include <string>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #include <gtest/gtest.h>
+#include "codec.h"
 #include "common.h"
+#include "exception.h"
+#include "json_reader.h"
+#include "json_writer.h"
 
 namespace test {
 
@@ -47,6 +55,269 @@ TEST(CommonUtils, NotNumber) {
   EXPECT_EQ(100, id);
 }
 
+TEST(Base64, EncodeDecode) {
+  const char* inputs[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+  const char* outputs[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+  for (int i = 0; i < 7; ++i) {
+    std::string encoded = common::base64Encode((const unsigned char*) inputs[i], strlen(inputs[i]));
+    EXPECT_STREQ(outputs[i], encoded.c_str());
+
+    unsigned char decoded[8];
+    size_t length = 0;
+    EXPECT_TRUE(common::base64Decode(encoded, decoded, length));
+    EXPECT_EQ(strlen(inputs[i]), length);
+    EXPECT_EQ(0, memcmp(inputs[i], decoded, length));
+  }
+}
+
+TEST(Base64, RejectMalformed) {
+  unsigned char decoded[8];
+  size_t length = 0;
+  EXPECT_FALSE(common::base64Decode("Zm9", decoded, length));
+  EXPECT_FALSE(common::base64Decode("Zm9*", decoded, length));
+  EXPECT_FALSE(common::base64Decode("Z===", decoded, length));
+  EXPECT_FALSE(common::base64Decode("Zm=v", decoded, length));
+}
+
+TEST(Base64, RejectTrailingBits) {
+  unsigned char decoded[8];
+  size_t length = 0;
+  EXPECT_FALSE(common::base64Decode("Zh==", decoded, length));
+  EXPECT_FALSE(common::base64Decode("Zm9=", decoded, length));
+}
+
+/* Codec */
+// ----------------------------------------------------------------------------
+// sizes around SIMD block boundaries of every level
+static const size_t CODEC_SIZES[] = {0, 1, 2, 3, 11, 12, 15, 16, 17, 23, 24, 27, 28, 31, 32, 33, 47, 48, 63, 64, 65, 100, 1000};
+
+static std::vector<unsigned char> randomBytes(size_t size) {
+  std::vector<unsigned char> bytes(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = rand() & 0xFF;
+  }
+  return bytes;
+}
+
+TEST(Codec, HexMatchesScalarAtEveryLevel) {
+  codec::Level supported = codec::getSupportedLevel();
+  for (size_t size : CODEC_SIZES) {
+    std::vector<unsigned char> bytes = randomBytes(size);
+    codec::setLevel(codec::Level::SCALAR);
+    std::string expected(codec::hexEncodedLength(size), '\0');
+    codec::hexEncode(bytes.data(), size, &expected[0]);
+    for (int level = codec::Level::SCALAR; level <= supported; ++level) {
+      codec::setLevel(static_cast<codec::Level>(level));
+      std::string encoded(codec::hexEncodedLength(size), '\0');
+      codec::hexEncode(bytes.data(), size, &encoded[0]);
+      EXPECT_EQ(expected, encoded);
+
+      std::vector<unsigned char> decoded(size + 1);
+      size_t length = 0;
+      EXPECT_TRUE(codec::hexDecode(encoded.c_str(), encoded.length(), decoded.data(), length));
+      EXPECT_EQ(size, length);
+      EXPECT_TRUE(std::equal(bytes.begin(), bytes.end(), decoded.begin()));
+    }
+  }
+  codec::setLevel(supported);
+}
+
+TEST(Codec, HexCompatibleWithStreamFormat) {
+  unsigned char bytes[] = {0x00, 0x0f, 0x10, 0xab, 0xff};
+  EXPECT_STREQ("000f10abff", common::bin2hex(bytes, sizeof(bytes)).c_str());
+
+  unsigned char decoded[5];
+  size_t length = 0;
+  common::hex2bin("000F10ABff", decoded, length);
+  EXPECT_EQ(5, length);
+  EXPECT_EQ(0, memcmp(bytes, decoded, length));
+}
+
+TEST(Codec, HexRejectInvalid) {
+  codec::Level supported = codec::getSupportedLevel();
+  const char invalid[] = {'g', 'G', '/', ':', '@', '`', ' ', '\0', '\x80', '\xff'};
+  for (int level = codec::Level::SCALAR; level <= supported; ++level) {
+    codec::setLevel(static_cast<codec::Level>(level));
+    std::string source(128, 'a');
+    unsigned char decoded[64];
+    size_t length = 0;
+    EXPECT_FALSE(codec::hexDecode(source.c_str(), 127, decoded, length));
+    for (size_t position = 0; position < source.length(); ++position) {
+      for (char c : invalid) {
+        std::string broken = source;
+        broken[position] = c;
+        EXPECT_FALSE(codec::hexDecode(broken.c_str(), broken.length(), decoded, length));
+      }
+    }
+  }
+  codec::setLevel(supported);
+  size_t length = 0;
+  unsigned char decoded[4];
+  EXPECT_THROW(common::hex2bin("0x", decoded, length), std::invalid_argument);
+}
+
+TEST(Codec, Base64MatchesScalarAtEveryLevel) {
+  codec::Level supported = codec::getSupportedLevel();
+  for (size_t size : CODEC_SIZES) {
+    std::vector<unsigned char> bytes = randomBytes(size);
+    codec::setLevel(codec::Level::SCALAR);
+    std::string expected(codec::base64EncodedLength(size), '\0');
+    codec::base64Encode(bytes.data(), size, &expected[0]);
+    for (int level = codec::Level::SCALAR; level <= supported; ++level) {
+      codec::setLevel(static_cast<codec::Level>(level));
+      std::string encoded(codec::base64EncodedLength(size), '\0');
+      codec::base64Encode(bytes.data(), size, &encoded[0]);
+      EXPECT_EQ(expected, encoded);
+
+      std::vector<unsigned char> decoded(codec::base64DecodedCapacity(encoded.length()) + 1);
+      size_t length = 0;
+      EXPECT_TRUE(codec::base64Decode(encoded.c_str(), encoded.length(), decoded.data(), length));
+      EXPECT_EQ(size, length);
+      EXPECT_TRUE(std::equal(bytes.begin(), bytes.end(), decoded.begin()));
+    }
+  }
+  codec::setLevel(supported);
+}
+
+TEST(Codec, Base64RejectInvalid) {
+  codec::Level supported = codec::getSupportedLevel();
+  const char invalid[] = {'=', '-', '_', '.', ' ', '\n', '\0', '\x80', '\xff'};
+  std::vector<unsigned char> bytes = randomBytes(96);
+  std::string source = common::base64Encode(bytes.data(), bytes.size());
+  for (int level = codec::Level::SCALAR; level <= supported; ++level) {
+    codec::setLevel(static_cast<codec::Level>(level));
+    std::vector<unsigned char> decoded(codec::base64DecodedCapacity(source.length()));
+    size_t length = 0;
+    for (size_t position = 0; position < source.length(); ++position) {
+      for (char c : invalid) {
+        std::string broken = source;
+        broken[position] = c;
+        if (c == '=' && position == source.length() - 1) {
+          continue;  // could be valid padding
+        }
+        EXPECT_FALSE(codec::base64Decode(broken.c_str(), broken.length(), decoded.data(), length));
+      }
+    }
+  }
+  codec::setLevel(supported);
+}
+
+TEST(JsonReader, ReadBoundFields) {
+  ID_t id = UNKNOWN_ID;
+  std::string login;
+  int channel = 0;
+  uint32_t generation = 0;
+  json::Reader reader;
+  reader.bind("id", &id).bind("login", &login).bind("channel", &channel).bind("generation", &generation, false);
+
+  std::string json = "{\"extra\":[1,{\"id\":5}],\"id\":9000000000,\"login\":\"Ma\\u0078im\\n\",\"channel\":-2}";
+  ASSERT_TRUE(reader.read(json));
+  EXPECT_EQ(9000000000LL, id);
+  EXPECT_STREQ("Maxim\n", login.c_str());
+  EXPECT_EQ(-2, channel);
+  EXPECT_FALSE(reader.isSet("generation"));
+  EXPECT_STREQ("{\"extra\":[1,{\"id\":5}],\"id\":9000000000,\"login\":\"Ma\\u0078im\\n\",\"channel\":-2}", json.c_str());  // input intact
+}
+
+TEST(JsonReader, RejectInvalid) {
+  ID_t id = UNKNOWN_ID;
+  int channel = 0;
+  uint32_t generation = 0;
+  json::Reader reader;
+  reader.bind("id", &id).bind("channel", &channel).bind("generation", &generation, false);
+
+  EXPECT_TRUE(reader.read("{\"id\":1,\"channel\":2}"));
+  EXPECT_FALSE(reader.read("{\"id\":1}"));  // missing required
+  EXPECT_FALSE(reader.read("{\"id\":\"1\",\"channel\":2}"));  // type mismatch
+  EXPECT_FALSE(reader.read("{\"id\":1,\"channel\":3000000000}"));  // out of range
+  EXPECT_FALSE(reader.read("{\"id\":1,\"channel\":2,\"generation\":-1}"));
+  EXPECT_FALSE(reader.read("{\"id\":1,\"channel\":2.5}"));
+  EXPECT_FALSE(reader.read("{\"id\":{},\"channel\":2}"));
+  EXPECT_FALSE(reader.read("{\"id\":1,\"channel\":2"));  // malformed
+  EXPECT_FALSE(reader.read("[{\"id\":1,\"channel\":2}]"));
+  EXPECT_FALSE(reader.read(""));
+}
+
+TEST(JsonReader, ReadNestedObject) {
+  ID_t id = UNKNOWN_ID;
+  json::Reader reader("inner");
+  reader.bind("id", &id);
+
+  EXPECT_TRUE(reader.read("{\"id\":1,\"other\":{\"id\":2},\"inner\":{\"deep\":{\"id\":3},\"id\":4}}"));
+  EXPECT_EQ(4, id);
+  EXPECT_FALSE(reader.read("{\"id\":1}"));
+  EXPECT_FALSE(reader.read("{\"inner\":5}"));
+}
+
+TEST(JsonReader, ReadSeveralObjects) {
+  ID_t id = UNKNOWN_ID, first_id = UNKNOWN_ID, second_id = UNKNOWN_ID;
+  int code = 0;
+  json::Reader reader;
+  reader.bind("id", &id, false).bind("code", &code, false)
+        .within("first").bind("id", &first_id, false)
+        .within("second").bind("id", &second_id, false);
+
+  EXPECT_TRUE(reader.read("{\"second\":{\"id\":3,\"first\":{\"id\":5}},\"id\":1,\"first\":{\"code\":7,\"id\":2}}"));
+  EXPECT_EQ(1, id);
+  EXPECT_EQ(2, first_id);
+  EXPECT_EQ(3, second_id);
+  EXPECT_FALSE(reader.isSet("code"));
+  EXPECT_TRUE(reader.isSet("id", "second"));
+
+  EXPECT_TRUE(reader.read("{\"code\":4}"));
+  EXPECT_FALSE(reader.isSet("id"));
+  EXPECT_FALSE(reader.isSet("id", "first"));
+  EXPECT_FALSE(reader.read("{\"first\":{\"id\":\"2\"}}"));
+}
+
+TEST(JsonReader, UnwrapObject) {
+  std::string json = "{\"id\":1,\"key\":{\"id\":2,\"key\":\"-----BEGIN\r\nKEY\",\"list\":[true,null,1.5]}}";
+  EXPECT_STREQ("{\"id\":2,\"key\":\"-----BEGINKEY\",\"list\":[true,null,1.5]}",
+               common::unwrapJsonObject("key", json, common::PreparseLeniency::STRICT).c_str());
+  EXPECT_STREQ(json.c_str(), common::unwrapJsonObject("missing", json).c_str());
+}
+
+TEST(JsonReader, MessageRoundTrip) {
+  Message message = Message::Builder(1000).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(500)
+      .setDestId(1001).setTimestamp(1461516681500).setSize(12).setEncrypted(false)
+      .setMessage("Hello, World").build();
+  EXPECT_TRUE(message == Message::fromJson(message.toJson()));
+  EXPECT_THROW(Message::fromJson("{\"id\":1000}"), ConvertException);
+}
+
+TEST(JsonWriter, EscapeStrings) {
+  Peer peer = Peer::Builder(1000).setLogin("Ma\"xim\\").setEmail("line\nbreak").setChannel(500).build();
+  std::string json = peer.toJson();
+  EXPECT_STREQ("{\"id\":1000,\"login\":\"Ma\\\"xim\\\\\",\"email\":\"line\\nbreak\",\"channel\":500}", json.c_str());
+  Peer parsed = Peer::fromJson(json);
+  EXPECT_STREQ(peer.getLogin().c_str(), parsed.getLogin().c_str());
+  EXPECT_STREQ(peer.getEmail().c_str(), parsed.getEmail().c_str());
+}
+
+TEST(JsonWriter, Response) {
+  for (size_t size : {0, 10, 100000}) {
+    json::Response response;
+    response.getWriter().StartObject();
+    response.getWriter().Key("system");
+    response.getWriter().String(std::string(size, 'x'));
+    response.getWriter().EndObject();
+    response.finish("200 OK", "Server: test");
+
+    std::string body = "{\"system\":\"" + std::string(size, 'x') + "\"}";
+    std::string expected = "HTTP/1.1 200 OK\r\nServer: test\r\nContent-Length: " + std::to_string(body.length()) + "\r\n\r\n" + body;
+    EXPECT_EQ(expected.length(), response.getLength());
+    EXPECT_STREQ(expected.c_str(), response.getData());
+  }
+
+  json::Response response;  // headers longer than reserved room
+  response.getWriter().StartArray();
+  response.getWriter().EndArray();
+  std::string headers(RESPONSE_HEADER_RESERVE, 'h');
+  response.finish("404 Not found", headers.c_str());
+  std::string expected = "HTTP/1.1 404 Not found\r\n" + headers + "\r\nContent-Length: 2\r\n\r\n[]";
+  EXPECT_STREQ(expected.c_str(), response.getData());
+}
+
 TEST(RestoreStrippedPEM, PublicInMemory1) {
   std::string pem_stripped = "-----BEGIN RSA PUBLIC KEY-----MIIBCgKCAQEA5wz5fNXVx5FMs74hJPdHrZ1NnvD8o2I5EsHwY2Tmd4FqbkfiASavjS5pglWYu10x0GHkJj1jHxU3yGqrnHchMW0zd0FmolVoc6Grutzryt0ekteCwsB4eP23dfZhWRvUTCi0Mr94ui+8ejmTMT/db3Yg54fXK6ctPd5DnzojKm/h4n+z5r7xyRMQbQb8EUpn7cBqRGzD+kGadtEuiFwRQFyMOOWyhtQ0PpsyNNJTCNJsc8w3+gOGi11mfOYRZjaHINkUI4yJUincacUJOLQQK2jQH4mBH0P5Wq6b/mGcxz17yZDvnwZZF3k82XDYsMYLEglKIzl1QXKua/dtEm0D+QIDAQAB-----END RSA PUBLIC KEY-----";
 
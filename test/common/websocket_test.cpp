@@ -0,0 +1,164 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "api/api.h"
+#include "websocket.h"
+
+namespace test {
+
+static Request upgradeRequest(const std::string& protocol) {
+  Request request;
+  request.startline.method = "GET";
+  request.startline.path = PATH_WEBSOCKET;
+  request.headers.push_back(Header{ "Host", "127.0.0.1:9000" });
+  request.headers.push_back(Header{ "upgrade", "WebSocket" });
+  request.headers.push_back(Header{ "Connection", "keep-alive, Upgrade" });
+  request.headers.push_back(Header{ "Sec-WebSocket-Key", "dGhlIHNhbXBsZSBub25jZQ==" });
+  request.headers.push_back(Header{ "Sec-WebSocket-Version", "13" });
+  if (!protocol.empty()) {
+    request.headers.push_back(Header{ "Sec-WebSocket-Protocol", protocol });
+  }
+  return request;
+}
+
+TEST(WebSocketTest, Handshake) {
+  // sample from RFC 6455, section 1.3
+  EXPECT_STREQ("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", ws::acceptKey("dGhlIHNhbXBsZSBub25jZQ==").c_str());
+
+  std::string response;
+  bool is_binary = true;
+  ASSERT_TRUE(ws::acceptUpgrade(upgradeRequest(""), &response, &is_binary));
+  EXPECT_FALSE(is_binary);
+  EXPECT_EQ(0, response.find("HTTP/1.1 101 Switching Protocols\r\n"));
+  EXPECT_NE(std::string::npos, response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"));
+  EXPECT_EQ(std::string::npos, response.find("Sec-WebSocket-Protocol"));
+
+  ASSERT_TRUE(ws::acceptUpgrade(upgradeRequest("chat, " WS_PROTOCOL_FRAME), &response, &is_binary));
+  EXPECT_TRUE(is_binary);
+  EXPECT_NE(std::string::npos, response.find("Sec-WebSocket-Protocol: " WS_PROTOCOL_FRAME "\r\n"));
+
+  Request request = upgradeRequest("");
+  request.headers.pop_back();  // no version
+  EXPECT_FALSE(ws::acceptUpgrade(request, &response, &is_binary));
+  EXPECT_EQ(0, response.find("HTTP/1.1 400 Bad Request\r\n"));
+}
+
+TEST(WebSocketTest, MaskedRoundTrip) {
+  const unsigned char mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+  std::vector<size_t> lengths = {0, 5, 125, 126, 65535, 65536, 100000};
+  std::string stream;
+  for (size_t length : lengths) {
+    std::string payload(length, '\0');
+    for (size_t i = 0; i < length; ++i) {
+      payload[i] = static_cast<char>(i * 7);
+    }
+    ws::encodeMaskedFrame(ws::Opcode::BINARY, payload.data(), payload.length(), mask, &stream);
+  }
+  std::string hello;
+  ws::encodeMaskedFrame(ws::Opcode::TEXT, "Hello", 5, mask, &hello);
+  EXPECT_EQ(std::string("\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58", 11), hello);  // RFC 6455, section 5.7
+
+  ws::FrameDecoder decoder;
+  std::vector<std::string> payloads;
+  for (size_t offset = 0; offset < stream.length(); offset += 4093) {  // arbitrary chunks
+    decoder.append(stream.data() + offset, std::min<size_t>(4093, stream.length() - offset));
+    ws::Frame frame;
+    while (decoder.next(&frame)) {
+      EXPECT_EQ(ws::Opcode::BINARY, frame.opcode);
+      payloads.emplace_back(frame.payload, frame.length);
+    }
+  }
+  ASSERT_EQ(lengths.size(), payloads.size());
+  for (size_t i = 0; i < lengths.size(); ++i) {
+    ASSERT_EQ(lengths[i], payloads[i].length());
+    if (lengths[i] > 0) {
+      EXPECT_EQ(static_cast<char>((lengths[i] - 1) * 7), payloads[i].back());
+    }
+  }
+  EXPECT_FALSE(decoder.isBroken());
+
+  std::string unmasked;  // client must mask its frames
+  ws::encodeFrame(ws::Opcode::TEXT, "Hello", 5, &unmasked);
+  EXPECT_EQ(std::string("\x81\x05Hello", 7), unmasked);
+  decoder.append(unmasked.data(), unmasked.length());
+  ws::Frame frame;
+  EXPECT_FALSE(decoder.next(&frame));
+  EXPECT_TRUE(decoder.isBroken());
+}
+
+TEST(WebSocketTest, Fragments) {
+  // "Hel" + ping + "lo", RFC 6455, section 5.7, masked
+  const unsigned char mask[4] = { 0x01, 0x02, 0x03, 0x04 };
+  std::string stream;
+  ws::encodeMaskedFrame(ws::Opcode::TEXT, "Hel", 3, mask, &stream);
+  stream[0] &= 0x7f;  // not final
+  ws::encodeMaskedFrame(ws::Opcode::PING, "ping", 4, mask, &stream);
+  ws::encodeMaskedFrame(ws::Opcode::CONTINUATION, "lo", 2, mask, &stream);
+
+  ws::FrameDecoder decoder;
+  decoder.append(stream.data(), stream.length());
+  ws::Frame frame;
+  ASSERT_TRUE(decoder.next(&frame));
+  EXPECT_EQ(ws::Opcode::PING, frame.opcode);
+  EXPECT_EQ("ping", std::string(frame.payload, frame.length));
+  ASSERT_TRUE(decoder.next(&frame));
+  EXPECT_EQ(ws::Opcode::TEXT, frame.opcode);
+  EXPECT_EQ("Hello", std::string(frame.payload, frame.length));
+  EXPECT_FALSE(decoder.next(&frame));
+
+  std::string orphan;
+  ws::encodeMaskedFrame(ws::Opcode::CONTINUATION, "lo", 2, mask, &orphan);
+  decoder.append(orphan.data(), orphan.length());
+  EXPECT_FALSE(decoder.next(&frame));
+  EXPECT_TRUE(decoder.isBroken());
+}
+
+TEST(WebSocketTest, HttpToFrames) {
+  std::string responses =
+      "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 10\r\n\r\n{\"code\":0}"
+      "HTTP/1.1 102 Processing\r\nContent-Length: 2\r\n\r\n{}";
+  std::string frames;
+  ASSERT_TRUE(ws::encodeHttpResponses(responses.c_str(), responses.length(), &frames));
+  EXPECT_FALSE(ws::encodeHttpResponses("HTTP/1.1 200 OK\r\n", 17, &frames));
+
+  ws::FrameDecoder decoder(false);
+  decoder.append(frames.data(), frames.length());
+  ws::Frame frame;
+  ASSERT_TRUE(decoder.next(&frame));
+  EXPECT_EQ(ws::Opcode::TEXT, frame.opcode);
+  EXPECT_EQ("{\"code\":0}", std::string(frame.payload, frame.length));
+  ASSERT_TRUE(decoder.next(&frame));
+  EXPECT_EQ("{}", std::string(frame.payload, frame.length));
+  EXPECT_FALSE(decoder.next(&frame));
+}
+
+}
@@ -0,0 +1,207 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "api/api.h"
+#include "wire.h"
+
+namespace test {
+
+TEST(WireTest, Varint) {
+  char buffer[WIRE_VARINT_MAX_LENGTH];
+  std::vector<uint64_t> values = {0, 1, 127, 128, 300, 16384, 1461516681500, UINT64_MAX};
+  for (uint64_t value : values) {
+    size_t used = wire::putVarint(value, buffer);
+    uint64_t decoded = 0;
+    EXPECT_EQ(used, wire::getVarint(buffer, used, &decoded));
+    EXPECT_EQ(value, decoded);
+    EXPECT_EQ(0, wire::getVarint(buffer, used - 1, &decoded));  // incomplete
+  }
+  EXPECT_EQ(1, wire::putVarint(127, buffer));
+  EXPECT_EQ(2, wire::putVarint(128, buffer));
+}
+
+TEST(WireTest, MessageRoundTrip) {
+  Message message = Message::Builder(102993).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(-500)
+      .setDestId(102997).setTimestamp(1461516681500).setSize(12).setEncrypted(true)
+      .setMessage(std::string("Hello\0World", 11)).build();
+  std::string frames;
+  wire::encodeMessage(message, &frames);
+  EXPECT_GT(message.toJson().length(), frames.length() + 60);
+
+  wire::FrameDecoder decoder;
+  wire::Frame frame;
+  decoder.append(frames.data(), frames.length());
+  ASSERT_TRUE(decoder.next(&frame));
+  EXPECT_EQ(wire::FrameType::MESSAGE, frame.type);
+  Message decoded;
+  ASSERT_TRUE(wire::decodeMessage(frame, &decoded));
+  EXPECT_TRUE(message == decoded);
+  EXPECT_FALSE(decoder.next(&frame));
+
+  Request request;
+  ASSERT_TRUE(wire::decodeRequest(frame, &request));
+  EXPECT_STREQ(PATH_MESSAGE, request.startline.path.c_str());
+  ASSERT_TRUE(wire::isFramed(request));
+  EXPECT_TRUE(wire::decodeMessage(request, &decoded));
+}
+
+TEST(WireTest, SplitStream) {
+  std::string stream;
+  wire::encodeHello(&stream);
+  wire::encodeRequest("GET", "/peer?login=Oleg", "", &stream);
+  wire::encodeRequest("POST", "/login", std::string(5000, 'x'), &stream);  // longer than single read
+  EXPECT_TRUE(wire::isHello(stream.data(), stream.length()));
+  EXPECT_FALSE(wire::isHello("GET / HTTP/1.1\r\n\r\n", 18));
+
+  wire::FrameDecoder decoder;
+  std::vector<Request> requests;
+  int hellos = 0;
+  for (size_t offset = 0; offset < stream.length(); offset += 7) {  // byte by byte chunks
+    decoder.append(stream.data() + offset, std::min<size_t>(7, stream.length() - offset));
+    wire::Frame frame;
+    while (decoder.next(&frame)) {
+      Request request;
+      if (frame.type == wire::FrameType::HELLO) {
+        ++hellos;
+      } else if (wire::decodeRequest(frame, &request)) {
+        requests.push_back(request);
+      }
+    }
+  }
+  EXPECT_EQ(1, hellos);
+  ASSERT_EQ(2, requests.size());
+  EXPECT_STREQ("GET", requests[0].startline.method.c_str());
+  EXPECT_STREQ("/peer?login=Oleg", requests[0].startline.path.c_str());
+  EXPECT_TRUE(requests[0].body.empty());
+  EXPECT_EQ(5000, requests[1].body.length());
+  EXPECT_FALSE(decoder.isBroken());
+
+  const char oversized[] = { '\xff', '\xff', '\xff', '\x7f' };
+  decoder.append(oversized, sizeof(oversized));
+  wire::Frame frame;
+  EXPECT_FALSE(decoder.next(&frame));
+  EXPECT_TRUE(decoder.isBroken());
+
+  // inbound limit of server is much smaller than of client
+  std::string large;
+  wire::encodeResponse(200, std::string(WIRE_MAX_FRAME_LENGTH, 'x').c_str(), WIRE_MAX_FRAME_LENGTH, &large);
+  wire::FrameDecoder inbound;
+  inbound.append(large.data(), large.length());
+  EXPECT_FALSE(inbound.next(&frame));
+  EXPECT_TRUE(inbound.isBroken());
+  wire::FrameDecoder downstream(WIRE_MAX_DOWNSTREAM_LENGTH);
+  downstream.append(large.data(), large.length());
+  EXPECT_TRUE(downstream.next(&frame));
+  EXPECT_FALSE(downstream.isBroken());
+}
+
+TEST(WireTest, HttpToFrames) {
+  std::string http = "POST /login HTTP/1.1\r\nHost: 127.0.0.1:9000\r\n\r\n{\"login\":\"maxim\"}";
+  std::string frames;
+  ASSERT_TRUE(wire::encodeHttpRequest(http.c_str(), http.length(), &frames));
+  wire::FrameDecoder decoder;
+  decoder.append(frames.data(), frames.length());
+  wire::Frame frame;
+  Request request;
+  ASSERT_TRUE(decoder.next(&frame));
+  ASSERT_TRUE(wire::decodeRequest(frame, &request));
+  EXPECT_STREQ("POST", request.startline.method.c_str());
+  EXPECT_STREQ("/login", request.startline.path.c_str());
+  EXPECT_STREQ("{\"login\":\"maxim\"}", request.body.c_str());
+
+  std::string responses =
+      "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 10\r\n\r\n{\"code\":0}"
+      "HTTP/1.1 102 Processing\r\nContent-Length: 2\r\n\r\n{}";
+  frames.clear();
+  ASSERT_TRUE(wire::encodeHttpResponses(responses.c_str(), responses.length(), &frames));
+  EXPECT_FALSE(wire::encodeHttpResponses("HTTP/1.1 200 OK\r\n", 17, &frames));
+  decoder.append(frames.data(), frames.length());
+  Response response;
+  ASSERT_TRUE(decoder.next(&frame));
+  ASSERT_TRUE(wire::decodeResponse(frame, &response));
+  EXPECT_EQ(200, response.codeline.code);
+  EXPECT_STREQ("{\"code\":0}", response.body.c_str());
+  ASSERT_TRUE(decoder.next(&frame));
+  ASSERT_TRUE(wire::decodeResponse(frame, &response));
+  EXPECT_EQ(102, response.codeline.code);
+  EXPECT_STREQ("{}", response.body.c_str());
+  EXPECT_FALSE(decoder.next(&frame));
+}
+
+TEST(WireTest, Deflate) {
+  std::string hello;
+  wire::encodeHello(&hello, WIRE_HELLO_DEFLATE);
+  EXPECT_TRUE(wire::isHello(hello.data(), hello.length()));
+  wire::FrameDecoder decoder;
+  wire::Frame frame;
+  decoder.append(hello.data(), hello.length());
+  ASSERT_TRUE(decoder.next(&frame));
+  EXPECT_EQ(WIRE_HELLO_DEFLATE, wire::getHelloFlags(frame));
+
+  std::string roster = "{\"peers\":[";
+  for (int i = 0; i < 200; ++i) {
+    roster += (i > 0 ? "," : "") + Peer::Builder(1000 + i).setLogin("peer_" + std::to_string(i))
+        .setEmail("peer_" + std::to_string(i) + "@ya.ru").setChannel(500).build().toJson();
+  }
+  roster += "],\"channel\":500}";
+  std::string frames;
+  wire::encodeResponse(200, roster.c_str(), roster.length(), &frames);
+  wire::encodeResponse(102, "{}", 2, &frames);
+
+  wire::Deflater deflater;
+  std::string deflated;
+  ASSERT_TRUE(deflater.deflate(frames.data(), frames.length(), &deflated));
+  EXPECT_LT(deflated.length() * 4, frames.length());
+  std::string small;
+  wire::encodeResponse(200, "{}", 2, &small);
+  EXPECT_FALSE(deflater.deflate(small.data(), small.length(), &deflated));  // not shorter, output is intact
+
+  wire::Inflater inflater;
+  for (int round = 0; round < 2; ++round) {  // contexts are reused
+    decoder.append(deflated.data(), deflated.length());
+    ASSERT_TRUE(decoder.next(&frame));
+    EXPECT_EQ(wire::FrameType::DEFLATED, frame.type);
+    std::string inflated;
+    ASSERT_TRUE(inflater.inflate(frame, &inflated));
+    EXPECT_EQ(frames, inflated);
+    EXPECT_FALSE(decoder.next(&frame));
+    deflated.clear();
+    ASSERT_TRUE(deflater.deflate(frames.data(), frames.length(), &deflated));
+  }
+
+  wire::Frame corrupted = { wire::FrameType::DEFLATED, roster.data(), roster.length() };
+  std::string output;
+  EXPECT_FALSE(inflater.inflate(corrupted, &output));
+  EXPECT_TRUE(output.empty());
+}
+
+}
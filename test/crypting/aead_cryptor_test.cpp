@@ -0,0 +1,152 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "common.h"
+#include "crypting/aead_cryptor.h"
+#include "crypting/crypting_util.h"
+
+namespace test {
+
+static secure::SymmetricKey fixedAeadKey() {
+  unsigned char raw[KEY_LENGTH];
+  for (int i = 0; i < KEY_LENGTH; ++i) {
+    raw[i] = i;
+  }
+  return secure::SymmetricKey(raw);
+}
+
+static const secure::AeadAlgorithm AEAD_ALGORITHMS[] = {
+  secure::AeadAlgorithm::AES_256_GCM,
+#if !USE_BORINGSSL
+  secure::AeadAlgorithm::CHACHA20_POLY1305
+#endif  // USE_BORINGSSL
+};
+
+TEST(AEADCryptor, SealOpen) {
+  std::string text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit.";
+  const unsigned char aad[] = "header";
+  for (auto algorithm : AEAD_ALGORITHMS) {
+    secure::AEADCryptor cryptor(fixedAeadKey(), algorithm);
+    ASSERT_TRUE(cryptor.isValid());
+    std::vector<unsigned char> sealed(secure::AEADCryptor::getSealedLength(text.length()));
+    int sealed_len = cryptor.seal((const unsigned char*) text.c_str(), text.length(), &sealed[0], aad, sizeof(aad));
+    EXPECT_EQ((int) sealed.size(), sealed_len);
+
+    secure::AEADCryptor receiver(fixedAeadKey(), algorithm);
+    std::vector<unsigned char> plain(text.length());
+    int plain_len = receiver.open(&sealed[0], sealed_len, &plain[0], aad, sizeof(aad));
+    ASSERT_EQ((int) text.length(), plain_len);
+    EXPECT_EQ(0, memcmp(text.c_str(), &plain[0], plain_len));
+  }
+}
+
+TEST(AEADCryptor, RejectTampered) {
+  std::string text = "Lorem ipsum dolor sit amet";
+  const unsigned char aad[] = "header";
+  const unsigned char other_aad[] = "header!";
+  for (auto algorithm : AEAD_ALGORITHMS) {
+    secure::AEADCryptor cryptor(fixedAeadKey(), algorithm);
+    std::vector<unsigned char> sealed(secure::AEADCryptor::getSealedLength(text.length()));
+    int sealed_len = cryptor.seal((const unsigned char*) text.c_str(), text.length(), &sealed[0], aad, sizeof(aad));
+    std::vector<unsigned char> plain(text.length());
+
+    for (int position : {0, AEAD_NONCE_LENGTH, sealed_len - 1}) {  // nonce, cipher, tag
+      std::vector<unsigned char> tampered(sealed);
+      tampered[position] ^= 0x01;
+      EXPECT_EQ(-1, cryptor.open(&tampered[0], sealed_len, &plain[0], aad, sizeof(aad)));
+    }
+    EXPECT_EQ(-1, cryptor.open(&sealed[0], sealed_len, &plain[0], other_aad, sizeof(other_aad)));
+    EXPECT_EQ(-1, cryptor.open(&sealed[0], AEAD_NONCE_LENGTH + AEAD_TAG_LENGTH - 1, &plain[0]));
+    EXPECT_EQ((int) text.length(), cryptor.open(&sealed[0], sealed_len, &plain[0], aad, sizeof(aad)));
+  }
+}
+
+TEST(AEADCryptor, SealBatch) {
+  std::vector<std::string> plains;
+  size_t total = 0;
+  for (size_t size = 0; size < 100; size += 7) {
+    plains.push_back(std::string(size, 'a' + size % 26));
+    total += secure::AEADCryptor::getSealedLength(size);
+  }
+  secure::AEADCryptor cryptor(fixedAeadKey());
+  std::vector<unsigned char> output(total);
+  std::vector<int> sealed_lens(plains.size());
+  ASSERT_EQ(plains.size(), cryptor.sealBatch(plains, &output[0], &sealed_lens[0]));
+
+  std::set<std::string> nonces;
+  unsigned char* sealed = &output[0];
+  for (size_t i = 0; i < plains.size(); ++i) {
+    nonces.insert(std::string((const char*) sealed, AEAD_NONCE_LENGTH));
+    std::vector<unsigned char> plain(plains[i].length() + 1);
+    int plain_len = cryptor.open(sealed, sealed_lens[i], &plain[0]);
+    ASSERT_EQ((int) plains[i].length(), plain_len);
+    EXPECT_EQ(0, memcmp(plains[i].c_str(), &plain[0], plain_len));
+    sealed += sealed_lens[i];
+  }
+  EXPECT_EQ(plains.size(), nonces.size());  // nonce is never repeated
+}
+
+TEST(AEADCryptor, SessionEnvelopeIsAuthenticated) {
+  std::string text = "Lorem ipsum dolor sit amet";
+  bool encrypted = false, decrypted = false;
+  std::string chunk = secure::good::encryptAndPack(fixedAeadKey(), text, encrypted);
+  ASSERT_TRUE(encrypted);
+  EXPECT_STREQ(text.c_str(), secure::good::unpackAndDecrypt(fixedAeadKey(), chunk, decrypted).c_str());
+  EXPECT_TRUE(decrypted);
+
+  std::string tampered = chunk;
+  tampered[tampered.length() - 6] = tampered[tampered.length() - 6] == 'A' ? 'B' : 'A';
+  secure::good::unpackAndDecrypt(fixedAeadKey(), tampered, decrypted);
+  EXPECT_FALSE(decrypted);
+}
+
+TEST(AEADCryptor, SessionNonceAdvances) {
+  bool encrypted = false;
+  unsigned char first[256], second[256];
+  size_t first_len = 0, second_len = 0;
+  ASSERT_TRUE(common::base64Decode(secure::good::encryptAndPack(fixedAeadKey(), "first", encrypted), first, first_len));
+  ASSERT_TRUE(common::base64Decode(secure::good::encryptAndPack(fixedAeadKey(), "second", encrypted), second, second_len));
+
+  // the same random prefix, next counter
+  const unsigned char* first_nonce = first + ENVELOPE_HEADER_SIZE;
+  const unsigned char* second_nonce = second + ENVELOPE_HEADER_SIZE;
+  EXPECT_EQ(0, memcmp(first_nonce, second_nonce, AEAD_NONCE_LENGTH - 4));
+  EXPECT_EQ(first_nonce[AEAD_NONCE_LENGTH - 1] + 1, second_nonce[AEAD_NONCE_LENGTH - 1]);
+  EXPECT_EQ(&secure::getAEADCryptor(fixedAeadKey()), &secure::getAEADCryptor(fixedAeadKey()));
+}
+
+}
+
+#endif  // SECURE
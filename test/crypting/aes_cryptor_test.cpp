@@ -35,6 +35,7 @@
 #include <cstring>
 #include "common.h"
 #include "crypting/aes_cryptor.h"
+#include "crypting/context_pool.h"
 #include "logger.h"
 
 namespace test {
@@ -86,6 +87,33 @@ TEST_F(AESCryptorFixedTest, DecryptCipher2) {
   EXPECT_STREQ("world", output.c_str());
 }
 
+TEST_F(AESCryptorFixedTest, EncryptIntoBuffer) {
+  std::string input = "hello";
+  unsigned char cipher[64], plain[64];
+  int cipher_len = m_cryptor.encrypt((const unsigned char*) input.c_str(), input.length(), cipher);
+  EXPECT_STREQ("55cc8e112f7fd1889f5ef9d92a8f1ce2", common::bin2hex(cipher, cipher_len).c_str());
+  int plain_len = m_cryptor.decrypt(cipher, cipher_len, plain);
+  ASSERT_EQ(input.length(), plain_len);
+  EXPECT_EQ(0, memcmp(input.c_str(), plain, plain_len));
+}
+
+TEST(CipherContextPool, Reuse) {
+  EVP_CIPHER_CTX* first = nullptr;
+  {
+    secure::CipherContext context;
+    first = context.get();
+    EXPECT_TRUE(first != nullptr);
+  }
+  size_t idle = secure::getIdleCipherContextsCount();
+  EXPECT_LE(1, idle);
+  {
+    secure::CipherContext context;
+    EXPECT_EQ(first, context.get());
+    EXPECT_EQ(idle - 1, secure::getIdleCipherContextsCount());
+  }
+  EXPECT_EQ(idle, secure::getIdleCipherContextsCount());
+}
+
 /* Random key and IV */
 // ----------------------------------------------
 TEST(AESCryptorTest, Complete) {
@@ -0,0 +1,194 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include "api/structures.h"
+#include "common.h"
+#include "codec.h"
+#include "crypting/agreement.h"
+#include "crypting/crypting_util.h"
+
+namespace test {
+
+static secure::SymmetricKey zeroSessionKey() {
+  unsigned char raw[KEY_LENGTH] = {0};
+  return secure::SymmetricKey(raw);
+}
+
+static std::pair<secure::Key, secure::Key> generateKeyPair(ID_t id) {
+  auto key_pair = secure::agreement::generateKeyPair(id, secure::agreement::getIdentityKey(id));
+  remove(common::createFilenameWithId(id, IDENTITY_KEY_FILE).c_str());
+  return key_pair;
+}
+
+static bool deriveSessionKey(const std::pair<secure::Key, secure::Key>& own, const std::pair<secure::Key, secure::Key>& own_ephemeral,
+                             const std::pair<secure::Key, secure::Key>& peer, const std::pair<secure::Key, secure::Key>& peer_ephemeral,
+                             secure::SymmetricKey& session_key) {
+  return secure::agreement::deriveSessionKey(own.second, own_ephemeral.second, peer.first, peer_ephemeral.first, session_key);
+}
+
+TEST(Agreement, KeyPairLayout) {
+  auto key_pair = generateKeyPair(1000);
+  EXPECT_EQ(secure::KeyVersion::X25519, key_pair.first.getVersion());
+  EXPECT_EQ(secure::KeyVersion::X25519, key_pair.second.getVersion());
+  EXPECT_EQ(codec::base64EncodedLength(AGREEMENT_PUBLIC_LENGTH), key_pair.first.getKey().length());
+  EXPECT_EQ(codec::base64EncodedLength(AGREEMENT_PRIVATE_LENGTH), key_pair.second.getKey().length());
+  EXPECT_TRUE(secure::agreement::verifyPublicKey(key_pair.first));
+
+  secure::Key parsed = secure::Key::fromJson(key_pair.first.toJson());
+  EXPECT_TRUE(key_pair.first == parsed);
+}
+
+TEST(Agreement, RejectForeignOrTamperedKey) {
+  auto key_pair = generateKeyPair(1000);
+  secure::Key foreign(1001, key_pair.first.getKey(), secure::KeyVersion::X25519);
+  EXPECT_FALSE(secure::agreement::verifyPublicKey(foreign));  // signature binds owner's id
+
+  std::string tampered = key_pair.first.getKey();
+  tampered[0] = tampered[0] == 'A' ? 'B' : 'A';
+  EXPECT_FALSE(secure::agreement::verifyPublicKey(secure::Key(1000, tampered, secure::KeyVersion::X25519)));
+  EXPECT_FALSE(secure::agreement::verifyPublicKey(secure::Key(1000, "short", secure::KeyVersion::X25519)));
+  EXPECT_FALSE(secure::agreement::verifyPublicKey(secure::Key(1000, key_pair.first.getKey())));  // RSA version
+}
+
+TEST(Agreement, IdentitySurvivesSessions) {
+  auto identity = secure::agreement::getIdentityKey(1003);
+  EXPECT_TRUE(common::isFileAccessible(common::createFilenameWithId(1003, IDENTITY_KEY_FILE)));
+  EXPECT_TRUE(identity == secure::agreement::getIdentityKey(1003));
+  auto first = secure::agreement::generateKeyPair(1003, identity);
+  auto second = secure::agreement::generateKeyPair(1003, secure::agreement::getIdentityKey(1003));
+  EXPECT_STRNE(first.first.getKey().c_str(), second.first.getKey().c_str());  // fresh agreement key
+  remove(common::createFilenameWithId(1003, IDENTITY_KEY_FILE).c_str());
+
+  std::string known = common::createFilenameWithId(1000, KNOWN_IDENTITIES_FILE);
+  remove(known.c_str());
+  EXPECT_TRUE(secure::agreement::pinIdentity(1000, first.first));   // trust on first use
+  EXPECT_TRUE(secure::agreement::pinIdentity(1000, second.first));  // same identity, next session
+  EXPECT_FALSE(secure::agreement::pinIdentity(1000, generateKeyPair(1003).first));  // impostor
+  EXPECT_TRUE(secure::agreement::pinIdentity(1000, generateKeyPair(1004).first));
+  remove(known.c_str());
+}
+
+TEST(Agreement, RejectForeignOrTamperedEphemeralKey) {
+  auto alice = generateKeyPair(1000);
+  auto bob = generateKeyPair(1001);
+  auto ephemeral = secure::agreement::generateEphemeralKeyPair(1001, alice.second);
+  EXPECT_EQ(codec::base64EncodedLength(EPHEMERAL_PUBLIC_LENGTH), ephemeral.first.getKey().length());
+  EXPECT_TRUE(secure::agreement::verifyEphemeralKey(ephemeral.first, 1001, alice.first));
+  EXPECT_FALSE(secure::agreement::verifyEphemeralKey(ephemeral.first, 1002, alice.first));  // sent to another peer
+  EXPECT_FALSE(secure::agreement::verifyEphemeralKey(ephemeral.first, 1001, bob.first));    // signed by another identity
+
+  std::string tampered = ephemeral.first.getKey();
+  tampered[0] = tampered[0] == 'A' ? 'B' : 'A';
+  EXPECT_FALSE(secure::agreement::verifyEphemeralKey(secure::Key(1000, tampered, secure::KeyVersion::X25519), 1001, alice.first));
+}
+
+TEST(Agreement, BothPeersDeriveSameSessionKey) {
+  auto alice = generateKeyPair(1000);
+  auto bob = generateKeyPair(1001);
+  auto eve = generateKeyPair(1002);
+  auto alice_ephemeral = secure::agreement::generateEphemeralKeyPair(1001, alice.second);
+  auto bob_ephemeral = secure::agreement::generateEphemeralKeyPair(1000, bob.second);
+  auto eve_ephemeral = secure::agreement::generateEphemeralKeyPair(1000, eve.second);
+  secure::SymmetricKey alice_key = zeroSessionKey(), bob_key = zeroSessionKey(), eve_key = zeroSessionKey();
+  EXPECT_TRUE(deriveSessionKey(alice, alice_ephemeral, bob, bob_ephemeral, alice_key));
+  EXPECT_TRUE(deriveSessionKey(bob, bob_ephemeral, alice, alice_ephemeral, bob_key));
+  EXPECT_TRUE(deriveSessionKey(eve, eve_ephemeral, alice, alice_ephemeral, eve_key));
+  EXPECT_EQ(0, memcmp(alice_key.key, bob_key.key, KEY_LENGTH));
+  EXPECT_NE(0, memcmp(alice_key.key, eve_key.key, KEY_LENGTH));
+
+  // same agreement keys, next one-time keys - another session key
+  secure::SymmetricKey next_key = zeroSessionKey();
+  auto next_ephemeral = secure::agreement::generateEphemeralKeyPair(1001, alice.second);
+  EXPECT_TRUE(deriveSessionKey(alice, next_ephemeral, bob, bob_ephemeral, next_key));
+  EXPECT_NE(0, memcmp(alice_key.key, next_key.key, KEY_LENGTH));
+}
+
+TEST(Agreement, SessionEnvelope) {
+  auto alice = generateKeyPair(1000);
+  auto bob = generateKeyPair(1001);
+  auto alice_ephemeral = secure::agreement::generateEphemeralKeyPair(1001, alice.second);
+  auto bob_ephemeral = secure::agreement::generateEphemeralKeyPair(1000, bob.second);
+  secure::SymmetricKey alice_key = zeroSessionKey(), bob_key = zeroSessionKey();
+  ASSERT_TRUE(deriveSessionKey(alice, alice_ephemeral, bob, bob_ephemeral, alice_key));
+  ASSERT_TRUE(deriveSessionKey(bob, bob_ephemeral, alice, alice_ephemeral, bob_key));
+
+  std::string text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit.";
+  Message message = Message::Builder(1000).setLogin("Alice").setEmail("alice@ya.ru").setChannel(0)
+      .setDestId(1001).setTimestamp(1461516681500).setSize(text.length()).setEncrypted(false).setMessage(text).build();
+  message.encrypt(alice_key);
+  EXPECT_TRUE(message.isEncrypted());
+  EXPECT_TRUE(secure::isBinaryEnvelope(message.getMessage()));
+  EXPECT_STRNE(text.c_str(), message.getMessage().c_str());
+
+  Message received = Message::fromJson(message.toJson());
+  received.decrypt(bob_key);
+  EXPECT_FALSE(received.isEncrypted());
+  EXPECT_STREQ(text.c_str(), received.getMessage().c_str());
+}
+
+TEST(Agreement, SenderKey) {
+  secure::SenderKey sender_key = secure::agreement::generateSenderKey(1000, 500, 1);
+  EXPECT_EQ(1000, sender_key.getId());
+  EXPECT_EQ(500, sender_key.getChannel());
+  EXPECT_EQ(1U, sender_key.getGeneration());
+
+  secure::SenderKey distributed = secure::SenderKey::fromJson(sender_key.toJson());
+  EXPECT_EQ(sender_key.getId(), distributed.getId());
+  EXPECT_EQ(sender_key.getChannel(), distributed.getChannel());
+  EXPECT_EQ(sender_key.getGeneration(), distributed.getGeneration());
+  EXPECT_STREQ(sender_key.getKey().c_str(), distributed.getKey().c_str());
+  EXPECT_THROW(secure::SenderKey::fromJson("{\"id\":1000}"), ConvertException);
+
+  secure::SymmetricKey own_key = zeroSessionKey(), member_key = zeroSessionKey();
+  ASSERT_TRUE(secure::agreement::decodeSenderKey(sender_key, own_key));
+  ASSERT_TRUE(secure::agreement::decodeSenderKey(distributed, member_key));
+  EXPECT_FALSE(secure::agreement::decodeSenderKey(secure::SenderKey(1000, 500, 1, "short"), member_key));
+
+  std::string text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit.";
+  Message message = Message::Builder(1000).setLogin("Alice").setEmail("alice@ya.ru").setChannel(500)
+      .setDestId(UNKNOWN_ID).setTimestamp(1461516681500).setSize(text.length()).setEncrypted(false).setMessage(text).build();
+  message.encrypt(own_key);  // once for all members
+  Message received = Message::fromJson(message.toJson());
+  received.decrypt(member_key);
+  EXPECT_STREQ(text.c_str(), received.getMessage().c_str());
+
+  secure::SymmetricKey rotated_key = zeroSessionKey();
+  ASSERT_TRUE(secure::agreement::decodeSenderKey(secure::agreement::generateSenderKey(1000, 500, 2), rotated_key));
+  Message stale = Message::fromJson(message.toJson());
+  stale.decrypt(rotated_key);
+  EXPECT_TRUE(stale.isEncrypted());
+}
+}
+
+#endif  // SECURE
@@ -33,6 +33,7 @@
 #include <cstdio>
 #include "common.h"
 #include "crypting/crypting_util.h"
+#include "crypting/key_cache.h"
 #include "crypting/random_util.h"
 #include "crypting/rsa_cryptor.h"
 #include "logger.h"
@@ -212,6 +213,24 @@ TEST_F(CryptingUtilTest, RSAdirectDoubleCipher) {
   EXPECT_STREQ(input.c_str(), output_two.c_str());
 }
 
+TEST_F(CryptingUtilTest, RSAdirectCachedKeys) {
+  std::string input = "qwerty123";
+  secure::KeyCache cache;
+
+  bool encrypted = false, decrypted = false;
+  std::string cipher = secure::good::encryptRSA(cache.getPublicKey(m_key_pair.first), input, encrypted);
+  EXPECT_TRUE(encrypted);
+
+  auto private_key = cache.getPrivateKey(m_key_pair.second);
+  EXPECT_EQ(private_key, cache.getPrivateKey(m_key_pair.second));  // parsed once
+  std::string output = secure::good::decryptRSA(private_key, cipher, decrypted);
+  EXPECT_TRUE(decrypted);
+  EXPECT_STREQ(input.c_str(), output.c_str());
+
+  cache.invalidate(m_key_pair.second.getId());
+  EXPECT_NE(private_key, cache.getPrivateKey(m_key_pair.second));  // parsed again
+}
+
 }
 
 #endif  // SECURE
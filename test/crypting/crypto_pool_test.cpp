@@ -0,0 +1,112 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "crypting/crypto_pool.h"
+
+namespace test {
+
+TEST(Log2Histogram, Percentiles) {
+  secure::Log2Histogram histogram;
+  EXPECT_EQ(0U, histogram.getPercentile(0.5));
+  for (uint64_t value = 1; value <= 100; ++value) {
+    histogram.record(value);
+  }
+  histogram.record(0);
+  EXPECT_EQ(101U, histogram.getCount());
+  EXPECT_EQ(64U, histogram.getPercentile(0.5));
+  EXPECT_EQ(128U, histogram.getPercentile(0.99));
+  EXPECT_EQ(1U, histogram.getPercentile(0.01));
+}
+
+TEST(CryptoWorkerPool, ExecuteOnWorker) {
+  secure::CryptoWorkerPool pool(2);
+  EXPECT_EQ(2U, pool.getWorkersCount());
+  std::atomic<int> sum(0);
+  std::vector<std::thread> callers;
+  for (int i = 1; i <= 100; ++i) {
+    callers.emplace_back([&pool, &sum, i]() {
+      std::thread::id caller = std::this_thread::get_id();
+      bool other_thread = false;
+      EXPECT_TRUE(pool.execute([&sum, &other_thread, caller, i]() {
+        other_thread = std::this_thread::get_id() != caller;
+        sum += i;
+      }));
+      EXPECT_TRUE(other_thread);
+    });
+  }
+  for (auto& caller : callers) {
+    caller.join();
+  }
+  EXPECT_EQ(5050, sum.load());
+  EXPECT_EQ(100U, pool.getLatencyHistogram().getCount());
+  EXPECT_EQ(0U, pool.getRejectedCount());
+}
+
+TEST(CryptoWorkerPool, ShedWhenQueueIsFull) {
+  secure::CryptoWorkerPool pool(1, 1);
+  std::atomic<bool> started(false), release(false);
+  std::thread busy([&pool, &started, &release]() {  // occupies the only worker
+    pool.execute([&started, &release]() {
+      started = true;
+      while (!release) { std::this_thread::yield(); }
+    });
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  std::thread queued([&pool]() {  // fills the queue
+    EXPECT_TRUE(pool.execute([](){}));
+  });
+  while (pool.getQueueDepth() == 0) {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(pool.execute([](){}));
+  EXPECT_EQ(1U, pool.getRejectedCount());
+
+  release = true;
+  busy.join();
+  queued.join();
+  EXPECT_TRUE(pool.execute([](){}));
+}
+
+TEST(CryptoWorkerPool, RethrowException) {
+  secure::CryptoWorkerPool pool(1);
+  EXPECT_THROW(pool.execute([]() { throw ConvertException(); }), ConvertException);
+  EXPECT_TRUE(pool.execute([](){}));
+}
+
+}
+
+#endif  // SECURE
@@ -36,6 +36,7 @@
 #include "crypting/includes.h"
 #include "crypting/crypting_util.h"
 #include "crypting/evp_cryptor.h"
+#include "crypting/key_cache.h"
 #include "crypting/random_util.h"
 #include "logger.h"
 
@@ -389,6 +390,34 @@ TEST_F(EVPfixture, SeparateRaw) {
   EXPECT_STREQ(message.c_str(), output.c_str());
 }
 
+// ----------------------------------------------
+TEST_F(EVPfixture, SeparateCachedKeysIntoBuffer) {
+  std::string message = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Phasellus scelerisque felis odio, eu hendrerit eros laoreet at.";
+  secure::KeyCache cache;
+
+  secure::EVPCryptor cryptor_one;
+  std::vector<unsigned char> cipher(message.length() + EVP_MAX_IV_LENGTH);
+  int cipher_len = cryptor_one.encrypt(cache.getPublicKey(m_key_pair.first), (const unsigned char*) message.c_str(), message.length(), &cipher[0]);
+  ASSERT_LT(0, cipher_len);
+  EXPECT_EQ(cipher_len, cryptor_one.getCipherLength());
+
+  std::vector<unsigned char> ek(cryptor_one.getEKlength());
+  std::vector<unsigned char> iv(cryptor_one.getIVlength());
+  cryptor_one.getEK(&ek[0]);
+  cryptor_one.getIV(&iv[0]);
+
+  // opened by the string API the same way as a cipher produced by it
+  secure::EVPCryptor cryptor_two;
+  cryptor_two.setEK(ek.size(), &ek[0]);
+  cryptor_two.setIV(iv.size(), &iv[0]);
+  cryptor_two.setCipherLength(cipher_len);
+
+  bool decrypted = false;
+  std::string output = cryptor_two.decrypt(common::bin2hex(&cipher[0], cipher_len), m_key_pair.second, decrypted);
+  EXPECT_TRUE(decrypted);
+  EXPECT_STREQ(message.c_str(), output.c_str());
+}
+
 // ----------------------------------------------
 TEST_F(EVPfixture, Separate) {
   std::string message = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Phasellus scelerisque felis odio, eu hendrerit eros laoreet at. Fusce ac rutrum nisl, quis feugiat tortor. Vestibulum non urna est. Maecenas quis mi at est blandit tempor. Nullam ut quam porttitor, convallis nisl vitae, pulvinar quam. In hac habitasse platea dictumst. Aenean vehicula mauris odio, eu mattis augue tristique in. Morbi nec magna sit amet elit tempor sagittis. Suspendisse id tempor velit. Suspendisse nec velit orci. Cum sociis natoque penatibus et magnis dis parturient montes, nascetur ridiculus mus. Vivamus commodo ullamcorper convallis. Nunc congue lobortis dictum.";
@@ -406,6 +435,57 @@ TEST_F(EVPfixture, Separate) {
   EXPECT_STREQ(message.c_str(), output.c_str());
 }
 
+// ----------------------------------------------
+TEST_F(EVPfixture, BinaryEnvelope) {
+  std::string message = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Phasellus scelerisque felis odio, eu hendrerit eros laoreet at.";
+
+  secure::EVPCryptor cryptor_one, cryptor_two;
+
+  bool encrypted = false;
+  std::string chunk = secure::good::encryptAndPack(cryptor_one, m_key_pair.first, message, encrypted);
+  EXPECT_TRUE(encrypted);
+  EXPECT_TRUE(secure::isBinaryEnvelope(chunk));
+
+  std::string legacy = secure::good::encryptAndPackLegacy(cryptor_one, m_key_pair.first, message, encrypted);
+  EXPECT_FALSE(secure::isBinaryEnvelope(legacy));
+  EXPECT_GT(legacy.length(), chunk.length());
+
+  bool decrypted = false;
+  std::string output = secure::good::unpackAndDecrypt(cryptor_two, m_key_pair.second, chunk, decrypted);
+  EXPECT_TRUE(decrypted);
+  EXPECT_STREQ(message.c_str(), output.c_str());
+}
+
+TEST_F(EVPfixture, LegacyEnvelope) {
+  std::string message = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Phasellus scelerisque felis odio, eu hendrerit eros laoreet at.";
+
+  secure::EVPCryptor cryptor_one, cryptor_two;
+
+  bool encrypted = false;
+  std::string chunk = secure::good::encryptAndPackLegacy(cryptor_one, m_key_pair.first, message, encrypted);
+  EXPECT_TRUE(encrypted);
+
+  bool decrypted = false;
+  std::string output = secure::good::unpackAndDecrypt(cryptor_two, m_key_pair.second, chunk, decrypted);
+  EXPECT_TRUE(decrypted);
+  EXPECT_STREQ(message.c_str(), output.c_str());
+}
+
+TEST_F(EVPfixture, MalformedEnvelope) {
+  std::string message = "Lorem ipsum dolor sit amet";
+
+  secure::EVPCryptor cryptor_one, cryptor_two;
+
+  bool encrypted = false;
+  std::string chunk = secure::good::encryptAndPack(cryptor_one, m_key_pair.first, message, encrypted);
+  std::string truncated = chunk.substr(0, chunk.length() - 4);
+
+  bool decrypted = true;
+  std::string output = secure::good::unpackAndDecrypt(cryptor_two, m_key_pair.second, truncated, decrypted);
+  EXPECT_FALSE(decrypted);
+  EXPECT_STREQ(truncated.c_str(), output.c_str());
+}
+
 // ----------------------------------------------
 TEST_F(EVPfixture, FixedMessage) {
   std::string text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Phasellus scelerisque felis odio, eu hendrerit eros laoreet at. Fusce ac rutrum nisl, quis feugiat tortor. Vestibulum non urna est. Maecenas quis mi at est blandit tempor. Nullam ut quam porttitor, convallis nisl vitae, pulvinar quam. In hac habitasse platea dictumst. Aenean vehicula mauris odio, eu mattis augue tristique in. Morbi nec magna sit amet elit tempor sagittis. Suspendisse id tempor velit. Suspendisse nec velit orci. Cum sociis natoque penatibus et magnis dis parturient montes, nascetur ridiculus mus. Vivamus commodo ullamcorper convallis. Nunc congue lobortis dictum.";
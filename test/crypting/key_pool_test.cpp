@@ -0,0 +1,111 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "crypting/crypting_util.h"
+#include "crypting/key_pool.h"
+#include "crypting/random_util.h"
+
+namespace test {
+
+TEST(Random, GenerateString) {
+  std::string first = secure::random::generateString(64);
+  std::string second = secure::random::generateString(64);
+  EXPECT_EQ(64U, first.length());
+  EXPECT_STRNE(first.c_str(), second.c_str());  // no reseeding with time
+  for (char c : first) {
+    EXPECT_TRUE(isalnum(c));
+  }
+  EXPECT_TRUE(secure::random::generateString(0).empty());
+}
+
+TEST(Random, GenerateBytes) {
+  unsigned char first[RANDOM_BUFFER_SIZE * 2 + 1] = {0};
+  unsigned char second[sizeof(first)] = {0};
+  secure::random::generateBytes(first, sizeof(first));  // crosses refills of buffer
+  secure::random::generateBytes(second, sizeof(second));
+  EXPECT_NE(0, memcmp(first, second, sizeof(first)));
+}
+
+TEST(KeyPool, TakePreGenerated) {
+  secure::KeyPool pool(1);
+  auto key_pair = pool.take(700);
+  EXPECT_EQ(700, key_pair.first.getId());
+  EXPECT_EQ(700, key_pair.second.getId());
+  EXPECT_EQ(secure::KeyVersion::RSA_PEM, key_pair.first.getVersion());
+
+  std::string text = "Lorem ipsum dolor sit amet";
+  bool encrypted = false, decrypted = false;
+  std::string cipher = secure::good::encryptRSA(key_pair.first, text, encrypted);
+  ASSERT_TRUE(encrypted);
+  EXPECT_STREQ(text.c_str(), secure::good::decryptRSA(key_pair.second, cipher, decrypted).c_str());
+  EXPECT_TRUE(decrypted);
+
+  EXPECT_EQ(0U, pool.getAvailableCount());
+  auto other_pair = pool.take(701);  // generated on demand, pool is not refilled
+  EXPECT_STRNE(key_pair.first.getKey().c_str(), other_pair.first.getKey().c_str());
+}
+
+TEST(KeyPool, TakeOnDemand) {
+  secure::KeyPool pool(0);  // nothing in advance
+  std::vector<std::pair<secure::Key, secure::Key>> key_pairs(3);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < key_pairs.size(); ++i) {
+    threads.emplace_back([&pool, &key_pairs, i]() { key_pairs[i] = pool.take(710 + i); });
+  }
+  for (auto& thread : threads) {
+    thread.join();  // each caller gets its own pair
+  }
+  EXPECT_STRNE(key_pairs[0].first.getKey().c_str(), key_pairs[1].first.getKey().c_str());
+  EXPECT_STRNE(key_pairs[1].first.getKey().c_str(), key_pairs[2].first.getKey().c_str());
+  EXPECT_EQ(712, key_pairs[2].first.getId());
+  EXPECT_EQ(0U, pool.getAvailableCount());
+}
+
+TEST(KeyPool, StoreAndLoad) {
+  auto key_pair = secure::random::generateKeyPair(702);
+  ASSERT_TRUE(secure::random::storeKeyPair(key_pair));
+  bool accessible = false;
+  auto loaded = secure::random::loadKeyPair(702, &accessible);
+  EXPECT_TRUE(accessible);
+  EXPECT_TRUE(key_pair.first == loaded.first);
+  EXPECT_TRUE(key_pair.second == loaded.second);
+  remove(common::createFilenameWithId(702, PUBLIC_KEY_FILE).c_str());
+  remove(common::createFilenameWithId(702, PRIVATE_KEY_FILE).c_str());
+}
+
+}
+
+#endif  // SECURE
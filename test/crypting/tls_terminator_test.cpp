@@ -0,0 +1,120 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#if SECURE
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/ssl.h>
+#include "crypting/tls_terminator.h"
+
+#define TEST_CERTIFICATE_FILE "../test/data/certificate.pem"
+#define TEST_PRIVATE_KEY_FILE "../test/data/private.pem"
+
+namespace test {
+
+/* Blocking client: handshake, send request, read reply; returns session for resumption */
+static SSL_SESSION* connectClient(SSL_CTX* context, int socket, SSL_SESSION* session, std::string* reply) {
+  SSL* ssl = SSL_new(context);
+  SSL_set_fd(ssl, socket);
+  if (session != nullptr) {
+    SSL_set_session(ssl, session);
+  }
+  SSL_SESSION* result = nullptr;
+  if (SSL_connect(ssl) == 1) {
+    char buffer[64];
+    SSL_write(ssl, "ping", 4);
+    int read_bytes = SSL_read(ssl, buffer, sizeof(buffer));  // also processes tickets sent after handshake
+    if (read_bytes > 0) {
+      reply->assign(buffer, read_bytes);
+    }
+    result = SSL_get1_session(ssl);
+    SSL_shutdown(ssl);
+  }
+  SSL_free(ssl);
+  return result;
+}
+
+static void serveOnce(secure::TlsTerminator& tls, SSL_CTX* context, SSL_SESSION** session, std::string* request, std::string* reply) {
+  int sockets[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+  std::thread client([context, &sockets, session, reply]() {
+    SSL_SESSION* resumable = connectClient(context, sockets[1], *session, reply);
+    SSL_SESSION_free(*session);
+    *session = resumable;
+  });
+  ASSERT_TRUE(tls.accept(sockets[0]));
+  EXPECT_TRUE(tls.isSecure(sockets[0]));
+  char buffer[64];
+  int read_bytes = tls.read(sockets[0], buffer, sizeof(buffer));
+  ASSERT_LT(0, read_bytes);
+  request->assign(buffer, read_bytes);
+  EXPECT_EQ(4, tls.write(sockets[0], "pong", 4));
+  client.join();
+  tls.close(sockets[0]);
+  EXPECT_FALSE(tls.isSecure(sockets[0]));
+  close(sockets[0]);
+  close(sockets[1]);
+}
+
+TEST(TlsTerminator, RejectMissingCertificate) {
+  secure::TlsTerminator tls;
+  EXPECT_FALSE(tls.init("../test/data/missing.pem", TEST_PRIVATE_KEY_FILE));
+  EXPECT_FALSE(tls.isEnabled());
+  EXPECT_FALSE(tls.isSecure(0));
+}
+
+TEST(TlsTerminator, HandshakeAndResume) {
+  secure::TlsTerminator tls;
+  ASSERT_TRUE(tls.init(TEST_CERTIFICATE_FILE, TEST_PRIVATE_KEY_FILE));
+  SSL_CTX* context = SSL_CTX_new(TLS_client_method());
+
+  SSL_SESSION* session = nullptr;
+  std::string request, reply;
+  serveOnce(tls, context, &session, &request, &reply);
+  EXPECT_STREQ("ping", request.c_str());
+  EXPECT_STREQ("pong", reply.c_str());
+  EXPECT_EQ(1U, tls.getFullHandshakesCount());
+  EXPECT_EQ(0U, tls.getResumedHandshakesCount());
+  ASSERT_TRUE(session != nullptr);
+
+  serveOnce(tls, context, &session, &request, &reply);  // with ticket from previous connection
+  EXPECT_STREQ("pong", reply.c_str());
+  EXPECT_EQ(1U, tls.getFullHandshakesCount());
+  EXPECT_EQ(1U, tls.getResumedHandshakesCount());
+
+  SSL_SESSION_free(session);
+  SSL_CTX_free(context);
+}
+
+}
+
+#endif  // SECURE
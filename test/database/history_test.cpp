@@ -0,0 +1,135 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include "database/message_history.h"
+
+#define TEST_HISTORY_DIRECTORY "test_history"
+
+namespace test {
+
+static std::string historyPage(uint64_t from_seq, uint64_t to_seq) {
+  std::string page;
+  for (uint64_t seq = from_seq; seq <= to_seq; ++seq) {
+    page.append(seq == from_seq ? "" : ",").append(db::MessageHistory::frame(seq, "{\"n\":" + std::to_string(seq) + "}"));
+  }
+  return page;
+}
+
+TEST(MessageHistory, PagesFromRing) {
+  removeJournal(TEST_HISTORY_DIRECTORY);
+  {
+    db::MessageJournal journal(TEST_HISTORY_DIRECTORY, TEST_SEGMENT_SIZE, 0);
+    db::MessageHistory history(&journal, 16);
+    for (int i = 1; i <= 5; ++i) {
+      EXPECT_EQ(i, history.append(500, 1000 + i, "{\"n\":" + std::to_string(i) + "}"));
+    }
+    EXPECT_EQ(1, history.append(600, 2000, "{\"n\":1}"));
+    EXPECT_EQ(5, history.getLastSeq(500));
+    EXPECT_EQ(0, history.getLastSeq(700));
+
+    std::string frames;
+    EXPECT_EQ(5, history.read(500, 0, 10, &frames));
+    EXPECT_EQ(historyPage(1, 5), frames);
+
+    frames.clear();
+    EXPECT_EQ(2, history.read(500, 2, 2, &frames));
+    EXPECT_EQ(historyPage(3, 4), frames);
+
+    frames.clear();
+    EXPECT_EQ(0, history.read(500, 5, 10, &frames));
+    EXPECT_EQ(0, history.read(700, 0, 10, &frames));
+    EXPECT_TRUE(frames.empty());
+  }
+  removeJournal(TEST_HISTORY_DIRECTORY);
+}
+
+TEST(MessageHistory, OlderPagesFromDisk) {
+  removeJournal(TEST_HISTORY_DIRECTORY);
+  {
+    db::MessageJournal journal(TEST_HISTORY_DIRECTORY, TEST_SEGMENT_SIZE, 0);
+    db::MessageHistory history(&journal, 4);
+    for (int i = 1; i <= 10; ++i) {
+      history.append(500, 1000 + i, "{\"n\":" + std::to_string(i) + "}");
+    }
+
+    // 1..6 have left the ring, 7..10 are still there
+    std::string frames;
+    EXPECT_EQ(10, history.read(500, 0, 20, &frames));
+    EXPECT_EQ(historyPage(1, 10), frames);
+
+    frames.clear();
+    EXPECT_EQ(3, history.read(500, 4, 3, &frames));
+    EXPECT_EQ(historyPage(5, 7), frames);
+  }
+  {
+    // after restart everything comes from disk
+    db::MessageJournal journal(TEST_HISTORY_DIRECTORY, TEST_SEGMENT_SIZE, 0);
+    db::MessageHistory history(&journal, 4);
+    EXPECT_EQ(10, history.getLastSeq(500));
+
+    std::string frames;
+    EXPECT_EQ(2, history.read(500, 8, 10, &frames));
+    EXPECT_EQ(historyPage(9, 10), frames);
+
+    EXPECT_EQ(11, history.append(500, 2000, "{\"n\":11}"));
+    frames.clear();
+    EXPECT_EQ(3, history.read(500, 8, 10, &frames));
+    EXPECT_EQ(historyPage(9, 11), frames);
+  }
+  removeJournal(TEST_HISTORY_DIRECTORY);
+}
+
+TEST(MessageHistory, NoGapsWhileRingMoves) {
+  removeJournal(TEST_HISTORY_DIRECTORY);
+  {
+    db::MessageJournal journal(TEST_HISTORY_DIRECTORY, TEST_SEGMENT_SIZE, 0);
+    db::MessageHistory history(&journal, 4);
+    const uint64_t total = 400;
+    std::thread writer([&history, total]() {
+      for (uint64_t i = 1; i <= total; ++i) {
+        history.append(500, 1000 + i, "{\"n\":" + std::to_string(i) + "}");
+      }
+    });
+
+    // every page must continue right after the previous one, wherever it came from
+    uint64_t since_seq = 0;
+    while (since_seq < total) {
+      std::string frames;
+      size_t count = history.read(500, since_seq, 7, &frames);
+      ASSERT_EQ(count > 0 ? historyPage(since_seq + 1, since_seq + count) : "", frames);
+      since_seq += count;
+    }
+    writer.join();
+  }
+  removeJournal(TEST_HISTORY_DIRECTORY);
+}
+
+}  // namespace test
@@ -0,0 +1,119 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <dirent.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "database/message_journal.h"
+
+#define TEST_JOURNAL_DIRECTORY "test_journal"
+#define TEST_SEGMENT_SIZE 4096
+
+namespace test {
+
+static void removeJournal(const std::string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir != nullptr) {
+    dirent* entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+      std::string name(entry->d_name);
+      if (name != "." && name != "..") {
+        unlink((directory + "/" + name).c_str());
+      }
+    }
+    closedir(dir);
+  }
+  rmdir(directory.c_str());
+}
+
+TEST(MessageJournal, SequencePerChannel) {
+  removeJournal(TEST_JOURNAL_DIRECTORY);
+  {
+    db::MessageJournal journal(TEST_JOURNAL_DIRECTORY, TEST_SEGMENT_SIZE, 0);
+    EXPECT_EQ(1, journal.append(0, 1000, "first"));
+    EXPECT_EQ(1, journal.append(5, 1001, "second"));
+    EXPECT_EQ(2, journal.append(0, 1002, "third"));
+    EXPECT_EQ(2, journal.getLastSeq(0));
+    EXPECT_EQ(1, journal.getLastSeq(5));
+    EXPECT_EQ(0, journal.getLastSeq(7));
+
+    std::vector<db::SegmentRecord> records;
+    EXPECT_EQ(2, journal.read(0, 0, 10, &records));
+    EXPECT_STREQ("first", records[0].getPayload().c_str());
+    EXPECT_STREQ("third", records[1].getPayload().c_str());
+    EXPECT_EQ(1002, records[1].getTimestamp());
+  }
+  removeJournal(TEST_JOURNAL_DIRECTORY);
+}
+
+TEST(MessageJournal, ReadAcrossSegmentsAndRecover) {
+  removeJournal(TEST_JOURNAL_DIRECTORY);
+  std::string payload(100, 'x');
+  {
+    db::MessageJournal journal(TEST_JOURNAL_DIRECTORY, TEST_SEGMENT_SIZE, 0);
+    for (int i = 0; i < 500; ++i) {
+      journal.append(i % 2, i, payload + std::to_string(i));
+    }
+    EXPECT_LT(1, journal.getSegmentsCount());
+  }
+  db::MessageJournal journal(TEST_JOURNAL_DIRECTORY, TEST_SEGMENT_SIZE, 0);
+  EXPECT_EQ(250, journal.getLastSeq(1));
+
+  std::vector<db::SegmentRecord> records;
+  EXPECT_EQ(5, journal.read(1, 100, 5, &records));
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(101 + i, records[i].getSeq());
+    EXPECT_EQ(payload + std::to_string(2 * (100 + i) + 1), records[i].getPayload());
+  }
+  EXPECT_EQ(251, journal.append(1, 500, payload));
+  removeJournal(TEST_JOURNAL_DIRECTORY);
+}
+
+TEST(MessageJournal, CompactKeepsRecentRecords) {
+  removeJournal(TEST_JOURNAL_DIRECTORY);
+  {
+    std::string payload(100, 'x');
+    db::MessageJournal journal(TEST_JOURNAL_DIRECTORY, TEST_SEGMENT_SIZE, 0);
+    for (int i = 0; i < 500; ++i) {
+      journal.append(0, i, payload);
+    }
+    size_t total = journal.getSegmentsCount();
+    EXPECT_LT(0, journal.compact(50));
+    EXPECT_GT(total, journal.getSegmentsCount());
+
+    std::vector<db::SegmentRecord> records;
+    journal.read(0, 450, 100, &records);
+    EXPECT_EQ(50, records.size());
+  }
+  removeJournal(TEST_JOURNAL_DIRECTORY);
+}
+
+}  // namespace test
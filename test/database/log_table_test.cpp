@@ -0,0 +1,162 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+#include <cstdio>
+#include <string>
+#include <gtest/gtest.h>
+#include "database/log_table.h"
+
+namespace test {
+
+static uint64_t dayStart(const std::string& day) {
+  uint64_t from = 0, to = 0;
+  db::LogTable::dayToRange(day, &from, &to);
+  return from;
+}
+
+static db::LogRecord logRecord(ID_t connection_id, uint64_t timestamp) {
+  return db::LogRecord(connection_id, 1, timestamp, "GET /" + std::to_string(timestamp) + " HTTP/1.1", "[Host: test]", "");
+}
+
+TEST(LogTable, PartitionPerDay) {
+  std::remove(DATABASE_NAME);
+  {
+    EXPECT_EQ("logs_20260101", db::LogTable::partitionName(dayStart("20260101") + 1000));
+    uint64_t from = 0, to = 0;
+    EXPECT_FALSE(db::LogTable::dayToRange("2026-01-01", &from, &to));
+    EXPECT_TRUE(db::LogTable::dayToRange("20260102", &from, &to));
+    EXPECT_EQ(dayStart("20260101") + 86400000, from);
+    EXPECT_EQ(from + 86400000 - 1, to);
+
+    db::LogTable table(0);
+    uint64_t day1 = dayStart("20260101"), day2 = dayStart("20260102");
+    ID_t first = table.addLog(logRecord(5, day1 + 300));
+    table.addLog(logRecord(6, day1 + 100));
+    table.addLog(logRecord(5, day2 + 200));
+    EXPECT_EQ(5, table.getLog(first).getConnectionId());
+    EXPECT_EQ(day1 + 300, table.getLog(first).getTimestamp());
+
+    db::LogRecord log = db::LogRecord::EMPTY;
+    db::LogCursor all = table.getLogs(day1, day2 + 86400000 - 1);
+    EXPECT_TRUE(all.next(&log));
+    EXPECT_EQ(day1 + 100, log.getTimestamp());
+    EXPECT_TRUE(all.next(&log));
+    EXPECT_EQ(day1 + 300, log.getTimestamp());
+    EXPECT_TRUE(all.next(&log));
+    EXPECT_EQ(day2 + 200, log.getTimestamp());
+    EXPECT_FALSE(all.next(&log));
+
+    db::LogCursor connection = table.getLogs(day1, day2 + 86400000 - 1, 6);
+    EXPECT_TRUE(connection.next(&log));
+    EXPECT_EQ(6, log.getConnectionId());
+    EXPECT_FALSE(connection.next(&log));
+
+    table.removeLog(first);
+    db::LogCursor day = table.getLogs(day1, day1 + 86400000 - 1);
+    EXPECT_TRUE(day.next(&log));
+    EXPECT_EQ(day1 + 100, log.getTimestamp());
+    EXPECT_FALSE(day.next(&log));
+  }
+  {
+    // partitions are found again after restart
+    db::LogTable table(0);
+    db::LogRecord log = db::LogRecord::EMPTY;
+    db::LogCursor cursor = table.getLogs(dayStart("20260102"), dayStart("20260103"));
+    EXPECT_TRUE(cursor.next(&log));
+    EXPECT_EQ(dayStart("20260102") + 200, log.getTimestamp());
+    EXPECT_FALSE(cursor.next(&log));
+  }
+  std::remove(DATABASE_NAME);
+}
+
+TEST(LogTable, RetentionDropsOldPartitions) {
+  std::remove(DATABASE_NAME);
+  {
+    db::LogTable table(2);
+    uint64_t day1 = dayStart("20260101"), day5 = dayStart("20260105");
+    for (int i = 0; i < 5; ++i) {
+      table.addLog(logRecord(1, day1 + i * 86400000ULL));
+    }
+    table.setRetentionDays(0);
+    EXPECT_EQ(0, table.applyRetention(day5 + 1000));
+    table.setRetentionDays(2);
+    EXPECT_EQ(2, table.applyRetention(day5 + 1000));  // days 1 and 2 are older than 3
+    EXPECT_EQ(0, table.applyRetention(day5 + 1000));
+
+    int total = 0;
+    db::LogRecord log = db::LogRecord::EMPTY;
+    db::LogCursor cursor = table.getLogs(day1, day5 + 86400000 - 1);
+    while (cursor.next(&log)) {
+      EXPECT_LE(dayStart("20260103"), log.getTimestamp());
+      ++total;
+    }
+    EXPECT_EQ(3, total);
+  }
+  std::remove(DATABASE_NAME);
+}
+
+TEST(LogTable, CursorAlongsideWritesAndRetention) {
+  std::remove(DATABASE_NAME);
+  {
+    db::LogTable table(1);
+    uint64_t day1 = dayStart("20260101"), day2 = dayStart("20260102");
+    const int total = LOG_CURSOR_BATCH + 10;
+    for (int i = 0; i < total; ++i) {
+      table.addLog(logRecord(1, day1 + i / 2));  // pairs of records with equal timestamps
+    }
+    table.addLog(logRecord(1, day2));
+
+    // writes and retention are not blocked by a cursor in progress, nor break it
+    int count = 0;
+    uint64_t last_timestamp = 0;
+    db::LogRecord log = db::LogRecord::EMPTY;
+    db::LogCursor cursor = table.getLogs(day1, day2 + 86400000 - 1);
+    while (cursor.next(&log)) {
+      EXPECT_LE(last_timestamp, log.getTimestamp());
+      last_timestamp = log.getTimestamp();
+      if (++count == LOG_CURSOR_BATCH) {
+        table.addLog(logRecord(2, day1 + total));  // later within the range, seen by the cursor
+        EXPECT_EQ(0, table.applyRetention(day2 + 1000));
+      }
+    }
+    EXPECT_EQ(total + 2, count);
+
+    // records of a partition dropped meanwhile end with the batch already read
+    db::LogCursor dropping = table.getLogs(day1, day2 + 86400000 - 1);
+    EXPECT_TRUE(dropping.next(&log));
+    EXPECT_EQ(1, table.applyRetention(dayStart("20260103") + 1000));  // day 1 is gone, day 2 is left
+    count = 0;
+    while (dropping.next(&log)) {
+      ++count;
+    }
+    EXPECT_EQ(LOG_CURSOR_BATCH - 1 + 1, count);
+    EXPECT_EQ(day2, log.getTimestamp());
+  }
+  std::remove(DATABASE_NAME);
+}
+
+}  // namespace test
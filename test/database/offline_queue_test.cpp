@@ -0,0 +1,137 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "database/offline_queue.h"
+
+#define TEST_OFFLINE_DIRECTORY "test_offline"
+
+namespace test {
+
+TEST(OfflineQueue, PopOnceAndSurviveRestart) {
+  removeJournal(TEST_OFFLINE_DIRECTORY);
+  {
+    db::OfflineQueue queue(TEST_OFFLINE_DIRECTORY, TEST_SEGMENT_SIZE, 16, 1000);
+    EXPECT_TRUE(queue.push(1000, 5000, "first"));
+    EXPECT_TRUE(queue.push(1001, 5001, "other"));
+    EXPECT_TRUE(queue.push(1000, 5002, "second"));
+    EXPECT_EQ(2, queue.getPendingCount(1000));
+
+    std::vector<db::SegmentRecord> frames;
+    EXPECT_EQ(2, queue.pop(1000, 5003, &frames));
+    EXPECT_STREQ("first", frames[0].getPayload().c_str());
+    EXPECT_STREQ("second", frames[1].getPayload().c_str());
+    EXPECT_EQ(0, queue.getPendingCount(1000));
+  }
+  {
+    db::OfflineQueue queue(TEST_OFFLINE_DIRECTORY, TEST_SEGMENT_SIZE, 16, 1000);
+    std::vector<db::SegmentRecord> frames;
+    EXPECT_EQ(0, queue.pop(1000, 5004, &frames));  // already delivered before restart
+    EXPECT_EQ(1, queue.pop(1001, 5004, &frames));
+    EXPECT_STREQ("other", frames[0].getPayload().c_str());
+  }
+  removeJournal(TEST_OFFLINE_DIRECTORY);
+}
+
+TEST(OfflineQueue, QuotaAndExpiration) {
+  removeJournal(TEST_OFFLINE_DIRECTORY);
+  {
+    std::string frame(100, 'x');
+    db::OfflineQueue queue(TEST_OFFLINE_DIRECTORY, TEST_SEGMENT_SIZE, 40, 1000);
+    for (int i = 0; i < 40; ++i) {
+      EXPECT_TRUE(queue.push(1000, 5000 + i * 100, frame));
+    }
+    EXPECT_FALSE(queue.push(1000, 9000, frame));  // quota exhausted
+    EXPECT_GT(queue.getSegmentsCount(), 1);
+
+    std::vector<db::SegmentRecord> frames;
+    EXPECT_EQ(11, queue.pop(1000, 8900, &frames));  // the rest is older than ttl
+    EXPECT_EQ(7900, frames[0].getTimestamp());
+    EXPECT_TRUE(queue.push(1000, 9000, frame));
+
+    EXPECT_GT(queue.compact(9000), 0);
+    frames.clear();
+    EXPECT_EQ(1, queue.pop(1000, 9000, &frames));
+  }
+  removeJournal(TEST_OFFLINE_DIRECTORY);
+}
+
+TEST(OfflineQueue, KeepPendingUntilAcknowledged) {
+  removeJournal(TEST_OFFLINE_DIRECTORY);
+  {
+    db::OfflineQueue queue(TEST_OFFLINE_DIRECTORY, TEST_SEGMENT_SIZE, 16, 1000);
+    EXPECT_TRUE(queue.push(1000, 5000, "first"));
+    EXPECT_TRUE(queue.push(1000, 5001, "second"));
+
+    std::vector<db::SegmentRecord> frames;
+    uint64_t last_seq = 0;
+    EXPECT_EQ(2, queue.peek(1000, 5002, &frames, &last_seq));
+    EXPECT_EQ(2, last_seq);
+    EXPECT_EQ(2, queue.getPendingCount(1000));  // sending has failed, say
+
+    frames.clear();
+    EXPECT_EQ(2, queue.peek(1000, 5003, &frames, &last_seq));
+    queue.acknowledge(1000, last_seq, 5003);
+    EXPECT_EQ(0, queue.getPendingCount(1000));
+
+    frames.clear();
+    EXPECT_EQ(0, queue.peek(1000, 5004, &frames, &last_seq));
+    EXPECT_EQ(0, last_seq);  // nothing to acknowledge
+  }
+  {
+    db::OfflineQueue queue(TEST_OFFLINE_DIRECTORY, TEST_SEGMENT_SIZE, 16, 1000);
+    EXPECT_EQ(0, queue.getPendingCount(1000));  // acknowledgement survives restart
+  }
+  removeJournal(TEST_OFFLINE_DIRECTORY);
+}
+
+TEST(OfflineQueue, Capacity) {
+  removeJournal(TEST_OFFLINE_DIRECTORY);
+  {
+    std::string frame(1000, 'x');
+    db::OfflineQueue queue(TEST_OFFLINE_DIRECTORY, TEST_SEGMENT_SIZE, 64, 1000, 2 * TEST_SEGMENT_SIZE);
+    int queued = 0;
+    for (ID_t id = 1000; id < 1020; ++id) {  // every recipient is within its quota
+      queued += queue.push(id, 5000, frame) ? 1 : 0;
+    }
+    EXPECT_EQ(2, queue.getSegmentsCount());
+    EXPECT_LT(queued, 20);
+    EXPECT_GT(queued, 0);
+
+    std::vector<db::SegmentRecord> frames;
+    for (ID_t id = 1000; id < 1020; ++id) {
+      queue.pop(id, 5001, &frames);
+    }
+    EXPECT_EQ(queued, frames.size());
+  }
+  removeJournal(TEST_OFFLINE_DIRECTORY);
+}
+
+}  // namespace test
@@ -0,0 +1,81 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <memory>
+#include <string>
+#include <gtest/gtest.h>
+#include "server/roster_cache.h"
+#include "api/types.h"
+
+namespace test {
+
+static server::RosterCache::Response rosterResponse(const std::string& body) {
+  return std::make_shared<const std::string>(body);
+}
+
+TEST(RosterCache, StaleVersionMiss) {
+  server::RosterCache cache;
+  EXPECT_FALSE(cache.get(500, 100));
+
+  cache.put(500, 100, rosterResponse("v100"));
+  ASSERT_TRUE(cache.get(500, 100));
+  EXPECT_EQ("v100", *cache.get(500, 100));
+  EXPECT_FALSE(cache.get(500, 101));  // list has changed since
+  EXPECT_FALSE(cache.get(600, 100));
+}
+
+TEST(RosterCache, NewerVersionWins) {
+  server::RosterCache cache;
+  cache.put(500, 102, rosterResponse("v102"));
+  cache.put(500, 101, rosterResponse("v101"));  // late writer of older list
+  EXPECT_FALSE(cache.get(500, 101));
+  ASSERT_TRUE(cache.get(500, 102));
+  EXPECT_EQ("v102", *cache.get(500, 102));
+
+  cache.put(500, 103, rosterResponse("v103"));
+  EXPECT_EQ("v103", *cache.get(500, 103));
+  EXPECT_EQ(1, cache.size());
+}
+
+TEST(RosterCache, InvalidateAlsoDropsAllPeers) {
+  server::RosterCache cache;
+  cache.put(500, 100, rosterResponse("500"));
+  cache.put(600, 100, rosterResponse("600"));
+  cache.put(WRONG_CHANNEL, 100, rosterResponse("all"));
+  EXPECT_EQ(3, cache.size());
+
+  cache.invalidate(500);
+  EXPECT_FALSE(cache.get(500, 100));
+  EXPECT_FALSE(cache.get(WRONG_CHANNEL, 100));
+  EXPECT_TRUE(cache.get(600, 100));
+
+  cache.clear();
+  EXPECT_EQ(0, cache.size());
+}
+
+}  // namespace test
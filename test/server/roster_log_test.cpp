@@ -0,0 +1,141 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include "server/roster_log.h"
+
+namespace test {
+
+typedef std::vector<std::pair<RosterMove, Peer>> RosterDeltas;
+
+static Peer rosterPeer(ID_t id, int channel) {
+  return Peer::Builder(id).setLogin("Oleg").setEmail("oleg@ya.ru").setChannel(channel).build();
+}
+
+TEST(RosterLog, VersionPerChannel) {
+  server::RosterLog log(100);
+  EXPECT_EQ(100, log.getVersion(WRONG_CHANNEL));
+  EXPECT_EQ(100, log.getVersion(500));
+
+  EXPECT_EQ(101, log.join(rosterPeer(1000, 500)));
+  EXPECT_EQ(102, log.join(rosterPeer(1001, 600)));
+  EXPECT_EQ(101, log.getVersion(500));
+  EXPECT_EQ(102, log.getVersion(600));
+  EXPECT_EQ(102, log.getVersion(WRONG_CHANNEL));
+
+  EXPECT_EQ(103, log.move(rosterPeer(1000, 600), 500));  // touches both channels
+  EXPECT_EQ(103, log.getVersion(500));
+  EXPECT_EQ(103, log.getVersion(600));
+  EXPECT_EQ(104, log.leave(rosterPeer(1001, 600)));
+  EXPECT_EQ(103, log.getVersion(500));
+  EXPECT_EQ(104, log.getVersion(600));
+}
+
+TEST(RosterLog, ChangesInOrder) {
+  server::RosterLog log(100);
+  log.join(rosterPeer(1000, 500));
+  log.join(rosterPeer(1001, 500));
+  log.leave(rosterPeer(1000, 500));
+
+  RosterDeltas deltas;
+  EXPECT_TRUE(log.getChanges(101, 500, &deltas));
+  ASSERT_EQ(2, deltas.size());
+  EXPECT_EQ(RosterMove::JOIN, deltas[0].first);
+  EXPECT_EQ(1001, deltas[0].second.getId());
+  EXPECT_EQ(RosterMove::LEAVE, deltas[1].first);
+  EXPECT_EQ(1000, deltas[1].second.getId());
+
+  deltas.clear();
+  EXPECT_TRUE(log.getChanges(103, 500, &deltas));  // up to date
+  EXPECT_TRUE(deltas.empty());
+  EXPECT_TRUE(log.getChanges(100, 600, &deltas));  // nothing on that channel
+  EXPECT_TRUE(deltas.empty());
+}
+
+TEST(RosterLog, MoveSeenFromChannels) {
+  server::RosterLog log(100);
+  log.join(rosterPeer(1000, 500));
+  uint64_t version = log.getVersion(WRONG_CHANNEL);
+  log.move(rosterPeer(1000, 600), 500);
+
+  RosterDeltas deltas;
+  EXPECT_TRUE(log.getChanges(version, 500, &deltas));
+  ASSERT_EQ(1, deltas.size());
+  EXPECT_EQ(RosterMove::LEAVE, deltas[0].first);  // moved out
+
+  deltas.clear();
+  EXPECT_TRUE(log.getChanges(version, 600, &deltas));
+  ASSERT_EQ(1, deltas.size());
+  EXPECT_EQ(RosterMove::JOIN, deltas[0].first);  // moved in
+  EXPECT_EQ(600, deltas[0].second.getChannel());
+
+  deltas.clear();
+  EXPECT_TRUE(log.getChanges(version, WRONG_CHANNEL, &deltas));
+  ASSERT_EQ(1, deltas.size());
+  EXPECT_EQ(RosterMove::MOVE, deltas[0].first);  // the whole list only sees new channel
+
+  deltas.clear();
+  EXPECT_TRUE(log.getChanges(version, 700, &deltas));
+  EXPECT_TRUE(deltas.empty());
+}
+
+TEST(RosterLog, FallbackOnTruncation) {
+  server::RosterLog log(100, 3);
+  log.join(rosterPeer(1000, 500));  // 101
+  log.join(rosterPeer(1001, 600));  // 102
+  log.join(rosterPeer(1002, 600));  // 103
+  log.join(rosterPeer(1003, 600));  // 104, 101 is dropped
+
+  RosterDeltas deltas;
+  EXPECT_FALSE(log.getChanges(100, WRONG_CHANNEL, &deltas));
+  EXPECT_FALSE(log.getChanges(100, 600, &deltas));
+  EXPECT_TRUE(log.getChanges(101, WRONG_CHANNEL, &deltas));
+  EXPECT_EQ(3, deltas.size());
+
+  // nothing has changed on channel since, dropped changes do not matter
+  deltas.clear();
+  EXPECT_TRUE(log.getChanges(101, 500, &deltas));
+  EXPECT_TRUE(deltas.empty());
+  EXPECT_EQ(3, log.size());
+}
+
+TEST(RosterLog, FallbackOnVersionAhead) {
+  server::RosterLog log(100);
+  log.join(rosterPeer(1000, 500));
+
+  // version seen before restart, when log went further
+  RosterDeltas deltas;
+  EXPECT_FALSE(log.getChanges(999, 500, &deltas));
+  EXPECT_FALSE(log.getChanges(999, WRONG_CHANNEL, &deltas));
+  EXPECT_FALSE(log.getChanges(999, 600, &deltas));
+  EXPECT_TRUE(deltas.empty());
+}
+
+}  // namespace test
@@ -0,0 +1,110 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "server/session_table.h"
+
+namespace test {
+
+TEST(SessionTable, OpenAndResumeDetached) {
+  server::SessionTable table(1000);
+  std::string token = table.open(1000);
+  EXPECT_EQ(2 * SESSION_TOKEN_BYTES, token.length());
+  EXPECT_NE(token, table.open(1001));
+  EXPECT_FALSE(table.isDetached(1000));
+
+  EXPECT_TRUE(table.detach(1000, 500, 42, 5000));
+  EXPECT_TRUE(table.isDetached(1000));
+
+  server::Session session;
+  EXPECT_EQ(server::ResumeStatus::SUCCESS, table.resume(1000, token, 5500, &session));
+  EXPECT_EQ(1000, session.id);
+  EXPECT_EQ(500, session.channel);
+  EXPECT_EQ(42, session.last_seq);
+  EXPECT_FALSE(table.isDetached(1000));
+}
+
+TEST(SessionTable, RejectAttached) {
+  server::SessionTable table(1000);
+  std::string token = table.open(1000);
+  server::Session session;
+  EXPECT_EQ(server::ResumeStatus::ATTACHED, table.resume(1000, token, 5000, &session));
+
+  // and again once resumed, till the next connection drop
+  EXPECT_TRUE(table.detach(1000, 500, 42, 5000));
+  EXPECT_EQ(server::ResumeStatus::SUCCESS, table.resume(1000, token, 5100, &session));
+  EXPECT_EQ(server::ResumeStatus::ATTACHED, table.resume(1000, token, 5200, &session));
+}
+
+TEST(SessionTable, RejectWrongTokenOrPeer) {
+  server::SessionTable table(1000);
+  std::string token = table.open(1000);
+  std::string other = table.open(1001);
+  EXPECT_TRUE(table.detach(1000, 500, 42, 5000));
+
+  server::Session session;
+  EXPECT_EQ(server::ResumeStatus::NO_SUCH_SESSION, table.resume(1000, other, 5100, &session));
+  EXPECT_EQ(server::ResumeStatus::NO_SUCH_SESSION, table.resume(1001, token, 5100, &session));
+  EXPECT_EQ(server::ResumeStatus::NO_SUCH_SESSION, table.resume(1000, "0123456789abcdef", 5100, &session));
+
+  // superseded by the next login
+  std::string next = table.open(1000);
+  EXPECT_EQ(server::ResumeStatus::NO_SUCH_SESSION, table.resume(1000, token, 5100, &session));
+  table.close(1000);
+  EXPECT_EQ(server::ResumeStatus::NO_SUCH_SESSION, table.resume(1000, next, 5100, &session));
+}
+
+TEST(SessionTable, Expire) {
+  server::SessionTable table(1000);
+  std::string token = table.open(1000);
+  table.open(1001);
+  EXPECT_TRUE(table.detach(1000, 500, 42, 5000));
+
+  std::vector<ID_t> expired;
+  table.expire(5900, &expired);
+  EXPECT_TRUE(expired.empty());
+
+  server::Session session;
+  EXPECT_EQ(server::ResumeStatus::EXPIRED, table.resume(1000, token, 6001, &session));
+  table.expire(6001, &expired);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_EQ(1000, expired[0]);  // attached session of 1001 stays
+  EXPECT_EQ(server::ResumeStatus::NO_SUCH_SESSION, table.resume(1000, token, 6002, &session));
+  EXPECT_FALSE(table.isDetached(1000));
+}
+
+TEST(SessionTable, DetachDisabled) {
+  server::SessionTable table(0);
+  table.open(1000);
+  EXPECT_FALSE(table.detach(1000, 500, 42, 5000));
+  EXPECT_FALSE(table.detach(1001, 500, 42, 5000));  // no session at all
+}
+
+}  // namespace test
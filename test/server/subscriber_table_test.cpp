@@ -0,0 +1,153 @@
+/** 
+ *   HTTP Chat server with authentication and multi-channeling.
+ *
+ *   Copyright (C) 2016  Maxim Alov
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *
+ *   This program and text files composing it, and/or compiled binary files
+ *   (object files, shared objects, binary executables) obtained from text
+ *   files of this program using compiler, as well as other files (text, images, etc.)
+ *   composing this program as a software project, or any part of it,
+ *   cannot be used by 3rd-parties in any commercial way (selling for money or for free,
+ *   advertising, commercial distribution, promotion, marketing, publishing in media, etc.).
+ *   Only the original author - Maxim Alov - has right to do any of the above actions.
+ */
+
+#include <errno.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "server/subscriber_table.h"
+
+namespace test {
+
+/* Fake sockets: accept up to given bytes per write, -1 - gone */
+class FakeSockets {
+public:
+  std::map<int, ssize_t> capacity;
+  std::map<int, std::vector<std::string>> writes;
+  std::set<int> closed;
+
+  void attach(server::SubscriberTable& table) {
+    table.setWriter([this](int socket, const char* buffer, size_t length) -> ssize_t {
+      ssize_t accepted = capacity[socket];
+      if (accepted < 0) {
+        errno = EPIPE;
+        return -1;
+      }
+      if (accepted == 0) {
+        errno = EAGAIN;
+        return -1;
+      }
+      size_t written = std::min(static_cast<size_t>(accepted), length);
+      writes[socket].emplace_back(buffer, length);
+      return written;
+    });
+    table.setCloser([this](int socket) { closed.insert(socket); });
+  }
+};
+
+TEST(SubscriberTable, PublishToChannel) {
+  FakeSockets sockets;  // outlives table, which closes sockets on destruction
+  server::SubscriberTable table;
+  sockets.attach(table);
+  sockets.capacity[10] = 1024;
+  sockets.capacity[11] = 1024;
+  sockets.capacity[12] = 1024;
+  table.subscribe(10, 500);
+  table.subscribe(11, 500);
+  table.subscribe(12, 600);
+  table.subscribe(12, 600);  // no duplicates
+  EXPECT_EQ(3, table.size());
+
+  EXPECT_EQ(2, table.publish(500, "event"));
+  EXPECT_EQ(0, table.publish(700, "event"));
+  EXPECT_EQ(1, sockets.writes[10].size());
+  EXPECT_EQ(1, sockets.writes[11].size());
+  EXPECT_TRUE(sockets.writes[12].empty());
+  EXPECT_EQ("event", sockets.writes[10][0]);
+}
+
+TEST(SubscriberTable, BatchBacklog) {
+  FakeSockets sockets;
+  server::SubscriberTable table;
+  sockets.attach(table);
+  sockets.capacity[10] = 2;
+  table.subscribe(10, 500);
+
+  EXPECT_EQ(1, table.publish(500, "first;"));  // 'fi' went out
+  sockets.capacity[10] = 0;
+  EXPECT_EQ(1, table.publish(500, "second;"));  // socket is backed up, kept
+  sockets.capacity[10] = 1024;
+  EXPECT_EQ(1, table.publish(500, "third;"));
+
+  // backlog goes out together with the new event in a single write
+  ASSERT_EQ(2, sockets.writes[10].size());
+  EXPECT_EQ("first;", sockets.writes[10][0]);
+  EXPECT_EQ("rst;second;third;", sockets.writes[10][1]);
+
+  EXPECT_EQ(1, table.publish(500, "fourth;"));  // backlog is empty again
+  ASSERT_EQ(3, sockets.writes[10].size());
+  EXPECT_EQ("fourth;", sockets.writes[10][2]);
+  EXPECT_TRUE(sockets.closed.empty());
+}
+
+TEST(SubscriberTable, DropSlow) {
+  FakeSockets sockets;
+  server::SubscriberTable table;
+  sockets.attach(table);
+  sockets.capacity[10] = 0;
+  sockets.capacity[11] = 1024 * 1024;
+  table.subscribe(10, 500);
+  table.subscribe(11, 500);
+
+  std::string event(SSE_MAX_PENDING_BYTES / 4, 'x');
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(2, table.publish(500, event));  // still within the limit
+  }
+  EXPECT_TRUE(sockets.closed.empty());
+
+  EXPECT_EQ(1, table.publish(500, event));
+  EXPECT_EQ(1, sockets.closed.count(10));
+  EXPECT_EQ(0, sockets.closed.count(11));
+  EXPECT_EQ(1, table.size());
+}
+
+TEST(SubscriberTable, DropDead) {
+  FakeSockets sockets;
+  server::SubscriberTable table;
+  sockets.attach(table);
+  sockets.capacity[10] = -1;
+  sockets.capacity[11] = 1024;
+  sockets.capacity[12] = -1;
+  table.subscribe(10, 500);
+  table.subscribe(11, 500);
+  table.subscribe(12, 600);
+
+  EXPECT_EQ(2, table.publishAll(": heartbeat\n\n"));
+  EXPECT_EQ(2, sockets.closed.size());
+  EXPECT_EQ(0, sockets.closed.count(11));
+  EXPECT_EQ(1, table.size());
+  EXPECT_EQ(0, table.publish(600, "event"));
+
+  table.clear();
+  EXPECT_EQ(1, sockets.closed.count(11));
+  EXPECT_EQ(0, table.size());
+}
+
+}  // namespace test
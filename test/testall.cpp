@@ -29,15 +29,30 @@
 #include <gtest/gtest.h>
 #include "common/common_test.cpp"
 #include "common/parser_test.cpp"
+#include "common/websocket_test.cpp"
+#include "common/wire_test.cpp"
+#include "database/journal_test.cpp"
+#include "database/history_test.cpp"
+#include "database/offline_queue_test.cpp"
+#include "database/log_table_test.cpp"
+#include "server/roster_cache_test.cpp"
+#include "server/roster_log_test.cpp"
+#include "server/session_table_test.cpp"
+#include "server/subscriber_table_test.cpp"
 #if SECURE
+#include "crypting/aead_cryptor_test.cpp"
 #include "crypting/aes_cryptor_test.cpp"
+#include "crypting/agreement_test.cpp"
 #include "crypting/evp_cryptor_test.cpp"
+#include "crypting/key_pool_test.cpp"
 #if USE_BORINGSSL
   // omit rsa_cryptor_test
 #else
 #include "crypting/rsa_cryptor_test.cpp"
 #endif  // USE_BORINGSSL
 #include "crypting/crypting_util_test.cpp"
+#include "crypting/crypto_pool_test.cpp"
+#include "crypting/tls_terminator_test.cpp"
 #endif  // SECURE
 
 int main(int argc, char **argv) {